@@ -795,9 +795,15 @@ again:
 		l0 = SPA_MIN(n_bytes, maxsize - offs);
 		l1 = n_bytes - l0;
 
-		spa_memcpy(dst, src + offs, l0);
-		if (l1 > 0)
-			spa_memcpy(dst + l0, src, l1);
+		if (b->h && SPA_FLAG_IS_SET(b->h->flags, SPA_META_HEADER_FLAG_GAP)) {
+			/* the buffer is silence, no need to read it */
+			snd_pcm_areas_silence(my_areas, off, state->channels,
+					n_frames, state->format);
+		} else {
+			spa_memcpy(dst, src + offs, l0);
+			if (l1 > 0)
+				spa_memcpy(dst + l0, src, l1);
+		}
 
 		state->ready_offset += n_bytes;
 
@@ -259,6 +259,7 @@ static int negotiate_buffers(struct impl *this)
 	uint32_t i, size, buffers, blocks, align, flags;
 	uint32_t *aligns;
 	struct spa_data *datas;
+	struct spa_meta metas[1];
 	uint32_t slave_flags, conv_flags;
 
 	spa_log_debug(this->log, "%p: %d", this, this->n_buffers);
@@ -326,8 +327,12 @@ static int negotiate_buffers(struct impl *this)
 		aligns[i] = align;
 	}
 
+	/* the slave can mark silence with the GAP flag of the header */
+	metas[0].type = SPA_META_Header;
+	metas[0].size = sizeof(struct spa_meta_header);
+
 	free(this->buffers);
-	this->buffers = spa_buffer_alloc_array(buffers, flags, 0, NULL, blocks, datas, aligns);
+	this->buffers = spa_buffer_alloc_array(buffers, flags, 1, metas, blocks, datas, aligns);
 	if (this->buffers == NULL)
 		return -errno;
 	this->n_buffers = buffers;
@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <spa/support/plugin.h>
 #include <spa/support/log.h>
@@ -38,12 +39,21 @@
 #include <spa/node/utils.h>
 #include <spa/param/audio/format-utils.h>
 #include <spa/param/param.h>
+#include <spa/param/props.h>
 #include <spa/pod/filter.h>
 #include <spa/debug/pod.h>
 #include <spa/debug/types.h>
 
+#include "channelmix-ops.h"
+#include "resample.h"
+#include "resample-native.h"
+
 #define NAME "audioconvert"
 
+/* number of samples that are mixed and resampled in one go in fused mode,
+ * small enough to keep the intermediate data in the cache */
+#define FUSED_BLOCK	256u
+
 struct buffer {
 	struct spa_list link;
 #define BUFFER_FLAG_OUT		(1 << 0)
@@ -109,8 +119,29 @@ struct impl {
 
 	struct spa_hook listener[2];
 
+	struct spa_io_position *io_position;
+	struct spa_io_rate_match *io_rate_match;
+
+	/* fused mode, channelmix and resample run here directly between
+	 * the buffers of the first and the last link */
+	struct channelmix mix;
+	struct resample resampler;
+	uint32_t cpu_flags;
+	uint32_t quality;
+	uint32_t in_offset;
+	uint32_t out_offset;
+	uint32_t out_buffer;
+	void *tmp_mem;
+	float *tmp[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t gap_samples;
+
 	unsigned int started:1;
 	unsigned int add_listener:1;
+	unsigned int split:1;
+	unsigned int fuse:1;
+	unsigned int fused:1;
+	unsigned int tmp_silent:1;
+	unsigned int out_gap:1;		/* output buffer holds only silence so far */
 };
 
 #define IS_MONITOR_PORT(this,dir,port_id) (dir == SPA_DIRECTION_OUTPUT && port_id > 0 &&	\
@@ -256,6 +287,145 @@ static int negotiate_link_format(struct impl *this, struct link *link)
 	return 0;
 }
 
+static int port_get_format(struct impl *this, struct spa_node *node,
+		enum spa_direction direction, struct spa_audio_info_raw *info)
+{
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod *param;
+	uint32_t state = 0;
+
+	if (spa_node_port_enum_params_sync(node, direction, 0,
+			SPA_PARAM_Format, &state, NULL, &param, &b) != 1)
+		return -EIO;
+
+	spa_zero(*info);
+	return spa_format_audio_raw_parse(param, info);
+}
+
+/* take the volumes from the channelmix node, it owns the Props */
+static void update_fused_volume(struct impl *this)
+{
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod *param, *channel_volumes = NULL;
+	float volume = 1.0f, volumes[SPA_AUDIO_MAX_CHANNELS];
+	int mute = false;
+	uint32_t i, state = 0, n_volumes = 0;
+
+	for (i = 0; i < SPA_AUDIO_MAX_CHANNELS; i++)
+		volumes[i] = 1.0f;
+
+	if (spa_node_enum_params_sync(this->channelmix,
+			SPA_PARAM_Props, &state, NULL, &param, &b) == 1 &&
+	    spa_pod_parse_object(param,
+			SPA_TYPE_OBJECT_Props, NULL,
+			SPA_PROP_volume,		SPA_POD_OPT_Float(&volume),
+			SPA_PROP_mute,			SPA_POD_OPT_Bool(&mute),
+			SPA_PROP_channelVolumes,	SPA_POD_OPT_Pod(&channel_volumes)) >= 0 &&
+	    channel_volumes != NULL)
+		n_volumes = spa_pod_copy_array(channel_volumes, SPA_TYPE_Float,
+				volumes, SPA_AUDIO_MAX_CHANNELS);
+
+	channelmix_set_volume(&this->mix, volume, mute, n_volumes, volumes);
+}
+
+static void clean_fused(struct impl *this)
+{
+	if (this->resampler.free)
+		resample_free(&this->resampler);
+	if (this->mix.free)
+		channelmix_free(&this->mix);
+	spa_zero(this->resampler);
+	spa_zero(this->mix);
+	free(this->tmp_mem);
+	this->tmp_mem = NULL;
+	this->fused = false;
+}
+
+/* Plan the fused conversion. The formats are negotiated on all links as
+ * before so that the formats of the channelmix and resample nodes are known,
+ * we then run their kernels ourselves directly from the buffers of the first
+ * link into the buffers of the last link, in small blocks. */
+static int setup_fused(struct impl *this)
+{
+	struct spa_audio_info_raw src_info, dst_info;
+	uint32_t i, src_chan, dst_chan, stride;
+	uint64_t src_mask, dst_mask;
+	void *tmp;
+	int res;
+
+	if ((res = port_get_format(this, this->channelmix, SPA_DIRECTION_INPUT, &src_info)) < 0 ||
+	    (res = port_get_format(this, this->resample, SPA_DIRECTION_OUTPUT, &dst_info)) < 0)
+		return res;
+
+	src_chan = src_info.channels;
+	dst_chan = dst_info.channels;
+
+	for (i = 0, src_mask = 0; i < src_chan; i++)
+		src_mask |= 1UL << src_info.position[i];
+	for (i = 0, dst_mask = 0; i < dst_chan; i++)
+		dst_mask |= 1UL << dst_info.position[i];
+
+	if (src_mask & 1 || src_chan == 1)
+		src_mask = channelmix_default_mask(src_chan);
+	if (dst_mask & 1 || dst_chan == 1)
+		dst_mask = channelmix_default_mask(dst_chan);
+
+	this->mix.src_chan = src_chan;
+	this->mix.src_mask = src_mask;
+	this->mix.dst_chan = dst_chan;
+	this->mix.dst_mask = dst_mask;
+	this->mix.cpu_flags = this->cpu_flags;
+	this->mix.log = this->log;
+
+	if ((res = channelmix_init(&this->mix)) < 0)
+		goto error;
+
+	update_fused_volume(this);
+
+	this->resampler.channels = dst_chan;
+	this->resampler.i_rate = src_info.rate;
+	this->resampler.o_rate = dst_info.rate;
+	this->resampler.cpu_flags = this->cpu_flags;
+	this->resampler.quality = this->quality;
+	this->resampler.log = this->log;
+
+	if ((res = impl_native_init(&this->resampler)) < 0)
+		goto error;
+
+	stride = SPA_ROUND_UP_N(FUSED_BLOCK * sizeof(float), 64);
+	if ((this->tmp_mem = malloc(dst_chan * stride + 64)) == NULL) {
+		res = -errno;
+		goto error;
+	}
+	tmp = SPA_PTR_ALIGN(this->tmp_mem, 64, void);
+	for (i = 0; i < dst_chan; i++)
+		this->tmp[i] = SPA_MEMBER(tmp, i * stride, float);
+
+	this->in_offset = 0;
+	this->out_offset = 0;
+	this->out_buffer = 0;
+	this->gap_samples = 0;
+	this->tmp_silent = false;
+
+	/* the middle stage is run by process_fused() */
+	this->nodes[1] = NULL;
+	this->nodes[2] = this->nodes[3];
+	this->n_nodes = 3;
+	this->fused = true;
+
+	spa_log_info(this->log, NAME " %p: fused %d@%d->%d@%d identity:%d", this,
+			src_chan, src_info.rate, dst_chan, dst_info.rate,
+			this->mix.identity);
+
+	return 0;
+
+error:
+	clean_fused(this);
+	return res;
+}
+
 static int setup_convert(struct impl *this)
 {
 	int i, j, res;
@@ -287,6 +457,11 @@ static int setup_convert(struct impl *this)
 		if ((res = negotiate_link_format(this, &this->links[j])) < 0)
 			return res;
 	}
+
+	if (this->fuse && (res = setup_fused(this)) < 0)
+		spa_log_warn(this->log, NAME " %p: can't fuse, using nodes: %s",
+				this, spa_strerror(res));
+
 	return 0;
 }
 
@@ -301,6 +476,7 @@ static int negotiate_link_buffers(struct impl *this, struct link *link)
 	uint32_t i, size, buffers, blocks, align, flags;
 	uint32_t *aligns;
 	struct spa_data *datas;
+	struct spa_meta metas[1];
 
 	if (link->n_buffers > 0)
 		return 0;
@@ -361,11 +537,15 @@ static int negotiate_link_buffers(struct impl *this, struct link *link)
 		aligns[i] = align;
 	}
 
+	/* the header carries the GAP flag between the nodes */
+	metas[0].type = SPA_META_Header;
+	metas[0].size = sizeof(struct spa_meta_header);
+
 	buffers = SPA_MAX(link->min_buffers, buffers);
 
 	if (link->buffers)
 		free(link->buffers);
-	link->buffers = spa_buffer_alloc_array(buffers, flags, 0, NULL, blocks, datas, aligns);
+	link->buffers = spa_buffer_alloc_array(buffers, flags, 1, metas, blocks, datas, aligns);
 	if (link->buffers == NULL)
 		return -errno;
 
@@ -392,6 +572,8 @@ static void clean_convert(struct impl *this)
 
 	spa_log_debug(this->log, NAME " %p: %d", this, this->n_links);
 
+	clean_fused(this);
+
 	for (i = 0; i < this->n_links; i++)
 		clean_link(this, &this->links[i]);
 	this->n_links = 0;
@@ -505,6 +687,7 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 
 	switch (id) {
 	case SPA_IO_Position:
+		this->io_position = data;
 		res = spa_node_set_io(this->resample, id, data, size);
 		break;
 	default:
@@ -753,6 +936,8 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 	case SPA_PARAM_Props:
 	{
 		res = spa_node_set_param(this->channelmix, id, flags, param);
+		if (res >= 0 && this->fused)
+			update_fused_volume(this);
 		break;
 	}
 	default:
@@ -1006,6 +1191,7 @@ impl_node_port_set_io(void *object,
 
 	switch (id) {
 	case SPA_IO_RateMatch:
+		this->io_rate_match = data;
 		res = spa_node_port_set_io(this->resample, direction, 0, id, data, size);
 		break;
 	default:
@@ -1035,6 +1221,146 @@ static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t
 	return spa_node_port_reuse_buffer(target, port_id, buffer_id);
 }
 
+/* channelmix and resample from the first link into the last link, this
+ * follows what the resample node does with the buffers and offsets */
+static int process_fused(struct impl *this)
+{
+	struct link *in = &this->links[0];
+	struct link *out = &this->links[this->n_links - 1];
+	struct spa_io_buffers *inio = &in->io, *outio = &out->io;
+	struct spa_buffer *sb, *db;
+	struct spa_meta_header *sh, *dh;
+	uint32_t i, size, maxsize, max, in_len, out_len, in_offset, out_offset;
+	const void *src_datas[SPA_AUDIO_MAX_CHANNELS];
+	void *dst_datas[SPA_AUDIO_MAX_CHANNELS];
+	bool flush_out = false, flush_in = false, gap, out_gap;
+	int res = 0;
+
+	if (outio->status == SPA_STATUS_HAVE_DATA)
+		return SPA_STATUS_HAVE_DATA;
+
+	if (inio->status != SPA_STATUS_HAVE_DATA)
+		return SPA_STATUS_NEED_DATA;
+
+	if (inio->buffer_id >= in->n_buffers)
+		return inio->status = -EINVAL;
+
+	sb = in->buffers[inio->buffer_id];
+	db = out->buffers[this->out_buffer];
+
+	size = sb->datas[0].chunk->size / sizeof(float);
+	maxsize = db->datas[0].maxsize / sizeof(float);
+
+	/* silence does not need to be mixed, only resampled until the
+	 * history of the resampler is silent as well */
+	sh = spa_buffer_find_meta_data(sb, SPA_META_Header, sizeof(*sh));
+	dh = spa_buffer_find_meta_data(db, SPA_META_Header, sizeof(*dh));
+	gap = (sh && SPA_FLAG_IS_SET(sh->flags, SPA_META_HEADER_FLAG_GAP)) ||
+		this->mix.zero;
+	out_gap = gap && this->gap_samples >= resample_delay(&this->resampler);
+
+	if (this->io_position)
+		max = this->io_position->clock.duration;
+	else
+		max = maxsize;
+
+	if (this->split) {
+		maxsize = SPA_MIN(maxsize, max);
+		flush_out = flush_in = this->io_rate_match != NULL;
+	} else {
+		flush_out = true;
+	}
+
+	if (this->io_rate_match) {
+		if (SPA_FLAG_IS_SET(this->io_rate_match->flags, SPA_IO_RATE_MATCH_FLAG_ACTIVE))
+			resample_update_rate(&this->resampler, this->io_rate_match->rate);
+		else
+			resample_update_rate(&this->resampler, 1.0);
+	}
+
+	in_offset = this->in_offset;
+	out_offset = this->out_offset;
+
+	while (in_offset < size && out_offset < maxsize) {
+		in_len = size - in_offset;
+		out_len = maxsize - out_offset;
+
+		for (i = 0; i < sb->n_datas; i++)
+			src_datas[i] = SPA_MEMBER(sb->datas[i].data, in_offset * sizeof(float), void);
+		for (i = 0; i < db->n_datas; i++)
+			dst_datas[i] = SPA_MEMBER(db->datas[i].data, out_offset * sizeof(float), void);
+
+		if (this->mix.identity) {
+			/* no mixing, resample straight from the input */
+			resample_process(&this->resampler, src_datas, &in_len, dst_datas, &out_len);
+		} else if (gap) {
+			in_len = SPA_MIN(in_len, FUSED_BLOCK);
+			if (!this->tmp_silent) {
+				for (i = 0; i < this->mix.dst_chan; i++)
+					memset(this->tmp[i], 0, FUSED_BLOCK * sizeof(float));
+				this->tmp_silent = true;
+			}
+			resample_process(&this->resampler, (const void **)this->tmp, &in_len,
+					dst_datas, &out_len);
+		} else {
+			in_len = SPA_MIN(in_len, FUSED_BLOCK);
+			channelmix_process(&this->mix, this->mix.dst_chan, (void **)this->tmp,
+					sb->n_datas, src_datas, in_len);
+			this->tmp_silent = false;
+			resample_process(&this->resampler, (const void **)this->tmp, &in_len,
+					dst_datas, &out_len);
+		}
+		if (in_len == 0 && out_len == 0)
+			break;
+
+		if (gap)
+			this->gap_samples = SPA_MIN(this->gap_samples + in_len, UINT32_MAX / 2);
+		else
+			this->gap_samples = 0;
+
+		in_offset += in_len;
+		out_offset += out_len;
+	}
+
+	spa_log_trace_fp(this->log, NAME " %p: fused in %d/%d out %d/%d max:%d", this,
+			in_offset, size, out_offset, maxsize, max);
+
+	for (i = 0; i < db->n_datas; i++) {
+		db->datas[i].chunk->size = out_offset * sizeof(float);
+		db->datas[i].chunk->offset = 0;
+	}
+	if (this->out_offset == 0)
+		this->out_gap = true;
+	this->out_gap &= out_gap;
+
+	if (in_offset >= size || flush_in) {
+		inio->status = SPA_STATUS_NEED_DATA;
+		in_offset = 0;
+		SPA_FLAG_SET(res, SPA_STATUS_NEED_DATA);
+	}
+	if (out_offset > 0 && (out_offset >= maxsize || flush_out)) {
+		if (dh) {
+			if (this->out_gap)
+				SPA_FLAG_SET(dh->flags, SPA_META_HEADER_FLAG_GAP);
+			else
+				SPA_FLAG_CLEAR(dh->flags, SPA_META_HEADER_FLAG_GAP);
+		}
+		outio->status = SPA_STATUS_HAVE_DATA;
+		outio->buffer_id = this->out_buffer;
+		this->out_buffer = (this->out_buffer + 1) % out->n_buffers;
+		out_offset = 0;
+		SPA_FLAG_SET(res, SPA_STATUS_HAVE_DATA);
+	}
+	this->in_offset = in_offset;
+	this->out_offset = out_offset;
+
+	if (this->io_rate_match) {
+		this->io_rate_match->delay = resample_delay(&this->resampler);
+		this->io_rate_match->size = resample_in_len(&this->resampler, max);
+	}
+	return res;
+}
+
 static int impl_node_process(void *object)
 {
 	struct impl *this = object;
@@ -1049,7 +1375,10 @@ static int impl_node_process(void *object)
 		res = SPA_STATUS_OK;
 		ready = 0;
 		for (i = 0; i < this->n_nodes; i++) {
-			r = spa_node_process(this->nodes[i]);
+			if (this->nodes[i] == NULL)
+				r = process_fused(this);
+			else
+				r = spa_node_process(this->nodes[i]);
 			spa_log_trace_fp(this->log, NAME " %p: process %d %d: %s",
 					this, i, r, r < 0 ? spa_strerror(r) : "ok");
 			if (r < 0)
@@ -1163,6 +1492,7 @@ impl_init(const struct spa_handle_factory *factory,
 	uint32_t i;
 	size_t size;
 	void *iface;
+	const char *str;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -1183,8 +1513,25 @@ impl_init(const struct spa_handle_factory *factory,
 		}
 	}
 
-	if (this->cpu)
+	if (this->cpu) {
 		this->max_align = spa_cpu_get_max_align(this->cpu);
+		this->cpu_flags = spa_cpu_get_flags(this->cpu);
+	}
+
+	/* the resample node defaults to split mode */
+	this->split = true;
+	this->fuse = true;
+	this->quality = RESAMPLE_DEFAULT_QUALITY;
+	if (info != NULL) {
+		if ((str = spa_dict_lookup(info, "factory.mode")) != NULL)
+			this->split = strcmp(str, "split") == 0;
+		if ((str = spa_dict_lookup(info, "resample.peaks")) != NULL && atoi(str))
+			this->fuse = false;
+		if ((str = spa_dict_lookup(info, "audioconvert.fused")) != NULL)
+			this->fuse &= strcmp(str, "true") == 0 || atoi(str) == 1;
+		if ((str = spa_dict_lookup(info, "resample.quality")) != NULL)
+			this->quality = impl_native_parse_quality(this->log, str);
+	}
 
 	this->node.iface = SPA_INTERFACE_INIT(
 			SPA_TYPE_INTERFACE_Node,
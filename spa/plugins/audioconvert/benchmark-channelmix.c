@@ -0,0 +1,208 @@
+/* Spa
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/support/log-impl.h>
+
+SPA_LOG_IMPL(logger);
+
+#include "channelmix-ops.c"
+
+struct stats {
+	uint32_t n_samples;
+	uint32_t n_src;
+	uint32_t n_dst;
+	uint64_t perf;
+	const char *name;
+	const char *impl;
+};
+
+#define MAX_SAMPLES	4096
+#define MAX_CHANNELS	11
+
+#define MAX_COUNT 1000
+
+static float samp_in[MAX_CHANNELS][MAX_SAMPLES] __attribute__ ((aligned (32)));
+static float samp_out[MAX_CHANNELS][MAX_SAMPLES] __attribute__ ((aligned (32)));
+
+static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
+
+#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * 64
+
+static uint32_t n_results = 0;
+static struct stats results[MAX_RESULTS];
+
+static uint32_t cpu_flags;
+
+static void run_test1(const char *name, const char *impl, channelmix_func_t func,
+		struct channelmix *mix, int n_samples)
+{
+	uint32_t i, j;
+	const void *ip[mix->src_chan];
+	void *op[mix->dst_chan];
+	struct timespec ts;
+	uint64_t count, t1, t2;
+
+	for (j = 0; j < mix->src_chan; j++)
+		ip[j] = samp_in[j];
+	for (j = 0; j < mix->dst_chan; j++)
+		op[j] = samp_out[j];
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		func(mix, mix->dst_chan, op, mix->src_chan, ip, n_samples);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.n_samples = n_samples,
+		.n_src = mix->src_chan,
+		.n_dst = mix->dst_chan,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+		.name = name,
+		.impl = impl
+	};
+}
+
+static void run_test(const char *name, const char *impl, channelmix_func_t func,
+		uint32_t src_chan, uint64_t src_mask, uint32_t dst_chan, uint64_t dst_mask)
+{
+	struct channelmix mix;
+	float volumes[SPA_AUDIO_MAX_CHANNELS];
+	size_t i;
+
+	spa_zero(mix);
+	mix.src_chan = src_chan;
+	mix.src_mask = src_mask;
+	mix.dst_chan = dst_chan;
+	mix.dst_mask = dst_mask;
+	mix.log = &logger.log;
+	spa_assert(channelmix_init(&mix) == 0);
+
+	for (i = 0; i < src_chan; i++)
+		volumes[i] = 1.0f;
+	channelmix_set_volume(&mix, 0.5f, false, src_chan, volumes);
+
+	for (i = 0; i < SPA_N_ELEMENTS(sample_sizes); i++)
+		run_test1(name, impl, func, &mix, sample_sizes[i]);
+}
+
+static void test_7p1(void)
+{
+	run_test("test_7p1_2", "c", channelmix_f32_7p1_2_c, 8, MASK_7_1, 2, MASK_STEREO);
+	run_test("test_7p1_3p1", "c", channelmix_f32_7p1_3p1_c, 8, MASK_7_1, 4, MASK_3_1);
+	run_test("test_7p1_4", "c", channelmix_f32_7p1_4_c, 8, MASK_7_1, 4, MASK_QUAD);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE) {
+		run_test("test_7p1_2", "sse", channelmix_f32_7p1_2_sse, 8, MASK_7_1, 2, MASK_STEREO);
+		run_test("test_7p1_3p1", "sse", channelmix_f32_7p1_3p1_sse, 8, MASK_7_1, 4, MASK_3_1);
+		run_test("test_7p1_4", "sse", channelmix_f32_7p1_4_sse, 8, MASK_7_1, 4, MASK_QUAD);
+	}
+#endif
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+	if (SPA_FLAG_IS_SET(cpu_flags, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3)) {
+		run_test("test_7p1_2", "avx", channelmix_f32_7p1_2_avx, 8, MASK_7_1, 2, MASK_STEREO);
+		run_test("test_7p1_3p1", "avx", channelmix_f32_7p1_3p1_avx, 8, MASK_7_1, 4, MASK_3_1);
+		run_test("test_7p1_4", "avx", channelmix_f32_7p1_4_avx, 8, MASK_7_1, 4, MASK_QUAD);
+	}
+#endif
+}
+
+#define MASK_5_1_SIDE	_M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR)
+
+static void test_n_m(void)
+{
+	run_test("test_7p1_5p1", "c", channelmix_f32_n_m_c, 8, MASK_7_1, 6, MASK_5_1_SIDE);
+	run_test("test_7p1_1", "c", channelmix_f32_n_m_c, 8, MASK_7_1, 1, MASK_MONO);
+	run_test("test_5p1_7p1", "c", channelmix_f32_n_m_c, 6, MASK_5_1_SIDE, 8, MASK_7_1);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE) {
+		run_test("test_7p1_5p1", "sse", channelmix_f32_n_m_sse, 8, MASK_7_1, 6, MASK_5_1_SIDE);
+		run_test("test_7p1_1", "sse", channelmix_f32_n_m_sse, 8, MASK_7_1, 1, MASK_MONO);
+		run_test("test_5p1_7p1", "sse", channelmix_f32_n_m_sse, 6, MASK_5_1_SIDE, 8, MASK_7_1);
+	}
+#endif
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+	if (SPA_FLAG_IS_SET(cpu_flags, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3)) {
+		run_test("test_7p1_5p1", "avx", channelmix_f32_n_m_avx, 8, MASK_7_1, 6, MASK_5_1_SIDE);
+		run_test("test_7p1_1", "avx", channelmix_f32_n_m_avx, 8, MASK_7_1, 1, MASK_MONO);
+		run_test("test_5p1_7p1", "avx", channelmix_f32_n_m_avx, 6, MASK_5_1_SIDE, 8, MASK_7_1);
+	}
+#endif
+}
+
+static int compare_func(const void *_a, const void *_b)
+{
+	const struct stats *a = _a, *b = _b;
+	int diff;
+	if ((diff = strcmp(a->name, b->name)) != 0) return diff;
+	if ((diff = a->n_samples - b->n_samples) != 0) return diff;
+	if ((diff = b->perf - a->perf) != 0) return diff;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i, j;
+
+	logger.log.level = SPA_LOG_LEVEL_WARN;
+
+#if defined (HAVE_SSE)
+	if (__builtin_cpu_supports("sse"))
+		cpu_flags |= SPA_CPU_FLAG_SSE;
+#endif
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+	if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("fma"))
+		cpu_flags |= SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3;
+#endif
+
+	for (i = 0; i < MAX_CHANNELS; i++)
+		for (j = 0; j < MAX_SAMPLES; j++)
+			samp_in[i][j] = (float)drand48() - 0.5f;
+
+	test_7p1();
+	test_n_m();
+
+	qsort(results, n_results, sizeof(struct stats), compare_func);
+
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		fprintf(stderr, "%-12."PRIu64" \t%-32.32s %s \t samples %d, channels %d->%d\n",
+				s->perf, s->name, s->impl, s->n_samples, s->n_src, s->n_dst);
+	}
+	return 0;
+}
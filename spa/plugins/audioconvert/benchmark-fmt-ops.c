@@ -50,11 +50,13 @@ static uint8_t samp_out[MAX_SAMPLES * MAX_CHANNELS * 4];
 static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
 static const int channel_counts[] = { 1, 2, 4, 6, 8, 11 };
 
-#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(channel_counts) * 60
+#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(channel_counts) * 120
 
 static uint32_t n_results = 0;
 static struct stats results[MAX_RESULTS];
 
+static uint32_t cpu_flags;
+
 static void run_test1(const char *name, const char *impl, bool in_packed, bool out_packed,
 		convert_func_t func, int n_channels, int n_samples)
 {
@@ -66,6 +68,8 @@ static void run_test1(const char *name, const char *impl, bool in_packed, bool o
 	struct convert conv;
 
 	conv.n_channels = n_channels;
+	conv.method = DITHER_METHOD_TRIANGULAR;
+	init_dither(&conv);
 
 	for (j = 0; j < n_channels; j++) {
 		ip[j] = &samp_in[j * n_samples * 4];
@@ -112,6 +116,14 @@ static void test_f32_u8(void)
 	run_test("test_f32d_u8", "c", false, true, conv_f32d_to_u8_c);
 	run_test("test_f32_u8d", "c", true, false, conv_f32_to_u8d_c);
 	run_test("test_f32d_u8d", "c", false, false, conv_f32d_to_u8d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_u8", "avx2", true, true, conv_f32_to_u8_avx2);
+		run_test("test_f32d_u8", "avx2", false, true, conv_f32d_to_u8_avx2);
+		run_test("test_f32_u8d", "avx2", true, false, conv_f32_to_u8d_avx2);
+		run_test("test_f32d_u8d", "avx2", false, false, conv_f32d_to_u8d_avx2);
+	}
+#endif
 }
 
 static void test_u8_f32(void)
@@ -119,6 +131,13 @@ static void test_u8_f32(void)
 	run_test("test_u8_f32", "c", true, true, conv_u8_to_f32_c);
 	run_test("test_u8d_f32", "c", false, true, conv_u8d_to_f32_c);
 	run_test("test_u8_f32d", "c", true, false, conv_u8_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_u8_f32", "avx2", true, true, conv_u8_to_f32_avx2);
+		run_test("test_u8d_f32", "avx2", false, true, conv_u8d_to_f32_avx2);
+		run_test("test_u8_f32d", "avx2", true, false, conv_u8_to_f32d_avx2);
+	}
+#endif
 }
 
 static void test_f32_s16(void)
@@ -129,6 +148,32 @@ static void test_f32_s16(void)
 	run_test("test_f32d_s16", "sse2", false, true, conv_f32d_to_s16_sse2);
 #endif
 	run_test("test_f32_s16d", "c", true, false, conv_f32_to_s16d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s16", "avx2", true, true, conv_f32_to_s16_avx2);
+		run_test("test_f32d_s16", "avx2", false, true, conv_f32d_to_s16_avx2);
+		run_test("test_f32_s16d", "avx2", true, false, conv_f32_to_s16d_avx2);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32d_s16", "neon", false, true, conv_f32d_to_s16_neon);
+	}
+#endif
+}
+
+static void test_f32_s16_dither(void)
+{
+	run_test("test_f32_s16_dither", "c", true, true, conv_f32_to_s16_dither_c);
+	run_test("test_f32d_s16_dither", "c", false, true, conv_f32d_to_s16_dither_c);
+	run_test("test_f32d_s16d_dither", "c", false, false, conv_f32d_to_s16d_dither_c);
+#if defined (HAVE_SSE2)
+	run_test("test_f32_s16_dither", "sse2", true, true, conv_f32_to_s16_dither_sse2);
+	run_test("test_f32d_s16_dither", "sse2", false, true, conv_f32d_to_s16_dither_sse2);
+	run_test("test_f32d_s16d_dither", "sse2", false, false, conv_f32d_to_s16d_dither_sse2);
+#endif
+	run_test("test_f32_s16_shaped", "c", true, true, conv_f32_to_s16_shaped_c);
+	run_test("test_f32d_s16_shaped", "c", false, true, conv_f32d_to_s16_shaped_c);
 }
 
 static void test_s16_f32(void)
@@ -139,6 +184,18 @@ static void test_s16_f32(void)
 #if defined (HAVE_SSE2)
 	run_test("test_s16_f32d", "sse2", true, false, conv_s16_to_f32d_sse2);
 #endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s16_f32", "avx2", true, true, conv_s16_to_f32_avx2);
+		run_test("test_s16d_f32", "avx2", false, true, conv_s16d_to_f32_avx2);
+		run_test("test_s16_f32d", "avx2", true, false, conv_s16_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s16_f32d", "neon", true, false, conv_s16_to_f32d_neon);
+	}
+#endif
 }
 
 static void test_f32_s32(void)
@@ -149,6 +206,23 @@ static void test_f32_s32(void)
 	run_test("test_f32d_s32", "sse2", false, true, conv_f32d_to_s32_sse2);
 #endif
 	run_test("test_f32_s32d", "c", true, false, conv_f32_to_s32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s32", "avx2", true, true, conv_f32_to_s32_avx2);
+		run_test("test_f32d_s32", "avx2", false, true, conv_f32d_to_s32_avx2);
+		run_test("test_f32_s32d", "avx2", true, false, conv_f32_to_s32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s32d", "avx512", true, false, conv_f32_to_s32d_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32d_s32", "neon", false, true, conv_f32d_to_s32_neon);
+	}
+#endif
 }
 
 static void test_s32_f32(void)
@@ -156,6 +230,23 @@ static void test_s32_f32(void)
 	run_test("test_s32_f32", "c", true, true, conv_s32_to_f32_c);
 	run_test("test_s32d_f32", "c", false, true, conv_s32d_to_f32_c);
 	run_test("test_s32_f32d", "c", true, false, conv_s32_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s32_f32", "avx2", true, true, conv_s32_to_f32_avx2);
+		run_test("test_s32d_f32", "avx2", false, true, conv_s32d_to_f32_avx2);
+		run_test("test_s32_f32d", "avx2", true, false, conv_s32_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s32_f32d", "avx512", true, false, conv_s32_to_f32d_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s32_f32d", "neon", true, false, conv_s32_to_f32d_neon);
+	}
+#endif
 }
 
 static void test_f32_s24(void)
@@ -163,6 +254,13 @@ static void test_f32_s24(void)
 	run_test("test_f32_s24", "c", true, true, conv_f32_to_s24_c);
 	run_test("test_f32d_s24", "c", false, true, conv_f32d_to_s24_c);
 	run_test("test_f32_s24d", "c", true, false, conv_f32_to_s24d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s24", "avx2", true, true, conv_f32_to_s24_avx2);
+		run_test("test_f32d_s24", "avx2", false, true, conv_f32d_to_s24_avx2);
+		run_test("test_f32_s24d", "avx2", true, false, conv_f32_to_s24d_avx2);
+	}
+#endif
 }
 
 static void test_s24_f32(void)
@@ -179,6 +277,13 @@ static void test_s24_f32(void)
 #if defined (HAVE_SSE41)
 	run_test("test_s24_f32d", "sse41", true, false, conv_s24_to_f32d_sse41);
 #endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s24_f32", "avx2", true, true, conv_s24_to_f32_avx2);
+		run_test("test_s24d_f32", "avx2", false, true, conv_s24d_to_f32_avx2);
+		run_test("test_s24_f32d", "avx2", true, false, conv_s24_to_f32d_avx2);
+	}
+#endif
 }
 
 static void test_f32_s24_32(void)
@@ -186,6 +291,23 @@ static void test_f32_s24_32(void)
 	run_test("test_f32_s24_32", "c", true, true, conv_f32_to_s24_32_c);
 	run_test("test_f32d_s24_32", "c", false, true, conv_f32d_to_s24_32_c);
 	run_test("test_f32_s24_32d", "c", true, false, conv_f32_to_s24_32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s24_32", "avx2", true, true, conv_f32_to_s24_32_avx2);
+		run_test("test_f32d_s24_32", "avx2", false, true, conv_f32d_to_s24_32_avx2);
+		run_test("test_f32_s24_32d", "avx2", true, false, conv_f32_to_s24_32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s24_32d", "avx512", true, false, conv_f32_to_s24_32d_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32d_s24_32", "neon", false, true, conv_f32d_to_s24_32_neon);
+	}
+#endif
 }
 
 static void test_s24_32_f32(void)
@@ -193,6 +315,23 @@ static void test_s24_32_f32(void)
 	run_test("test_s24_32_f32", "c", true, true, conv_s24_32_to_f32_c);
 	run_test("test_s24_32d_f32", "c", false, true, conv_s24_32d_to_f32_c);
 	run_test("test_s24_32_f32d", "c", true, false, conv_s24_32_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s24_32_f32", "avx2", true, true, conv_s24_32_to_f32_avx2);
+		run_test("test_s24_32d_f32", "avx2", false, true, conv_s24_32d_to_f32_avx2);
+		run_test("test_s24_32_f32d", "avx2", true, false, conv_s24_32_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s24_32_f32d", "avx512", true, false, conv_s24_32_to_f32d_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s24_32_f32d", "neon", true, false, conv_s24_32_to_f32d_neon);
+	}
+#endif
 }
 
 static void test_interleave(void)
@@ -201,6 +340,16 @@ static void test_interleave(void)
 	run_test("test_interleave_16", "c", false, true, conv_interleave_16_c);
 	run_test("test_interleave_24", "c", false, true, conv_interleave_24_c);
 	run_test("test_interleave_32", "c", false, true, conv_interleave_32_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_interleave_32", "avx2", false, true, conv_interleave_32_avx2);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_interleave_32", "neon", false, true, conv_interleave_32_neon);
+	}
+#endif
 }
 
 static void test_deinterleave(void)
@@ -209,6 +358,21 @@ static void test_deinterleave(void)
 	run_test("test_deinterleave_16", "c", true, false, conv_deinterleave_16_c);
 	run_test("test_deinterleave_24", "c", true, false, conv_deinterleave_24_c);
 	run_test("test_deinterleave_32", "c", true, false, conv_deinterleave_32_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_deinterleave_32", "avx2", true, false, conv_deinterleave_32_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_deinterleave_32", "avx512", true, false, conv_deinterleave_32_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_deinterleave_32", "neon", true, false, conv_deinterleave_32_neon);
+	}
+#endif
 }
 
 static int compare_func(const void *_a, const void *_b)
@@ -226,9 +390,22 @@ int main(int argc, char *argv[])
 {
 	uint32_t i;
 
+#if defined (HAVE_AVX2)
+	if (__builtin_cpu_supports("avx2"))
+		cpu_flags |= SPA_CPU_FLAG_AVX2;
+#endif
+#if defined (HAVE_AVX512)
+	if (__builtin_cpu_supports("avx512f"))
+		cpu_flags |= SPA_CPU_FLAG_AVX512;
+#endif
+#if defined (HAVE_NEON)
+	cpu_flags |= SPA_CPU_FLAG_NEON;
+#endif
+
 	test_f32_u8();
 	test_u8_f32();
 	test_f32_s16();
+	test_f32_s16_dither();
 	test_s16_f32();
 	test_f32_s32();
 	test_s32_f32();
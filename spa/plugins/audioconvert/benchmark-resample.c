@@ -55,7 +55,7 @@ static const int in_rates[] = { 44100, 44100, 48000, 96000, 22050, 96000 };
 static const int out_rates[] = { 44100, 48000, 44100, 48000, 48000, 44100 };
 
 
-#define MAX_RESAMPLER	5
+#define MAX_RESAMPLER	(5 + SPA_N_ELEMENTS(quality_presets))
 #define MAX_SIZES	SPA_N_ELEMENTS(sample_sizes)
 #define MAX_RATES	SPA_N_ELEMENTS(in_rates)
 #define MAX_RESULTS	MAX_RESAMPLER * MAX_SIZES * MAX_RATES
@@ -126,12 +126,13 @@ static int compare_func(const void *_a, const void *_b)
 int main(int argc, char *argv[])
 {
 	struct resample r;
-	uint32_t i;
+	uint32_t i, j;
 
 	for (i = 0; i < SPA_N_ELEMENTS(in_rates); i++) {
 		spa_zero(r);
 		r.channels = 2;
 		r.cpu_flags = 0;
+		r.quality = RESAMPLE_DEFAULT_QUALITY;
 		r.i_rate = in_rates[i];
 		r.o_rate = out_rates[i];
 		impl_native_init(&r);
@@ -143,6 +144,7 @@ int main(int argc, char *argv[])
 		spa_zero(r);
 		r.channels = 2;
 		r.cpu_flags = SPA_CPU_FLAG_SSE;
+		r.quality = RESAMPLE_DEFAULT_QUALITY;
 		r.i_rate = in_rates[i];
 		r.o_rate = out_rates[i];
 		impl_native_init(&r);
@@ -155,6 +157,7 @@ int main(int argc, char *argv[])
 		spa_zero(r);
 		r.channels = 2;
 		r.cpu_flags = SPA_CPU_FLAG_SSSE3 | SPA_CPU_FLAG_SLOW_UNALIGNED;
+		r.quality = RESAMPLE_DEFAULT_QUALITY;
 		r.i_rate = in_rates[i];
 		r.o_rate = out_rates[i];
 		impl_native_init(&r);
@@ -167,6 +170,7 @@ int main(int argc, char *argv[])
 		spa_zero(r);
 		r.channels = 2;
 		r.cpu_flags = SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3;
+		r.quality = RESAMPLE_DEFAULT_QUALITY;
 		r.i_rate = in_rates[i];
 		r.o_rate = out_rates[i];
 		impl_native_init(&r);
@@ -174,6 +178,33 @@ int main(int argc, char *argv[])
 		resample_free(&r);
 	}
 #endif
+#if defined (HAVE_NEON)
+	for (i = 0; i < SPA_N_ELEMENTS(in_rates); i++) {
+		spa_zero(r);
+		r.channels = 2;
+		r.cpu_flags = SPA_CPU_FLAG_NEON;
+		r.quality = RESAMPLE_DEFAULT_QUALITY;
+		r.i_rate = in_rates[i];
+		r.o_rate = out_rates[i];
+		impl_native_init(&r);
+		run_test("native", "neon", &r);
+		resample_free(&r);
+	}
+#endif
+
+	for (j = 0; j < SPA_N_ELEMENTS(quality_presets); j++) {
+		for (i = 0; i < SPA_N_ELEMENTS(in_rates); i++) {
+			spa_zero(r);
+			r.channels = 2;
+			r.cpu_flags = 0;
+			r.quality = quality_presets[j].quality;
+			r.i_rate = in_rates[i];
+			r.o_rate = out_rates[i];
+			impl_native_init(&r);
+			run_test(quality_presets[j].name, "c", &r);
+			resample_free(&r);
+		}
+	}
 
 	qsort(results, n_results, sizeof(struct stats), compare_func);
 
@@ -0,0 +1,277 @@
+/* Spa
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "channelmix-ops.h"
+
+#include <immintrin.h>
+
+void
+channelmix_f32_n_m_avx(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, j, k, n, n_j, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float *sj[n_src];
+	float vj[n_src];
+	__m256 v[n_src], t[4];
+
+	for (i = 0; i < n_dst; i++) {
+		float *di = d[i];
+		bool aligned = SPA_IS_ALIGNED(di, 32);
+
+		/* only mix the sources that contribute to this channel */
+		for (j = 0, n_j = 0; j < n_src; j++) {
+			if (mix->matrix[i][j] == 0.0f)
+				continue;
+			aligned &= SPA_IS_ALIGNED(s[j], 32);
+			sj[n_j] = s[j];
+			vj[n_j] = mix->matrix[i][j];
+			v[n_j++] = _mm256_set1_ps(mix->matrix[i][j]);
+		}
+		if (n_j == 0) {
+			memset(di, 0, n_samples * sizeof(float));
+			continue;
+		}
+		if (n_j == 1 && vj[0] == 1.0f) {
+			spa_memcpy(di, sj[0], n_samples * sizeof(float));
+			continue;
+		}
+
+		unrolled = aligned ? n_samples & ~31 : 0;
+
+		/* add one source at a time over the block, this reads fewer
+		 * streams at once than summing all sources per sample */
+		for(n = 0; n < unrolled; n += 32) {
+			t[0] = _mm256_mul_ps(_mm256_load_ps(&sj[0][n]), v[0]);
+			t[1] = _mm256_mul_ps(_mm256_load_ps(&sj[0][n+8]), v[0]);
+			t[2] = _mm256_mul_ps(_mm256_load_ps(&sj[0][n+16]), v[0]);
+			t[3] = _mm256_mul_ps(_mm256_load_ps(&sj[0][n+24]), v[0]);
+			_mm256_store_ps(&di[n], t[0]);
+			_mm256_store_ps(&di[n+8], t[1]);
+			_mm256_store_ps(&di[n+16], t[2]);
+			_mm256_store_ps(&di[n+24], t[3]);
+		}
+		for (k = 1; k < n_j; k++) {
+			for(n = 0; n < unrolled; n += 32) {
+				t[0] = _mm256_fmadd_ps(_mm256_load_ps(&sj[k][n]), v[k], _mm256_load_ps(&di[n]));
+				t[1] = _mm256_fmadd_ps(_mm256_load_ps(&sj[k][n+8]), v[k], _mm256_load_ps(&di[n+8]));
+				t[2] = _mm256_fmadd_ps(_mm256_load_ps(&sj[k][n+16]), v[k], _mm256_load_ps(&di[n+16]));
+				t[3] = _mm256_fmadd_ps(_mm256_load_ps(&sj[k][n+24]), v[k], _mm256_load_ps(&di[n+24]));
+				_mm256_store_ps(&di[n], t[0]);
+				_mm256_store_ps(&di[n+8], t[1]);
+				_mm256_store_ps(&di[n+16], t[2]);
+				_mm256_store_ps(&di[n+24], t[3]);
+			}
+		}
+		for(n = unrolled; n < n_samples; n++) {
+			float sum = sj[0][n] * vj[0];
+			for (k = 1; k < n_j; k++)
+				sum += sj[k][n] * vj[k];
+			di[n] = sum;
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR */
+void
+channelmix_f32_7p1_2_avx(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m[10] = {
+		mix->matrix[0][0], mix->matrix[1][1],
+		mix->matrix[0][2], mix->matrix[1][2],
+		mix->matrix[0][3], mix->matrix[1][3],
+		mix->matrix[0][4], mix->matrix[1][5],
+		mix->matrix[0][6], mix->matrix[1][7] };
+	const __m256 v0 = _mm256_set1_ps(m[0]), v1 = _mm256_set1_ps(m[1]);
+	const __m256 clev0 = _mm256_set1_ps(m[2]), clev1 = _mm256_set1_ps(m[3]);
+	const __m256 llev0 = _mm256_set1_ps(m[4]), llev1 = _mm256_set1_ps(m[5]);
+	const __m256 slev0 = _mm256_set1_ps(m[6]), slev1 = _mm256_set1_ps(m[7]);
+	const __m256 rlev0 = _mm256_set1_ps(m[8]), rlev1 = _mm256_set1_ps(m[9]);
+	__m256 ctr, lfe, l, r;
+	const float *sFL = s[0], *sFR = s[1], *sFC = s[2], *sLFE = s[3];
+	const float *sSL = s[4], *sSR = s[5], *sRL = s[6], *sRR = s[7];
+	float *dFL = d[0], *dFR = d[1];
+
+	unrolled = n_samples & ~7;
+	for (i = 0; i < n_src; i++)
+		if (!SPA_IS_ALIGNED(s[i], 32))
+			unrolled = 0;
+	if (!SPA_IS_ALIGNED(dFL, 32) ||
+	    !SPA_IS_ALIGNED(dFR, 32))
+		unrolled = 0;
+
+	if (mix->zero) {
+		memset(dFL, 0, n_samples * sizeof(float));
+		memset(dFR, 0, n_samples * sizeof(float));
+	}
+	else {
+		for(n = 0; n < unrolled; n += 8) {
+			ctr = _mm256_load_ps(&sFC[n]);
+			lfe = _mm256_load_ps(&sLFE[n]);
+			l = _mm256_mul_ps(_mm256_load_ps(&sFL[n]), v0);
+			l = _mm256_fmadd_ps(ctr, clev0, l);
+			l = _mm256_fmadd_ps(lfe, llev0, l);
+			l = _mm256_fmadd_ps(_mm256_load_ps(&sSL[n]), slev0, l);
+			l = _mm256_fmadd_ps(_mm256_load_ps(&sRL[n]), rlev0, l);
+			r = _mm256_mul_ps(_mm256_load_ps(&sFR[n]), v1);
+			r = _mm256_fmadd_ps(ctr, clev1, r);
+			r = _mm256_fmadd_ps(lfe, llev1, r);
+			r = _mm256_fmadd_ps(_mm256_load_ps(&sSR[n]), slev1, r);
+			r = _mm256_fmadd_ps(_mm256_load_ps(&sRR[n]), rlev1, r);
+			_mm256_store_ps(&dFL[n], l);
+			_mm256_store_ps(&dFR[n], r);
+		}
+		for(; n < n_samples; n++) {
+			dFL[n] = sFL[n] * m[0] + sFC[n] * m[2] + sLFE[n] * m[4] +
+				sSL[n] * m[6] + sRL[n] * m[8];
+			dFR[n] = sFR[n] * m[1] + sFC[n] * m[3] + sLFE[n] * m[5] +
+				sSR[n] * m[7] + sRR[n] * m[9];
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR+FC+LFE*/
+void
+channelmix_f32_7p1_3p1_avx(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m[8] = {
+		mix->matrix[0][0], mix->matrix[1][1],
+		mix->matrix[2][2], mix->matrix[3][3],
+		mix->matrix[0][4], mix->matrix[1][5],
+		mix->matrix[0][6], mix->matrix[1][7] };
+	const __m256 v0 = _mm256_set1_ps(m[0]), v1 = _mm256_set1_ps(m[1]);
+	const __m256 v2 = _mm256_set1_ps(m[2]), v3 = _mm256_set1_ps(m[3]);
+	const __m256 slev0 = _mm256_set1_ps(m[4]), slev1 = _mm256_set1_ps(m[5]);
+	const __m256 rlev0 = _mm256_set1_ps(m[6]), rlev1 = _mm256_set1_ps(m[7]);
+	__m256 l, r;
+	const float *sFL = s[0], *sFR = s[1], *sFC = s[2], *sLFE = s[3];
+	const float *sSL = s[4], *sSR = s[5], *sRL = s[6], *sRR = s[7];
+	float *dFL = d[0], *dFR = d[1], *dFC = d[2], *dLFE = d[3];
+
+	unrolled = n_samples & ~7;
+	for (i = 0; i < n_src; i++)
+		if (!SPA_IS_ALIGNED(s[i], 32))
+			unrolled = 0;
+	for (i = 0; i < n_dst; i++)
+		if (!SPA_IS_ALIGNED(d[i], 32))
+			unrolled = 0;
+
+	if (mix->zero) {
+		for (i = 0; i < n_dst; i++)
+			memset(d[i], 0, n_samples * sizeof(float));
+	}
+	else {
+		for(n = 0; n < unrolled; n += 8) {
+			l = _mm256_mul_ps(_mm256_load_ps(&sFL[n]), v0);
+			l = _mm256_fmadd_ps(_mm256_load_ps(&sSL[n]), slev0, l);
+			l = _mm256_fmadd_ps(_mm256_load_ps(&sRL[n]), rlev0, l);
+			r = _mm256_mul_ps(_mm256_load_ps(&sFR[n]), v1);
+			r = _mm256_fmadd_ps(_mm256_load_ps(&sSR[n]), slev1, r);
+			r = _mm256_fmadd_ps(_mm256_load_ps(&sRR[n]), rlev1, r);
+			_mm256_store_ps(&dFL[n], l);
+			_mm256_store_ps(&dFR[n], r);
+			_mm256_store_ps(&dFC[n], _mm256_mul_ps(_mm256_load_ps(&sFC[n]), v2));
+			_mm256_store_ps(&dLFE[n], _mm256_mul_ps(_mm256_load_ps(&sLFE[n]), v3));
+		}
+		for(; n < n_samples; n++) {
+			dFL[n] = sFL[n] * m[0] + sSL[n] * m[4] + sRL[n] * m[6];
+			dFR[n] = sFR[n] * m[1] + sSR[n] * m[5] + sRR[n] * m[7];
+			dFC[n] = sFC[n] * m[2];
+			dLFE[n] = sLFE[n] * m[3];
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR+RL+RR*/
+void
+channelmix_f32_7p1_4_avx(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m[10] = {
+		mix->matrix[0][0], mix->matrix[1][1],
+		mix->matrix[0][2], mix->matrix[1][2],
+		mix->matrix[0][3], mix->matrix[1][3],
+		mix->matrix[2][4], mix->matrix[3][5],
+		mix->matrix[2][6], mix->matrix[3][7] };
+	const __m256 v0 = _mm256_set1_ps(m[0]), v1 = _mm256_set1_ps(m[1]);
+	const __m256 clev0 = _mm256_set1_ps(m[2]), clev1 = _mm256_set1_ps(m[3]);
+	const __m256 llev0 = _mm256_set1_ps(m[4]), llev1 = _mm256_set1_ps(m[5]);
+	const __m256 slev0 = _mm256_set1_ps(m[6]), slev1 = _mm256_set1_ps(m[7]);
+	const __m256 rlev0 = _mm256_set1_ps(m[8]), rlev1 = _mm256_set1_ps(m[9]);
+	__m256 ctr, lfe, l, r;
+	const float *sFL = s[0], *sFR = s[1], *sFC = s[2], *sLFE = s[3];
+	const float *sSL = s[4], *sSR = s[5], *sRL = s[6], *sRR = s[7];
+	float *dFL = d[0], *dFR = d[1], *dRL = d[2], *dRR = d[3];
+
+	unrolled = n_samples & ~7;
+	for (i = 0; i < n_src; i++)
+		if (!SPA_IS_ALIGNED(s[i], 32))
+			unrolled = 0;
+	for (i = 0; i < n_dst; i++)
+		if (!SPA_IS_ALIGNED(d[i], 32))
+			unrolled = 0;
+
+	if (mix->zero) {
+		for (i = 0; i < n_dst; i++)
+			memset(d[i], 0, n_samples * sizeof(float));
+	}
+	else {
+		for(n = 0; n < unrolled; n += 8) {
+			ctr = _mm256_load_ps(&sFC[n]);
+			lfe = _mm256_load_ps(&sLFE[n]);
+			l = _mm256_mul_ps(_mm256_load_ps(&sFL[n]), v0);
+			l = _mm256_fmadd_ps(ctr, clev0, l);
+			l = _mm256_fmadd_ps(lfe, llev0, l);
+			r = _mm256_mul_ps(_mm256_load_ps(&sFR[n]), v1);
+			r = _mm256_fmadd_ps(ctr, clev1, r);
+			r = _mm256_fmadd_ps(lfe, llev1, r);
+			_mm256_store_ps(&dFL[n], l);
+			_mm256_store_ps(&dFR[n], r);
+			l = _mm256_mul_ps(_mm256_load_ps(&sSL[n]), slev0);
+			l = _mm256_fmadd_ps(_mm256_load_ps(&sRL[n]), rlev0, l);
+			r = _mm256_mul_ps(_mm256_load_ps(&sSR[n]), slev1);
+			r = _mm256_fmadd_ps(_mm256_load_ps(&sRR[n]), rlev1, r);
+			_mm256_store_ps(&dRL[n], l);
+			_mm256_store_ps(&dRR[n], r);
+		}
+		for(; n < n_samples; n++) {
+			dFL[n] = sFL[n] * m[0] + sFC[n] * m[2] + sLFE[n] * m[4];
+			dFR[n] = sFR[n] * m[1] + sFC[n] * m[3] + sLFE[n] * m[5];
+			dRL[n] = sSL[n] * m[6] + sRL[n] * m[8];
+			dRR[n] = sSR[n] * m[7] + sRR[n] * m[9];
+		}
+	}
+}
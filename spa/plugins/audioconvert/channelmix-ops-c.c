@@ -54,16 +54,35 @@ void
 channelmix_f32_n_m_c(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
 		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
 {
-	uint32_t i, j, n;
+	uint32_t i, j, k, n, n_j;
 	float **d = (float **) dst;
 	const float **s = (const float **) src;
-
-	for (n = 0; n < n_samples; n++) {
-		for (i = 0; i < n_dst; i++) {
-			float sum = 0.0f;
-			for (j = 0; j < n_src; j++)
-				sum += s[j][n] * mix->matrix[i][j];
-			d[i][n] = sum;
+	const float *sj[n_src];
+	float vj[n_src];
+
+	for (i = 0; i < n_dst; i++) {
+		float *di = d[i];
+
+		/* only mix the sources that contribute to this channel */
+		for (j = 0, n_j = 0; j < n_src; j++) {
+			if (mix->matrix[i][j] == 0.0f)
+				continue;
+			sj[n_j] = s[j];
+			vj[n_j++] = mix->matrix[i][j];
+		}
+		if (n_j == 0) {
+			memset(di, 0, n_samples * sizeof(float));
+		}
+		else if (n_j == 1 && vj[0] == 1.0f) {
+			spa_memcpy(di, sj[0], n_samples * sizeof(float));
+		}
+		else {
+			for (n = 0; n < n_samples; n++)
+				di[n] = sj[0][n] * vj[0];
+			for (k = 1; k < n_j; k++) {
+				for (n = 0; n < n_samples; n++)
+					di[n] += sj[k][n] * vj[k];
+			}
 		}
 	}
 }
@@ -384,8 +403,10 @@ channelmix_f32_7p1_2_c(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRI
 	const float **s = (const float **) src;
 	const float v0 = mix->matrix[0][0];
 	const float v1 = mix->matrix[1][1];
-	const float clev = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
-	const float llev = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+	const float clev0 = mix->matrix[0][2];
+	const float clev1 = mix->matrix[1][2];
+	const float llev0 = mix->matrix[0][3];
+	const float llev1 = mix->matrix[1][3];
 	const float slev0 = mix->matrix[0][4];
 	const float slev1 = mix->matrix[1][5];
 	const float rlev0 = mix->matrix[0][6];
@@ -397,9 +418,10 @@ channelmix_f32_7p1_2_c(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRI
 	}
 	else {
 		for (n = 0; n < n_samples; n++) {
-			const float ctr = clev * s[2][n] + llev * s[3][n];
-			d[0][n] = s[0][n] * v0 + ctr + s[4][n] * slev0 + s[6][n] * rlev0;
-			d[1][n] = s[1][n] * v1 + ctr + s[5][n] * slev1 + s[6][n] * rlev1;
+			d[0][n] = s[0][n] * v0 + s[2][n] * clev0 + s[3][n] * llev0 +
+				s[4][n] * slev0 + s[6][n] * rlev0;
+			d[1][n] = s[1][n] * v1 + s[2][n] * clev1 + s[3][n] * llev1 +
+				s[5][n] * slev1 + s[7][n] * rlev1;
 		}
 	}
 }
@@ -416,8 +438,10 @@ channelmix_f32_7p1_3p1_c(struct channelmix *mix, uint32_t n_dst, void * SPA_REST
 	const float v1 = mix->matrix[1][1];
 	const float v2 = mix->matrix[2][2];
 	const float v3 = mix->matrix[3][3];
-	const float v4 = (mix->matrix[0][4] + mix->matrix[0][6]) * 0.5f;
-	const float v5 = (mix->matrix[1][5] + mix->matrix[1][6]) * 0.5f;
+	const float slev0 = mix->matrix[0][4];
+	const float slev1 = mix->matrix[1][5];
+	const float rlev0 = mix->matrix[0][6];
+	const float rlev1 = mix->matrix[1][7];
 
 	if (mix->zero) {
 		for (i = 0; i < n_dst; i++)
@@ -425,8 +449,8 @@ channelmix_f32_7p1_3p1_c(struct channelmix *mix, uint32_t n_dst, void * SPA_REST
 	}
 	else {
 		for (n = 0; n < n_samples; n++) {
-			d[0][n] = s[0][n] * v0 + (s[4][n] + s[6][n]) * v4;
-			d[1][n] = s[1][n] * v1 + (s[5][n] + s[7][n]) * v5;
+			d[0][n] = s[0][n] * v0 + s[4][n] * slev0 + s[6][n] * rlev0;
+			d[1][n] = s[1][n] * v1 + s[5][n] * slev1 + s[7][n] * rlev1;
 			d[2][n] = s[2][n] * v2;
 			d[3][n] = s[3][n] * v3;
 		}
@@ -443,12 +467,14 @@ channelmix_f32_7p1_4_c(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRI
 	const float **s = (const float **) src;
 	const float v0 = mix->matrix[0][0];
 	const float v1 = mix->matrix[1][1];
-	const float clev = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
-	const float llev = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
-	const float slev0 = mix->matrix[0][4];
-	const float slev1 = mix->matrix[1][5];
-	const float rlev0 = mix->matrix[0][6];
-	const float rlev1 = mix->matrix[1][7];
+	const float clev0 = mix->matrix[0][2];
+	const float clev1 = mix->matrix[1][2];
+	const float llev0 = mix->matrix[0][3];
+	const float llev1 = mix->matrix[1][3];
+	const float slev0 = mix->matrix[2][4];
+	const float slev1 = mix->matrix[3][5];
+	const float rlev0 = mix->matrix[2][6];
+	const float rlev1 = mix->matrix[3][7];
 
 	if (mix->zero) {
 		for (i = 0; i < n_dst; i++)
@@ -456,13 +482,10 @@ channelmix_f32_7p1_4_c(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRI
 	}
 	else {
 		for (n = 0; n < n_samples; n++) {
-			const float ctr = s[2][n] * clev + s[3][n] * llev;
-			const float sl = s[4][n] * slev0;
-			const float sr = s[5][n] * slev1;
-			d[0][n] = s[0][n] * v0 + ctr + sl;
-			d[1][n] = s[1][n] * v1 + ctr + sr;
-			d[2][n] = s[6][n] * rlev0 + sl;
-			d[3][n] = s[7][n] * rlev1 + sr;
+			d[0][n] = s[0][n] * v0 + s[2][n] * clev0 + s[3][n] * llev0;
+			d[1][n] = s[1][n] * v1 + s[2][n] * clev1 + s[3][n] * llev1;
+			d[2][n] = s[4][n] * slev0 + s[6][n] * rlev0;
+			d[3][n] = s[5][n] * slev1 + s[7][n] * rlev1;
 		}
 	}
 }
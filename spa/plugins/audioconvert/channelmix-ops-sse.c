@@ -376,3 +376,278 @@ channelmix_f32_5p1_4_sse(struct channelmix *mix, uint32_t n_dst, void * SPA_REST
 		}
 	}
 }
+
+void
+channelmix_f32_n_m_sse(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, j, k, n, n_j, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float *sj[n_src];
+	float vj[n_src];
+	__m128 v[n_src], t[4];
+
+	for (i = 0; i < n_dst; i++) {
+		float *di = d[i];
+		bool aligned = SPA_IS_ALIGNED(di, 16);
+
+		/* only mix the sources that contribute to this channel */
+		for (j = 0, n_j = 0; j < n_src; j++) {
+			if (mix->matrix[i][j] == 0.0f)
+				continue;
+			aligned &= SPA_IS_ALIGNED(s[j], 16);
+			sj[n_j] = s[j];
+			vj[n_j] = mix->matrix[i][j];
+			v[n_j++] = _mm_set1_ps(mix->matrix[i][j]);
+		}
+		if (n_j == 0) {
+			memset(di, 0, n_samples * sizeof(float));
+			continue;
+		}
+		if (n_j == 1 && vj[0] == 1.0f) {
+			spa_memcpy(di, sj[0], n_samples * sizeof(float));
+			continue;
+		}
+
+		unrolled = aligned ? n_samples & ~15 : 0;
+
+		/* add one source at a time over the block, this reads fewer
+		 * streams at once than summing all sources per sample */
+		for(n = 0; n < unrolled; n += 16) {
+			t[0] = _mm_mul_ps(_mm_load_ps(&sj[0][n]), v[0]);
+			t[1] = _mm_mul_ps(_mm_load_ps(&sj[0][n+4]), v[0]);
+			t[2] = _mm_mul_ps(_mm_load_ps(&sj[0][n+8]), v[0]);
+			t[3] = _mm_mul_ps(_mm_load_ps(&sj[0][n+12]), v[0]);
+			_mm_store_ps(&di[n], t[0]);
+			_mm_store_ps(&di[n+4], t[1]);
+			_mm_store_ps(&di[n+8], t[2]);
+			_mm_store_ps(&di[n+12], t[3]);
+		}
+		for (k = 1; k < n_j; k++) {
+			for(n = 0; n < unrolled; n += 16) {
+				t[0] = _mm_add_ps(_mm_load_ps(&di[n]), _mm_mul_ps(_mm_load_ps(&sj[k][n]), v[k]));
+				t[1] = _mm_add_ps(_mm_load_ps(&di[n+4]), _mm_mul_ps(_mm_load_ps(&sj[k][n+4]), v[k]));
+				t[2] = _mm_add_ps(_mm_load_ps(&di[n+8]), _mm_mul_ps(_mm_load_ps(&sj[k][n+8]), v[k]));
+				t[3] = _mm_add_ps(_mm_load_ps(&di[n+12]), _mm_mul_ps(_mm_load_ps(&sj[k][n+12]), v[k]));
+				_mm_store_ps(&di[n], t[0]);
+				_mm_store_ps(&di[n+4], t[1]);
+				_mm_store_ps(&di[n+8], t[2]);
+				_mm_store_ps(&di[n+12], t[3]);
+			}
+		}
+		for(n = unrolled; n < n_samples; n++) {
+			float sum = sj[0][n] * vj[0];
+			for (k = 1; k < n_j; k++)
+				sum += sj[k][n] * vj[k];
+			di[n] = sum;
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR */
+void
+channelmix_f32_7p1_2_sse(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const __m128 v0 = _mm_set1_ps(mix->matrix[0][0]);
+	const __m128 v1 = _mm_set1_ps(mix->matrix[1][1]);
+	const __m128 clev0 = _mm_set1_ps(mix->matrix[0][2]);
+	const __m128 clev1 = _mm_set1_ps(mix->matrix[1][2]);
+	const __m128 llev0 = _mm_set1_ps(mix->matrix[0][3]);
+	const __m128 llev1 = _mm_set1_ps(mix->matrix[1][3]);
+	const __m128 slev0 = _mm_set1_ps(mix->matrix[0][4]);
+	const __m128 slev1 = _mm_set1_ps(mix->matrix[1][5]);
+	const __m128 rlev0 = _mm_set1_ps(mix->matrix[0][6]);
+	const __m128 rlev1 = _mm_set1_ps(mix->matrix[1][7]);
+	__m128 ctr, lfe, l, r;
+	const float *sFL = s[0], *sFR = s[1], *sFC = s[2], *sLFE = s[3];
+	const float *sSL = s[4], *sSR = s[5], *sRL = s[6], *sRR = s[7];
+	float *dFL = d[0], *dFR = d[1];
+
+	unrolled = n_samples & ~3;
+	for (i = 0; i < n_src; i++)
+		if (!SPA_IS_ALIGNED(s[i], 16))
+			unrolled = 0;
+	if (!SPA_IS_ALIGNED(dFL, 16) ||
+	    !SPA_IS_ALIGNED(dFR, 16))
+		unrolled = 0;
+
+	if (mix->zero) {
+		memset(dFL, 0, n_samples * sizeof(float));
+		memset(dFR, 0, n_samples * sizeof(float));
+	}
+	else {
+		for(n = 0; n < unrolled; n += 4) {
+			ctr = _mm_load_ps(&sFC[n]);
+			lfe = _mm_load_ps(&sLFE[n]);
+			l = _mm_mul_ps(_mm_load_ps(&sFL[n]), v0);
+			l = _mm_add_ps(l, _mm_mul_ps(ctr, clev0));
+			l = _mm_add_ps(l, _mm_mul_ps(lfe, llev0));
+			l = _mm_add_ps(l, _mm_mul_ps(_mm_load_ps(&sSL[n]), slev0));
+			l = _mm_add_ps(l, _mm_mul_ps(_mm_load_ps(&sRL[n]), rlev0));
+			r = _mm_mul_ps(_mm_load_ps(&sFR[n]), v1);
+			r = _mm_add_ps(r, _mm_mul_ps(ctr, clev1));
+			r = _mm_add_ps(r, _mm_mul_ps(lfe, llev1));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&sSR[n]), slev1));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&sRR[n]), rlev1));
+			_mm_store_ps(&dFL[n], l);
+			_mm_store_ps(&dFR[n], r);
+		}
+		for(; n < n_samples; n++) {
+			ctr = _mm_load_ss(&sFC[n]);
+			lfe = _mm_load_ss(&sLFE[n]);
+			l = _mm_mul_ss(_mm_load_ss(&sFL[n]), v0);
+			l = _mm_add_ss(l, _mm_mul_ss(ctr, clev0));
+			l = _mm_add_ss(l, _mm_mul_ss(lfe, llev0));
+			l = _mm_add_ss(l, _mm_mul_ss(_mm_load_ss(&sSL[n]), slev0));
+			l = _mm_add_ss(l, _mm_mul_ss(_mm_load_ss(&sRL[n]), rlev0));
+			r = _mm_mul_ss(_mm_load_ss(&sFR[n]), v1);
+			r = _mm_add_ss(r, _mm_mul_ss(ctr, clev1));
+			r = _mm_add_ss(r, _mm_mul_ss(lfe, llev1));
+			r = _mm_add_ss(r, _mm_mul_ss(_mm_load_ss(&sSR[n]), slev1));
+			r = _mm_add_ss(r, _mm_mul_ss(_mm_load_ss(&sRR[n]), rlev1));
+			_mm_store_ss(&dFL[n], l);
+			_mm_store_ss(&dFR[n], r);
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR+FC+LFE*/
+void
+channelmix_f32_7p1_3p1_sse(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const __m128 v0 = _mm_set1_ps(mix->matrix[0][0]);
+	const __m128 v1 = _mm_set1_ps(mix->matrix[1][1]);
+	const __m128 v2 = _mm_set1_ps(mix->matrix[2][2]);
+	const __m128 v3 = _mm_set1_ps(mix->matrix[3][3]);
+	const __m128 slev0 = _mm_set1_ps(mix->matrix[0][4]);
+	const __m128 slev1 = _mm_set1_ps(mix->matrix[1][5]);
+	const __m128 rlev0 = _mm_set1_ps(mix->matrix[0][6]);
+	const __m128 rlev1 = _mm_set1_ps(mix->matrix[1][7]);
+	__m128 l, r;
+	const float *sFL = s[0], *sFR = s[1], *sFC = s[2], *sLFE = s[3];
+	const float *sSL = s[4], *sSR = s[5], *sRL = s[6], *sRR = s[7];
+	float *dFL = d[0], *dFR = d[1], *dFC = d[2], *dLFE = d[3];
+
+	unrolled = n_samples & ~3;
+	for (i = 0; i < n_src; i++)
+		if (!SPA_IS_ALIGNED(s[i], 16))
+			unrolled = 0;
+	for (i = 0; i < n_dst; i++)
+		if (!SPA_IS_ALIGNED(d[i], 16))
+			unrolled = 0;
+
+	if (mix->zero) {
+		for (i = 0; i < n_dst; i++)
+			memset(d[i], 0, n_samples * sizeof(float));
+	}
+	else {
+		for(n = 0; n < unrolled; n += 4) {
+			l = _mm_mul_ps(_mm_load_ps(&sFL[n]), v0);
+			l = _mm_add_ps(l, _mm_mul_ps(_mm_load_ps(&sSL[n]), slev0));
+			l = _mm_add_ps(l, _mm_mul_ps(_mm_load_ps(&sRL[n]), rlev0));
+			r = _mm_mul_ps(_mm_load_ps(&sFR[n]), v1);
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&sSR[n]), slev1));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&sRR[n]), rlev1));
+			_mm_store_ps(&dFL[n], l);
+			_mm_store_ps(&dFR[n], r);
+			_mm_store_ps(&dFC[n], _mm_mul_ps(_mm_load_ps(&sFC[n]), v2));
+			_mm_store_ps(&dLFE[n], _mm_mul_ps(_mm_load_ps(&sLFE[n]), v3));
+		}
+		for(; n < n_samples; n++) {
+			l = _mm_mul_ss(_mm_load_ss(&sFL[n]), v0);
+			l = _mm_add_ss(l, _mm_mul_ss(_mm_load_ss(&sSL[n]), slev0));
+			l = _mm_add_ss(l, _mm_mul_ss(_mm_load_ss(&sRL[n]), rlev0));
+			r = _mm_mul_ss(_mm_load_ss(&sFR[n]), v1);
+			r = _mm_add_ss(r, _mm_mul_ss(_mm_load_ss(&sSR[n]), slev1));
+			r = _mm_add_ss(r, _mm_mul_ss(_mm_load_ss(&sRR[n]), rlev1));
+			_mm_store_ss(&dFL[n], l);
+			_mm_store_ss(&dFR[n], r);
+			_mm_store_ss(&dFC[n], _mm_mul_ss(_mm_load_ss(&sFC[n]), v2));
+			_mm_store_ss(&dLFE[n], _mm_mul_ss(_mm_load_ss(&sLFE[n]), v3));
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR+RL+RR*/
+void
+channelmix_f32_7p1_4_sse(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const __m128 v0 = _mm_set1_ps(mix->matrix[0][0]);
+	const __m128 v1 = _mm_set1_ps(mix->matrix[1][1]);
+	const __m128 clev0 = _mm_set1_ps(mix->matrix[0][2]);
+	const __m128 clev1 = _mm_set1_ps(mix->matrix[1][2]);
+	const __m128 llev0 = _mm_set1_ps(mix->matrix[0][3]);
+	const __m128 llev1 = _mm_set1_ps(mix->matrix[1][3]);
+	const __m128 slev0 = _mm_set1_ps(mix->matrix[2][4]);
+	const __m128 slev1 = _mm_set1_ps(mix->matrix[3][5]);
+	const __m128 rlev0 = _mm_set1_ps(mix->matrix[2][6]);
+	const __m128 rlev1 = _mm_set1_ps(mix->matrix[3][7]);
+	__m128 ctr, lfe, l, r;
+	const float *sFL = s[0], *sFR = s[1], *sFC = s[2], *sLFE = s[3];
+	const float *sSL = s[4], *sSR = s[5], *sRL = s[6], *sRR = s[7];
+	float *dFL = d[0], *dFR = d[1], *dRL = d[2], *dRR = d[3];
+
+	unrolled = n_samples & ~3;
+	for (i = 0; i < n_src; i++)
+		if (!SPA_IS_ALIGNED(s[i], 16))
+			unrolled = 0;
+	for (i = 0; i < n_dst; i++)
+		if (!SPA_IS_ALIGNED(d[i], 16))
+			unrolled = 0;
+
+	if (mix->zero) {
+		for (i = 0; i < n_dst; i++)
+			memset(d[i], 0, n_samples * sizeof(float));
+	}
+	else {
+		for(n = 0; n < unrolled; n += 4) {
+			ctr = _mm_load_ps(&sFC[n]);
+			lfe = _mm_load_ps(&sLFE[n]);
+			l = _mm_mul_ps(_mm_load_ps(&sFL[n]), v0);
+			l = _mm_add_ps(l, _mm_mul_ps(ctr, clev0));
+			l = _mm_add_ps(l, _mm_mul_ps(lfe, llev0));
+			r = _mm_mul_ps(_mm_load_ps(&sFR[n]), v1);
+			r = _mm_add_ps(r, _mm_mul_ps(ctr, clev1));
+			r = _mm_add_ps(r, _mm_mul_ps(lfe, llev1));
+			_mm_store_ps(&dFL[n], l);
+			_mm_store_ps(&dFR[n], r);
+			l = _mm_mul_ps(_mm_load_ps(&sSL[n]), slev0);
+			l = _mm_add_ps(l, _mm_mul_ps(_mm_load_ps(&sRL[n]), rlev0));
+			r = _mm_mul_ps(_mm_load_ps(&sSR[n]), slev1);
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&sRR[n]), rlev1));
+			_mm_store_ps(&dRL[n], l);
+			_mm_store_ps(&dRR[n], r);
+		}
+		for(; n < n_samples; n++) {
+			ctr = _mm_load_ss(&sFC[n]);
+			lfe = _mm_load_ss(&sLFE[n]);
+			l = _mm_mul_ss(_mm_load_ss(&sFL[n]), v0);
+			l = _mm_add_ss(l, _mm_mul_ss(ctr, clev0));
+			l = _mm_add_ss(l, _mm_mul_ss(lfe, llev0));
+			r = _mm_mul_ss(_mm_load_ss(&sFR[n]), v1);
+			r = _mm_add_ss(r, _mm_mul_ss(ctr, clev1));
+			r = _mm_add_ss(r, _mm_mul_ss(lfe, llev1));
+			_mm_store_ss(&dFL[n], l);
+			_mm_store_ss(&dFR[n], r);
+			l = _mm_mul_ss(_mm_load_ss(&sSL[n]), slev0);
+			l = _mm_add_ss(l, _mm_mul_ss(_mm_load_ss(&sRL[n]), rlev0));
+			r = _mm_mul_ss(_mm_load_ss(&sSR[n]), slev1);
+			r = _mm_add_ss(r, _mm_mul_ss(_mm_load_ss(&sRR[n]), rlev1));
+			_mm_store_ss(&dRL[n], l);
+			_mm_store_ss(&dRR[n], r);
+		}
+	}
+}
@@ -64,6 +64,11 @@ static const struct channelmix_info {
 	{ 2, MASK_MONO, 2, MASK_MONO, channelmix_copy_sse, SPA_CPU_FLAG_SSE },
 	{ 2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_sse, SPA_CPU_FLAG_SSE },
 	{ EQ, 0, EQ, 0, channelmix_copy_sse, SPA_CPU_FLAG_SSE },
+#endif
+#if defined (HAVE_NEON)
+	{ 2, MASK_MONO, 2, MASK_MONO, channelmix_copy_neon, SPA_CPU_FLAG_NEON },
+	{ 2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_neon, SPA_CPU_FLAG_NEON },
+	{ EQ, 0, EQ, 0, channelmix_copy_neon, SPA_CPU_FLAG_NEON },
 #endif
 	{ 2, MASK_MONO, 2, MASK_MONO, channelmix_copy_c, 0 },
 	{ 2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_c, 0 },
@@ -75,28 +80,66 @@ static const struct channelmix_info {
 	{ 4, MASK_3_1, 1, MASK_MONO, channelmix_f32_3p1_1_c, 0 },
 #if defined (HAVE_SSE)
 	{ 2, MASK_STEREO, 4, MASK_QUAD, channelmix_f32_2_4_sse, SPA_CPU_FLAG_SSE },
+#endif
+#if defined (HAVE_NEON)
+	{ 2, MASK_STEREO, 4, MASK_QUAD, channelmix_f32_2_4_neon, SPA_CPU_FLAG_NEON },
 #endif
 	{ 2, MASK_STEREO, 4, MASK_QUAD, channelmix_f32_2_4_c, 0 },
 	{ 2, MASK_STEREO, 4, MASK_3_1, channelmix_f32_2_3p1_c, 0 },
 	{ 2, MASK_STEREO, 6, MASK_5_1, channelmix_f32_2_5p1_c, 0 },
 #if defined (HAVE_SSE)
 	{ 6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_sse, SPA_CPU_FLAG_SSE },
+#endif
+#if defined (HAVE_NEON)
+	{ 6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_neon, SPA_CPU_FLAG_NEON },
 #endif
 	{ 6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_c, 0 },
 #if defined (HAVE_SSE)
 	{ 6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_sse, SPA_CPU_FLAG_SSE },
+#endif
+#if defined (HAVE_NEON)
+	{ 6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_neon, SPA_CPU_FLAG_NEON },
 #endif
 	{ 6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_c, 0 },
 
 #if defined (HAVE_SSE)
 	{ 6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_sse, SPA_CPU_FLAG_SSE },
+#endif
+#if defined (HAVE_NEON)
+	{ 6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_neon, SPA_CPU_FLAG_NEON },
 #endif
 	{ 6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_c, 0 },
 
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+	{ 8, MASK_7_1, 2, MASK_STEREO, channelmix_f32_7p1_2_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3 },
+#endif
+#if defined (HAVE_SSE)
+	{ 8, MASK_7_1, 2, MASK_STEREO, channelmix_f32_7p1_2_sse, SPA_CPU_FLAG_SSE },
+#endif
 	{ 8, MASK_7_1, 2, MASK_STEREO, channelmix_f32_7p1_2_c, 0 },
+
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+	{ 8, MASK_7_1, 4, MASK_QUAD, channelmix_f32_7p1_4_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3 },
+#endif
+#if defined (HAVE_SSE)
+	{ 8, MASK_7_1, 4, MASK_QUAD, channelmix_f32_7p1_4_sse, SPA_CPU_FLAG_SSE },
+#endif
 	{ 8, MASK_7_1, 4, MASK_QUAD, channelmix_f32_7p1_4_c, 0 },
+
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+	{ 8, MASK_7_1, 4, MASK_3_1, channelmix_f32_7p1_3p1_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3 },
+#endif
+#if defined (HAVE_SSE)
+	{ 8, MASK_7_1, 4, MASK_3_1, channelmix_f32_7p1_3p1_sse, SPA_CPU_FLAG_SSE },
+#endif
 	{ 8, MASK_7_1, 4, MASK_3_1, channelmix_f32_7p1_3p1_c, 0 },
 
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+	{ ANY, 0, ANY, 0, channelmix_f32_n_m_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3 },
+#endif
+#if defined (HAVE_SSE)
+	{ ANY, 0, ANY, 0, channelmix_f32_n_m_sse, SPA_CPU_FLAG_SSE },
+#endif
 	{ ANY, 0, ANY, 0, channelmix_f32_n_m_c, 0 },
 };
 
@@ -71,6 +71,40 @@ int channelmix_init(struct channelmix *mix);
 #define channelmix_set_volume(mix,...)	(mix)->set_volume(mix, __VA_ARGS__)
 #define channelmix_free(mix)		(mix)->free(mix)
 
+/* mask to use for unpositioned channels */
+static inline uint64_t channelmix_default_mask(uint32_t channels)
+{
+	uint64_t mask = 0;
+	switch (channels) {
+	case 8:
+		mask |= _M(RL);
+		mask |= _M(RR);
+		/* fallthrough */
+	case 6:
+		mask |= _M(SL);
+		mask |= _M(SR);
+		mask |= _M(LFE);
+		/* fallthrough */
+	case 3:
+		mask |= _M(FC);
+		/* fallthrough */
+	case 2:
+		mask |= _M(FL);
+		mask |= _M(FR);
+		break;
+	case 1:
+		mask |= _M(MONO);
+		break;
+	case 4:
+		mask |= _M(FL);
+		mask |= _M(FR);
+		mask |= _M(RL);
+		mask |= _M(RR);
+		break;
+	}
+	return mask;
+}
+
 #define DEFINE_FUNCTION(name,arch)					\
 void channelmix_##name##_##arch(struct channelmix *mix,			\
 		uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],		\
@@ -95,9 +129,25 @@ DEFINE_FUNCTION(f32_7p1_4, c);
 
 #if defined (HAVE_SSE)
 DEFINE_FUNCTION(copy, sse);
+DEFINE_FUNCTION(f32_n_m, sse);
 DEFINE_FUNCTION(f32_2_4, sse);
 DEFINE_FUNCTION(f32_5p1_2, sse);
 DEFINE_FUNCTION(f32_5p1_3p1, sse);
 DEFINE_FUNCTION(f32_5p1_4, sse);
+DEFINE_FUNCTION(f32_7p1_2, sse);
+DEFINE_FUNCTION(f32_7p1_3p1, sse);
 DEFINE_FUNCTION(f32_7p1_4, sse);
 #endif
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+DEFINE_FUNCTION(f32_n_m, avx);
+DEFINE_FUNCTION(f32_7p1_2, avx);
+DEFINE_FUNCTION(f32_7p1_3p1, avx);
+DEFINE_FUNCTION(f32_7p1_4, avx);
+#endif
+#if defined (HAVE_NEON)
+DEFINE_FUNCTION(copy, neon);
+DEFINE_FUNCTION(f32_2_4, neon);
+DEFINE_FUNCTION(f32_5p1_2, neon);
+DEFINE_FUNCTION(f32_5p1_3p1, neon);
+DEFINE_FUNCTION(f32_5p1_4, neon);
+#endif
@@ -75,6 +75,7 @@ static void props_reset(struct props *props)
 struct buffer {
 	uint32_t id;
 #define BUFFER_FLAG_OUT		(1 << 0)
+#define BUFFER_FLAG_SILENT	(1 << 1)	/* the data is known to be all zero */
 	uint32_t flags;
 	struct spa_list link;
 	struct spa_buffer *outbuf;
@@ -153,39 +154,6 @@ static void emit_params_changed(struct impl *this)
 	emit_info(this, false);
 }
 
-static uint64_t default_mask(uint32_t channels)
-{
-	uint64_t mask = 0;
-	switch (channels) {
-	case 8:
-		mask |= _MASK(RL);
-		mask |= _MASK(RR);
-		/* fallthrough */
-	case 6:
-		mask |= _MASK(SL);
-		mask |= _MASK(SR);
-		mask |= _MASK(LFE);
-		/* fallthrough */
-	case 3:
-		mask |= _MASK(FC);
-		/* fallthrough */
-	case 2:
-		mask |= _MASK(FL);
-		mask |= _MASK(FR);
-		break;
-	case 1:
-		mask |= _MASK(MONO);
-		break;
-	case 4:
-		mask |= _MASK(FL);
-		mask |= _MASK(FR);
-		mask |= _MASK(RL);
-		mask |= _MASK(RR);
-		break;
-	}
-	return mask;
-}
-
 static int setup_convert(struct impl *this,
 		enum spa_direction direction,
 		const struct spa_audio_info *info)
@@ -212,9 +180,9 @@ static int setup_convert(struct impl *this,
 		dst_mask |= 1UL << dst_info->info.raw.position[i];
 
 	if (src_mask & 1 || src_chan == 1)
-		src_mask = default_mask(src_chan);
+		src_mask = channelmix_default_mask(src_chan);
 	if (dst_mask & 1 || dst_chan == 1)
-		dst_mask = default_mask(dst_chan);
+		dst_mask = channelmix_default_mask(dst_chan);
 
 	spa_log_info(this->log, NAME " %p: %s/%d@%d->%s/%d@%d %08"PRIx64":%08"PRIx64, this,
 			spa_debug_type_find_name(spa_type_audio_format, src_info->info.raw.format),
@@ -693,7 +661,11 @@ static int port_set_format(void *object,
 		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
 	}
+	/* EnumFormat of the other port is derived from this format */
+	other->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	other->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
 	emit_port_info(this, port, false);
+	emit_port_info(this, other, false);
 
 	return res;
 }
@@ -887,10 +859,14 @@ static int impl_node_process(void *object)
 		uint32_t n_dst_datas = db->n_datas;
 		const void *src_datas[n_src_datas];
 		void *dst_datas[n_dst_datas];
-		bool is_passthrough;
+		bool is_passthrough, gap;
 
 		is_passthrough = this->is_passthrough && this->mix.identity;
 
+		/* silence in or a muted matrix make silence */
+		gap = (sbuf->h && SPA_FLAG_IS_SET(sbuf->h->flags, SPA_META_HEADER_FLAG_GAP)) ||
+			this->mix.zero;
+
 		n_samples = sb->datas[0].chunk->size / inport->stride;
 
 		for (i = 0; i < n_src_datas; i++)
@@ -901,9 +877,25 @@ static int impl_node_process(void *object)
 			db->datas[i].chunk->size = n_samples * outport->stride;
 		}
 
-		if (!is_passthrough)
+		if (is_passthrough) {
+			/* the input data is passed on */
+		} else if (gap) {
+			if (!SPA_FLAG_IS_SET(dbuf->flags, BUFFER_FLAG_SILENT)) {
+				for (i = 0; i < n_dst_datas; i++)
+					memset(dbuf->datas[i], 0, db->datas[i].maxsize);
+				SPA_FLAG_SET(dbuf->flags, BUFFER_FLAG_SILENT);
+			}
+		} else {
 			channelmix_process(&this->mix, n_dst_datas, dst_datas,
 				    n_src_datas, src_datas, n_samples);
+			SPA_FLAG_CLEAR(dbuf->flags, BUFFER_FLAG_SILENT);
+		}
+		if (dbuf->h) {
+			if (gap)
+				SPA_FLAG_SET(dbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+			else
+				SPA_FLAG_CLEAR(dbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+		}
 	}
 
 	outio->status = SPA_STATUS_HAVE_DATA;
@@ -0,0 +1,534 @@
+/* Spa
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "fmt-ops.h"
+
+#include <immintrin.h>
+
+/* Every sample format has helpers to load, gather and store 8 samples as
+ * floats, to store them as two groups of 4 and to read or write a single
+ * sample for the tails. The conversion
+ * functions are generated from them with the macros below and produce the
+ * same results as the C versions. */
+
+#define u8_SIZE		1
+#define s16_SIZE	2
+#define s24_SIZE	3
+#define s32_SIZE	4
+#define s24_32_SIZE	4
+#define f32_SIZE	4
+
+static inline __m256 clamp_avx2(__m256 in)
+{
+	in = _mm256_max_ps(in, _mm256_set1_ps(-1.0f));
+	return _mm256_min_ps(in, _mm256_set1_ps(1.0f));
+}
+
+static inline float u8_read(const void *src)
+{
+	return U8_TO_F32(*(const uint8_t*)src);
+}
+
+static inline void u8_write(void *dst, float val)
+{
+	*(uint8_t*)dst = F32_TO_U8(val);
+}
+
+static inline __m256 u8_to_f32_avx2(__m256i in)
+{
+	__m256 out = _mm256_cvtepi32_ps(in);
+	out = _mm256_mul_ps(out, _mm256_set1_ps(1.0f / U8_OFFS));
+	return _mm256_sub_ps(out, _mm256_set1_ps(1.0f));
+}
+
+static inline __m256 u8_load_avx2(const void *src)
+{
+	__m128i in = _mm_loadl_epi64((const __m128i*)src);
+	return u8_to_f32_avx2(_mm256_cvtepu8_epi32(in));
+}
+
+static inline __m256 u8_gather_avx2(const void *src, __m256i offs)
+{
+	__m256i in = _mm256_i32gather_epi32((const int*)src, offs, 1);
+	return u8_to_f32_avx2(_mm256_and_si256(in, _mm256_set1_epi32(0xff)));
+}
+
+static inline void u8_store2_avx2(void *dst0, void *dst1, __m256 in)
+{
+	__m256i out;
+
+	in = _mm256_mul_ps(clamp_avx2(in), _mm256_set1_ps(U8_SCALE));
+	in = _mm256_add_ps(in, _mm256_set1_ps(U8_OFFS));
+	out = _mm256_cvttps_epi32(in);
+	out = _mm256_packus_epi32(out, out);
+	out = _mm256_packus_epi16(out, out);
+	*((int32_t*)dst0) = _mm_cvtsi128_si32(_mm256_castsi256_si128(out));
+	*((int32_t*)dst1) = _mm_cvtsi128_si32(_mm256_extracti128_si256(out, 1));
+}
+
+static inline void u8_store_avx2(void *dst, __m256 in)
+{
+	u8_store2_avx2(dst, SPA_MEMBER(dst, 4 * u8_SIZE, void), in);
+}
+
+static inline float s16_read(const void *src)
+{
+	return S16_TO_F32(*(const int16_t*)src);
+}
+
+static inline void s16_write(void *dst, float val)
+{
+	*(int16_t*)dst = F32_TO_S16(val);
+}
+
+static inline __m256 s16_load_avx2(const void *src)
+{
+	__m256i in = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)src));
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(in), _mm256_set1_ps(1.0f / S16_SCALE));
+}
+
+static inline __m256 s16_gather_avx2(const void *src, __m256i offs)
+{
+	__m256i in = _mm256_i32gather_epi32((const int*)src, offs, 1);
+	in = _mm256_srai_epi32(_mm256_slli_epi32(in, 16), 16);
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(in), _mm256_set1_ps(1.0f / S16_SCALE));
+}
+
+static inline void s16_store2_avx2(void *dst0, void *dst1, __m256 in)
+{
+	__m256i out;
+
+	in = _mm256_mul_ps(clamp_avx2(in), _mm256_set1_ps(S16_SCALE));
+	out = _mm256_cvttps_epi32(in);
+	out = _mm256_packs_epi32(out, out);
+	_mm_storel_epi64((__m128i*)dst0, _mm256_castsi256_si128(out));
+	_mm_storel_epi64((__m128i*)dst1, _mm256_extracti128_si256(out, 1));
+}
+
+static inline void s16_store_avx2(void *dst, __m256 in)
+{
+	s16_store2_avx2(dst, SPA_MEMBER(dst, 4 * s16_SIZE, void), in);
+}
+
+static inline float s24_read(const void *src)
+{
+	return S24_TO_F32(read_s24(src));
+}
+
+static inline void s24_write(void *dst, float val)
+{
+	write_s24(dst, F32_TO_S24(val));
+}
+
+static inline __m256 s24_load_avx2(const void *src)
+{
+	const uint8_t *s = src;
+	__m256i in;
+
+	/* samples 0-3 are in the low lane, 4-7 start at byte 4 of the high lane */
+	in = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)&s[0])),
+			_mm_loadu_si128((const __m128i*)&s[8]), 1);
+	in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(
+			-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+			-1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15));
+	in = _mm256_srai_epi32(in, 8);
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(in), _mm256_set1_ps(1.0f / S24_SCALE));
+}
+
+static inline __m256 s24_gather_avx2(const void *src, __m256i offs)
+{
+	__m256i in = _mm256_i32gather_epi32((const int*)src, offs, 1);
+	in = _mm256_srai_epi32(_mm256_slli_epi32(in, 8), 8);
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(in), _mm256_set1_ps(1.0f / S24_SCALE));
+}
+
+static inline void s24_store2_avx2(void *dst0, void *dst1, __m256 in)
+{
+	uint8_t *d0 = dst0, *d1 = dst1;
+	__m256i out;
+	__m128i lo, hi;
+
+	in = _mm256_mul_ps(clamp_avx2(in), _mm256_set1_ps(S24_SCALE));
+	out = _mm256_cvttps_epi32(in);
+	out = _mm256_shuffle_epi8(out, _mm256_setr_epi8(
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+	lo = _mm256_castsi256_si128(out);
+	hi = _mm256_extracti128_si256(out, 1);
+	_mm_storel_epi64((__m128i*)&d0[0], lo);
+	*((int32_t*)&d0[8]) = _mm_extract_epi32(lo, 2);
+	_mm_storel_epi64((__m128i*)&d1[0], hi);
+	*((int32_t*)&d1[8]) = _mm_extract_epi32(hi, 2);
+}
+
+static inline void s24_store_avx2(void *dst, __m256 in)
+{
+	s24_store2_avx2(dst, SPA_MEMBER(dst, 4 * s24_SIZE, void), in);
+}
+
+static inline float s32_read(const void *src)
+{
+	return S32_TO_F32(*(const int32_t*)src);
+}
+
+static inline void s32_write(void *dst, float val)
+{
+	*(int32_t*)dst = F32_TO_S32(val);
+}
+
+static inline __m256 s32_load_avx2(const void *src)
+{
+	__m256i in = _mm256_loadu_si256((const __m256i*)src);
+	in = _mm256_srai_epi32(in, 8);
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(in), _mm256_set1_ps(1.0f / S24_SCALE));
+}
+
+static inline __m256 s32_gather_avx2(const void *src, __m256i offs)
+{
+	__m256i in = _mm256_i32gather_epi32((const int*)src, offs, 1);
+	in = _mm256_srai_epi32(in, 8);
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(in), _mm256_set1_ps(1.0f / S24_SCALE));
+}
+
+static inline __m256i s32_pack_avx2(__m256 in)
+{
+	in = _mm256_mul_ps(clamp_avx2(in), _mm256_set1_ps(S24_SCALE));
+	return _mm256_slli_epi32(_mm256_cvttps_epi32(in), 8);
+}
+
+static inline void s32_store2_avx2(void *dst0, void *dst1, __m256 in)
+{
+	__m256i out = s32_pack_avx2(in);
+	_mm_storeu_si128((__m128i*)dst0, _mm256_castsi256_si128(out));
+	_mm_storeu_si128((__m128i*)dst1, _mm256_extracti128_si256(out, 1));
+}
+
+static inline void s32_store_avx2(void *dst, __m256 in)
+{
+	_mm256_storeu_si256((__m256i*)dst, s32_pack_avx2(in));
+}
+
+static inline float s24_32_read(const void *src)
+{
+	return S24_TO_F32(*(const int32_t*)src);
+}
+
+static inline void s24_32_write(void *dst, float val)
+{
+	*(int32_t*)dst = F32_TO_S24(val);
+}
+
+static inline __m256 s24_32_load_avx2(const void *src)
+{
+	__m256i in = _mm256_loadu_si256((const __m256i*)src);
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(in), _mm256_set1_ps(1.0f / S24_SCALE));
+}
+
+static inline __m256 s24_32_gather_avx2(const void *src, __m256i offs)
+{
+	__m256i in = _mm256_i32gather_epi32((const int*)src, offs, 1);
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(in), _mm256_set1_ps(1.0f / S24_SCALE));
+}
+
+static inline __m256i s24_32_pack_avx2(__m256 in)
+{
+	in = _mm256_mul_ps(clamp_avx2(in), _mm256_set1_ps(S24_SCALE));
+	return _mm256_cvttps_epi32(in);
+}
+
+static inline void s24_32_store2_avx2(void *dst0, void *dst1, __m256 in)
+{
+	__m256i out = s24_32_pack_avx2(in);
+	_mm_storeu_si128((__m128i*)dst0, _mm256_castsi256_si128(out));
+	_mm_storeu_si128((__m128i*)dst1, _mm256_extracti128_si256(out, 1));
+}
+
+static inline void s24_32_store_avx2(void *dst, __m256 in)
+{
+	_mm256_storeu_si256((__m256i*)dst, s24_32_pack_avx2(in));
+}
+
+static inline float f32_read(const void *src)
+{
+	return *(const float*)src;
+}
+
+static inline void f32_write(void *dst, float val)
+{
+	*(float*)dst = val;
+}
+
+static inline __m256 f32_load_avx2(const void *src)
+{
+	return _mm256_loadu_ps(src);
+}
+
+static inline __m256 f32_gather_avx2(const void *src, __m256i offs)
+{
+	return _mm256_i32gather_ps(src, offs, 1);
+}
+
+static inline void f32_store2_avx2(void *dst0, void *dst1, __m256 in)
+{
+	_mm_storeu_ps(dst0, _mm256_castps256_ps128(in));
+	_mm_storeu_ps(dst1, _mm256_extractf128_ps(in, 1));
+}
+
+static inline void f32_store_avx2(void *dst, __m256 in)
+{
+	_mm256_storeu_ps(dst, in);
+}
+
+/* [a0 b0 a1 b1 ... a7 b7] -> [a0 ... a7] [b0 ... b7] */
+static inline void deinterleave_2_avx2(const __m256 in[2], __m256 out[2])
+{
+	__m256 a, b;
+
+	a = _mm256_shuffle_ps(in[0], in[1], _MM_SHUFFLE(2, 0, 2, 0));
+	b = _mm256_shuffle_ps(in[0], in[1], _MM_SHUFFLE(3, 1, 3, 1));
+	out[0] = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(a), _MM_SHUFFLE(3, 1, 2, 0)));
+	out[1] = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(b), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+/* [a0 ... a7] [b0 ... b7] -> [a0 b0 a1 b1 ... a7 b7] */
+static inline void interleave_2_avx2(const __m256 in[2], __m256 out[2])
+{
+	__m256 lo, hi;
+
+	lo = _mm256_unpacklo_ps(in[0], in[1]);
+	hi = _mm256_unpackhi_ps(in[0], in[1]);
+	out[0] = _mm256_permute2f128_ps(lo, hi, 0x20);
+	out[1] = _mm256_permute2f128_ps(lo, hi, 0x31);
+}
+
+/* [a0 ... a7] [b0 ... b7] [c0 ... c7] [d0 ... d7] ->
+ * [a0 b0 c0 d0 a4 b4 c4 d4] [a1 b1 c1 d1 a5 b5 c5 d5] ... */
+static inline void interleave_4_avx2(const __m256 in[4], __m256 out[4])
+{
+	__m256 t[4];
+
+	t[0] = _mm256_unpacklo_ps(in[0], in[1]);
+	t[1] = _mm256_unpackhi_ps(in[0], in[1]);
+	t[2] = _mm256_unpacklo_ps(in[2], in[3]);
+	t[3] = _mm256_unpackhi_ps(in[2], in[3]);
+	out[0] = _mm256_shuffle_ps(t[0], t[2], _MM_SHUFFLE(1, 0, 1, 0));
+	out[1] = _mm256_shuffle_ps(t[0], t[2], _MM_SHUFFLE(3, 2, 3, 2));
+	out[2] = _mm256_shuffle_ps(t[1], t[3], _MM_SHUFFLE(1, 0, 1, 0));
+	out[3] = _mm256_shuffle_ps(t[1], t[3], _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+/* interleaved to interleaved */
+#define MAKE_CONV(name,from,to)								\
+void											\
+conv_##name##_avx2(struct convert *conv, void * SPA_RESTRICT dst[],			\
+		const void * SPA_RESTRICT src[], uint32_t n_samples)			\
+{											\
+	const uint8_t *s = src[0];							\
+	uint8_t *d = dst[0];								\
+	uint32_t n, unrolled;								\
+											\
+	n_samples *= conv->n_channels;							\
+	unrolled = n_samples & ~7;							\
+											\
+	for (n = 0; n < unrolled; n += 8)						\
+		to##_store_avx2(&d[n * to##_SIZE], from##_load_avx2(&s[n * from##_SIZE]));	\
+	for (; n < n_samples; n++)							\
+		to##_write(&d[n * to##_SIZE], from##_read(&s[n * from##_SIZE]));	\
+}
+
+/* planar to planar */
+#define MAKE_CONV_PLANAR(name,from,to)							\
+void											\
+conv_##name##_avx2(struct convert *conv, void * SPA_RESTRICT dst[],			\
+		const void * SPA_RESTRICT src[], uint32_t n_samples)			\
+{											\
+	uint32_t i, n, unrolled = n_samples & ~7, n_channels = conv->n_channels;	\
+											\
+	for (i = 0; i < n_channels; i++) {						\
+		const uint8_t *s = src[i];						\
+		uint8_t *d = dst[i];							\
+											\
+		for (n = 0; n < unrolled; n += 8)					\
+			to##_store_avx2(&d[n * to##_SIZE], from##_load_avx2(&s[n * from##_SIZE]));	\
+		for (; n < n_samples; n++)						\
+			to##_write(&d[n * to##_SIZE], from##_read(&s[n * from##_SIZE]));	\
+	}										\
+}
+
+/* interleaved to planar. Stereo is shuffled from contiguous loads, other
+ * channel counts gather the samples of a channel. The gather reads 4 bytes
+ * per sample so for the smaller formats the frames that would be read past
+ * the end are left for the tail. */
+#define MAKE_CONV_DEINTERLEAVE(name,from,to)						\
+void											\
+conv_##name##_avx2(struct convert *conv, void * SPA_RESTRICT dst[],			\
+		const void * SPA_RESTRICT src[], uint32_t n_samples)			\
+{											\
+	const uint8_t *s = src[0];							\
+	uint8_t **d = (uint8_t **) dst;							\
+	uint32_t i, n, unrolled, n_channels = conv->n_channels;				\
+	uint32_t stride = n_channels * from##_SIZE;					\
+											\
+	if (n_channels == 2) {								\
+		__m256 in[2], out[2];							\
+											\
+		unrolled = n_samples & ~7;						\
+		for (n = 0; n < unrolled; n += 8) {					\
+			in[0] = from##_load_avx2(&s[(2 * n + 0) * from##_SIZE]);	\
+			in[1] = from##_load_avx2(&s[(2 * n + 8) * from##_SIZE]);	\
+			deinterleave_2_avx2(in, out);					\
+			to##_store_avx2(&d[0][n * to##_SIZE], out[0]);			\
+			to##_store_avx2(&d[1][n * to##_SIZE], out[1]);			\
+		}									\
+	} else {									\
+		__m256i offs = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),	\
+				_mm256_set1_epi32(stride));				\
+											\
+		uint32_t pad = (4 - from##_SIZE + stride - 1) / stride;		\
+											\
+		unrolled = n_samples > pad ? (n_samples - pad) & ~7 : 0;		\
+											\
+		for (n = 0; n < unrolled; n += 8) {					\
+			for (i = 0; i < n_channels; i++)				\
+				to##_store_avx2(&d[i][n * to##_SIZE],			\
+					from##_gather_avx2(&s[n * stride + i * from##_SIZE], offs));	\
+		}									\
+	}										\
+	for (; n < n_samples; n++) {							\
+		for (i = 0; i < n_channels; i++)					\
+			to##_write(&d[i][n * to##_SIZE],				\
+					from##_read(&s[n * stride + i * from##_SIZE]));	\
+	}										\
+}
+
+/* planar to interleaved. Stereo is shuffled into contiguous stores. Other
+ * channel counts are done 4 channels at a time, transposed so that 4
+ * samples are stored in each frame, and the remaining channels one sample
+ * at a time from a temporary. */
+#define MAKE_CONV_INTERLEAVE(name,from,to)						\
+void											\
+conv_##name##_avx2(struct convert *conv, void * SPA_RESTRICT dst[],			\
+		const void * SPA_RESTRICT src[], uint32_t n_samples)			\
+{											\
+	const uint8_t **s = (const uint8_t **) src;					\
+	uint8_t *d = dst[0];								\
+	uint32_t i, k, n, unrolled = n_samples & ~7, n_channels = conv->n_channels;	\
+	uint32_t stride = n_channels * to##_SIZE;					\
+											\
+	if (n_channels == 2) {								\
+		__m256 in[2], out[2];							\
+											\
+		for (n = 0; n < unrolled; n += 8) {					\
+			in[0] = from##_load_avx2(&s[0][n * from##_SIZE]);		\
+			in[1] = from##_load_avx2(&s[1][n * from##_SIZE]);		\
+			interleave_2_avx2(in, out);					\
+			to##_store_avx2(&d[(2 * n + 0) * to##_SIZE], out[0]);		\
+			to##_store_avx2(&d[(2 * n + 8) * to##_SIZE], out[1]);		\
+		}									\
+	} else {									\
+		__m256 in[4], out[4];							\
+		uint8_t tmp[8 * to##_SIZE];						\
+											\
+		for (i = 0; i + 4 <= n_channels; i += 4) {				\
+			for (n = 0; n < unrolled; n += 8) {				\
+				for (k = 0; k < 4; k++)					\
+					in[k] = from##_load_avx2(&s[i + k][n * from##_SIZE]);	\
+				interleave_4_avx2(in, out);				\
+				for (k = 0; k < 4; k++)					\
+					to##_store2_avx2(&d[(n + k) * stride + i * to##_SIZE],	\
+						&d[(n + k + 4) * stride + i * to##_SIZE], out[k]);	\
+			}								\
+		}									\
+		for (; i < n_channels; i++) {						\
+			for (n = 0; n < unrolled; n += 8) {				\
+				to##_store_avx2(tmp, from##_load_avx2(&s[i][n * from##_SIZE]));	\
+				for (k = 0; k < 8; k++)					\
+					memcpy(&d[(n + k) * stride + i * to##_SIZE],	\
+							&tmp[k * to##_SIZE], to##_SIZE);\
+			}								\
+		}									\
+		n = unrolled;								\
+	}										\
+	for (; n < n_samples; n++) {							\
+		for (i = 0; i < n_channels; i++)					\
+			to##_write(&d[n * stride + i * to##_SIZE],			\
+					from##_read(&s[i][n * from##_SIZE]));		\
+	}										\
+}
+
+MAKE_CONV(u8_to_f32, u8, f32)
+MAKE_CONV_PLANAR(u8d_to_f32d, u8, f32)
+MAKE_CONV_DEINTERLEAVE(u8_to_f32d, u8, f32)
+MAKE_CONV_INTERLEAVE(u8d_to_f32, u8, f32)
+
+MAKE_CONV(s16_to_f32, s16, f32)
+MAKE_CONV_PLANAR(s16d_to_f32d, s16, f32)
+MAKE_CONV_DEINTERLEAVE(s16_to_f32d, s16, f32)
+MAKE_CONV_INTERLEAVE(s16d_to_f32, s16, f32)
+
+MAKE_CONV(s24_to_f32, s24, f32)
+MAKE_CONV_PLANAR(s24d_to_f32d, s24, f32)
+MAKE_CONV_DEINTERLEAVE(s24_to_f32d, s24, f32)
+MAKE_CONV_INTERLEAVE(s24d_to_f32, s24, f32)
+
+MAKE_CONV(s32_to_f32, s32, f32)
+MAKE_CONV_PLANAR(s32d_to_f32d, s32, f32)
+MAKE_CONV_DEINTERLEAVE(s32_to_f32d, s32, f32)
+MAKE_CONV_INTERLEAVE(s32d_to_f32, s32, f32)
+
+MAKE_CONV(s24_32_to_f32, s24_32, f32)
+MAKE_CONV_PLANAR(s24_32d_to_f32d, s24_32, f32)
+MAKE_CONV_DEINTERLEAVE(s24_32_to_f32d, s24_32, f32)
+MAKE_CONV_INTERLEAVE(s24_32d_to_f32, s24_32, f32)
+
+MAKE_CONV(f32_to_u8, f32, u8)
+MAKE_CONV_PLANAR(f32d_to_u8d, f32, u8)
+MAKE_CONV_DEINTERLEAVE(f32_to_u8d, f32, u8)
+MAKE_CONV_INTERLEAVE(f32d_to_u8, f32, u8)
+
+MAKE_CONV(f32_to_s16, f32, s16)
+MAKE_CONV_PLANAR(f32d_to_s16d, f32, s16)
+MAKE_CONV_DEINTERLEAVE(f32_to_s16d, f32, s16)
+MAKE_CONV_INTERLEAVE(f32d_to_s16, f32, s16)
+
+MAKE_CONV(f32_to_s24, f32, s24)
+MAKE_CONV_PLANAR(f32d_to_s24d, f32, s24)
+MAKE_CONV_DEINTERLEAVE(f32_to_s24d, f32, s24)
+MAKE_CONV_INTERLEAVE(f32d_to_s24, f32, s24)
+
+MAKE_CONV(f32_to_s32, f32, s32)
+MAKE_CONV_PLANAR(f32d_to_s32d, f32, s32)
+MAKE_CONV_DEINTERLEAVE(f32_to_s32d, f32, s32)
+MAKE_CONV_INTERLEAVE(f32d_to_s32, f32, s32)
+
+MAKE_CONV(f32_to_s24_32, f32, s24_32)
+MAKE_CONV_PLANAR(f32d_to_s24_32d, f32, s24_32)
+MAKE_CONV_DEINTERLEAVE(f32_to_s24_32d, f32, s24_32)
+MAKE_CONV_INTERLEAVE(f32d_to_s24_32, f32, s24_32)
+
+MAKE_CONV_DEINTERLEAVE(deinterleave_32, f32, f32)
+MAKE_CONV_INTERLEAVE(interleave_32, f32, f32)
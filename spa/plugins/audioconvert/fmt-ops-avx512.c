@@ -0,0 +1,135 @@
+/* Spa
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fmt-ops.h"
+
+#include <immintrin.h>
+
+/* The AVX-512 gather loads 16 samples of a channel at once, which makes
+ * deinterleaving the 32 bits formats faster than with AVX2 for all but
+ * stereo. The scatter is slower than the AVX2 transposes and the contiguous
+ * conversions are memory bound so those use the AVX2 versions. */
+
+static inline __m512 clamp_avx512(__m512 in)
+{
+	in = _mm512_max_ps(in, _mm512_set1_ps(-1.0f));
+	return _mm512_min_ps(in, _mm512_set1_ps(1.0f));
+}
+
+static inline float s32_read(const void *src)
+{
+	return S32_TO_F32(*(const int32_t*)src);
+}
+
+static inline void s32_write(void *dst, float val)
+{
+	*(int32_t*)dst = F32_TO_S32(val);
+}
+
+static inline __m512 s32_to_f32_avx512(__m512i in)
+{
+	in = _mm512_srai_epi32(in, 8);
+	return _mm512_mul_ps(_mm512_cvtepi32_ps(in), _mm512_set1_ps(1.0f / S24_SCALE));
+}
+
+static inline __m512i f32_to_s32_avx512(__m512 in)
+{
+	in = _mm512_mul_ps(clamp_avx512(in), _mm512_set1_ps(S24_SCALE));
+	return _mm512_slli_epi32(_mm512_cvttps_epi32(in), 8);
+}
+
+static inline float s24_32_read(const void *src)
+{
+	return S24_TO_F32(*(const int32_t*)src);
+}
+
+static inline void s24_32_write(void *dst, float val)
+{
+	*(int32_t*)dst = F32_TO_S24(val);
+}
+
+static inline __m512 s24_32_to_f32_avx512(__m512i in)
+{
+	return _mm512_mul_ps(_mm512_cvtepi32_ps(in), _mm512_set1_ps(1.0f / S24_SCALE));
+}
+
+static inline __m512i f32_to_s24_32_avx512(__m512 in)
+{
+	in = _mm512_mul_ps(clamp_avx512(in), _mm512_set1_ps(S24_SCALE));
+	return _mm512_cvttps_epi32(in);
+}
+
+static inline float f32_read(const void *src)
+{
+	return *(const float*)src;
+}
+
+static inline void f32_write(void *dst, float val)
+{
+	*(float*)dst = val;
+}
+
+static inline __m512i offsets_avx512(uint32_t stride)
+{
+	return _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+				8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(stride));
+}
+
+/* interleaved to planar, gathers the samples of each channel */
+#define MAKE_CONV_DEINTERLEAVE(name,from,to,conv_func)					\
+void											\
+conv_##name##_avx512(struct convert *conv, void * SPA_RESTRICT dst[],			\
+		const void * SPA_RESTRICT src[], uint32_t n_samples)			\
+{											\
+	const uint32_t *s = src[0];							\
+	uint32_t **d = (uint32_t **) dst;						\
+	uint32_t i, n, unrolled = n_samples & ~15, n_channels = conv->n_channels;	\
+	__m512i offs = offsets_avx512(n_channels * sizeof(uint32_t));			\
+	__m512i in;									\
+											\
+	for (n = 0; n < unrolled; n += 16) {						\
+		for (i = 0; i < n_channels; i++) {					\
+			in = _mm512_i32gather_epi32(offs, &s[n * n_channels + i], 1);	\
+			_mm512_storeu_si512(&d[i][n], conv_func(in));			\
+		}									\
+	}										\
+	for (; n < n_samples; n++) {							\
+		for (i = 0; i < n_channels; i++)					\
+			to##_write(&d[i][n], from##_read(&s[n * n_channels + i]));	\
+	}										\
+}
+
+#define S32_TO_F32_AVX512(v)	_mm512_castps_si512(s32_to_f32_avx512(v))
+#define S24_32_TO_F32_AVX512(v)	_mm512_castps_si512(s24_32_to_f32_avx512(v))
+#define F32_TO_S32_AVX512(v)	f32_to_s32_avx512(_mm512_castsi512_ps(v))
+#define F32_TO_S24_32_AVX512(v)	f32_to_s24_32_avx512(_mm512_castsi512_ps(v))
+#define F32_TO_F32_AVX512(v)	(v)
+
+MAKE_CONV_DEINTERLEAVE(s32_to_f32d, s32, f32, S32_TO_F32_AVX512)
+MAKE_CONV_DEINTERLEAVE(s24_32_to_f32d, s24_32, f32, S24_32_TO_F32_AVX512)
+
+MAKE_CONV_DEINTERLEAVE(f32_to_s32d, f32, s32, F32_TO_S32_AVX512)
+MAKE_CONV_DEINTERLEAVE(f32_to_s24_32d, f32, s24_32, F32_TO_S24_32_AVX512)
+
+MAKE_CONV_DEINTERLEAVE(deinterleave_32, f32, f32, F32_TO_F32_AVX512)
@@ -502,6 +502,224 @@ conv_f32d_to_s16_c(struct convert *conv, void * SPA_RESTRICT dst[], const void *
 	}
 }
 
+static inline uint32_t xorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return (*state = x);
+}
+
+/* fill the first n_samples of conv->dither with noise in LSB units. Every
+ * sample uses the lane n & 3 of the state so that the SIMD versions
+ * produce the same sequence. */
+void update_dither_c(struct convert *conv, uint32_t n_samples)
+{
+	uint32_t n, *state = conv->random;
+	const float scale = 1.0f / 4294967296.0f;
+	float *dither = conv->dither;
+
+	if (conv->method == DITHER_METHOD_RECTANGULAR) {
+		for (n = 0; n < n_samples; n++)
+			dither[n] = (int32_t)xorshift(&state[n & 3]) * scale;
+	} else {
+		for (n = 0; n < n_samples; n++) {
+			float r = (int32_t)xorshift(&state[n & 3]) * scale;
+			dither[n] = r + (int32_t)xorshift(&state[n & 3]) * scale;
+		}
+	}
+}
+
+/* The dither variants convert in blocks of at most DITHER_SIZE samples.
+ * Noise is consumed in source order, for planar sources channel i uses
+ * dither[i * chunk + n]. */
+void
+conv_f32d_to_s16d_dither_c(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, j, n, chunk, n_channels = conv->n_channels;
+	const float *dither = conv->dither;
+
+	for (j = 0; j < n_samples; j += chunk) {
+		chunk = SPA_MIN(n_samples - j, DITHER_SIZE / n_channels);
+		update_dither_c(conv, chunk * n_channels);
+
+		for (i = 0; i < n_channels; i++) {
+			const float *s = (const float *)src[i] + j, *r = &dither[i * chunk];
+			int16_t *d = (int16_t *)dst[i] + j;
+
+			for (n = 0; n < chunk; n++)
+				d[n] = F32_TO_S16_D(s[n], r[n]);
+		}
+	}
+}
+
+void
+conv_f32_to_s16_dither_c(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n, chunk, n_channels = conv->n_channels;
+	const float *s = src[0], *dither = conv->dither;
+	int16_t *d = dst[0];
+
+	n_samples *= n_channels;
+
+	for (i = 0; i < n_samples; i += chunk) {
+		chunk = SPA_MIN(n_samples - i, DITHER_SIZE);
+		update_dither_c(conv, chunk);
+
+		for (n = 0; n < chunk; n++)
+			d[i + n] = F32_TO_S16_D(s[i + n], dither[n]);
+	}
+}
+
+void
+conv_f32_to_s16d_dither_c(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float *s = src[0], *dither = conv->dither;
+	int16_t **d = (int16_t **) dst;
+	uint32_t i, j, n, chunk, n_channels = conv->n_channels;
+
+	for (j = 0; j < n_samples; j += chunk) {
+		chunk = SPA_MIN(n_samples - j, DITHER_SIZE / n_channels);
+		update_dither_c(conv, chunk * n_channels);
+
+		for (n = 0; n < chunk; n++) {
+			for (i = 0; i < n_channels; i++)
+				d[i][j + n] = F32_TO_S16_D(*s++, dither[n * n_channels + i]);
+		}
+	}
+}
+
+void
+conv_f32d_to_s16_dither_c(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float **s = (const float **) src;
+	const float *dither = conv->dither;
+	int16_t *d = dst[0];
+	uint32_t i, j, n, chunk, n_channels = conv->n_channels;
+
+	for (j = 0; j < n_samples; j += chunk) {
+		chunk = SPA_MIN(n_samples - j, DITHER_SIZE / n_channels);
+		update_dither_c(conv, chunk * n_channels);
+
+		for (n = 0; n < chunk; n++) {
+			for (i = 0; i < n_channels; i++)
+				*d++ = F32_TO_S16_D(s[i][j + n], dither[i * chunk + n]);
+		}
+	}
+}
+
+/* Lipshitz' minimally audible noise shaping filter, the error is fed back
+ * through it so that the quantization noise moves to where the ear is
+ * least sensitive. */
+static const float ns_lipshitz[] = { 2.033f, -2.165f, 1.959f, -1.590f, 0.6149f };
+
+static inline int16_t shape_s16(struct shaper *sh, float v, float r)
+{
+	uint32_t k, idx = sh->idx;
+	float t;
+	int16_t out;
+
+	v *= S16_SCALE;
+	for (k = 0; k < SPA_N_ELEMENTS(ns_lipshitz); k++)
+		v -= ns_lipshitz[k] * sh->e[idx + k];
+
+	t = SPA_CLAMP(v, S16_MIN, S16_MAX);
+	out = lrintf(SPA_CLAMP(t + r, S16_MIN, S16_MAX));
+
+	idx = (idx + MAX_NS - 1) & (MAX_NS - 1);
+	sh->e[idx] = sh->e[idx + MAX_NS] = out - t;
+	sh->idx = idx;
+
+	return out;
+}
+
+void
+conv_f32d_to_s16d_shaped_c(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, j, n, chunk, n_channels = conv->n_channels;
+	const float *dither = conv->dither;
+
+	for (j = 0; j < n_samples; j += chunk) {
+		chunk = SPA_MIN(n_samples - j, DITHER_SIZE / n_channels);
+		update_dither_c(conv, chunk * n_channels);
+
+		for (i = 0; i < n_channels; i++) {
+			const float *s = (const float *)src[i] + j, *r = &dither[i * chunk];
+			int16_t *d = (int16_t *)dst[i] + j;
+			struct shaper *sh = &conv->shaper[i];
+
+			for (n = 0; n < chunk; n++)
+				d[n] = shape_s16(sh, s[n], r[n]);
+		}
+	}
+}
+
+void
+conv_f32_to_s16_shaped_c(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float *s = src[0], *dither = conv->dither;
+	int16_t *d = dst[0];
+	uint32_t i, j, n, chunk, n_channels = conv->n_channels;
+
+	for (j = 0; j < n_samples; j += chunk) {
+		chunk = SPA_MIN(n_samples - j, DITHER_SIZE / n_channels);
+		update_dither_c(conv, chunk * n_channels);
+
+		for (n = 0; n < chunk * n_channels; n += n_channels) {
+			for (i = 0; i < n_channels; i++)
+				*d++ = shape_s16(&conv->shaper[i], *s++, dither[n + i]);
+		}
+	}
+}
+
+void
+conv_f32_to_s16d_shaped_c(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float *s = src[0], *dither = conv->dither;
+	int16_t **d = (int16_t **) dst;
+	uint32_t i, j, n, chunk, n_channels = conv->n_channels;
+
+	for (j = 0; j < n_samples; j += chunk) {
+		chunk = SPA_MIN(n_samples - j, DITHER_SIZE / n_channels);
+		update_dither_c(conv, chunk * n_channels);
+
+		for (n = 0; n < chunk; n++) {
+			for (i = 0; i < n_channels; i++)
+				d[i][j + n] = shape_s16(&conv->shaper[i], *s++,
+						dither[n * n_channels + i]);
+		}
+	}
+}
+
+void
+conv_f32d_to_s16_shaped_c(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float **s = (const float **) src;
+	const float *dither = conv->dither;
+	int16_t *d = dst[0];
+	uint32_t i, j, n, chunk, n_channels = conv->n_channels;
+
+	for (j = 0; j < n_samples; j += chunk) {
+		chunk = SPA_MIN(n_samples - j, DITHER_SIZE / n_channels);
+		update_dither_c(conv, chunk * n_channels);
+
+		for (n = 0; n < chunk; n++) {
+			for (i = 0; i < n_channels; i++)
+				*d++ = shape_s16(&conv->shaper[i], s[i][j + n],
+						dither[i * chunk + n]);
+		}
+	}
+}
+
 void
 conv_f32d_to_s32d_c(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
 		uint32_t n_samples)
@@ -0,0 +1,345 @@
+/* Spa
+ *
+ * Copyright © 2018 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fmt-ops.h"
+
+#include <arm_neon.h>
+
+/* per format lane and structure accessors, the lane index must be a
+ * constant so these are macros */
+#define s16_zero		vdup_n_s16(0)
+#define s16_ld1_lane		vld1_lane_s16
+#define s16_ld2_lane		vld2_lane_s16
+#define s16_ld4_lane		vld4_lane_s16
+#define s16_ld2			vld2_s16
+#define s16_ld4			vld4_s16
+#define s16_st1_lane		vst1_lane_s16
+#define s16_st2_lane		vst2_lane_s16
+#define s16_st4_lane		vst4_lane_s16
+#define s16_st2			vst2_s16
+#define s16_st4			vst4_s16
+#define s16_read(v)		S16_TO_F32(v)
+#define s16_write(v)		F32_TO_S16(v)
+typedef int16_t s16_t;
+typedef int16x4_t s16x1_t;
+typedef int16x4x2_t s16x2_t;
+typedef int16x4x4_t s16x4_t;
+
+#define s32_zero		vdupq_n_s32(0)
+#define s32_ld1_lane		vld1q_lane_s32
+#define s32_ld2_lane		vld2q_lane_s32
+#define s32_ld4_lane		vld4q_lane_s32
+#define s32_ld2			vld2q_s32
+#define s32_ld4			vld4q_s32
+#define s32_st1_lane		vst1q_lane_s32
+#define s32_st2_lane		vst2q_lane_s32
+#define s32_st4_lane		vst4q_lane_s32
+#define s32_st2			vst2q_s32
+#define s32_st4			vst4q_s32
+#define s32_read(v)		S32_TO_F32(v)
+#define s32_write(v)		F32_TO_S32(v)
+typedef int32_t s32_t;
+typedef int32x4_t s32x1_t;
+typedef int32x4x2_t s32x2_t;
+typedef int32x4x4_t s32x4_t;
+
+#define s24_32_zero		s32_zero
+#define s24_32_ld1_lane		s32_ld1_lane
+#define s24_32_ld2_lane		s32_ld2_lane
+#define s24_32_ld4_lane		s32_ld4_lane
+#define s24_32_ld2		s32_ld2
+#define s24_32_ld4		s32_ld4
+#define s24_32_st1_lane		s32_st1_lane
+#define s24_32_st2_lane		s32_st2_lane
+#define s24_32_st4_lane		s32_st4_lane
+#define s24_32_st2		s32_st2
+#define s24_32_st4		s32_st4
+#define s24_32_read(v)		S24_TO_F32(v)
+#define s24_32_write(v)		F32_TO_S24(v)
+typedef int32_t s24_32_t;
+typedef int32x4_t s24_32x1_t;
+typedef int32x4x2_t s24_32x2_t;
+typedef int32x4x4_t s24_32x4_t;
+
+#define f32_zero		vdupq_n_f32(0.0f)
+#define f32_ld1_lane		vld1q_lane_f32
+#define f32_ld2_lane		vld2q_lane_f32
+#define f32_ld4_lane		vld4q_lane_f32
+#define f32_ld2			vld2q_f32
+#define f32_ld4			vld4q_f32
+#define f32_st1_lane		vst1q_lane_f32
+#define f32_st2_lane		vst2q_lane_f32
+#define f32_st4_lane		vst4q_lane_f32
+#define f32_st2			vst2q_f32
+#define f32_st4			vst4q_f32
+#define f32_read(v)		(v)
+#define f32_write(v)		(v)
+typedef float f32_t;
+typedef float32x4_t f32x1_t;
+typedef float32x4x2_t f32x2_t;
+typedef float32x4x4_t f32x4_t;
+
+static inline float32x4_t clamp_neon(float32x4_t v)
+{
+	return vminq_f32(vmaxq_f32(v, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+}
+
+static inline float32x4_t s16_to_f32_neon(int16x4_t v)
+{
+	return vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(v)), 1.0f / S16_SCALE);
+}
+static inline int16x4_t f32_to_s16_neon(float32x4_t v)
+{
+	return vmovn_s32(vcvtq_s32_f32(vmulq_n_f32(clamp_neon(v), S16_SCALE)));
+}
+static inline float32x4_t s32_to_f32_neon(int32x4_t v)
+{
+	return vmulq_n_f32(vcvtq_f32_s32(vshrq_n_s32(v, 8)), 1.0f / S24_SCALE);
+}
+static inline int32x4_t f32_to_s32_neon(float32x4_t v)
+{
+	return vshlq_n_s32(vcvtq_s32_f32(vmulq_n_f32(clamp_neon(v), S24_SCALE)), 8);
+}
+static inline float32x4_t s24_32_to_f32_neon(int32x4_t v)
+{
+	return vmulq_n_f32(vcvtq_f32_s32(v), 1.0f / S24_SCALE);
+}
+static inline int32x4_t f32_to_s24_32_neon(float32x4_t v)
+{
+	return vcvtq_s32_f32(vmulq_n_f32(clamp_neon(v), S24_SCALE));
+}
+static inline float32x4_t f32_to_f32_neon(float32x4_t v)
+{
+	return v;
+}
+
+/* interleaved to planar, 1, 2 or 4 channels at a time. Frames are loaded
+ * into vector lanes with the structure lane loads so that any stride works,
+ * when the stride matches the group a full structure load is used. */
+#define MAKE_DEINTERLEAVE(fmt,name)							\
+static void										\
+conv_##name##_1s_neon(void *data, void * SPA_RESTRICT dst[],				\
+		const void * SPA_RESTRICT src, uint32_t n_channels, uint32_t n_samples)	\
+{											\
+	const fmt##_t *s = src;								\
+	float *d0 = dst[0];								\
+	uint32_t n, unrolled = n_samples & ~3;						\
+	fmt##x1_t in = fmt##_zero;							\
+											\
+	for(n = 0; n < unrolled; n += 4) {						\
+		in = fmt##_ld1_lane(&s[0*n_channels], in, 0);				\
+		in = fmt##_ld1_lane(&s[1*n_channels], in, 1);				\
+		in = fmt##_ld1_lane(&s[2*n_channels], in, 2);				\
+		in = fmt##_ld1_lane(&s[3*n_channels], in, 3);				\
+		vst1q_f32(&d0[n], fmt##_to_f32_neon(in));				\
+		s += 4*n_channels;							\
+	}										\
+	for(; n < n_samples; n++) {							\
+		d0[n] = fmt##_read(s[0]);						\
+		s += n_channels;							\
+	}										\
+}											\
+static void										\
+conv_##name##_2s_neon(void *data, void * SPA_RESTRICT dst[],				\
+		const void * SPA_RESTRICT src, uint32_t n_channels, uint32_t n_samples)	\
+{											\
+	const fmt##_t *s = src;								\
+	float *d0 = dst[0], *d1 = dst[1];						\
+	uint32_t n, unrolled = n_samples & ~3;						\
+	fmt##x2_t in = { { fmt##_zero, fmt##_zero } };					\
+											\
+	for(n = 0; n < unrolled; n += 4) {						\
+		if (n_channels == 2) {							\
+			in = fmt##_ld2(s);						\
+		} else {								\
+			in = fmt##_ld2_lane(&s[0*n_channels], in, 0);			\
+			in = fmt##_ld2_lane(&s[1*n_channels], in, 1);			\
+			in = fmt##_ld2_lane(&s[2*n_channels], in, 2);			\
+			in = fmt##_ld2_lane(&s[3*n_channels], in, 3);			\
+		}									\
+		vst1q_f32(&d0[n], fmt##_to_f32_neon(in.val[0]));			\
+		vst1q_f32(&d1[n], fmt##_to_f32_neon(in.val[1]));			\
+		s += 4*n_channels;							\
+	}										\
+	for(; n < n_samples; n++) {							\
+		d0[n] = fmt##_read(s[0]);						\
+		d1[n] = fmt##_read(s[1]);						\
+		s += n_channels;							\
+	}										\
+}											\
+static void										\
+conv_##name##_4s_neon(void *data, void * SPA_RESTRICT dst[],				\
+		const void * SPA_RESTRICT src, uint32_t n_channels, uint32_t n_samples)	\
+{											\
+	const fmt##_t *s = src;								\
+	float *d0 = dst[0], *d1 = dst[1], *d2 = dst[2], *d3 = dst[3];			\
+	uint32_t n, unrolled = n_samples & ~3;						\
+	fmt##x4_t in = { { fmt##_zero, fmt##_zero, fmt##_zero, fmt##_zero } };		\
+											\
+	for(n = 0; n < unrolled; n += 4) {						\
+		if (n_channels == 4) {							\
+			in = fmt##_ld4(s);						\
+		} else {								\
+			in = fmt##_ld4_lane(&s[0*n_channels], in, 0);			\
+			in = fmt##_ld4_lane(&s[1*n_channels], in, 1);			\
+			in = fmt##_ld4_lane(&s[2*n_channels], in, 2);			\
+			in = fmt##_ld4_lane(&s[3*n_channels], in, 3);			\
+		}									\
+		vst1q_f32(&d0[n], fmt##_to_f32_neon(in.val[0]));			\
+		vst1q_f32(&d1[n], fmt##_to_f32_neon(in.val[1]));			\
+		vst1q_f32(&d2[n], fmt##_to_f32_neon(in.val[2]));			\
+		vst1q_f32(&d3[n], fmt##_to_f32_neon(in.val[3]));			\
+		s += 4*n_channels;							\
+	}										\
+	for(; n < n_samples; n++) {							\
+		d0[n] = fmt##_read(s[0]);						\
+		d1[n] = fmt##_read(s[1]);						\
+		d2[n] = fmt##_read(s[2]);						\
+		d3[n] = fmt##_read(s[3]);						\
+		s += n_channels;							\
+	}										\
+}											\
+void											\
+conv_##name##_neon(struct convert *conv, void * SPA_RESTRICT dst[],			\
+		const void * SPA_RESTRICT src[], uint32_t n_samples)			\
+{											\
+	const fmt##_t *s = src[0];							\
+	uint32_t i = 0, n_channels = conv->n_channels;					\
+											\
+	for(; i + 3 < n_channels; i += 4)						\
+		conv_##name##_4s_neon(conv, &dst[i], &s[i], n_channels, n_samples);	\
+	for(; i + 1 < n_channels; i += 2)						\
+		conv_##name##_2s_neon(conv, &dst[i], &s[i], n_channels, n_samples);	\
+	for(; i < n_channels; i++)							\
+		conv_##name##_1s_neon(conv, &dst[i], &s[i], n_channels, n_samples);	\
+}
+
+/* planar to interleaved, the mirror of the above */
+#define MAKE_INTERLEAVE(fmt,name)							\
+static void										\
+conv_##name##_1s_neon(void *data, void * SPA_RESTRICT dst,				\
+		const void * SPA_RESTRICT src[], uint32_t n_channels, uint32_t n_samples)	\
+{											\
+	const float *s0 = src[0];							\
+	fmt##_t *d = dst;								\
+	uint32_t n, unrolled = n_samples & ~3;						\
+	fmt##x1_t out;									\
+											\
+	for(n = 0; n < unrolled; n += 4) {						\
+		out = f32_to_##fmt##_neon(vld1q_f32(&s0[n]));				\
+		fmt##_st1_lane(&d[0*n_channels], out, 0);				\
+		fmt##_st1_lane(&d[1*n_channels], out, 1);				\
+		fmt##_st1_lane(&d[2*n_channels], out, 2);				\
+		fmt##_st1_lane(&d[3*n_channels], out, 3);				\
+		d += 4*n_channels;							\
+	}										\
+	for(; n < n_samples; n++) {							\
+		d[0] = fmt##_write(s0[n]);						\
+		d += n_channels;							\
+	}										\
+}											\
+static void										\
+conv_##name##_2s_neon(void *data, void * SPA_RESTRICT dst,				\
+		const void * SPA_RESTRICT src[], uint32_t n_channels, uint32_t n_samples)	\
+{											\
+	const float *s0 = src[0], *s1 = src[1];						\
+	fmt##_t *d = dst;								\
+	uint32_t n, unrolled = n_samples & ~3;						\
+	fmt##x2_t out;									\
+											\
+	for(n = 0; n < unrolled; n += 4) {						\
+		out.val[0] = f32_to_##fmt##_neon(vld1q_f32(&s0[n]));			\
+		out.val[1] = f32_to_##fmt##_neon(vld1q_f32(&s1[n]));			\
+		if (n_channels == 2) {							\
+			fmt##_st2(d, out);						\
+		} else {								\
+			fmt##_st2_lane(&d[0*n_channels], out, 0);			\
+			fmt##_st2_lane(&d[1*n_channels], out, 1);			\
+			fmt##_st2_lane(&d[2*n_channels], out, 2);			\
+			fmt##_st2_lane(&d[3*n_channels], out, 3);			\
+		}									\
+		d += 4*n_channels;							\
+	}										\
+	for(; n < n_samples; n++) {							\
+		d[0] = fmt##_write(s0[n]);						\
+		d[1] = fmt##_write(s1[n]);						\
+		d += n_channels;							\
+	}										\
+}											\
+static void										\
+conv_##name##_4s_neon(void *data, void * SPA_RESTRICT dst,				\
+		const void * SPA_RESTRICT src[], uint32_t n_channels, uint32_t n_samples)	\
+{											\
+	const float *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];		\
+	fmt##_t *d = dst;								\
+	uint32_t n, unrolled = n_samples & ~3;						\
+	fmt##x4_t out;									\
+											\
+	for(n = 0; n < unrolled; n += 4) {						\
+		out.val[0] = f32_to_##fmt##_neon(vld1q_f32(&s0[n]));			\
+		out.val[1] = f32_to_##fmt##_neon(vld1q_f32(&s1[n]));			\
+		out.val[2] = f32_to_##fmt##_neon(vld1q_f32(&s2[n]));			\
+		out.val[3] = f32_to_##fmt##_neon(vld1q_f32(&s3[n]));			\
+		if (n_channels == 4) {							\
+			fmt##_st4(d, out);						\
+		} else {								\
+			fmt##_st4_lane(&d[0*n_channels], out, 0);			\
+			fmt##_st4_lane(&d[1*n_channels], out, 1);			\
+			fmt##_st4_lane(&d[2*n_channels], out, 2);			\
+			fmt##_st4_lane(&d[3*n_channels], out, 3);			\
+		}									\
+		d += 4*n_channels;							\
+	}										\
+	for(; n < n_samples; n++) {							\
+		d[0] = fmt##_write(s0[n]);						\
+		d[1] = fmt##_write(s1[n]);						\
+		d[2] = fmt##_write(s2[n]);						\
+		d[3] = fmt##_write(s3[n]);						\
+		d += n_channels;							\
+	}										\
+}											\
+void											\
+conv_##name##_neon(struct convert *conv, void * SPA_RESTRICT dst[],			\
+		const void * SPA_RESTRICT src[], uint32_t n_samples)			\
+{											\
+	fmt##_t *d = dst[0];								\
+	uint32_t i = 0, n_channels = conv->n_channels;					\
+											\
+	for(; i + 3 < n_channels; i += 4)						\
+		conv_##name##_4s_neon(conv, &d[i], &src[i], n_channels, n_samples);	\
+	for(; i + 1 < n_channels; i += 2)						\
+		conv_##name##_2s_neon(conv, &d[i], &src[i], n_channels, n_samples);	\
+	for(; i < n_channels; i++)							\
+		conv_##name##_1s_neon(conv, &d[i], &src[i], n_channels, n_samples);	\
+}
+
+MAKE_DEINTERLEAVE(s16, s16_to_f32d);
+MAKE_DEINTERLEAVE(s32, s32_to_f32d);
+MAKE_DEINTERLEAVE(s24_32, s24_32_to_f32d);
+MAKE_DEINTERLEAVE(f32, deinterleave_32);
+
+MAKE_INTERLEAVE(s16, f32d_to_s16);
+MAKE_INTERLEAVE(s32, f32d_to_s32);
+MAKE_INTERLEAVE(s24_32, f32d_to_s24_32);
+MAKE_INTERLEAVE(f32, interleave_32);
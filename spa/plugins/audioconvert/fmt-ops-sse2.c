@@ -724,3 +724,205 @@ conv_f32d_to_s16_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const voi
 	for(; i < n_channels; i++)
 		conv_f32d_to_s16_1s_sse2(conv, &d[i], &src[i], n_channels, n_samples);
 }
+
+static inline __m128i xorshift_sse2(__m128i x)
+{
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+	return x;
+}
+
+void update_dither_sse2(struct convert *conv, uint32_t n_samples)
+{
+	uint32_t n, unrolled = n_samples & ~3;
+	__m128i state = _mm_loadu_si128((__m128i*)conv->random);
+	__m128 scale = _mm_set1_ps(1.0f / 4294967296.0f), r;
+	float *dither = conv->dither;
+
+	if (conv->method == DITHER_METHOD_RECTANGULAR) {
+		for (n = 0; n < unrolled; n += 4) {
+			state = xorshift_sse2(state);
+			_mm_storeu_ps(&dither[n], _mm_mul_ps(_mm_cvtepi32_ps(state), scale));
+		}
+	} else {
+		for (n = 0; n < unrolled; n += 4) {
+			state = xorshift_sse2(state);
+			r = _mm_mul_ps(_mm_cvtepi32_ps(state), scale);
+			state = xorshift_sse2(state);
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_cvtepi32_ps(state), scale));
+			_mm_storeu_ps(&dither[n], r);
+		}
+	}
+	if (n < n_samples) {
+		/* only advance the lanes that are used, like the C version */
+		uint32_t i, random[4];
+		float tail[4];
+
+		_mm_storeu_si128((__m128i*)random, state);
+		state = xorshift_sse2(state);
+		r = _mm_mul_ps(_mm_cvtepi32_ps(state), scale);
+		if (conv->method != DITHER_METHOD_RECTANGULAR) {
+			state = xorshift_sse2(state);
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_cvtepi32_ps(state), scale));
+		}
+		_mm_storeu_ps(tail, r);
+		_mm_storeu_si128((__m128i*)conv->random, state);
+
+		for (i = 0; n < n_samples; i++, n++)
+			dither[n] = tail[i];
+		for (; i < 4; i++)
+			conv->random[i] = random[i];
+	} else {
+		_mm_storeu_si128((__m128i*)conv->random, state);
+	}
+}
+
+static inline __m128i f32_to_s16_dither_sse2(const float *s, const float *r, __m128 scale,
+		__m128 int_min, __m128 int_max)
+{
+	__m128 in[2];
+
+	in[0] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(s), scale), _mm_loadu_ps(r));
+	in[1] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(s + 4), scale), _mm_loadu_ps(r + 4));
+	in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+	in[1] = _mm_min_ps(int_max, _mm_max_ps(in[1], int_min));
+	return _mm_packs_epi32(_mm_cvtps_epi32(in[0]), _mm_cvtps_epi32(in[1]));
+}
+
+static inline int16_t f32_to_s16_dither1_sse2(float s, float r, __m128 scale,
+		__m128 int_min, __m128 int_max)
+{
+	__m128 in = _mm_add_ss(_mm_mul_ss(_mm_set_ss(s), scale), _mm_set_ss(r));
+	in = _mm_min_ss(int_max, _mm_max_ss(in, int_min));
+	return _mm_cvtss_si32(in);
+}
+
+static void
+conv_f32_to_s16_dither_1s_sse2(void *data, int16_t * SPA_RESTRICT d, const float * SPA_RESTRICT s,
+		const float *r, uint32_t n_samples)
+{
+	uint32_t n, unrolled = n_samples & ~7;
+	__m128 scale = _mm_set1_ps(S16_SCALE);
+	__m128 int_max = _mm_set1_ps(S16_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), int_max);
+
+	for(n = 0; n < unrolled; n += 8)
+		_mm_storeu_si128((__m128i*)&d[n],
+				f32_to_s16_dither_sse2(&s[n], &r[n], scale, int_min, int_max));
+	for(; n < n_samples; n++)
+		d[n] = f32_to_s16_dither1_sse2(s[n], r[n], scale, int_min, int_max);
+}
+
+void
+conv_f32_to_s16_dither_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, chunk, n_channels = conv->n_channels;
+	const float *s = src[0];
+	int16_t *d = dst[0];
+
+	n_samples *= n_channels;
+
+	for (i = 0; i < n_samples; i += chunk) {
+		chunk = SPA_MIN(n_samples - i, DITHER_SIZE);
+		update_dither_sse2(conv, chunk);
+		conv_f32_to_s16_dither_1s_sse2(conv, &d[i], &s[i], conv->dither, chunk);
+	}
+}
+
+void
+conv_f32d_to_s16d_dither_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, j, chunk, n_channels = conv->n_channels;
+
+	for (j = 0; j < n_samples; j += chunk) {
+		chunk = SPA_MIN(n_samples - j, DITHER_SIZE / n_channels);
+		update_dither_sse2(conv, chunk * n_channels);
+
+		for (i = 0; i < n_channels; i++)
+			conv_f32_to_s16_dither_1s_sse2(conv, (int16_t *)dst[i] + j,
+					(const float *)src[i] + j, &conv->dither[i * chunk], chunk);
+	}
+}
+
+/* stereo only, other layouts go through the 1s version */
+static void
+conv_f32d_to_s16_dither_2s_sse2(void *data, int16_t * SPA_RESTRICT d, const float * SPA_RESTRICT s0,
+		const float * SPA_RESTRICT s1, const float *r0, const float *r1,
+		uint32_t n_samples)
+{
+	uint32_t n, unrolled = n_samples & ~7;
+	__m128i t[2], out[2];
+	__m128 scale = _mm_set1_ps(S16_SCALE);
+	__m128 int_max = _mm_set1_ps(S16_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), int_max);
+
+	for(n = 0; n < unrolled; n += 8) {
+		t[0] = f32_to_s16_dither_sse2(&s0[n], &r0[n], scale, int_min, int_max);
+		t[1] = f32_to_s16_dither_sse2(&s1[n], &r1[n], scale, int_min, int_max);
+		out[0] = _mm_unpacklo_epi16(t[0], t[1]);
+		out[1] = _mm_unpackhi_epi16(t[0], t[1]);
+		_mm_storeu_si128((__m128i*)(d + 0), out[0]);
+		_mm_storeu_si128((__m128i*)(d + 8), out[1]);
+		d += 16;
+	}
+	for(; n < n_samples; n++) {
+		d[0] = f32_to_s16_dither1_sse2(s0[n], r0[n], scale, int_min, int_max);
+		d[1] = f32_to_s16_dither1_sse2(s1[n], r1[n], scale, int_min, int_max);
+		d += 2;
+	}
+}
+
+static void
+conv_f32d_to_s16_dither_1s_sse2(void *data, int16_t * SPA_RESTRICT d, const float * SPA_RESTRICT s0,
+		const float *r0, uint32_t n_channels, uint32_t n_samples)
+{
+	uint32_t n, unrolled = n_samples & ~7;
+	__m128i out;
+	__m128 scale = _mm_set1_ps(S16_SCALE);
+	__m128 int_max = _mm_set1_ps(S16_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), int_max);
+
+	for(n = 0; n < unrolled; n += 8) {
+		out = f32_to_s16_dither_sse2(&s0[n], &r0[n], scale, int_min, int_max);
+		d[0*n_channels] = _mm_extract_epi16(out, 0);
+		d[1*n_channels] = _mm_extract_epi16(out, 1);
+		d[2*n_channels] = _mm_extract_epi16(out, 2);
+		d[3*n_channels] = _mm_extract_epi16(out, 3);
+		d[4*n_channels] = _mm_extract_epi16(out, 4);
+		d[5*n_channels] = _mm_extract_epi16(out, 5);
+		d[6*n_channels] = _mm_extract_epi16(out, 6);
+		d[7*n_channels] = _mm_extract_epi16(out, 7);
+		d += 8*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		*d = f32_to_s16_dither1_sse2(s0[n], r0[n], scale, int_min, int_max);
+		d += n_channels;
+	}
+}
+
+void
+conv_f32d_to_s16_dither_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float **s = (const float **) src;
+	const float *dither = conv->dither;
+	int16_t *d = dst[0];
+	uint32_t i, j, chunk, n_channels = conv->n_channels;
+
+	for (j = 0; j < n_samples; j += chunk) {
+		chunk = SPA_MIN(n_samples - j, DITHER_SIZE / n_channels);
+		update_dither_sse2(conv, chunk * n_channels);
+
+		if (n_channels == 2) {
+			conv_f32d_to_s16_dither_2s_sse2(conv, &d[j * 2], &s[0][j], &s[1][j],
+					&dither[0], &dither[chunk], chunk);
+		} else {
+			for (i = 0; i < n_channels; i++)
+				conv_f32d_to_s16_dither_1s_sse2(conv, &d[j * n_channels + i],
+						&s[i][j], &dither[i * chunk], n_channels, chunk);
+		}
+	}
+}
@@ -23,8 +23,10 @@
  */
 
 #include <math.h>
+#include <string.h>
 
 #include <spa/utils/defs.h>
+#include <spa/param/audio/raw.h>
 
 #define U8_MIN		0
 #define U8_MAX		255
@@ -39,6 +41,7 @@
 #define S16_SCALE	32767.0f
 #define S16_TO_F32(v)	(((int16_t)(v)) * (1.0f / S16_SCALE))
 #define F32_TO_S16(v)	(int16_t)(SPA_CLAMP(v, -1.0f, 1.0f) * S16_SCALE)
+#define F32_TO_S16_D(v,d)	(int16_t)lrintf(SPA_CLAMP((v) * S16_SCALE + (d), S16_MIN, S16_MAX))
 
 #define S24_MIN		-8388607
 #define S24_MAX		8388607
@@ -77,18 +80,33 @@ static inline void write_s24(void *dst, int32_t val)
 #endif
 }
 
-#define MAX_NS	64
+#define MAX_NS		8
+#define DITHER_SIZE	1024u
+
+enum dither_method {
+	DITHER_METHOD_NONE = 0,		/**< clamp and truncate */
+	DITHER_METHOD_RECTANGULAR,	/**< 1 LSB rectangular PDF noise */
+	DITHER_METHOD_TRIANGULAR,	/**< 2 LSB triangular PDF noise */
+	DITHER_METHOD_SHAPED,		/**< triangular PDF noise with error feedback */
+};
+
+struct shaper {
+	float e[MAX_NS * 2];
+	uint32_t idx;
+};
 
 struct convert {
 	uint32_t src_fmt;
 	uint32_t dst_fmt;
 	uint32_t n_channels;
 	uint32_t cpu_flags;
+	uint32_t method;		/* dither method, set before convert_init */
 
 	unsigned int is_passthrough:1;
-	float ns_data[MAX_NS];
-	uint32_t ns_idx;
-	uint32_t ns_size;
+
+	uint32_t random[4];		/* xorshift state, one per lane */
+	float dither[DITHER_SIZE];	/* noise for the current block, in LSB */
+	struct shaper shaper[SPA_AUDIO_MAX_CHANNELS];
 
 	void (*process) (struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
 			uint32_t n_samples);
@@ -97,6 +115,43 @@ struct convert {
 
 int convert_init(struct convert *conv);
 
+/* silence is all zero bytes, except for the unsigned formats */
+static inline bool convert_silence_is_zero(uint32_t format)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_U8:
+	case SPA_AUDIO_FORMAT_U8P:
+	case SPA_AUDIO_FORMAT_U16_LE:
+	case SPA_AUDIO_FORMAT_U16_BE:
+	case SPA_AUDIO_FORMAT_U18_LE:
+	case SPA_AUDIO_FORMAT_U18_BE:
+	case SPA_AUDIO_FORMAT_U20_LE:
+	case SPA_AUDIO_FORMAT_U20_BE:
+	case SPA_AUDIO_FORMAT_U24_LE:
+	case SPA_AUDIO_FORMAT_U24_BE:
+	case SPA_AUDIO_FORMAT_U24_32_LE:
+	case SPA_AUDIO_FORMAT_U24_32_BE:
+	case SPA_AUDIO_FORMAT_U32_LE:
+	case SPA_AUDIO_FORMAT_U32_BE:
+		return false;
+	default:
+		return true;
+	}
+}
+
+/* check if all the data is zero, this stops at the first byte that is not */
+static inline bool convert_is_silent(const void *datas[], uint32_t n_datas, uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_datas; i++) {
+		const uint8_t *d = datas[i];
+		if (size > 0 && (d[0] != 0 || memcmp(d, d + 1, size - 1) != 0))
+			return false;
+	}
+	return true;
+}
+
 #define convert_process(conv,...)	(conv)->process(conv, __VA_ARGS__)
 #define convert_free(conv)		(conv)->free(conv)
 
@@ -160,6 +215,15 @@ DEFINE_FUNCTION(interleave_8, c);
 DEFINE_FUNCTION(interleave_16, c);
 DEFINE_FUNCTION(interleave_24, c);
 DEFINE_FUNCTION(interleave_32, c);
+DEFINE_FUNCTION(f32_to_s16_dither, c);
+DEFINE_FUNCTION(f32_to_s16d_dither, c);
+DEFINE_FUNCTION(f32d_to_s16_dither, c);
+DEFINE_FUNCTION(f32d_to_s16d_dither, c);
+DEFINE_FUNCTION(f32_to_s16_shaped, c);
+DEFINE_FUNCTION(f32_to_s16d_shaped, c);
+DEFINE_FUNCTION(f32d_to_s16_shaped, c);
+DEFINE_FUNCTION(f32d_to_s16d_shaped, c);
+void update_dither_c(struct convert *conv, uint32_t n_samples);
 
 #if defined(HAVE_SSE2)
 DEFINE_FUNCTION(s16_to_f32d_2, sse2);
@@ -168,11 +232,75 @@ DEFINE_FUNCTION(s24_to_f32d, sse2);
 DEFINE_FUNCTION(s32_to_f32d, sse2);
 DEFINE_FUNCTION(f32d_to_s32, sse2);
 DEFINE_FUNCTION(f32d_to_s16, sse2);
+DEFINE_FUNCTION(f32_to_s16_dither, sse2);
+DEFINE_FUNCTION(f32d_to_s16_dither, sse2);
+DEFINE_FUNCTION(f32d_to_s16d_dither, sse2);
+void update_dither_sse2(struct convert *conv, uint32_t n_samples);
 #endif
 #if defined(HAVE_SSSE3)
 DEFINE_FUNCTION(s24_to_f32d, ssse3);
 #endif
 #if defined(HAVE_SSE41)
 DEFINE_FUNCTION(s24_to_f32d, sse41);
-
+#endif
+#if defined(HAVE_NEON)
+DEFINE_FUNCTION(s16_to_f32d, neon);
+DEFINE_FUNCTION(s32_to_f32d, neon);
+DEFINE_FUNCTION(s24_32_to_f32d, neon);
+DEFINE_FUNCTION(deinterleave_32, neon);
+DEFINE_FUNCTION(f32d_to_s16, neon);
+DEFINE_FUNCTION(f32d_to_s32, neon);
+DEFINE_FUNCTION(f32d_to_s24_32, neon);
+DEFINE_FUNCTION(interleave_32, neon);
+#endif
+#if defined(HAVE_AVX2)
+DEFINE_FUNCTION(u8_to_f32, avx2);
+DEFINE_FUNCTION(u8d_to_f32d, avx2);
+DEFINE_FUNCTION(u8_to_f32d, avx2);
+DEFINE_FUNCTION(u8d_to_f32, avx2);
+DEFINE_FUNCTION(s16_to_f32, avx2);
+DEFINE_FUNCTION(s16d_to_f32d, avx2);
+DEFINE_FUNCTION(s16_to_f32d, avx2);
+DEFINE_FUNCTION(s16d_to_f32, avx2);
+DEFINE_FUNCTION(s24_to_f32, avx2);
+DEFINE_FUNCTION(s24d_to_f32d, avx2);
+DEFINE_FUNCTION(s24_to_f32d, avx2);
+DEFINE_FUNCTION(s24d_to_f32, avx2);
+DEFINE_FUNCTION(s32_to_f32, avx2);
+DEFINE_FUNCTION(s32d_to_f32d, avx2);
+DEFINE_FUNCTION(s32_to_f32d, avx2);
+DEFINE_FUNCTION(s32d_to_f32, avx2);
+DEFINE_FUNCTION(s24_32_to_f32, avx2);
+DEFINE_FUNCTION(s24_32d_to_f32d, avx2);
+DEFINE_FUNCTION(s24_32_to_f32d, avx2);
+DEFINE_FUNCTION(s24_32d_to_f32, avx2);
+DEFINE_FUNCTION(f32_to_u8, avx2);
+DEFINE_FUNCTION(f32d_to_u8d, avx2);
+DEFINE_FUNCTION(f32_to_u8d, avx2);
+DEFINE_FUNCTION(f32d_to_u8, avx2);
+DEFINE_FUNCTION(f32_to_s16, avx2);
+DEFINE_FUNCTION(f32d_to_s16d, avx2);
+DEFINE_FUNCTION(f32_to_s16d, avx2);
+DEFINE_FUNCTION(f32d_to_s16, avx2);
+DEFINE_FUNCTION(f32_to_s24, avx2);
+DEFINE_FUNCTION(f32d_to_s24d, avx2);
+DEFINE_FUNCTION(f32_to_s24d, avx2);
+DEFINE_FUNCTION(f32d_to_s24, avx2);
+DEFINE_FUNCTION(f32_to_s32, avx2);
+DEFINE_FUNCTION(f32d_to_s32d, avx2);
+DEFINE_FUNCTION(f32_to_s32d, avx2);
+DEFINE_FUNCTION(f32d_to_s32, avx2);
+DEFINE_FUNCTION(f32_to_s24_32, avx2);
+DEFINE_FUNCTION(f32d_to_s24_32d, avx2);
+DEFINE_FUNCTION(f32_to_s24_32d, avx2);
+DEFINE_FUNCTION(f32d_to_s24_32, avx2);
+DEFINE_FUNCTION(deinterleave_32, avx2);
+DEFINE_FUNCTION(interleave_32, avx2);
+#endif
+#if defined(HAVE_AVX512)
+DEFINE_FUNCTION(s32_to_f32d, avx512);
+DEFINE_FUNCTION(s24_32_to_f32d, avx512);
+DEFINE_FUNCTION(f32_to_s32d, avx512);
+DEFINE_FUNCTION(f32_to_s24_32d, avx512);
+DEFINE_FUNCTION(deinterleave_32, avx512);
 #endif
@@ -55,7 +55,7 @@
 #define MAX_PORTS	128
 
 #define PROP_DEFAULT_TRUNCATE	false
-#define PROP_DEFAULT_DITHER	0
+#define PROP_DEFAULT_DITHER	DITHER_METHOD_NONE
 
 struct impl;
 
@@ -70,9 +70,21 @@ static void props_reset(struct props *props)
 	props->dither = PROP_DEFAULT_DITHER;
 }
 
+static uint32_t dither_method_from_label(const char *label)
+{
+	if (strcmp(label, "rectangular") == 0)
+		return DITHER_METHOD_RECTANGULAR;
+	else if (strcmp(label, "triangular") == 0)
+		return DITHER_METHOD_TRIANGULAR;
+	else if (strcmp(label, "shaped") == 0)
+		return DITHER_METHOD_SHAPED;
+	return DITHER_METHOD_NONE;
+}
+
 struct buffer {
 	uint32_t id;
 #define BUFFER_FLAG_OUT		(1 << 0)
+#define BUFFER_FLAG_SILENT	(1 << 1)	/* the data is known to be all zero */
 	uint32_t flags;
 	struct spa_list link;
 	struct spa_buffer *outbuf;
@@ -187,12 +199,13 @@ static int setup_convert(struct impl *this)
 	this->conv.dst_fmt = dst_fmt;
 	this->conv.n_channels = outformat.info.raw.channels;
 	this->conv.cpu_flags = this->cpu_flags;
+	this->conv.method = this->props.dither;
 
 	if ((res = convert_init(&this->conv)) < 0)
 		return res;
 
-	spa_log_info(this->log, NAME " %p: got converter features %08x:%08x", this,
-			this->cpu_flags, this->conv.cpu_flags);
+	spa_log_info(this->log, NAME " %p: got converter features %08x:%08x dither:%d", this,
+			this->cpu_flags, this->conv.cpu_flags, this->conv.method);
 
 	this->is_passthrough = this->conv.is_passthrough;
 
@@ -614,6 +627,7 @@ static int port_set_format(void *object,
 		spa_log_debug(this->log, NAME " %p: set format on port %d:%d res:%d stride:%d",
 				this, direction, port_id, res, port->stride);
 	}
+	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
 	if (port->have_format) {
 		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_READWRITE);
 		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
@@ -621,6 +635,12 @@ static int port_set_format(void *object,
 		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
 	}
+	/* EnumFormat of the other port is derived from this format */
+	other->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	other->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+	emit_port_info(this, port, false);
+	emit_port_info(this, other, false);
+
 	return 0;
 }
 
@@ -800,6 +820,7 @@ static int impl_node_process(void *object)
 	uint32_t i, n_src_datas, n_dst_datas;
 	int res = 0;
 	uint32_t n_samples, size, maxsize, offs;
+	bool gap;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 
@@ -868,8 +889,32 @@ static int impl_node_process(void *object)
 		outb->datas[i].chunk->size = n_samples * outport->stride;
 	}
 
-	if (!this->is_passthrough)
+	/* a gap only needs silence in the output, the buffers keep it
+	 * until they are used for something else */
+	gap = inbuf->h && SPA_FLAG_IS_SET(inbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+	/* silence that is not marked is found as well, the check ends
+	 * at the first sample that is not zero */
+	if (!gap && n_samples > 0 && convert_silence_is_zero(inport->format.info.raw.format))
+		gap = convert_is_silent(src_datas, n_src_datas, n_samples * inport->stride);
+
+	if (this->is_passthrough) {
+		/* the input data is passed on */
+	} else if (gap && convert_silence_is_zero(outport->format.info.raw.format)) {
+		if (!SPA_FLAG_IS_SET(outbuf->flags, BUFFER_FLAG_SILENT)) {
+			for (i = 0; i < n_dst_datas; i++)
+				memset(outbuf->datas[i], 0, outb->datas[i].maxsize);
+			SPA_FLAG_SET(outbuf->flags, BUFFER_FLAG_SILENT);
+		}
+	} else {
 		convert_process(&this->conv, dst_datas, src_datas, n_samples);
+		SPA_FLAG_CLEAR(outbuf->flags, BUFFER_FLAG_SILENT);
+	}
+	if (outbuf->h) {
+		if (gap)
+			SPA_FLAG_SET(outbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+		else
+			SPA_FLAG_CLEAR(outbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+	}
 
 	inio->status = SPA_STATUS_NEED_DATA;
 	res |= SPA_STATUS_NEED_DATA;
@@ -962,6 +1007,7 @@ impl_init(const struct spa_handle_factory *factory,
 {
 	struct impl *this;
 	uint32_t i;
+	const char *str;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -997,6 +1043,11 @@ impl_init(const struct spa_handle_factory *factory,
 	this->info.n_params = 0;
 	props_reset(&this->props);
 
+	if (info != NULL) {
+		if ((str = spa_dict_lookup(info, "dither.method")) != NULL)
+			this->props.dither = dither_method_from_label(str);
+	}
+
 	init_port(this, SPA_DIRECTION_OUTPUT, 0);
 	init_port(this, SPA_DIRECTION_INPUT, 0);
 
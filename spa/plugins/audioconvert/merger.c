@@ -59,9 +59,11 @@
 struct buffer {
 	uint32_t id;
 #define BUFFER_FLAG_QUEUED	(1<<0)
+#define BUFFER_FLAG_SILENT	(1<<1)	/* the data is known to be all zero */
 	uint32_t flags;
 	struct spa_list link;
 	struct spa_buffer *buf;
+	struct spa_meta_header *h;
 	void *datas[MAX_DATAS];
 };
 
@@ -303,6 +305,9 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 
 		port->have_format = true;
 		port->format = info;
+		port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+		port->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+		emit_port_info(this, port, false);
 		this->monitor = monitor;
 
 		this->have_profile = true;
@@ -686,7 +691,9 @@ static int port_set_format(void *object,
 		port->have_format = true;
 	}
 
+	/* EnumFormat is derived from the current format */
 	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	port->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
 	if (port->have_format) {
 		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_READWRITE);
 		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
@@ -783,6 +790,7 @@ impl_node_port_use_buffers(void *object,
 		b->id = i;
 		b->flags = 0;
 		b->buf = buffers[i];
+		b->h = spa_buffer_find_meta_data(buffers[i], SPA_META_Header, sizeof(*b->h));
 
 		if (n_datas != port->blocks) {
 			spa_log_error(this->log, NAME " %p: invalid blocks %d on buffer %d",
@@ -935,6 +943,7 @@ static int impl_node_process(void *object)
 	const void **src_datas;
 	void **dst_datas;
 	int res = 0;
+	bool gap = true;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 
@@ -973,6 +982,9 @@ static int impl_node_process(void *object)
 
 		src_datas[n_src_datas++] = SPA_MEMBER(sd->data, sd->chunk->offset, void);
 
+		if (sbuf->h == NULL || !SPA_FLAG_IS_SET(sbuf->h->flags, SPA_META_HEADER_FLAG_GAP))
+			gap = false;
+
 		n_samples = SPA_MIN(n_samples, sd->chunk->size / inport->stride);
 
 		spa_log_trace_fp(this->log, NAME " %p: %d %d %d %p", this,
@@ -992,8 +1004,25 @@ static int impl_node_process(void *object)
 		spa_log_trace_fp(this->log, NAME " %p %p %d", this, dst_datas[i],
 				n_samples * outport->stride);
 	}
-	if (!this->is_passthrough)
+	/* when all inputs are silent, the output only needs silence once */
+	if (this->is_passthrough) {
+		/* the input data is passed on */
+	} else if (gap && convert_silence_is_zero(outport->format.info.raw.format)) {
+		if (!SPA_FLAG_IS_SET(dbuf->flags, BUFFER_FLAG_SILENT)) {
+			for (i = 0; i < n_dst_datas; i++)
+				memset(dbuf->datas[i], 0, dbuf->buf->datas[i].maxsize);
+			SPA_FLAG_SET(dbuf->flags, BUFFER_FLAG_SILENT);
+		}
+	} else {
 		convert_process(&this->conv, dst_datas, src_datas, n_samples);
+		SPA_FLAG_CLEAR(dbuf->flags, BUFFER_FLAG_SILENT);
+	}
+	if (dbuf->h) {
+		if (gap)
+			SPA_FLAG_SET(dbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+		else
+			SPA_FLAG_CLEAR(dbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+	}
 
 	return res | SPA_STATUS_HAVE_DATA;
 }
@@ -0,0 +1,143 @@
+/* Spa
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <spa/support/log.h>
+
+#include "resample-native-impl.h"
+
+/* one cache for the whole process, all resample and audioconvert nodes
+ * converting between the same rates use the same filter bank */
+static struct spa_list filter_cache = { &filter_cache, &filter_cache };
+static pthread_mutex_t filter_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct native_filter_stats filter_stats;
+
+static inline double sinc(double x)
+{
+	if (x < 1e-6) return 1.0;
+	x *= M_PI;
+	return sin(x) / x;
+}
+
+static inline double blackman(double x, double n_taps)
+{
+	double w = 2.0 * x * M_PI / n_taps + M_PI;
+	return 0.3635819 - 0.4891775 * cos(w) +
+		0.1365995 * cos(2 * w) - 0.0106411 * cos(3 * w);
+}
+
+static int build_filter(float *taps, uint32_t stride, uint32_t n_taps, uint32_t n_phases, double cutoff)
+{
+	uint32_t i, j, n_taps12 = n_taps/2;
+
+	for (i = 0; i <= n_phases; i++) {
+		double t = (double) i / (double) n_phases;
+		for (j = 0; j < n_taps12; j++, t += 1.0) {
+			/* exploit symmetry in filter taps */
+			taps[(n_phases - i) * stride + n_taps12 + j] =
+				taps[i * stride + (n_taps12 - j - 1)] =
+					cutoff * sinc(t * cutoff) * blackman(t, n_taps);
+		}
+	}
+	return 0;
+}
+
+static inline size_t filter_size(uint32_t n_phases, uint32_t stride)
+{
+	return stride * (n_phases + 1) * sizeof(float);
+}
+
+struct native_filter *native_filter_get(struct spa_log *log, uint32_t quality,
+		uint32_t in_rate, uint32_t out_rate, uint32_t n_taps, uint32_t n_phases,
+		uint32_t stride, double cutoff)
+{
+	struct native_filter *f;
+	float *taps;
+
+	pthread_mutex_lock(&filter_lock);
+	spa_list_for_each(f, &filter_cache, link) {
+		/* the stride is part of the key so that a simd variant that
+		 * wants a different layout gets its own filter */
+		if (f->quality == quality &&
+		    f->in_rate == in_rate &&
+		    f->out_rate == out_rate &&
+		    f->stride == stride) {
+			f->ref++;
+			filter_stats.hits++;
+			goto done;
+		}
+	}
+	f = malloc(sizeof(struct native_filter) + filter_size(n_phases, stride) + 64);
+	if (f == NULL)
+		goto done;
+
+	taps = SPA_MEMBER_ALIGN(f, sizeof(struct native_filter), 64, float);
+	build_filter(taps, stride, n_taps, n_phases, cutoff);
+
+	f->ref = 1;
+	f->quality = quality;
+	f->in_rate = in_rate;
+	f->out_rate = out_rate;
+	f->n_taps = n_taps;
+	f->n_phases = n_phases;
+	f->stride = stride;
+	f->taps = taps;
+	spa_list_append(&filter_cache, &f->link);
+
+	filter_stats.misses++;
+	filter_stats.n_filters++;
+	filter_stats.size += filter_size(n_phases, stride);
+done:
+	if (f != NULL)
+		spa_log_debug(log, "native filter %p: quality:%u in:%u out:%u ref:%d "
+				"hits:%u misses:%u filters:%u size:%zu", f, quality,
+				in_rate, out_rate, f->ref, filter_stats.hits,
+				filter_stats.misses, filter_stats.n_filters,
+				filter_stats.size);
+	pthread_mutex_unlock(&filter_lock);
+	return f;
+}
+
+void native_filter_unref(struct spa_log *log, struct native_filter *f)
+{
+	pthread_mutex_lock(&filter_lock);
+	if (--f->ref == 0) {
+		filter_stats.n_filters--;
+		filter_stats.size -= filter_size(f->n_phases, f->stride);
+		spa_log_debug(log, "native filter %p: free, filters:%u size:%zu",
+				f, filter_stats.n_filters, filter_stats.size);
+		spa_list_remove(&f->link);
+		free(f);
+	}
+	pthread_mutex_unlock(&filter_lock);
+}
+
+void native_filter_get_stats(struct native_filter_stats *stats)
+{
+	pthread_mutex_lock(&filter_lock);
+	*stats = filter_stats;
+	pthread_mutex_unlock(&filter_lock);
+}
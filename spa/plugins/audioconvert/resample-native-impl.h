@@ -25,6 +25,7 @@
 #include <math.h>
 
 #include <spa/utils/defs.h>
+#include <spa/utils/list.h>
 
 #include "resample.h"
 
@@ -32,6 +33,33 @@ typedef void (*resample_func_t)(struct resample *r,
         const void * SPA_RESTRICT src[], uint32_t *in_len,
         void * SPA_RESTRICT dst[], uint32_t offs, uint32_t *out_len);
 
+/* a filter bank, read-only once built and shared by all resamplers in
+ * the process with the same settings, see resample-filter.c */
+struct native_filter {
+	struct spa_list link;
+	int ref;
+	uint32_t quality;
+	uint32_t in_rate;
+	uint32_t out_rate;
+	uint32_t n_taps;
+	uint32_t n_phases;
+	uint32_t stride;
+	const float *taps;
+};
+
+struct native_filter_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t n_filters;		/* filters in the cache */
+	size_t size;			/* bytes used by the filters */
+};
+
+struct native_filter *native_filter_get(struct spa_log *log, uint32_t quality,
+		uint32_t in_rate, uint32_t out_rate, uint32_t n_taps, uint32_t n_phases,
+		uint32_t stride, double cutoff);
+void native_filter_unref(struct spa_log *log, struct native_filter *f);
+void native_filter_get_stats(struct native_filter_stats *stats);
+
 struct native_data {
 	double rate;
 	uint32_t n_taps;
@@ -46,8 +74,9 @@ struct native_data {
 	uint32_t hist;
 	float **history;
 	resample_func_t func;
-	float *filter;
+	const float *filter;
 	float *hist_mem;
+	struct native_filter *cached;
 };
 
 #define DEFINE_RESAMPLER(type,arch)						\
@@ -179,6 +208,10 @@ DEFINE_RESAMPLER(inter,sse);
 DEFINE_RESAMPLER(full,ssse3);
 DEFINE_RESAMPLER(inter,ssse3);
 #endif
+#if defined (HAVE_NEON)
+DEFINE_RESAMPLER(full,neon);
+DEFINE_RESAMPLER(inter,neon);
+#endif
 #if defined (HAVE_AVX) && defined(HAVE_FMA)
 DEFINE_RESAMPLER(full,avx);
 DEFINE_RESAMPLER(inter,avx);
@@ -22,6 +22,9 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <string.h>
+#include <stdlib.h>
+
 #include "resample-native-impl.h"
 
 struct quality {
@@ -29,8 +32,6 @@ struct quality {
 	double cutoff;
 };
 
-#define DEFAULT_QUALITY	4
-
 static const struct quality blackman_qualities[] = {
 	{ 8, 0.5, },
 	{ 16, 0.6, },
@@ -45,38 +46,45 @@ static const struct quality blackman_qualities[] = {
 	{ 160, 0.960, }
 };
 
-static inline double sinc(double x)
-{
-	if (x < 1e-6) return 1.0;
-	x *= M_PI;
-	return sin(x) / x;
-}
+struct quality_preset {
+	const char *name;
+	uint32_t quality;
+};
 
-static inline double blackman(double x, double n_taps)
-{
-	double w = 2.0 * x * M_PI / n_taps + M_PI;
-	return 0.3635819 - 0.4891775 * cos(w) +
-		0.1365995 * cos(2 * w) - 0.0106411 * cos(3 * w);
-}
+static const struct quality_preset quality_presets[] = {
+	{ "voice", 1, },		/* minimal CPU, enough bandwidth for speech */
+	{ "low-latency", 3, },		/* short filter for pro-audio */
+	{ "default", RESAMPLE_DEFAULT_QUALITY, },
+	{ "music", 8, },		/* long filter with a steep cutoff */
+};
 
-static int build_filter(float *taps, uint32_t stride, uint32_t n_taps, uint32_t n_phases, double cutoff)
+/* parse a preset name or a quality index, anything else gives the default */
+static inline uint32_t impl_native_parse_quality(struct spa_log *log, const char *str)
 {
-	uint32_t i, j, n_taps12 = n_taps/2;
-
-	for (i = 0; i <= n_phases; i++) {
-		double t = (double) i / (double) n_phases;
-		for (j = 0; j < n_taps12; j++, t += 1.0) {
-			/* exploit symmetry in filter taps */
-			taps[(n_phases - i) * stride + n_taps12 + j] =
-				taps[i * stride + (n_taps12 - j - 1)] =
-					cutoff * sinc(t * cutoff) * blackman(t, n_taps);
-		}
+	uint32_t i;
+	char *end;
+	long val;
+
+	for (i = 0; i < SPA_N_ELEMENTS(quality_presets); i++) {
+		if (strcmp(str, quality_presets[i].name) == 0)
+			return quality_presets[i].quality;
 	}
-	return 0;
+	val = strtol(str, &end, 10);
+	if (end == str || *end != '\0' ||
+	    val < 0 || val >= (long)SPA_N_ELEMENTS(blackman_qualities)) {
+		spa_log_warn(log, "native: invalid resample quality '%s', using %d",
+				str, RESAMPLE_DEFAULT_QUALITY);
+		return RESAMPLE_DEFAULT_QUALITY;
+	}
+	return val;
 }
 
 static void impl_native_free(struct resample *r)
 {
+	struct native_data *d = r->data;
+
+	if (d != NULL)
+		native_filter_unref(r->log, d->cached);
 	free(r->data);
 	r->data = NULL;
 }
@@ -96,6 +104,11 @@ static void impl_native_update_rate(struct resample *r, double rate)
 	struct native_data *data = r->data;
 	uint32_t in_rate, out_rate, phase, gcd, old_out_rate;
 
+	/* called for each cycle when rate matching, only redo the work
+	 * when the rate actually changed */
+	if (rate == data->rate)
+		return;
+
 	old_out_rate = data->out_rate;
 	in_rate = r->i_rate / rate;
 	out_rate = r->o_rate;
@@ -133,6 +146,10 @@ static void impl_native_update_rate(struct resample *r, double rate)
 #if defined(HAVE_AVX) && defined(HAVE_FMA)
 		if (SPA_FLAG_IS_SET(r->cpu_flags, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3))
 			data->func = is_full ? do_resample_full_avx : do_resample_inter_avx;
+#endif
+#if defined (HAVE_NEON)
+		if (SPA_FLAG_IS_SET(r->cpu_flags, SPA_CPU_FLAG_NEON))
+			data->func = is_full ? do_resample_full_neon : do_resample_inter_neon;
 #endif
 	}
 }
@@ -195,9 +212,17 @@ static void impl_native_process(struct resample *r,
 
 	if (in >= hist) {
 		/* we are past the history and can now work on the new
-		 * input data */
-		in = *in_len;
-		data->func(r, src, &in, dst, out, out_len);
+		 * input data. Skip the samples that were already consumed
+		 * as part of the refilled history. */
+		const void *ss[r->channels];
+		uint32_t skip = in - hist;
+
+		for (c = 0; c < r->channels; c++)
+			ss[c] = &s[c][skip];
+
+		in = *in_len - skip;
+		data->func(r, ss, &in, dst, out, out_len);
+		in += skip;
 		spa_log_trace_fp(r->log, "native %p: in:%d/%d out %d/%d",
 				r, *in_len, in, *out_len, out);
 
@@ -253,12 +278,25 @@ static uint32_t impl_native_delay (struct resample *r)
 	return d->n_taps;
 }
 
+static inline double impl_native_scale(uint32_t quality, uint32_t in_rate, uint32_t out_rate)
+{
+	return SPA_MIN(blackman_qualities[quality].cutoff * out_rate / in_rate, 1.0);
+}
+
+/* the number of taps is both the delay in samples and the number of
+ * multiply-adds per output sample and channel */
+static inline uint32_t impl_native_taps(uint32_t quality, uint32_t in_rate, uint32_t out_rate)
+{
+	double scale = impl_native_scale(quality, in_rate, out_rate);
+	/* multiple of 8 taps to ease simd optimizations */
+	return SPA_ROUND_UP_N((uint32_t)ceil(blackman_qualities[quality].n_taps / scale), 8);
+}
+
 static int impl_native_init(struct resample *r)
 {
 	struct native_data *d;
-	const struct quality *q = &blackman_qualities[DEFAULT_QUALITY];
-	double scale;
-	uint32_t c, n_taps, n_phases, filter_size, in_rate, out_rate, gcd, filter_stride;
+	struct native_filter *f;
+	uint32_t c, n_taps, n_phases, in_rate, out_rate, gcd, filter_stride;
 	uint32_t history_stride, history_size, oversample;
 
 	r->free = impl_native_free;
@@ -268,14 +306,14 @@ static int impl_native_init(struct resample *r)
 	r->reset = impl_native_reset;
 	r->delay = impl_native_delay;
 
+	r->quality = SPA_MIN(r->quality, SPA_N_ELEMENTS(blackman_qualities) - 1);
+
 	gcd = calc_gcd(r->i_rate, r->o_rate);
 
 	in_rate = r->i_rate / gcd;
 	out_rate = r->o_rate / gcd;
 
-	scale = SPA_MIN(q->cutoff * out_rate / in_rate, 1.0);
-	/* multiple of 8 taps to ease simd optimizations */
-	n_taps = SPA_ROUND_UP_N((uint32_t)ceil(q->n_taps / scale), 8);
+	n_taps = impl_native_taps(r->quality, in_rate, out_rate);
 
 	/* try to get at least 256 phases so that interpolation is
 	 * accurate enough when activated */
@@ -284,36 +322,43 @@ static int impl_native_init(struct resample *r)
 	n_phases *= oversample;
 
 	filter_stride = SPA_ROUND_UP_N(n_taps * sizeof(float), 64);
-	filter_size = filter_stride * (n_phases + 1);
 	history_stride = SPA_ROUND_UP_N(2 * n_taps * sizeof(float), 64);
 	history_size = r->channels * history_stride;
 
+	f = native_filter_get(r->log, r->quality, in_rate, out_rate, n_taps, n_phases,
+			filter_stride / sizeof(float),
+			impl_native_scale(r->quality, in_rate, out_rate));
+	if (f == NULL)
+		return -errno;
+
 	d = malloc(sizeof(struct native_data) +
-			filter_size +
 			history_size +
 			(r->channels * sizeof(float*)) +
 			64);
 
-	if (d == NULL)
-		return -errno;
+	if (d == NULL) {
+		int res = -errno;
+		native_filter_unref(r->log, f);
+		return res;
+	}
 
 	r->data = d;
+	d->cached = f;
+	d->rate = 0.0;
 	d->n_taps = n_taps;
 	d->n_phases = n_phases;
 	d->in_rate = in_rate;
 	d->out_rate = out_rate;
-	d->filter = SPA_MEMBER_ALIGN(d, sizeof(struct native_data), 64, float);
-	d->hist_mem = SPA_MEMBER_ALIGN(d->filter, filter_size, 64, float);
+	d->filter = f->taps;
+	d->hist_mem = SPA_MEMBER_ALIGN(d, sizeof(struct native_data), 64, float);
 	d->history = SPA_MEMBER(d->hist_mem, history_size, float*);
 	d->filter_stride = filter_stride / sizeof(float);
 	d->filter_stride_os = d->filter_stride * oversample;
 	for (c = 0; c < r->channels; c++)
 		d->history[c] = SPA_MEMBER(d->hist_mem, c * history_stride, float);
 
-	build_filter(d->filter, d->filter_stride, n_taps, n_phases, scale);
-
-	spa_log_debug(r->log, "native %p: in:%d out:%d n_taps:%d n_phases:%d",
-			r, in_rate, out_rate, n_taps, n_phases);
+	spa_log_debug(r->log, "native %p: in:%d out:%d quality:%d n_taps:%d n_phases:%d",
+			r, in_rate, out_rate, r->quality, n_taps, n_phases);
 
 	impl_native_reset(r);
 	impl_native_update_rate(r, 1.0);
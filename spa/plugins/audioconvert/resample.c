@@ -55,11 +55,13 @@ struct impl;
 
 struct props {
 	double rate;
+	uint32_t quality;
 };
 
 static void props_reset(struct props *props)
 {
 	props->rate = 1.0;
+	props->quality = RESAMPLE_DEFAULT_QUALITY;
 }
 
 struct buffer {
@@ -92,6 +94,8 @@ struct port {
 
 	uint32_t offset;
 	struct spa_list queue;
+
+	unsigned int gap:1;		/* output buffer holds only silence so far */
 };
 
 struct impl {
@@ -107,6 +111,7 @@ struct impl {
 	uint64_t info_all;
 	struct spa_node_info info;
 	struct props props;
+	struct spa_param_info params[8];
 
 	struct spa_hook_list hooks;
 
@@ -117,6 +122,7 @@ struct impl {
 #define MODE_MERGE	1
 #define MODE_CONVERT	2
 	int mode;
+	uint32_t gap_samples;		/* consecutive samples of silence in */
 	unsigned int started:1;
 	unsigned int peaks:1;
 
@@ -160,6 +166,7 @@ static int setup_convert(struct impl *this,
 	this->resample.channels = src_info->info.raw.channels;
 	this->resample.i_rate = src_info->info.raw.rate;
 	this->resample.o_rate = dst_info->info.raw.rate;
+	this->resample.quality = this->props.quality;
 	this->resample.log = this->log;
 
 	if (this->peaks)
@@ -174,7 +181,92 @@ static int impl_node_enum_params(void *object, int seq,
 				 uint32_t id, uint32_t start, uint32_t num,
 				 const struct spa_pod *filter)
 {
-	return -ENOTSUP;
+	struct impl *this = object;
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_result_node_params result;
+	uint32_t count = 0;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+
+	result.id = id;
+	result.next = start;
+      next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_PropInfo:
+	{
+		struct props *p = &this->props;
+		struct spa_pod_frame f[2];
+		uint32_t i, i_rate, o_rate;
+		char label[128];
+
+		/* report the cost of the presets for the configured rates */
+		i_rate = this->resample.i_rate ? this->resample.i_rate : DEFAULT_RATE;
+		o_rate = this->resample.o_rate ? this->resample.o_rate : 48000;
+
+		switch (result.index) {
+		case 0:
+			spa_pod_builder_push_object(&b, &f[0], SPA_TYPE_OBJECT_PropInfo, id);
+			spa_pod_builder_add(&b,
+				SPA_PROP_INFO_id,   SPA_POD_Id(SPA_PROP_quality),
+				SPA_PROP_INFO_name, SPA_POD_String("Resampler quality"),
+				SPA_PROP_INFO_type, SPA_POD_CHOICE_RANGE_Int(p->quality, 0,
+						SPA_N_ELEMENTS(blackman_qualities) - 1),
+				0);
+			spa_pod_builder_prop(&b, SPA_PROP_INFO_labels, 0);
+			spa_pod_builder_push_struct(&b, &f[1]);
+			for (i = 0; i < SPA_N_ELEMENTS(quality_presets); i++) {
+				const struct quality_preset *q = &quality_presets[i];
+				uint32_t n_taps = impl_native_taps(q->quality, i_rate, o_rate);
+
+				snprintf(label, sizeof(label), "%s: %.2f ms delay, %u taps",
+						q->name, n_taps * 1000.0 / i_rate, n_taps);
+				spa_pod_builder_int(&b, q->quality);
+				spa_pod_builder_string(&b, label);
+			}
+			spa_pod_builder_pop(&b, &f[1]);
+			param = spa_pod_builder_pop(&b, &f[0]);
+			break;
+		default:
+			return 0;
+		}
+		break;
+	}
+	case SPA_PARAM_Props:
+	{
+		struct props *p = &this->props;
+
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_Props, id,
+				SPA_PROP_rate,		SPA_POD_Double(p->rate),
+				SPA_PROP_quality,	SPA_POD_Int(p->quality));
+			break;
+		default:
+			return 0;
+		}
+		break;
+	}
+	default:
+		return -ENOENT;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
 }
 
 static int apply_props(struct impl *this, const struct spa_pod *param)
@@ -190,6 +282,15 @@ static int apply_props(struct impl *this, const struct spa_pod *param)
 				resample_update_rate(&this->resample, p->rate);
 			}
 			break;
+		case SPA_PROP_quality:
+		{
+			int32_t quality;
+			/* used for the next format */
+			if (spa_pod_get_int(&prop->value, &quality) == 0)
+				p->quality = SPA_CLAMP(quality, 0,
+						(int32_t)SPA_N_ELEMENTS(blackman_qualities) - 1);
+			break;
+		}
 		default:
 			break;
 		}
@@ -546,7 +647,11 @@ static int port_set_format(void *object,
 		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_READWRITE);
 		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
 	}
+	/* EnumFormat of the other port is derived from this format */
+	other->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	other->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
 	emit_port_info(this, port, false);
+	emit_port_info(this, other, false);
 
 	return res;
 }
@@ -713,6 +818,7 @@ static int impl_node_process(void *object)
 	void **dst_datas;
 	bool flush_out = false;
 	bool flush_in = false;
+	bool gap;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 
@@ -793,8 +899,20 @@ static int impl_node_process(void *object)
 	for (i = 0; i < db->n_datas; i++)
 		dst_datas[i] = SPA_MEMBER(db->datas[i].data, outport->offset, void);
 
+	/* the output is silence when the input and the history are silent */
+	gap = sbuf->h && SPA_FLAG_IS_SET(sbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+	if (outport->offset == 0)
+		outport->gap = true;
+	if (!gap || this->peaks || this->gap_samples < resample_delay(&this->resample))
+		outport->gap = false;
+
 	resample_process(&this->resample, src_datas, &in_len, dst_datas, &out_len);
 
+	if (gap)
+		this->gap_samples = SPA_MIN(this->gap_samples + in_len, UINT32_MAX / 2);
+	else
+		this->gap_samples = 0;
+
 	spa_log_trace_fp(this->log, NAME " %p: in %d/%d %zd %d out %d/%d %zd %d max:%d",
 			this, pin_len, in_len, size / sizeof(float), inport->offset,
 			pout_len, out_len, maxsize / sizeof(float), outport->offset,
@@ -815,6 +933,12 @@ static int impl_node_process(void *object)
 
 	outport->offset += out_len * sizeof(float);
 	if (outport->offset > 0 && (outport->offset >= maxsize || flush_out)) {
+		if (dbuf->h) {
+			if (outport->gap)
+				SPA_FLAG_SET(dbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+			else
+				SPA_FLAG_CLEAR(dbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+		}
 		outio->status = SPA_STATUS_HAVE_DATA;
 		outio->buffer_id = dbuf->id;
 		dequeue_buffer(this, dbuf);
@@ -925,9 +1049,13 @@ impl_init(const struct spa_handle_factory *factory,
 	if (this->cpu)
 		this->resample.cpu_flags = spa_cpu_get_flags(this->cpu);
 
+	props_reset(&this->props);
+
 	if (info != NULL) {
 		if ((str = spa_dict_lookup(info, "resample.peaks")) != NULL)
 			this->peaks = atoi(str);
+		if ((str = spa_dict_lookup(info, "resample.quality")) != NULL)
+			this->props.quality = impl_native_parse_quality(this->log, str);
 		if ((str = spa_dict_lookup(info, "factory.mode")) != NULL) {
 			if (strcmp(str, "split") == 0)
 				this->mode = MODE_SPLIT;
@@ -947,8 +1075,13 @@ impl_init(const struct spa_handle_factory *factory,
 	spa_hook_list_init(&this->hooks);
 
 	this->info = SPA_NODE_INFO_INIT();
-	this->info_all = SPA_NODE_CHANGE_MASK_FLAGS;
+	this->info_all = SPA_NODE_CHANGE_MASK_FLAGS |
+			SPA_NODE_CHANGE_MASK_PARAMS;
 	this->info.flags = SPA_NODE_FLAG_RT;
+	this->params[0] = SPA_PARAM_INFO(SPA_PARAM_PropInfo, SPA_PARAM_INFO_READ);
+	this->params[1] = SPA_PARAM_INFO(SPA_PARAM_Props, SPA_PARAM_INFO_READWRITE);
+	this->info.params = this->params;
+	this->info.n_params = 2;
 
 	port = GET_OUT_PORT(this, 0);
 	port->direction = SPA_DIRECTION_OUTPUT;
@@ -982,8 +1115,6 @@ impl_init(const struct spa_handle_factory *factory,
 	port->info.n_params = 5;
 	spa_list_init(&port->queue);
 
-	props_reset(&this->props);
-
 	return 0;
 }
 
@@ -28,8 +28,11 @@
 #include <spa/support/cpu.h>
 #include <spa/support/log.h>
 
+#define RESAMPLE_DEFAULT_QUALITY	4
+
 struct resample {
 	uint32_t cpu_flags;
+	uint32_t quality;
 	uint32_t channels;
 	uint32_t i_rate;
 	uint32_t o_rate;
@@ -59,9 +59,11 @@
 struct buffer {
 	uint32_t id;
 #define BUFFER_FLAG_QUEUED	(1<<0)
+#define BUFFER_FLAG_SILENT	(1<<1)	/* the data is known to be all zero */
 	uint32_t flags;
 	struct spa_list link;
 	struct spa_buffer *buf;
+	struct spa_meta_header *h;
 	void *datas[MAX_DATAS];
 };
 
@@ -290,6 +292,9 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 		this->is_passthrough = true;
 		port->have_format = true;
 		port->format = info;
+		port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+		port->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+		emit_port_info(this, port, false);
 
 		this->port_count = info.info.raw.channels;
 		for (i = 0; i < this->port_count; i++) {
@@ -652,7 +657,9 @@ static int port_set_format(void *object,
 
 		port->have_format = true;
 	}
+	/* EnumFormat is derived from the current format */
 	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	port->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
 	if (port->have_format) {
 		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_READWRITE);
 		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
@@ -746,6 +753,7 @@ impl_node_port_use_buffers(void *object,
 		b->id = i;
 		b->buf = buffers[i];
 		b->flags = 0;
+		b->h = spa_buffer_find_meta_data(buffers[i], SPA_META_Header, sizeof(*b->h));
 
 		for (j = 0; j < n_datas; j++) {
 			if (d[j].data == NULL) {
@@ -823,6 +831,7 @@ static int impl_node_process(void *object)
 	const void **src_datas;
 	void **dst_datas;
 	int res = 0;
+	bool gap;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 
@@ -841,6 +850,7 @@ static int impl_node_process(void *object)
 
 	sbuf = &inport->buffers[inio->buffer_id];
 	sd = sbuf->buf->datas;
+	gap = sbuf->h && SPA_FLAG_IS_SET(sbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
 
 	n_src_datas = sbuf->buf->n_datas;
 	src_datas = alloca(sizeof(void*) * n_src_datas);
@@ -898,6 +908,25 @@ static int impl_node_process(void *object)
 			dd[j].chunk->size = n_samples * outport->stride;
 		}
 
+		/* silence is only written once in each buffer */
+		if (this->is_passthrough) {
+			/* the input data is passed on */
+		} else if (gap) {
+			if (!SPA_FLAG_IS_SET(dbuf->flags, BUFFER_FLAG_SILENT)) {
+				for (j = 0; j < dbuf->buf->n_datas; j++)
+					memset(dbuf->datas[j], 0, dd[j].maxsize);
+				SPA_FLAG_SET(dbuf->flags, BUFFER_FLAG_SILENT);
+			}
+		} else {
+			SPA_FLAG_CLEAR(dbuf->flags, BUFFER_FLAG_SILENT);
+		}
+		if (dbuf->h) {
+			if (gap)
+				SPA_FLAG_SET(dbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+			else
+				SPA_FLAG_CLEAR(dbuf->h->flags, SPA_META_HEADER_FLAG_GAP);
+		}
+
 		outio->status = SPA_STATUS_HAVE_DATA;
 		outio->buffer_id = dbuf->id;
 		res |= SPA_STATUS_HAVE_DATA;
@@ -911,7 +940,7 @@ static int impl_node_process(void *object)
 			n_src_datas, n_dst_datas, n_samples, maxsize, inport->stride,
 			this->is_passthrough);
 
-	if (!this->is_passthrough)
+	if (!this->is_passthrough && !gap)
 		convert_process(&this->conv, dst_datas, src_datas, n_samples);
 
 	inio->status = SPA_STATUS_NEED_DATA;
@@ -28,13 +28,17 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 
 #include <spa/utils/names.h>
+#include <spa/utils/dict.h>
 #include <spa/support/plugin.h>
 #include <spa/param/param.h>
 #include <spa/param/audio/format.h>
 #include <spa/param/audio/format-utils.h>
 #include <spa/node/node.h>
+#include <spa/node/io.h>
+#include <spa/node/utils.h>
 #include <spa/debug/mem.h>
 #include <spa/support/log-impl.h>
 
@@ -65,7 +69,7 @@ static const struct spa_handle_factory *find_factory(const char *name)
 	return NULL;
 }
 
-static int setup_context(struct context *ctx)
+static int setup_context(struct context *ctx, const struct spa_dict *info)
 {
 	size_t size;
 	int res;
@@ -80,14 +84,14 @@ static int setup_context(struct context *ctx)
 	factory = find_factory(SPA_NAME_AUDIO_CONVERT);
 	spa_assert(factory != NULL);
 
-	size = spa_handle_factory_get_size(factory, NULL);
+	size = spa_handle_factory_get_size(factory, info);
 
 	ctx->convert_handle = calloc(1, size);
 	spa_assert(ctx->convert_handle != NULL);
 
 	res = spa_handle_factory_init(factory,
 			ctx->convert_handle,
-			NULL,
+			info,
 			support, 1);
 	spa_assert(res >= 0);
 
@@ -509,13 +513,157 @@ static int test_set_in_format2(struct context *ctx)
 	return 0;
 }
 
+#define N_SAMPLES	1024
+#define N_CYCLES	8
+
+static void set_format(struct spa_node *node, enum spa_direction direction,
+		struct spa_audio_info_raw *info)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	int res;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_format_audio_raw_build(&b, SPA_PARAM_Format, info);
+
+	res = spa_node_port_set_param(node, direction, 0,
+			SPA_PARAM_Format, 0, param);
+	spa_assert(res == 0);
+}
+
+/* convert S16 stereo at 48000 to F32 mono at 44100 and return the
+ * number of output samples */
+static uint32_t run_convert(const char *fused, float *out, uint32_t max_out)
+{
+	struct context ctx;
+	struct spa_dict_item items[2];
+	struct spa_audio_info_raw info;
+	struct spa_buffer in_buf, out_buf, *in_bufs[1], *out_bufs[1];
+	struct spa_data in_data, out_data;
+	struct spa_chunk in_chunk, out_chunk;
+	struct spa_io_buffers in_io, out_io;
+	int16_t in_mem[N_SAMPLES * 2];
+	float out_mem[N_SAMPLES];
+	uint32_t i, j, n_out = 0;
+	int res;
+
+	items[0] = SPA_DICT_ITEM_INIT("factory.mode", "convert");
+	items[1] = SPA_DICT_ITEM_INIT("audioconvert.fused", fused);
+
+	spa_zero(ctx);
+	setup_context(&ctx, &SPA_DICT_INIT_ARRAY(items));
+
+	info = (struct spa_audio_info_raw) {
+		.format = SPA_AUDIO_FORMAT_S16,
+		.rate = 48000,
+		.channels = 2,
+		.position = { SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR, }
+	};
+	set_format(ctx.convert_node, SPA_DIRECTION_INPUT, &info);
+
+	info = (struct spa_audio_info_raw) {
+		.format = SPA_AUDIO_FORMAT_F32,
+		.rate = 44100,
+		.channels = 1,
+		.position = { SPA_AUDIO_CHANNEL_MONO, }
+	};
+	set_format(ctx.convert_node, SPA_DIRECTION_OUTPUT, &info);
+
+	spa_zero(in_buf);
+	spa_zero(in_data);
+	in_data.type = SPA_DATA_MemPtr;
+	in_data.data = in_mem;
+	in_data.maxsize = sizeof(in_mem);
+	in_data.chunk = &in_chunk;
+	in_buf.n_datas = 1;
+	in_buf.datas = &in_data;
+	in_bufs[0] = &in_buf;
+
+	spa_zero(out_buf);
+	spa_zero(out_data);
+	out_data.type = SPA_DATA_MemPtr;
+	out_data.data = out_mem;
+	out_data.maxsize = sizeof(out_mem);
+	out_data.chunk = &out_chunk;
+	out_buf.n_datas = 1;
+	out_buf.datas = &out_data;
+	out_bufs[0] = &out_buf;
+
+	res = spa_node_port_use_buffers(ctx.convert_node, SPA_DIRECTION_INPUT, 0,
+			0, in_bufs, 1);
+	spa_assert(res == 0);
+	res = spa_node_port_use_buffers(ctx.convert_node, SPA_DIRECTION_OUTPUT, 0,
+			0, out_bufs, 1);
+	spa_assert(res == 0);
+
+	in_io = SPA_IO_BUFFERS_INIT;
+	out_io = SPA_IO_BUFFERS_INIT;
+	res = spa_node_port_set_io(ctx.convert_node, SPA_DIRECTION_INPUT, 0,
+			SPA_IO_Buffers, &in_io, sizeof(in_io));
+	spa_assert(res == 0);
+	res = spa_node_port_set_io(ctx.convert_node, SPA_DIRECTION_OUTPUT, 0,
+			SPA_IO_Buffers, &out_io, sizeof(out_io));
+	spa_assert(res == 0);
+
+	res = spa_node_send_command(ctx.convert_node,
+			&SPA_NODE_COMMAND_INIT(SPA_NODE_COMMAND_Start));
+	spa_assert(res == 0);
+
+	for (i = 0; i < N_CYCLES; i++) {
+		for (j = 0; j < N_SAMPLES; j++) {
+			uint32_t t = i * N_SAMPLES + j;
+			in_mem[j * 2 + 0] = (int16_t)(t * 37);
+			in_mem[j * 2 + 1] = (int16_t)(t * -53);
+		}
+		in_chunk.offset = 0;
+		in_chunk.size = sizeof(in_mem);
+		in_io.status = SPA_STATUS_HAVE_DATA;
+		in_io.buffer_id = 0;
+
+		res = spa_node_process(ctx.convert_node);
+		spa_assert(res >= 0);
+		spa_assert(in_io.status == SPA_STATUS_NEED_DATA);
+
+		if (out_io.status == SPA_STATUS_HAVE_DATA) {
+			uint32_t n = out_chunk.size / sizeof(float);
+
+			spa_assert(n_out + n <= max_out);
+			memcpy(&out[n_out], out_mem, n * sizeof(float));
+			n_out += n;
+			out_io.status = SPA_STATUS_NEED_DATA;
+		}
+	}
+	clean_context(&ctx);
+
+	return n_out;
+}
+
+static int test_process_fused(void)
+{
+	float out[2][N_SAMPLES * N_CYCLES];
+	uint32_t i, n_out[2];
+
+	n_out[0] = run_convert("false", out[0], N_SAMPLES * N_CYCLES);
+	n_out[1] = run_convert("true", out[1], N_SAMPLES * N_CYCLES);
+
+	fprintf(stderr, "nodes: %d samples, fused: %d samples\n", n_out[0], n_out[1]);
+
+	spa_assert(n_out[0] > 0);
+	spa_assert(n_out[0] == n_out[1]);
+	for (i = 0; i < n_out[0]; i++)
+		spa_assert(fabsf(out[0][i] - out[1][i]) < 1e-6f);
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	struct context ctx;
 
 	spa_zero(ctx);
 
-	setup_context(&ctx);
+	setup_context(&ctx, NULL);
 
 	test_init_state(&ctx);
 	test_set_in_format(&ctx);
@@ -532,5 +680,7 @@ int main(int argc, char *argv[])
 
 	clean_context(&ctx);
 
+	test_process_fused();
+
 	return 0;
 }
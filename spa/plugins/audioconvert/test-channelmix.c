@@ -118,6 +118,117 @@ static void test_7p1_N(void)
 	test_mix(8, _M(FL)|_M(FR)|_M(LFE)|_M(FC)|_M(SL)|_M(SR)|_M(RL)|_M(RR), 2, _M(FL)|_M(FR), (float[]) { 0.5, 0.5 });
 }
 
+#define N_SAMPLES	1029
+
+static float samp_in[8][N_SAMPLES] __attribute__ ((aligned (32)));
+static float samp_out[8][N_SAMPLES] __attribute__ ((aligned (32)));
+static float samp_ref[8][N_SAMPLES];
+
+/* run the optimized function on aligned and unaligned data and compare with
+ * the C version */
+static void check_mix(struct channelmix *mix, channelmix_func_t func, channelmix_func_t ref)
+{
+	const void *ip[8];
+	void *op[8];
+	uint32_t i, j, n, offs;
+
+	for (offs = 0; offs < 2; offs++) {
+		for (i = 0; i < mix->src_chan; i++)
+			ip[i] = &samp_in[i][offs];
+		for (i = 0; i < mix->dst_chan; i++)
+			op[i] = samp_ref[i];
+		n = N_SAMPLES - offs;
+		ref(mix, mix->dst_chan, op, mix->src_chan, ip, n);
+
+		for (i = 0; i < mix->dst_chan; i++)
+			op[i] = &samp_out[i][offs];
+		func(mix, mix->dst_chan, op, mix->src_chan, ip, n);
+
+		for (i = 0; i < mix->dst_chan; i++)
+			for (j = 0; j < n; j++)
+				spa_assert(fabsf(samp_out[i][j + offs] - samp_ref[i][j]) < 1e-5f);
+	}
+}
+
+static void test_optimized(uint32_t src_chan, uint64_t src_mask, uint32_t dst_chan, uint64_t dst_mask,
+		channelmix_func_t func, channelmix_func_t ref)
+{
+	struct channelmix mix;
+	float volumes[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t i, j;
+
+	for (i = 0; i < 8; i++)
+		for (j = 0; j < N_SAMPLES; j++)
+			samp_in[i][j] = (float)drand48() - 0.5f;
+
+	spa_zero(mix);
+	mix.src_chan = src_chan;
+	mix.dst_chan = dst_chan;
+	mix.src_mask = src_mask;
+	mix.dst_mask = dst_mask;
+	mix.log = &logger.log;
+	spa_assert(channelmix_init(&mix) == 0);
+
+	for (i = 0; i < src_chan; i++)
+		volumes[i] = 1.0f;
+	channelmix_set_volume(&mix, 1.0f, false, src_chan, volumes);
+	check_mix(&mix, func, ref);
+
+	for (i = 0; i < src_chan; i++)
+		volumes[i] = (float)drand48();
+	channelmix_set_volume(&mix, 0.7f, false, src_chan, volumes);
+	check_mix(&mix, func, ref);
+
+	channelmix_set_volume(&mix, 1.0f, true, src_chan, volumes);
+	check_mix(&mix, func, ref);
+}
+
+#define MASK_5_1_SIDE	_M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR)
+
+static void test_7p1_optimized(channelmix_func_t f_2, channelmix_func_t f_3p1,
+		channelmix_func_t f_4, channelmix_func_t f_n_m)
+{
+	test_optimized(8, MASK_7_1, 2, MASK_STEREO, f_2, channelmix_f32_7p1_2_c);
+	test_optimized(8, MASK_7_1, 4, MASK_3_1, f_3p1, channelmix_f32_7p1_3p1_c);
+	test_optimized(8, MASK_7_1, 4, MASK_QUAD, f_4, channelmix_f32_7p1_4_c);
+
+	test_optimized(8, MASK_7_1, 6, MASK_5_1_SIDE, f_n_m, channelmix_f32_n_m_c);
+	test_optimized(8, MASK_7_1, 1, MASK_MONO, f_n_m, channelmix_f32_n_m_c);
+	test_optimized(6, MASK_5_1_SIDE, 8, MASK_7_1, f_n_m, channelmix_f32_n_m_c);
+	test_optimized(3, _M(FL)|_M(FR)|_M(LFE), 5, _M(FL)|_M(FR)|_M(FC)|_M(SL)|_M(SR),
+			f_n_m, channelmix_f32_n_m_c);
+}
+
+static void test_7p1_simd(void)
+{
+#if defined (HAVE_SSE)
+	if (__builtin_cpu_supports("sse"))
+		test_7p1_optimized(channelmix_f32_7p1_2_sse, channelmix_f32_7p1_3p1_sse,
+				channelmix_f32_7p1_4_sse, channelmix_f32_n_m_sse);
+#endif
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+	if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("fma"))
+		test_7p1_optimized(channelmix_f32_7p1_2_avx, channelmix_f32_7p1_3p1_avx,
+				channelmix_f32_7p1_4_avx, channelmix_f32_n_m_avx);
+#endif
+}
+
+static void test_neon(void)
+{
+#if defined (HAVE_NEON)
+	test_optimized(2, MASK_STEREO, 2, MASK_STEREO,
+			channelmix_copy_neon, channelmix_copy_c);
+	test_optimized(2, MASK_STEREO, 4, MASK_QUAD,
+			channelmix_f32_2_4_neon, channelmix_f32_2_4_c);
+	test_optimized(6, MASK_5_1_SIDE, 2, MASK_STEREO,
+			channelmix_f32_5p1_2_neon, channelmix_f32_5p1_2_c);
+	test_optimized(6, MASK_5_1_SIDE, 4, MASK_3_1,
+			channelmix_f32_5p1_3p1_neon, channelmix_f32_5p1_3p1_c);
+	test_optimized(6, MASK_5_1_SIDE, 4, MASK_QUAD,
+			channelmix_f32_5p1_4_neon, channelmix_f32_5p1_4_c);
+#endif
+}
+
 int main(int argc, char *argv[])
 {
 	logger.log.level = SPA_LOG_LEVEL_TRACE;
@@ -129,5 +240,9 @@ int main(int argc, char *argv[])
 	test_5p1_N();
 	test_7p1_N();
 
+	logger.log.level = SPA_LOG_LEVEL_WARN;
+	test_7p1_simd();
+	test_neon();
+
 	return 0;
 }
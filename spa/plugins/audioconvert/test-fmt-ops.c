@@ -40,25 +40,30 @@ static uint8_t samp_in[N_SAMPLES * 4];
 static uint8_t samp_out[N_SAMPLES * 4];
 static uint8_t temp_in[N_SAMPLES * N_CHANNELS * 4];
 static uint8_t temp_out[N_SAMPLES * N_CHANNELS * 4];
+static uint8_t ref_out[N_SAMPLES * N_CHANNELS * 4];
 
-static void run_test(const char *name,
-		const void *in, size_t in_size, const void *out, size_t out_size, size_t n_samples,
-		bool in_packed, bool out_packed, convert_func_t func)
+static const uint32_t channel_counts[] = { 1, 2, N_CHANNELS };
+
+static uint32_t cpu_flags;
+
+static void run_test1(const void *in, size_t in_size, const void *out, size_t out_size,
+		size_t n_samples, bool in_packed, bool out_packed, convert_func_t func,
+		uint32_t n_channels)
 {
 	const void *ip[N_CHANNELS];
 	void *tp[N_CHANNELS];
-	int i, j;
+	uint32_t i, j;
 	const uint8_t *in8 = in, *out8 = out;
 	struct convert conv;
 
-	conv.n_channels = N_CHANNELS;
+	conv.n_channels = n_channels;
 
 	for (j = 0; j < N_SAMPLES; j++) {
 		memcpy(&samp_in[j * in_size], &in8[(j % n_samples) * in_size], in_size);
 		memcpy(&samp_out[j * out_size], &out8[(j % n_samples) * out_size], out_size);
 	}
 
-	for (j = 0; j < N_CHANNELS; j++)
+	for (j = 0; j < n_channels; j++)
 		ip[j] = samp_in;
 
 	if (in_packed) {
@@ -84,28 +89,81 @@ static void run_test(const char *name,
 	}
 
 	spa_zero(temp_out);
-	for (j = 0; j < N_CHANNELS; j++)
+	for (j = 0; j < n_channels; j++)
 		tp[j] = &temp_out[j * N_SAMPLES * out_size];
 
 	func(&conv, tp, ip, N_SAMPLES);
 
-	fprintf(stderr, "test %s:\n", name);
 	if (out_packed) {
 		const uint8_t *d = tp[0], *s = samp_out;
 		for (i = 0; i < N_SAMPLES; i++) {
-			for (j = 0; j < N_CHANNELS; j++) {
+			for (j = 0; j < n_channels; j++) {
 				spa_assert(memcmp(d, s, out_size) == 0);
 				d += out_size;
 			}
 			s += out_size;
 		}
 	} else {
-		for (j = 0; j < N_CHANNELS; j++) {
+		for (j = 0; j < n_channels; j++) {
 			spa_assert(memcmp(tp[j], samp_out, N_SAMPLES * out_size) == 0);
 		}
 	}
 }
 
+static void run_test(const char *name,
+		const void *in, size_t in_size, const void *out, size_t out_size, size_t n_samples,
+		bool in_packed, bool out_packed, convert_func_t func)
+{
+	size_t i;
+
+	fprintf(stderr, "test %s:\n", name);
+	for (i = 0; i < SPA_N_ELEMENTS(channel_counts); i++)
+		run_test1(in, in_size, out, out_size, n_samples, in_packed, out_packed,
+				func, channel_counts[i]);
+}
+
+/* compare against the C version with different random data in each channel */
+static void run_test_ref(const char *name, size_t in_size, size_t out_size,
+		bool in_packed, bool out_packed, convert_func_t ref, convert_func_t func)
+{
+	const void *ip[N_CHANNELS];
+	void *rp[N_CHANNELS], *tp[N_CHANNELS];
+	uint32_t i, j, n_channels;
+	struct convert conv;
+
+	fprintf(stderr, "test %s:\n", name);
+
+	for (i = 0; i < N_SAMPLES * N_CHANNELS; i++) {
+		if (in_size == sizeof(float)) {
+			float v = (rand() / (float)RAND_MAX) * 2.4f - 1.2f;
+			memcpy(&temp_in[i * in_size], &v, in_size);
+		} else {
+			for (j = 0; j < in_size; j++)
+				temp_in[i * in_size + j] = rand();
+		}
+	}
+	for (i = 0; i < SPA_N_ELEMENTS(channel_counts); i++) {
+		n_channels = conv.n_channels = channel_counts[i];
+
+		for (j = 0; j < n_channels; j++) {
+			ip[j] = &temp_in[in_packed ? 0 : j * N_SAMPLES * in_size];
+			rp[j] = &ref_out[out_packed ? 0 : j * N_SAMPLES * out_size];
+			tp[j] = &temp_out[out_packed ? 0 : j * N_SAMPLES * out_size];
+		}
+		spa_zero(ref_out);
+		spa_zero(temp_out);
+
+		/* the dither functions must see the same noise */
+		conv.method = DITHER_METHOD_TRIANGULAR;
+		init_dither(&conv);
+		ref(&conv, rp, ip, N_SAMPLES);
+		init_dither(&conv);
+		func(&conv, tp, ip, N_SAMPLES);
+
+		spa_assert(memcmp(ref_out, temp_out, sizeof(temp_out)) == 0);
+	}
+}
+
 static void test_f32_u8(void)
 {
 	const float in[] = { 0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 1.1f, -1.1f };
@@ -119,6 +177,18 @@ static void test_f32_u8(void)
 			true, false, conv_f32_to_u8d_c);
 	run_test("test_f32d_u8d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_f32d_to_u8d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_u8_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, true, conv_f32_to_u8_avx2);
+		run_test("test_f32d_u8_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_f32d_to_u8_avx2);
+		run_test("test_f32_u8d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_f32_to_u8d_avx2);
+		run_test("test_f32d_u8d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, false, conv_f32d_to_u8d_avx2);
+	}
+#endif
 }
 
 static void test_u8_f32(void)
@@ -134,6 +204,18 @@ static void test_u8_f32(void)
 			true, false, conv_u8_to_f32d_c);
 	run_test("test_u8d_f32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_u8d_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_u8_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, true, conv_u8_to_f32_avx2);
+		run_test("test_u8d_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_u8d_to_f32_avx2);
+		run_test("test_u8_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_u8_to_f32d_avx2);
+		run_test("test_u8d_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, false, conv_u8d_to_f32d_avx2);
+	}
+#endif
 }
 
 static void test_f32_s16(void)
@@ -149,6 +231,24 @@ static void test_f32_s16(void)
 			true, false, conv_f32_to_s16d_c);
 	run_test("test_f32d_s16d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_f32d_to_s16d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s16_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, true, conv_f32_to_s16_avx2);
+		run_test("test_f32d_s16_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_f32d_to_s16_avx2);
+		run_test("test_f32_s16d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_f32_to_s16d_avx2);
+		run_test("test_f32d_s16d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, false, conv_f32d_to_s16d_avx2);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32d_s16_neon", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_f32d_to_s16_neon);
+	}
+#endif
 }
 
 static void test_s16_f32(void)
@@ -164,6 +264,24 @@ static void test_s16_f32(void)
 			true, true, conv_s16_to_f32_c);
 	run_test("test_s16d_f32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_s16d_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s16_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_s16_to_f32d_avx2);
+		run_test("test_s16d_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_s16d_to_f32_avx2);
+		run_test("test_s16_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, true, conv_s16_to_f32_avx2);
+		run_test("test_s16d_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, false, conv_s16d_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s16_f32d_neon", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_s16_to_f32d_neon);
+	}
+#endif
 }
 
 static void test_f32_s32(void)
@@ -180,6 +298,30 @@ static void test_f32_s32(void)
 			true, false, conv_f32_to_s32d_c);
 	run_test("test_f32d_s32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_f32d_to_s32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, true, conv_f32_to_s32_avx2);
+		run_test("test_f32d_s32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_f32d_to_s32_avx2);
+		run_test("test_f32_s32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_f32_to_s32d_avx2);
+		run_test("test_f32d_s32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, false, conv_f32d_to_s32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_f32_to_s32d_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32d_s32_neon", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_f32d_to_s32_neon);
+	}
+#endif
 }
 
 static void test_s32_f32(void)
@@ -195,6 +337,30 @@ static void test_s32_f32(void)
 			true, true, conv_s32_to_f32_c);
 	run_test("test_s32d_f32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_s32d_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s32_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_s32_to_f32d_avx2);
+		run_test("test_s32d_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_s32d_to_f32_avx2);
+		run_test("test_s32_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, true, conv_s32_to_f32_avx2);
+		run_test("test_s32d_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, false, conv_s32d_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s32_f32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_s32_to_f32d_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s32_f32d_neon", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_s32_to_f32d_neon);
+	}
+#endif
 }
 
 static void test_f32_s24(void)
@@ -211,6 +377,18 @@ static void test_f32_s24(void)
 			true, false, conv_f32_to_s24d_c);
 	run_test("test_f32d_s24d", in, sizeof(in[0]), out, 3, SPA_N_ELEMENTS(in),
 			false, false, conv_f32d_to_s24d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s24_avx2", in, sizeof(in[0]), out, 3, SPA_N_ELEMENTS(in),
+				true, true, conv_f32_to_s24_avx2);
+		run_test("test_f32d_s24_avx2", in, sizeof(in[0]), out, 3, SPA_N_ELEMENTS(in),
+				false, true, conv_f32d_to_s24_avx2);
+		run_test("test_f32_s24d_avx2", in, sizeof(in[0]), out, 3, SPA_N_ELEMENTS(in),
+				true, false, conv_f32_to_s24d_avx2);
+		run_test("test_f32d_s24d_avx2", in, sizeof(in[0]), out, 3, SPA_N_ELEMENTS(in),
+				false, false, conv_f32d_to_s24d_avx2);
+	}
+#endif
 }
 
 static void test_s24_f32(void)
@@ -227,6 +405,18 @@ static void test_s24_f32(void)
 			true, true, conv_s24_to_f32_c);
 	run_test("test_s24d_f32d", in, 3, out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_s24d_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s24_f32d_avx2", in, 3, out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_s24_to_f32d_avx2);
+		run_test("test_s24d_f32_avx2", in, 3, out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_s24d_to_f32_avx2);
+		run_test("test_s24_f32_avx2", in, 3, out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, true, conv_s24_to_f32_avx2);
+		run_test("test_s24d_f32d_avx2", in, 3, out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, false, conv_s24d_to_f32d_avx2);
+	}
+#endif
 }
 
 static void test_f32_s24_32(void)
@@ -243,6 +433,30 @@ static void test_f32_s24_32(void)
 			true, false, conv_f32_to_s24_32d_c);
 	run_test("test_f32d_s24_32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_f32d_to_s24_32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s24_32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, true, conv_f32_to_s24_32_avx2);
+		run_test("test_f32d_s24_32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_f32d_to_s24_32_avx2);
+		run_test("test_f32_s24_32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_f32_to_s24_32d_avx2);
+		run_test("test_f32d_s24_32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, false, conv_f32d_to_s24_32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s24_32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_f32_to_s24_32d_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32d_s24_32_neon", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_f32d_to_s24_32_neon);
+	}
+#endif
 }
 
 static void test_s24_32_f32(void)
@@ -258,10 +472,243 @@ static void test_s24_32_f32(void)
 			true, true, conv_s24_32_to_f32_c);
 	run_test("test_s24_32d_f32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_s24_32d_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s24_32_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_s24_32_to_f32d_avx2);
+		run_test("test_s24_32d_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, true, conv_s24_32d_to_f32_avx2);
+		run_test("test_s24_32_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, true, conv_s24_32_to_f32_avx2);
+		run_test("test_s24_32d_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				false, false, conv_s24_32d_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s24_32_f32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_s24_32_to_f32d_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s24_32_f32d_neon", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+				true, false, conv_s24_32_to_f32d_neon);
+	}
+#endif
+}
+
+static void test_ref(void)
+{
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test_ref("f32_to_s16_dither_sse2", 4, 2, true, true,
+				conv_f32_to_s16_dither_c, conv_f32_to_s16_dither_sse2);
+		run_test_ref("f32d_to_s16d_dither_sse2", 4, 2, false, false,
+				conv_f32d_to_s16d_dither_c, conv_f32d_to_s16d_dither_sse2);
+		run_test_ref("f32d_to_s16_dither_sse2", 4, 2, false, true,
+				conv_f32d_to_s16_dither_c, conv_f32d_to_s16_dither_sse2);
+	}
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test_ref("u8_to_f32_avx2", 1, 4, true, true,
+				conv_u8_to_f32_c, conv_u8_to_f32_avx2);
+		run_test_ref("u8d_to_f32d_avx2", 1, 4, false, false,
+				conv_u8d_to_f32d_c, conv_u8d_to_f32d_avx2);
+		run_test_ref("u8_to_f32d_avx2", 1, 4, true, false,
+				conv_u8_to_f32d_c, conv_u8_to_f32d_avx2);
+		run_test_ref("u8d_to_f32_avx2", 1, 4, false, true,
+				conv_u8d_to_f32_c, conv_u8d_to_f32_avx2);
+		run_test_ref("s16_to_f32_avx2", 2, 4, true, true,
+				conv_s16_to_f32_c, conv_s16_to_f32_avx2);
+		run_test_ref("s16d_to_f32d_avx2", 2, 4, false, false,
+				conv_s16d_to_f32d_c, conv_s16d_to_f32d_avx2);
+		run_test_ref("s16_to_f32d_avx2", 2, 4, true, false,
+				conv_s16_to_f32d_c, conv_s16_to_f32d_avx2);
+		run_test_ref("s16d_to_f32_avx2", 2, 4, false, true,
+				conv_s16d_to_f32_c, conv_s16d_to_f32_avx2);
+		run_test_ref("s24_to_f32_avx2", 3, 4, true, true,
+				conv_s24_to_f32_c, conv_s24_to_f32_avx2);
+		run_test_ref("s24d_to_f32d_avx2", 3, 4, false, false,
+				conv_s24d_to_f32d_c, conv_s24d_to_f32d_avx2);
+		run_test_ref("s24_to_f32d_avx2", 3, 4, true, false,
+				conv_s24_to_f32d_c, conv_s24_to_f32d_avx2);
+		run_test_ref("s24d_to_f32_avx2", 3, 4, false, true,
+				conv_s24d_to_f32_c, conv_s24d_to_f32_avx2);
+		run_test_ref("s32_to_f32_avx2", 4, 4, true, true,
+				conv_s32_to_f32_c, conv_s32_to_f32_avx2);
+		run_test_ref("s32d_to_f32d_avx2", 4, 4, false, false,
+				conv_s32d_to_f32d_c, conv_s32d_to_f32d_avx2);
+		run_test_ref("s32_to_f32d_avx2", 4, 4, true, false,
+				conv_s32_to_f32d_c, conv_s32_to_f32d_avx2);
+		run_test_ref("s32d_to_f32_avx2", 4, 4, false, true,
+				conv_s32d_to_f32_c, conv_s32d_to_f32_avx2);
+		run_test_ref("s24_32_to_f32_avx2", 4, 4, true, true,
+				conv_s24_32_to_f32_c, conv_s24_32_to_f32_avx2);
+		run_test_ref("s24_32d_to_f32d_avx2", 4, 4, false, false,
+				conv_s24_32d_to_f32d_c, conv_s24_32d_to_f32d_avx2);
+		run_test_ref("s24_32_to_f32d_avx2", 4, 4, true, false,
+				conv_s24_32_to_f32d_c, conv_s24_32_to_f32d_avx2);
+		run_test_ref("s24_32d_to_f32_avx2", 4, 4, false, true,
+				conv_s24_32d_to_f32_c, conv_s24_32d_to_f32_avx2);
+		run_test_ref("f32_to_u8_avx2", 4, 1, true, true,
+				conv_f32_to_u8_c, conv_f32_to_u8_avx2);
+		run_test_ref("f32d_to_u8d_avx2", 4, 1, false, false,
+				conv_f32d_to_u8d_c, conv_f32d_to_u8d_avx2);
+		run_test_ref("f32_to_u8d_avx2", 4, 1, true, false,
+				conv_f32_to_u8d_c, conv_f32_to_u8d_avx2);
+		run_test_ref("f32d_to_u8_avx2", 4, 1, false, true,
+				conv_f32d_to_u8_c, conv_f32d_to_u8_avx2);
+		run_test_ref("f32_to_s16_avx2", 4, 2, true, true,
+				conv_f32_to_s16_c, conv_f32_to_s16_avx2);
+		run_test_ref("f32d_to_s16d_avx2", 4, 2, false, false,
+				conv_f32d_to_s16d_c, conv_f32d_to_s16d_avx2);
+		run_test_ref("f32_to_s16d_avx2", 4, 2, true, false,
+				conv_f32_to_s16d_c, conv_f32_to_s16d_avx2);
+		run_test_ref("f32d_to_s16_avx2", 4, 2, false, true,
+				conv_f32d_to_s16_c, conv_f32d_to_s16_avx2);
+		run_test_ref("f32_to_s24_avx2", 4, 3, true, true,
+				conv_f32_to_s24_c, conv_f32_to_s24_avx2);
+		run_test_ref("f32d_to_s24d_avx2", 4, 3, false, false,
+				conv_f32d_to_s24d_c, conv_f32d_to_s24d_avx2);
+		run_test_ref("f32_to_s24d_avx2", 4, 3, true, false,
+				conv_f32_to_s24d_c, conv_f32_to_s24d_avx2);
+		run_test_ref("f32d_to_s24_avx2", 4, 3, false, true,
+				conv_f32d_to_s24_c, conv_f32d_to_s24_avx2);
+		run_test_ref("f32_to_s32_avx2", 4, 4, true, true,
+				conv_f32_to_s32_c, conv_f32_to_s32_avx2);
+		run_test_ref("f32d_to_s32d_avx2", 4, 4, false, false,
+				conv_f32d_to_s32d_c, conv_f32d_to_s32d_avx2);
+		run_test_ref("f32_to_s32d_avx2", 4, 4, true, false,
+				conv_f32_to_s32d_c, conv_f32_to_s32d_avx2);
+		run_test_ref("f32d_to_s32_avx2", 4, 4, false, true,
+				conv_f32d_to_s32_c, conv_f32d_to_s32_avx2);
+		run_test_ref("f32_to_s24_32_avx2", 4, 4, true, true,
+				conv_f32_to_s24_32_c, conv_f32_to_s24_32_avx2);
+		run_test_ref("f32d_to_s24_32d_avx2", 4, 4, false, false,
+				conv_f32d_to_s24_32d_c, conv_f32d_to_s24_32d_avx2);
+		run_test_ref("f32_to_s24_32d_avx2", 4, 4, true, false,
+				conv_f32_to_s24_32d_c, conv_f32_to_s24_32d_avx2);
+		run_test_ref("f32d_to_s24_32_avx2", 4, 4, false, true,
+				conv_f32d_to_s24_32_c, conv_f32d_to_s24_32_avx2);
+		run_test_ref("deinterleave_32_avx2", 4, 4, true, false,
+				conv_deinterleave_32_c, conv_deinterleave_32_avx2);
+		run_test_ref("interleave_32_avx2", 4, 4, false, true,
+				conv_interleave_32_c, conv_interleave_32_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test_ref("s32_to_f32d_avx512", 4, 4, true, false,
+				conv_s32_to_f32d_c, conv_s32_to_f32d_avx512);
+		run_test_ref("s24_32_to_f32d_avx512", 4, 4, true, false,
+				conv_s24_32_to_f32d_c, conv_s24_32_to_f32d_avx512);
+		run_test_ref("f32_to_s32d_avx512", 4, 4, true, false,
+				conv_f32_to_s32d_c, conv_f32_to_s32d_avx512);
+		run_test_ref("f32_to_s24_32d_avx512", 4, 4, true, false,
+				conv_f32_to_s24_32d_c, conv_f32_to_s24_32d_avx512);
+		run_test_ref("deinterleave_32_avx512", 4, 4, true, false,
+				conv_deinterleave_32_c, conv_deinterleave_32_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test_ref("s16_to_f32d_neon", 2, 4, true, false,
+				conv_s16_to_f32d_c, conv_s16_to_f32d_neon);
+		run_test_ref("s32_to_f32d_neon", 4, 4, true, false,
+				conv_s32_to_f32d_c, conv_s32_to_f32d_neon);
+		run_test_ref("s24_32_to_f32d_neon", 4, 4, true, false,
+				conv_s24_32_to_f32d_c, conv_s24_32_to_f32d_neon);
+		run_test_ref("f32d_to_s16_neon", 4, 2, false, true,
+				conv_f32d_to_s16_c, conv_f32d_to_s16_neon);
+		run_test_ref("f32d_to_s32_neon", 4, 4, false, true,
+				conv_f32d_to_s32_c, conv_f32d_to_s32_neon);
+		run_test_ref("f32d_to_s24_32_neon", 4, 4, false, true,
+				conv_f32d_to_s24_32_c, conv_f32d_to_s24_32_neon);
+		run_test_ref("deinterleave_32_neon", 4, 4, true, false,
+				conv_deinterleave_32_c, conv_deinterleave_32_neon);
+		run_test_ref("interleave_32_neon", 4, 4, false, true,
+				conv_interleave_32_c, conv_interleave_32_neon);
+	}
+#endif
+}
+
+static void run_test_dither(const char *name, uint32_t src_fmt, uint32_t method,
+		float max_err)
+{
+	const void *ip[2];
+	void *op[2];
+	uint32_t i, j;
+	struct convert conv;
+	float *in = (float *) temp_in;
+	int16_t *out = (int16_t *) temp_out;
+	double sum = 0.0;
+	/* a quarter LSB above an integer value, truncation can't get there */
+	const float val = 100.25f;
+
+	fprintf(stderr, "test %s:\n", name);
+
+	spa_zero(conv);
+	conv.src_fmt = src_fmt;
+	conv.dst_fmt = SPA_AUDIO_FORMAT_S16;
+	conv.n_channels = 2;
+	conv.cpu_flags = cpu_flags;
+	conv.method = method;
+	spa_assert(convert_init(&conv) == 0);
+
+	for (i = 0; i < N_SAMPLES * 2; i++)
+		in[i] = val / S16_SCALE;
+	ip[0] = in;
+	ip[1] = &in[N_SAMPLES];
+	op[0] = out;
+
+	for (j = 0; j < 64; j++) {
+		convert_process(&conv, op, ip, N_SAMPLES);
+		for (i = 0; i < N_SAMPLES * 2; i++) {
+			spa_assert(fabsf(out[i] - val) <= max_err);
+			sum += out[i];
+		}
+	}
+	/* the dither makes the average output follow the input */
+	spa_assert(fabs(sum / (64 * N_SAMPLES * 2) - val) < 0.05);
+
+	convert_free(&conv);
+}
+
+static void test_dither(void)
+{
+	run_test_dither("f32_s16_rectangular", SPA_AUDIO_FORMAT_F32,
+			DITHER_METHOD_RECTANGULAR, 1.0f);
+	run_test_dither("f32d_s16_rectangular", SPA_AUDIO_FORMAT_F32P,
+			DITHER_METHOD_RECTANGULAR, 1.0f);
+	run_test_dither("f32_s16_triangular", SPA_AUDIO_FORMAT_F32,
+			DITHER_METHOD_TRIANGULAR, 1.5f);
+	run_test_dither("f32d_s16_triangular", SPA_AUDIO_FORMAT_F32P,
+			DITHER_METHOD_TRIANGULAR, 1.5f);
+	run_test_dither("f32_s16_shaped", SPA_AUDIO_FORMAT_F32,
+			DITHER_METHOD_SHAPED, 16.0f);
+	run_test_dither("f32d_s16_shaped", SPA_AUDIO_FORMAT_F32P,
+			DITHER_METHOD_SHAPED, 16.0f);
 }
 
 int main(int argc, char *argv[])
 {
+#if defined (HAVE_SSE2)
+	if (__builtin_cpu_supports("sse2"))
+		cpu_flags |= SPA_CPU_FLAG_SSE2;
+#endif
+#if defined (HAVE_AVX2)
+	if (__builtin_cpu_supports("avx2"))
+		cpu_flags |= SPA_CPU_FLAG_AVX2;
+#endif
+#if defined (HAVE_AVX512)
+	if (__builtin_cpu_supports("avx512f"))
+		cpu_flags |= SPA_CPU_FLAG_AVX512;
+#endif
+#if defined (HAVE_NEON)
+	cpu_flags |= SPA_CPU_FLAG_NEON;
+#endif
 
 	test_f32_u8();
 	test_u8_f32();
@@ -273,5 +720,7 @@ int main(int argc, char *argv[])
 	test_s24_f32();
 	test_f32_s24_32();
 	test_s24_32_f32();
+	test_ref();
+	test_dither();
 	return 0;
 }
@@ -0,0 +1,555 @@
+/* Spa
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+
+#include <spa/utils/names.h>
+#include <spa/utils/dict.h>
+#include <spa/support/plugin.h>
+#include <spa/buffer/buffer.h>
+#include <spa/param/param.h>
+#include <spa/param/props.h>
+#include <spa/param/audio/format.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/node/node.h>
+#include <spa/node/io.h>
+#include <spa/support/log-impl.h>
+
+SPA_LOG_IMPL(logger);
+
+#define N_SAMPLES	1024
+#define MAX_DATAS	2
+#define POISON		1234.0f
+
+/* a port of the node under test with one buffer that has a header */
+struct buf {
+	struct spa_buffer buffer, *buffers[1];
+	struct spa_meta meta;
+	struct spa_meta_header header;
+	struct spa_data datas[MAX_DATAS];
+	struct spa_chunk chunks[MAX_DATAS];
+	struct spa_io_buffers io;
+	float mem[MAX_DATAS][N_SAMPLES] SPA_ALIGNED(64);
+};
+
+static const struct spa_handle_factory *find_factory(const char *name)
+{
+	uint32_t index = 0;
+	const struct spa_handle_factory *factory;
+
+	while (spa_handle_factory_enum(&factory, &index) == 1) {
+		if (strcmp(factory->name, name) == 0)
+			return factory;
+	}
+	return NULL;
+}
+
+static struct spa_node *make_node(struct spa_handle **handle, const char *name,
+		const struct spa_dict *info)
+{
+	const struct spa_handle_factory *factory;
+	struct spa_support support[1];
+	void *iface;
+
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Log, &logger);
+
+	factory = find_factory(name);
+	spa_assert(factory != NULL);
+
+	*handle = calloc(1, spa_handle_factory_get_size(factory, info));
+	spa_assert(*handle != NULL);
+	spa_assert(spa_handle_factory_init(factory, *handle, info, support, 1) >= 0);
+	spa_assert(spa_handle_get_interface(*handle, SPA_TYPE_INTERFACE_Node, &iface) >= 0);
+
+	return iface;
+}
+
+static void free_node(struct spa_handle *handle)
+{
+	spa_handle_clear(handle);
+	free(handle);
+}
+
+static void set_format(struct spa_node *node, enum spa_direction direction,
+		uint32_t port_id, uint32_t format, uint32_t rate, uint32_t channels)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	struct spa_audio_info_raw info;
+
+	spa_zero(info);
+	info.format = format;
+	info.rate = rate;
+	info.channels = channels;
+	if (channels == 1) {
+		info.position[0] = SPA_AUDIO_CHANNEL_MONO;
+	} else {
+		info.position[0] = SPA_AUDIO_CHANNEL_FL;
+		info.position[1] = SPA_AUDIO_CHANNEL_FR;
+	}
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_format_audio_raw_build(&b, SPA_PARAM_Format, &info);
+	spa_assert(spa_node_port_set_param(node, direction, port_id,
+			SPA_PARAM_Format, 0, param) >= 0);
+}
+
+/* make F32P stereo DSP ports on one side of the merger or the splitter */
+static void set_dsp(struct spa_node *node, enum spa_direction direction)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	struct spa_audio_info_raw info;
+
+	spa_zero(info);
+	info.format = SPA_AUDIO_FORMAT_F32P;
+	info.rate = 48000;
+	info.channels = 2;
+	info.position[0] = SPA_AUDIO_CHANNEL_FL;
+	info.position[1] = SPA_AUDIO_CHANNEL_FR;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_format_audio_raw_build(&b, SPA_PARAM_Format, &info);
+	param = spa_pod_builder_add_object(&b,
+		SPA_TYPE_OBJECT_ParamPortConfig, SPA_PARAM_PortConfig,
+		SPA_PARAM_PORT_CONFIG_direction,	SPA_POD_Id(direction),
+		SPA_PARAM_PORT_CONFIG_mode,		SPA_POD_Id(SPA_PARAM_PORT_CONFIG_MODE_dsp),
+		SPA_PARAM_PORT_CONFIG_format,		SPA_POD_Pod(param));
+	spa_assert(spa_node_set_param(node, SPA_PARAM_PortConfig, 0, param) == 0);
+}
+
+static void buf_init(struct buf *b, struct spa_node *node,
+		enum spa_direction direction, uint32_t port_id, uint32_t n_datas)
+{
+	uint32_t i;
+
+	spa_zero(*b);
+	b->meta.type = SPA_META_Header;
+	b->meta.data = &b->header;
+	b->meta.size = sizeof(b->header);
+	for (i = 0; i < n_datas; i++) {
+		b->datas[i].type = SPA_DATA_MemPtr;
+		b->datas[i].data = b->mem[i];
+		b->datas[i].maxsize = sizeof(b->mem[i]);
+		b->datas[i].chunk = &b->chunks[i];
+	}
+	b->buffer.n_metas = 1;
+	b->buffer.metas = &b->meta;
+	b->buffer.n_datas = n_datas;
+	b->buffer.datas = b->datas;
+	b->buffers[0] = &b->buffer;
+	b->io = SPA_IO_BUFFERS_INIT;
+
+	spa_assert(spa_node_port_use_buffers(node, direction, port_id,
+			0, b->buffers, 1) == 0);
+	spa_assert(spa_node_port_set_io(node, direction, port_id,
+			SPA_IO_Buffers, &b->io, sizeof(b->io)) == 0);
+}
+
+/* fill all datas of an input with a value and hand it to the node */
+static void buf_push(struct buf *b, bool gap, float value, uint32_t size)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < b->buffer.n_datas; i++) {
+		for (j = 0; j < size / sizeof(float); j++)
+			b->mem[i][j] = value;
+		b->chunks[i].offset = 0;
+		b->chunks[i].size = size;
+	}
+	b->header.flags = gap ? SPA_META_HEADER_FLAG_GAP : 0;
+	b->io.status = SPA_STATUS_HAVE_DATA;
+	b->io.buffer_id = 0;
+}
+
+/* take the data of an output, return if it has the GAP flag */
+static bool buf_pull(struct buf *b)
+{
+	spa_assert(b->io.status == SPA_STATUS_HAVE_DATA);
+	spa_assert(b->io.buffer_id == 0);
+	b->io.status = SPA_STATUS_NEED_DATA;
+	return SPA_FLAG_IS_SET(b->header.flags, SPA_META_HEADER_FLAG_GAP);
+}
+
+/* check that the first n floats of all datas have a value */
+static bool buf_is(struct buf *b, float value, uint32_t n)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < b->buffer.n_datas; i++) {
+		const float *d = b->datas[i].data;
+		for (j = 0; j < n; j++)
+			if (fabsf(d[j] - value) > 1e-6f)
+				return false;
+	}
+	return true;
+}
+
+static void buf_poison(struct buf *b)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < b->buffer.n_datas; i++)
+		for (j = 0; j < N_SAMPLES; j++)
+			b->mem[i][j] = POISON;
+}
+
+static void process(struct spa_node *node)
+{
+	spa_assert(spa_node_process(node) >= 0);
+}
+
+/* deinterleave F32 stereo: silence is written once in each buffer and
+ * all zero input is found without the GAP flag */
+static void test_fmtconvert(void)
+{
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct buf in, out;
+
+	node = make_node(&handle, SPA_NAME_AUDIO_PROCESS_FORMAT, NULL);
+	set_format(node, SPA_DIRECTION_INPUT, 0, SPA_AUDIO_FORMAT_F32, 48000, 2);
+	set_format(node, SPA_DIRECTION_OUTPUT, 0, SPA_AUDIO_FORMAT_F32P, 48000, 2);
+	buf_init(&in, node, SPA_DIRECTION_INPUT, 0, 1);
+	buf_init(&out, node, SPA_DIRECTION_OUTPUT, 0, 2);
+
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+	spa_assert(buf_is(&out, 0.5f, N_SAMPLES / 2));
+
+	/* the data of a GAP is not read */
+	buf_push(&in, true, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, 0.0f, N_SAMPLES / 2));
+
+	/* the buffer is known to be silent, the zeros are not written again */
+	buf_poison(&out);
+	buf_push(&in, true, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, POISON, N_SAMPLES / 2));
+
+	/* sound in between makes the next GAP write zeros */
+	buf_push(&in, false, 0.25f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+	spa_assert(buf_is(&out, 0.25f, N_SAMPLES / 2));
+
+	buf_push(&in, true, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, 0.0f, N_SAMPLES / 2));
+
+	/* zeros without the flag */
+	buf_push(&in, false, 0.0f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, 0.0f, N_SAMPLES / 2));
+
+	free_node(handle);
+}
+
+/* the silence of unsigned formats is not zero, it is converted */
+static void test_fmtconvert_unsigned(void)
+{
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct buf in, out;
+	const uint8_t *d;
+	uint32_t i;
+
+	node = make_node(&handle, SPA_NAME_AUDIO_PROCESS_FORMAT, NULL);
+	set_format(node, SPA_DIRECTION_INPUT, 0, SPA_AUDIO_FORMAT_F32P, 48000, 1);
+	set_format(node, SPA_DIRECTION_OUTPUT, 0, SPA_AUDIO_FORMAT_U8P, 48000, 1);
+	buf_init(&in, node, SPA_DIRECTION_INPUT, 0, 1);
+	buf_init(&out, node, SPA_DIRECTION_OUTPUT, 0, 1);
+
+	buf_push(&in, true, 0.0f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(out.chunks[0].size == N_SAMPLES);
+	d = out.datas[0].data;
+	for (i = 0; i < N_SAMPLES; i++)
+		spa_assert(d[i] == 0x80);
+
+	free_node(handle);
+}
+
+static void set_mute(struct spa_node *node, bool mute)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_pod_builder_add_object(&b,
+		SPA_TYPE_OBJECT_Props, SPA_PARAM_Props,
+		SPA_PROP_mute, SPA_POD_Bool(mute));
+	spa_assert(spa_node_set_param(node, SPA_PARAM_Props, 0, param) >= 0);
+}
+
+/* downmix stereo to mono, a GAP or a muted matrix make silence */
+static void test_channelmix(void)
+{
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct buf in, out;
+
+	node = make_node(&handle, SPA_NAME_AUDIO_PROCESS_CHANNELMIX, NULL);
+	set_format(node, SPA_DIRECTION_INPUT, 0, SPA_AUDIO_FORMAT_F32P, 48000, 2);
+	set_format(node, SPA_DIRECTION_OUTPUT, 0, SPA_AUDIO_FORMAT_F32P, 48000, 1);
+	buf_init(&in, node, SPA_DIRECTION_INPUT, 0, 2);
+	buf_init(&out, node, SPA_DIRECTION_OUTPUT, 0, 1);
+
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+	spa_assert(!buf_is(&out, 0.0f, N_SAMPLES));
+
+	buf_push(&in, true, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, 0.0f, N_SAMPLES));
+
+	buf_poison(&out);
+	buf_push(&in, true, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, POISON, N_SAMPLES));
+
+	set_mute(node, true);
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, POISON, N_SAMPLES));
+
+	set_mute(node, false);
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+	spa_assert(!buf_is(&out, POISON, N_SAMPLES));
+
+	set_mute(node, true);
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, 0.0f, N_SAMPLES));
+
+	free_node(handle);
+}
+
+/* interleave two DSP ports, the output is a GAP when all inputs are */
+static void test_merger(void)
+{
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct buf in[2], out;
+	uint32_t i;
+
+	node = make_node(&handle, SPA_NAME_AUDIO_PROCESS_INTERLEAVE, NULL);
+	set_dsp(node, SPA_DIRECTION_INPUT);
+	for (i = 0; i < 2; i++)
+		set_format(node, SPA_DIRECTION_INPUT, i, SPA_AUDIO_FORMAT_F32P, 48000, 1);
+	set_format(node, SPA_DIRECTION_OUTPUT, 0, SPA_AUDIO_FORMAT_F32, 48000, 2);
+	for (i = 0; i < 2; i++)
+		buf_init(&in[i], node, SPA_DIRECTION_INPUT, i, 1);
+	buf_init(&out, node, SPA_DIRECTION_OUTPUT, 0, 1);
+
+	/* one input with sound */
+	buf_push(&in[0], true, 0.0f, N_SAMPLES / 2 * sizeof(float));
+	buf_push(&in[1], false, 0.5f, N_SAMPLES / 2 * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+	spa_assert(out.mem[0][0] == 0.0f && out.mem[0][1] == 0.5f);
+
+	buf_push(&in[0], true, 0.5f, N_SAMPLES / 2 * sizeof(float));
+	buf_push(&in[1], true, 0.5f, N_SAMPLES / 2 * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, 0.0f, N_SAMPLES));
+
+	buf_poison(&out);
+	buf_push(&in[0], true, 0.5f, N_SAMPLES / 2 * sizeof(float));
+	buf_push(&in[1], true, 0.5f, N_SAMPLES / 2 * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	spa_assert(buf_is(&out, POISON, N_SAMPLES));
+
+	free_node(handle);
+}
+
+/* deinterleave to two DSP ports, a GAP goes to all of them */
+static void test_splitter(void)
+{
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct buf in, out[2];
+	uint32_t i;
+
+	node = make_node(&handle, SPA_NAME_AUDIO_PROCESS_DEINTERLEAVE, NULL);
+	set_dsp(node, SPA_DIRECTION_OUTPUT);
+	set_format(node, SPA_DIRECTION_INPUT, 0, SPA_AUDIO_FORMAT_F32, 48000, 2);
+	for (i = 0; i < 2; i++) {
+		set_format(node, SPA_DIRECTION_OUTPUT, i, SPA_AUDIO_FORMAT_F32P, 48000, 1);
+		buf_init(&out[i], node, SPA_DIRECTION_OUTPUT, i, 1);
+	}
+	buf_init(&in, node, SPA_DIRECTION_INPUT, 0, 1);
+
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	for (i = 0; i < 2; i++) {
+		spa_assert(!buf_pull(&out[i]));
+		spa_assert(buf_is(&out[i], 0.5f, N_SAMPLES / 2));
+	}
+
+	buf_push(&in, true, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	for (i = 0; i < 2; i++) {
+		spa_assert(buf_pull(&out[i]));
+		spa_assert(buf_is(&out[i], 0.0f, N_SAMPLES / 2));
+		buf_poison(&out[i]);
+	}
+
+	buf_push(&in, true, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	for (i = 0; i < 2; i++) {
+		spa_assert(buf_pull(&out[i]));
+		spa_assert(buf_is(&out[i], POISON, N_SAMPLES / 2));
+	}
+
+	free_node(handle);
+}
+
+/* the output of the resampler is only a GAP when the input was silent
+ * for longer than the filter delay, before that the history rings out */
+static void test_resample(void)
+{
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct spa_dict_item items[1];
+	struct buf in, out;
+	uint32_t n;
+
+	/* in merge mode each input makes an output */
+	items[0] = SPA_DICT_ITEM_INIT("factory.mode", "merge");
+
+	node = make_node(&handle, SPA_NAME_AUDIO_PROCESS_RESAMPLE, &SPA_DICT_INIT_ARRAY(items));
+	set_format(node, SPA_DIRECTION_INPUT, 0, SPA_AUDIO_FORMAT_F32P, 48000, 1);
+	set_format(node, SPA_DIRECTION_OUTPUT, 0, SPA_AUDIO_FORMAT_F32P, 44100, 1);
+	buf_init(&in, node, SPA_DIRECTION_INPUT, 0, 1);
+	buf_init(&out, node, SPA_DIRECTION_OUTPUT, 0, 1);
+
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+
+	buf_push(&in, true, 0.0f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+	spa_assert(!buf_is(&out, 0.0f, 1));
+
+	buf_push(&in, true, 0.0f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(buf_pull(&out));
+	n = out.chunks[0].size / sizeof(float);
+	spa_assert(n > 0);
+	spa_assert(buf_is(&out, 0.0f, n));
+
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+
+	free_node(handle);
+}
+
+/* S16 stereo at 48000 to F32 mono at 44100, the channelmix and resample
+ * run in one step */
+static void test_fused(void)
+{
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct spa_dict_item items[2];
+	struct buf in, out;
+	uint32_t i, n;
+	bool gap[4];
+
+	items[0] = SPA_DICT_ITEM_INIT("factory.mode", "convert");
+	items[1] = SPA_DICT_ITEM_INIT("audioconvert.fused", "true");
+
+	node = make_node(&handle, SPA_NAME_AUDIO_CONVERT, &SPA_DICT_INIT_ARRAY(items));
+	set_format(node, SPA_DIRECTION_INPUT, 0, SPA_AUDIO_FORMAT_S16, 48000, 2);
+	set_format(node, SPA_DIRECTION_OUTPUT, 0, SPA_AUDIO_FORMAT_F32, 44100, 1);
+	buf_init(&in, node, SPA_DIRECTION_INPUT, 0, 1);
+	buf_init(&out, node, SPA_DIRECTION_OUTPUT, 0, 1);
+
+	spa_assert(spa_node_send_command(node,
+			&SPA_NODE_COMMAND_INIT(SPA_NODE_COMMAND_Start)) == 0);
+
+	/* the bytes of 0.5f are sound in S16 */
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+
+	/* silence, marked or not, becomes a GAP once the history is silent */
+	for (i = 0; i < SPA_N_ELEMENTS(gap); i++) {
+		buf_push(&in, i < 2, i < 2 ? 0.5f : 0.0f, N_SAMPLES * sizeof(float));
+		process(node);
+		gap[i] = buf_pull(&out);
+		n = out.chunks[0].size / sizeof(float);
+		spa_assert(n > 0);
+		if (gap[i])
+			spa_assert(buf_is(&out, 0.0f, n));
+	}
+	spa_assert(!gap[0]);
+	spa_assert(gap[1] && gap[2] && gap[3]);
+
+	buf_push(&in, false, 0.5f, N_SAMPLES * sizeof(float));
+	process(node);
+	spa_assert(!buf_pull(&out));
+
+	free_node(handle);
+}
+
+int main(int argc, char *argv[])
+{
+	logger.log.level = SPA_LOG_LEVEL_WARN;
+
+	test_fmtconvert();
+	test_fmtconvert_unsigned();
+	test_channelmix();
+	test_merger();
+	test_splitter();
+	test_resample();
+	test_fused();
+
+	return 0;
+}
@@ -28,6 +28,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 
 #include <spa/support/log-impl.h>
 #include <spa/debug/mem.h>
@@ -70,20 +71,24 @@ static void test_native(void)
 	spa_zero(r);
 	r.log = &logger.log;
 	r.channels = 1;
+	r.quality = RESAMPLE_DEFAULT_QUALITY;
 	r.i_rate = 44100;
 	r.o_rate = 44100;
 	impl_native_init(&r);
 
 	feed_1(&r);
+	resample_free(&r);
 
 	spa_zero(r);
 	r.log = &logger.log;
 	r.channels = 1;
+	r.quality = RESAMPLE_DEFAULT_QUALITY;
 	r.i_rate = 44100;
 	r.o_rate = 48000;
 	impl_native_init(&r);
 
 	feed_1(&r);
+	resample_free(&r);
 }
 
 static void pull_blocks(struct resample *r, uint32_t size)
@@ -121,29 +126,184 @@ static void test_in_len(void)
 	spa_zero(r);
 	r.log = &logger.log;
 	r.channels = 1;
+	r.quality = RESAMPLE_DEFAULT_QUALITY;
 	r.i_rate = 32000;
 	r.o_rate = 48000;
 	impl_native_init(&r);
 
 	pull_blocks(&r, 1024);
+	resample_free(&r);
 
 	spa_zero(r);
 	r.log = &logger.log;
 	r.channels = 1;
+	r.quality = RESAMPLE_DEFAULT_QUALITY;
 	r.i_rate = 44100;
 	r.o_rate = 48000;
 	impl_native_init(&r);
 
 	pull_blocks(&r, 1024);
+	resample_free(&r);
 
 	spa_zero(r);
 	r.log = &logger.log;
 	r.channels = 1;
+	r.quality = RESAMPLE_DEFAULT_QUALITY;
 	r.i_rate = 48000;
 	r.o_rate = 44100;
 	impl_native_init(&r);
 
 	pull_blocks(&r, 1024);
+	resample_free(&r);
+}
+
+static void test_filter_cache(void)
+{
+	struct resample r1, r2, r3;
+	struct native_data *d1, *d2, *d3;
+	struct native_filter_stats stats, start;
+
+	native_filter_get_stats(&start);
+
+	spa_zero(r1);
+	r1.log = &logger.log;
+	r1.channels = 2;
+	r1.quality = RESAMPLE_DEFAULT_QUALITY;
+	r1.i_rate = 44100;
+	r1.o_rate = 48000;
+	spa_assert(impl_native_init(&r1) == 0);
+
+	r2 = r1;
+	r2.data = NULL;
+	r2.channels = 1;
+	spa_assert(impl_native_init(&r2) == 0);
+
+	r3 = r1;
+	r3.data = NULL;
+	r3.quality = impl_native_parse_quality(&logger.log, "low-latency");
+	spa_assert(impl_native_init(&r3) == 0);
+
+	d1 = r1.data;
+	d2 = r2.data;
+	d3 = r3.data;
+	/* same quality and ratio share the filter */
+	spa_assert(d1->filter == d2->filter);
+	spa_assert(d1->cached->ref == 2);
+	spa_assert(d1->filter != d3->filter);
+	spa_assert(d3->n_taps < d1->n_taps);
+	spa_assert(resample_delay(&r3) == impl_native_taps(r3.quality, 147, 160));
+
+	native_filter_get_stats(&stats);
+	spa_assert(stats.hits == start.hits + 1);
+	spa_assert(stats.misses == start.misses + 2);
+	spa_assert(stats.n_filters == 2);
+
+	resample_free(&r1);
+	spa_assert(d2->cached->ref == 1);
+	resample_free(&r2);
+	resample_free(&r3);
+
+	native_filter_get_stats(&stats);
+	spa_assert(stats.n_filters == 0);
+	spa_assert(stats.size == 0);
+}
+
+static void test_parse_quality(void)
+{
+	struct spa_log *log = &logger.log;
+
+	spa_assert(impl_native_parse_quality(log, "voice") == 1);
+	spa_assert(impl_native_parse_quality(log, "music") == 8);
+	spa_assert(impl_native_parse_quality(log, "0") == 0);
+	spa_assert(impl_native_parse_quality(log, "10") == 10);
+	spa_assert(impl_native_parse_quality(log, "9") == 9);
+
+	/* anything else falls back to the default quality */
+	spa_assert(impl_native_parse_quality(log, "") == RESAMPLE_DEFAULT_QUALITY);
+	spa_assert(impl_native_parse_quality(log, "best") == RESAMPLE_DEFAULT_QUALITY);
+	spa_assert(impl_native_parse_quality(log, "3x") == RESAMPLE_DEFAULT_QUALITY);
+	spa_assert(impl_native_parse_quality(log, "-1") == RESAMPLE_DEFAULT_QUALITY);
+	spa_assert(impl_native_parse_quality(log, "11") == RESAMPLE_DEFAULT_QUALITY);
+}
+
+#define N_COMPARE	4096
+
+/* the optimized inner products sum in a different order than the C version,
+ * the output must stay within 1e-5 of it */
+static void compare_optimized(const char *name, uint32_t cpu_flags,
+		uint32_t i_rate, uint32_t o_rate, double rate)
+{
+	struct resample r1, r2;
+	static float in[N_COMPARE], out1[N_COMPARE * 2], out2[N_COMPARE * 2];
+	const void *src[1];
+	void *dst[1];
+	uint32_t i, in_len, out_len1, out_len2;
+
+	fprintf(stderr, "compare %s %d->%d rate:%f\n", name, i_rate, o_rate, rate);
+
+	for (i = 0; i < N_COMPARE; i++)
+		in[i] = sinf(i * 0.05f) * 0.8f + ((float)drand48() - 0.5f) * 0.2f;
+
+	spa_zero(r1);
+	r1.log = &logger.log;
+	r1.channels = 1;
+	r1.quality = RESAMPLE_DEFAULT_QUALITY;
+	r1.i_rate = i_rate;
+	r1.o_rate = o_rate;
+	spa_assert(impl_native_init(&r1) == 0);
+	resample_update_rate(&r1, rate);
+
+	r2 = r1;
+	r2.data = NULL;
+	r2.cpu_flags = cpu_flags;
+	spa_assert(impl_native_init(&r2) == 0);
+	resample_update_rate(&r2, rate);
+
+	src[0] = in;
+	in_len = N_COMPARE;
+	out_len1 = N_COMPARE * 2;
+	dst[0] = out1;
+	resample_process(&r1, src, &in_len, dst, &out_len1);
+
+	in_len = N_COMPARE;
+	out_len2 = N_COMPARE * 2;
+	dst[0] = out2;
+	resample_process(&r2, src, &in_len, dst, &out_len2);
+
+	spa_assert(out_len1 == out_len2);
+	spa_assert(out_len1 > 0);
+	for (i = 0; i < out_len1; i++)
+		spa_assert(fabsf(out1[i] - out2[i]) < 1e-5f);
+
+	resample_free(&r1);
+	resample_free(&r2);
+}
+
+static void test_optimized(const char *name, uint32_t cpu_flags)
+{
+	compare_optimized(name, cpu_flags, 44100, 48000, 1.0);
+	compare_optimized(name, cpu_flags, 48000, 44100, 1.0);
+	compare_optimized(name, cpu_flags, 44100, 48000, 1.01);
+	compare_optimized(name, cpu_flags, 48000, 48000, 0.99);
+}
+
+static void test_simd(void)
+{
+#if defined (HAVE_SSE)
+	if (__builtin_cpu_supports("sse"))
+		test_optimized("sse", SPA_CPU_FLAG_SSE);
+#endif
+#if defined (HAVE_SSSE3)
+	if (__builtin_cpu_supports("ssse3"))
+		test_optimized("ssse3", SPA_CPU_FLAG_SSSE3 | SPA_CPU_FLAG_SLOW_UNALIGNED);
+#endif
+#if defined (HAVE_AVX) && defined(HAVE_FMA)
+	if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("fma"))
+		test_optimized("avx", SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3);
+#endif
+#if defined (HAVE_NEON)
+	test_optimized("neon", SPA_CPU_FLAG_NEON);
+#endif
 }
 
 int main(int argc, char *argv[])
@@ -152,6 +312,11 @@ int main(int argc, char *argv[])
 
 	test_native();
 	test_in_len();
+	test_filter_cache();
+	test_parse_quality();
+
+	logger.log.level = SPA_LOG_LEVEL_WARN;
+	test_simd();
 
 	return 0;
 }
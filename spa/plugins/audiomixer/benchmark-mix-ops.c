@@ -0,0 +1,217 @@
+/* Spa
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/support/cpu.h>
+
+#include "mix-ops.h"
+
+typedef void (*mix_func_t) (struct mix_ops *ops, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src[], uint32_t n_src, uint32_t n_samples);
+typedef void (*mix_gain_func_t) (struct mix_ops *ops, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src[], const struct mix_gain gain[],
+		uint32_t n_src, uint32_t n_samples);
+
+struct stats {
+	uint32_t n_samples;
+	uint32_t n_src;
+	uint64_t perf;
+	const char *name;
+	const char *impl;
+};
+
+#define MAX_SAMPLES	4096
+#define MAX_SOURCES	32
+
+#define MAX_COUNT 1000
+
+/* one extra sample so that the inputs can be moved out of alignment */
+static float samp_in[MAX_SOURCES][MAX_SAMPLES + 1] __attribute__ ((aligned (32)));
+static float samp_out[MAX_SAMPLES + 1] __attribute__ ((aligned (32)));
+static struct mix_gain gains[MAX_SOURCES];
+static struct mix_gain ramps[MAX_SOURCES];
+
+static const int sample_sizes[] = { 64, 256, 1024, 4096 };
+static const int source_counts[] = { 1, 2, 4, 8, 16, 32 };
+
+#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(source_counts) * 16
+
+static uint32_t n_results = 0;
+static struct stats results[MAX_RESULTS];
+
+static uint32_t cpu_flags;
+
+static void run_test1(const char *name, const char *impl, bool aligned,
+		mix_func_t func, mix_gain_func_t gain_func, const struct mix_gain *gain,
+		int n_src, int n_samples)
+{
+	int i, j;
+	const void *ip[n_src];
+	void *op;
+	struct timespec ts;
+	uint64_t count, t1, t2;
+	struct mix_ops mix;
+
+	spa_zero(mix);
+	for (j = 0; j < n_src; j++)
+		ip[j] = &samp_in[j][aligned ? 0 : 1];
+	op = &samp_out[aligned ? 0 : 1];
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		if (gain_func)
+			gain_func(&mix, op, ip, gain, n_src, n_samples);
+		else
+			func(&mix, op, ip, n_src, n_samples);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.n_samples = n_samples,
+		.n_src = n_src,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+		.name = name,
+		.impl = impl
+	};
+}
+
+static void run_test(const char *name, const char *impl, bool aligned,
+		mix_func_t func, mix_gain_func_t gain_func, const struct mix_gain *gain)
+{
+	size_t i, j;
+
+	for (i = 0; i < SPA_N_ELEMENTS(sample_sizes); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(source_counts); j++) {
+			run_test1(name, impl, aligned, func, gain_func, gain, source_counts[j],
+				sample_sizes[i]);
+		}
+	}
+}
+
+static void test_f32(void)
+{
+	run_test("test_f32", "c", true, mix_f32_c, NULL, NULL);
+	run_test("test_f32_unaligned", "c", false, mix_f32_c, NULL, NULL);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE) {
+		run_test("test_f32", "sse", true, mix_f32_sse, NULL, NULL);
+		run_test("test_f32_unaligned", "sse", false, mix_f32_sse, NULL, NULL);
+	}
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX) {
+		run_test("test_f32", "avx", true, mix_f32_avx, NULL, NULL);
+		run_test("test_f32_unaligned", "avx", false, mix_f32_avx, NULL, NULL);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32", "neon", true, mix_f32_neon, NULL, NULL);
+		run_test("test_f32_unaligned", "neon", false, mix_f32_neon, NULL, NULL);
+	}
+#endif
+}
+
+static void test_f32_gain(void)
+{
+	run_test("test_f32_gain", "c", true, NULL, mix_f32_gain_c, gains);
+	run_test("test_f32_gain_unaligned", "c", false, NULL, mix_f32_gain_c, gains);
+	run_test("test_f32_ramp", "c", true, NULL, mix_f32_gain_c, ramps);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE) {
+		run_test("test_f32_gain", "sse", true, NULL, mix_f32_gain_sse, gains);
+		run_test("test_f32_gain_unaligned", "sse", false, NULL, mix_f32_gain_sse, gains);
+		run_test("test_f32_ramp", "sse", true, NULL, mix_f32_gain_sse, ramps);
+	}
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX) {
+		run_test("test_f32_gain", "avx", true, NULL, mix_f32_gain_avx, gains);
+		run_test("test_f32_gain_unaligned", "avx", false, NULL, mix_f32_gain_avx, gains);
+		run_test("test_f32_ramp", "avx", true, NULL, mix_f32_gain_avx, ramps);
+	}
+#endif
+}
+
+static int compare_func(const void *_a, const void *_b)
+{
+	const struct stats *a = _a, *b = _b;
+	int diff;
+	if ((diff = strcmp(a->name, b->name)) != 0) return diff;
+	if ((diff = a->n_samples - b->n_samples) != 0) return diff;
+	if ((diff = a->n_src - b->n_src) != 0) return diff;
+	if ((diff = b->perf - a->perf) != 0) return diff;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i, j;
+
+#if defined (HAVE_SSE)
+	if (__builtin_cpu_supports("sse"))
+		cpu_flags |= SPA_CPU_FLAG_SSE;
+#endif
+#if defined (HAVE_AVX)
+	if (__builtin_cpu_supports("avx"))
+		cpu_flags |= SPA_CPU_FLAG_AVX;
+#endif
+#if defined (HAVE_NEON)
+	cpu_flags |= SPA_CPU_FLAG_NEON;
+#endif
+
+	for (i = 0; i < MAX_SOURCES; i++)
+		for (j = 0; j <= MAX_SAMPLES; j++)
+			samp_in[i][j] = (float)drand48() - 0.5f;
+	for (i = 0; i < MAX_SOURCES; i++) {
+		gains[i].start = gains[i].end = (float)drand48();
+		ramps[i].start = (float)drand48();
+		ramps[i].end = (float)drand48();
+	}
+
+	test_f32();
+	test_f32_gain();
+
+	qsort(results, n_results, sizeof(struct stats), compare_func);
+
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		fprintf(stderr, "%-12."PRIu64" \t%-32.32s %s \t samples %d, sources %d\n",
+				s->perf, s->name, s->impl, s->n_samples, s->n_src);
+	}
+	return 0;
+}
@@ -67,3 +67,55 @@ mix_f64_c(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRIC
 			d[n] += s[n];
 	}
 }
+
+void
+mix_f32_gain_c(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		const struct mix_gain gain[], uint32_t n_src, uint32_t n_samples)
+{
+	uint32_t i, n;
+	float *d = dst;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(float));
+		return;
+	}
+	for (i = 0; i < n_src; i++) {
+		const float *s = src[i];
+		float g = gain[i].start;
+		float step = (gain[i].end - g) / n_samples;
+
+		if (i == 0) {
+			for (n = 0; n < n_samples; n++)
+				d[n] = s[n] * (g + step * n);
+		} else {
+			for (n = 0; n < n_samples; n++)
+				d[n] += s[n] * (g + step * n);
+		}
+	}
+}
+
+void
+mix_f64_gain_c(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		const struct mix_gain gain[], uint32_t n_src, uint32_t n_samples)
+{
+	uint32_t i, n;
+	double *d = dst;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(double));
+		return;
+	}
+	for (i = 0; i < n_src; i++) {
+		const double *s = src[i];
+		double g = gain[i].start;
+		double step = (gain[i].end - g) / n_samples;
+
+		if (i == 0) {
+			for (n = 0; n < n_samples; n++)
+				d[n] = s[n] * (g + step * n);
+		} else {
+			for (n = 0; n < n_samples; n++)
+				d[n] += s[n] * (g + step * n);
+		}
+	}
+}
@@ -32,58 +32,199 @@
 
 #include <xmmintrin.h>
 
-static inline void mix_2(float * dst, const float * SPA_RESTRICT src, uint32_t n_samples)
+/* the number of inputs that are summed in registers in one pass over dst */
+#define MAX_PASS	8u
+
+static inline __m128 load_ps(const float *p, bool aligned)
 {
-	uint32_t n, unrolled;
-	__m128 in1[4], in2[4];
+	return aligned ? _mm_load_ps(p) : _mm_loadu_ps(p);
+}
 
-	if (SPA_IS_ALIGNED(src, 16) &&
-	    SPA_IS_ALIGNED(dst, 16))
-		unrolled = n_samples & ~15;
+static inline void store_ps(float *p, __m128 v, bool aligned)
+{
+	if (aligned)
+		_mm_store_ps(p, v);
 	else
-		unrolled = 0;
+		_mm_storeu_ps(p, v);
+}
+
+/* dst = sum of n_src inputs, dst can be one of the inputs */
+static inline void mix_n(float * dst, const float *src[],
+		uint32_t n_src, uint32_t n_samples, bool aligned)
+{
+	uint32_t n, i, unrolled;
+	__m128 in[4];
+
+	unrolled = n_samples & ~15;
 
 	for (n = 0; n < unrolled; n += 16) {
-		in1[0] = _mm_load_ps(&dst[n+ 0]);
-		in1[1] = _mm_load_ps(&dst[n+ 4]);
-		in1[2] = _mm_load_ps(&dst[n+ 8]);
-		in1[3] = _mm_load_ps(&dst[n+12]);
-
-		in2[0] = _mm_load_ps(&src[n+ 0]);
-		in2[1] = _mm_load_ps(&src[n+ 4]);
-		in2[2] = _mm_load_ps(&src[n+ 8]);
-		in2[3] = _mm_load_ps(&src[n+12]);
-
-		in1[0] = _mm_add_ps(in1[0], in2[0]);
-		in1[1] = _mm_add_ps(in1[1], in2[1]);
-		in1[2] = _mm_add_ps(in1[2], in2[2]);
-		in1[3] = _mm_add_ps(in1[3], in2[3]);
-
-		_mm_store_ps(&dst[n+ 0], in1[0]);
-		_mm_store_ps(&dst[n+ 4], in1[1]);
-		_mm_store_ps(&dst[n+ 8], in1[2]);
-		_mm_store_ps(&dst[n+12], in1[3]);
+		in[0] = load_ps(&src[0][n+ 0], aligned);
+		in[1] = load_ps(&src[0][n+ 4], aligned);
+		in[2] = load_ps(&src[0][n+ 8], aligned);
+		in[3] = load_ps(&src[0][n+12], aligned);
+
+		for (i = 1; i < n_src; i++) {
+			in[0] = _mm_add_ps(in[0], load_ps(&src[i][n+ 0], aligned));
+			in[1] = _mm_add_ps(in[1], load_ps(&src[i][n+ 4], aligned));
+			in[2] = _mm_add_ps(in[2], load_ps(&src[i][n+ 8], aligned));
+			in[3] = _mm_add_ps(in[3], load_ps(&src[i][n+12], aligned));
+		}
+		store_ps(&dst[n+ 0], in[0], aligned);
+		store_ps(&dst[n+ 4], in[1], aligned);
+		store_ps(&dst[n+ 8], in[2], aligned);
+		store_ps(&dst[n+12], in[3], aligned);
+	}
+	for (; n + 4 <= n_samples; n += 4) {
+		in[0] = load_ps(&src[0][n], aligned);
+		for (i = 1; i < n_src; i++)
+			in[0] = _mm_add_ps(in[0], load_ps(&src[i][n], aligned));
+		store_ps(&dst[n], in[0], aligned);
 	}
 	for (; n < n_samples; n++) {
-		in1[0] = _mm_load_ss(&dst[n]),
-		in2[0] = _mm_load_ss(&src[n]),
-		in1[0] = _mm_add_ss(in1[0], in2[0]);
-		_mm_store_ss(&dst[n], in1[0]);
+		in[0] = _mm_load_ss(&src[0][n]);
+		for (i = 1; i < n_src; i++)
+			in[0] = _mm_add_ss(in[0], _mm_load_ss(&src[i][n]));
+		_mm_store_ss(&dst[n], in[0]);
 	}
 }
 
+static void mix_pass(float * dst, const float *src[],
+		uint32_t n_src, uint32_t n_samples, bool aligned)
+{
+	if (aligned)
+		mix_n(dst, src, n_src, n_samples, true);
+	else
+		mix_n(dst, src, n_src, n_samples, false);
+}
+
+/* dst = sum of n_src inputs multiplied by their gain at each sample,
+ * the gain of input i at sample n is start[i] + step[i] * n */
+static inline void mix_gain_n(float * dst, const float *src[],
+		const float start[], const float step[],
+		uint32_t n_src, uint32_t n_samples, bool aligned)
+{
+	uint32_t n, i, j, unrolled;
+	__m128 g0[MAX_PASS], gs[MAX_PASS], pos[4], in[4], g;
+	const __m128 idx = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+	for (i = 0; i < n_src; i++) {
+		g0[i] = _mm_set1_ps(start[i]);
+		gs[i] = _mm_set1_ps(step[i]);
+	}
+	unrolled = n_samples & ~15;
+
+	for (n = 0; n < unrolled; n += 16) {
+		for (j = 0; j < 4; j++) {
+			pos[j] = _mm_add_ps(_mm_set1_ps((float)(n + j * 4)), idx);
+			in[j] = _mm_setzero_ps();
+		}
+		for (i = 0; i < n_src; i++) {
+			/* most inputs are not ramping */
+			if (step[i] == 0.0f) {
+				for (j = 0; j < 4; j++)
+					in[j] = _mm_add_ps(in[j], _mm_mul_ps(g0[i],
+							load_ps(&src[i][n + j * 4], aligned)));
+			} else {
+				for (j = 0; j < 4; j++) {
+					g = _mm_add_ps(g0[i], _mm_mul_ps(gs[i], pos[j]));
+					in[j] = _mm_add_ps(in[j], _mm_mul_ps(g,
+							load_ps(&src[i][n + j * 4], aligned)));
+				}
+			}
+		}
+		for (j = 0; j < 4; j++)
+			store_ps(&dst[n + j * 4], in[j], aligned);
+	}
+	for (; n < n_samples; n++) {
+		float sum = 0.0f;
+		for (i = 0; i < n_src; i++)
+			sum += src[i][n] * (start[i] + step[i] * n);
+		dst[n] = sum;
+	}
+}
+
+static void mix_gain_pass(float * dst, const float *src[],
+		const float start[], const float step[],
+		uint32_t n_src, uint32_t n_samples, bool aligned)
+{
+	if (aligned)
+		mix_gain_n(dst, src, start, step, n_src, n_samples, true);
+	else
+		mix_gain_n(dst, src, start, step, n_src, n_samples, false);
+}
+
 void
 mix_f32_sse(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
 		uint32_t n_src, uint32_t n_samples)
 {
-	uint32_t i;
+	const float **s = (const float **)src;
+	const float *in[MAX_PASS];
+	uint32_t i, n;
+	bool aligned;
 
-	if (n_src == 0)
+	if (n_src == 0) {
 		memset(dst, 0, n_samples * sizeof(float));
-	else if (dst != src[0])
-		memcpy(dst, src[0], n_samples * sizeof(float));
+		return;
+	}
+	if (n_src == 1) {
+		if (dst != src[0])
+			memcpy(dst, src[0], n_samples * sizeof(float));
+		return;
+	}
+
+	aligned = SPA_IS_ALIGNED(dst, 16);
+	for (i = 0; i < n_src; i++)
+		aligned &= SPA_IS_ALIGNED(src[i], 16);
+
+	/* the first pass writes dst, the next ones add more inputs to it */
+	n = SPA_MIN(n_src, MAX_PASS);
+	mix_pass(dst, s, n, n_samples, aligned);
+
+	in[0] = dst;
+	for (i = n; i < n_src; i += n) {
+		n = SPA_MIN(n_src - i, MAX_PASS - 1);
+		memcpy(&in[1], &s[i], n * sizeof(float *));
+		mix_pass(dst, in, n + 1, n_samples, aligned);
+	}
+}
+
+void
+mix_f32_gain_sse(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		const struct mix_gain gain[], uint32_t n_src, uint32_t n_samples)
+{
+	const float **s = (const float **)src;
+	const float *in[MAX_PASS];
+	float start[MAX_PASS], step[MAX_PASS];
+	uint32_t i, j, n;
+	bool aligned;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(float));
+		return;
+	}
+
+	aligned = SPA_IS_ALIGNED(dst, 16);
+	for (i = 0; i < n_src; i++)
+		aligned &= SPA_IS_ALIGNED(src[i], 16);
+
+	/* the first pass writes dst, the next ones add more inputs to it */
+	n = SPA_MIN(n_src, MAX_PASS);
+	for (j = 0; j < n; j++) {
+		start[j] = gain[j].start;
+		step[j] = (gain[j].end - gain[j].start) / n_samples;
+	}
+	mix_gain_pass(dst, s, start, step, n, n_samples, aligned);
 
-	for (i = 1; i < n_src; i++) {
-		mix_2(dst, src[i], n_samples);
+	in[0] = dst;
+	start[0] = 1.0f;
+	step[0] = 0.0f;
+	for (i = n; i < n_src; i += n) {
+		n = SPA_MIN(n_src - i, MAX_PASS - 1);
+		for (j = 0; j < n; j++) {
+			in[j + 1] = s[i + j];
+			start[j + 1] = gain[i + j].start;
+			step[j + 1] = (gain[i + j].end - gain[i + j].start) / n_samples;
+		}
+		mix_gain_pass(dst, in, start, step, n + 1, n_samples, aligned);
 	}
 }
@@ -51,8 +51,8 @@
 #define PORT_DEFAULT_MUTE	false
 
 struct port_props {
-	double volume;
-	int32_t mute;
+	float volume;
+	bool mute;
 };
 
 static void port_props_reset(struct port_props *props)
@@ -79,6 +79,7 @@ struct port {
 	uint32_t id;
 
 	struct port_props props;
+	float gain;			/**< gain applied at the end of the last cycle */
 
 	struct spa_io_buffers *io;
 
@@ -88,6 +89,7 @@ struct port {
 
 	unsigned int valid:1;
 	unsigned int have_format:1;
+	unsigned int have_gain:1;	/**< gain is set by a processed cycle */
 
 	struct buffer buffers[MAX_BUFFERS];
 	uint32_t n_buffers;
@@ -123,6 +125,7 @@ struct impl {
 
 	unsigned int have_format:1;
 	unsigned int started:1;
+	unsigned int empty_silent:1;	/* empty is known to be all zero */
 
 	float empty[MAX_SAMPLES + MAX_ALIGN];
 };
@@ -241,6 +244,7 @@ static int impl_node_add_port(void *object, enum spa_direction direction, uint32
 	port->id = port_id;
 
 	port_props_reset(&port->props);
+	port->have_gain = false;
 
 	spa_list_init(&port->queue);
 	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
@@ -255,8 +259,9 @@ static int impl_node_add_port(void *object, enum spa_direction direction, uint32
 	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
 	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->params[5] = SPA_PARAM_INFO(SPA_PARAM_Props, SPA_PARAM_INFO_READWRITE);
 	port->info.params = port->params;
-	port->info.n_params = 5;
+	port->info.n_params = 6;
 
 	this->port_count++;
 	if (this->last_port <= port_id)
@@ -419,6 +424,22 @@ next:
 			return 0;
 		}
 		break;
+
+	case SPA_PARAM_Props:
+		if (direction != SPA_DIRECTION_INPUT)
+			return -ENOENT;
+
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_Props, id,
+				SPA_PROP_volume, SPA_POD_Float(port->props.volume),
+				SPA_PROP_mute,   SPA_POD_Bool(port->props.mute));
+			break;
+		default:
+			return 0;
+		}
+		break;
 	default:
 		return -ENOENT;
 	}
@@ -541,6 +562,55 @@ static int port_set_format(void *object,
 	return 0;
 }
 
+/* the new volume is picked up by the next cycle, which ramps to it */
+static int port_set_props(void *object,
+			  enum spa_direction direction,
+			  uint32_t port_id,
+			  const struct spa_pod *param)
+{
+	struct impl *this = object;
+	struct port *port;
+	struct spa_pod_prop *prop;
+	struct spa_pod_object *obj = (struct spa_pod_object *) param;
+	struct port_props *p;
+	int changed = 0;
+
+	if (direction != SPA_DIRECTION_INPUT)
+		return -ENOENT;
+	if (param != NULL && !spa_pod_is_object_type(param, SPA_TYPE_OBJECT_Props))
+		return -EINVAL;
+
+	port = GET_IN_PORT(this, port_id);
+	p = &port->props;
+
+	if (param == NULL) {
+		port_props_reset(p);
+		changed++;
+	} else {
+		SPA_POD_OBJECT_FOREACH(obj, prop) {
+			switch (prop->key) {
+			case SPA_PROP_volume:
+				if (spa_pod_get_float(&prop->value, &p->volume) == 0)
+					changed++;
+				break;
+			case SPA_PROP_mute:
+				if (spa_pod_get_bool(&prop->value, &p->mute) == 0)
+					changed++;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	if (changed) {
+		spa_log_debug(this->log, NAME " %p: port %d volume %f mute %d",
+				this, port_id, p->volume, p->mute);
+		port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+		port->params[5].flags ^= SPA_PARAM_INFO_SERIAL;
+		emit_port_info(this, port, false);
+	}
+	return 0;
+}
 
 static int
 impl_node_port_set_param(void *object,
@@ -553,11 +623,14 @@ impl_node_port_set_param(void *object,
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
 
-	if (id == SPA_PARAM_Format) {
+	switch (id) {
+	case SPA_PARAM_Format:
 		return port_set_format(this, direction, port_id, flags, param);
-	}
-	else
+	case SPA_PARAM_Props:
+		return port_set_props(this, direction, port_id, param);
+	default:
 		return -ENOENT;
+	}
 }
 
 static int
@@ -593,6 +666,7 @@ impl_node_port_use_buffers(void *object,
 		b->flags = 0;
 		b->id = i;
 		b->h = spa_buffer_find_meta_data(buffers[i], SPA_META_Header, sizeof(*b->h));
+		b->buf = *buffers[i];
 
 		if (d[0].data == NULL) {
 			spa_log_error(this->log, NAME " %p: invalid memory on buffer %d", this, i);
@@ -663,6 +737,8 @@ static int impl_node_process(void *object)
         struct buffer **buffers;
         struct buffer *outb;
 	const void **datas;
+	struct mix_gain *gains;
+	bool unity = true;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 
@@ -684,6 +760,7 @@ static int impl_node_process(void *object)
 
         buffers = alloca(MAX_PORTS * sizeof(struct buffer *));
         datas = alloca(MAX_PORTS * sizeof(void *));
+        gains = alloca(MAX_PORTS * sizeof(struct mix_gain));
         n_buffers = 0;
 
 	maxsize = MAX_SAMPLES * sizeof(float);
@@ -692,6 +769,7 @@ static int impl_node_process(void *object)
 		struct port *inport = GET_IN_PORT(this, i);
 		struct spa_io_buffers *inio = NULL;
 		struct buffer *inb;
+		struct mix_gain *gain;
 
 		if (!inport->valid ||
 		    (inio = inport->io) == NULL ||
@@ -712,9 +790,26 @@ static int impl_node_process(void *object)
 		spa_log_trace_fp(this->log, NAME " %p: mix input %d %p->%p %d %d %d", this,
 				i, inio, outio, inio->status, inio->buffer_id, maxsize);
 
+		inio->status = SPA_STATUS_NEED_DATA;
+
+		/* ramp from the gain of the previous cycle to the current volume,
+		 * the first cycle of a port starts at its volume */
+		gain = &gains[n_buffers];
+		gain->end = inport->props.mute ? 0.0f : inport->props.volume;
+		gain->start = inport->have_gain ? inport->gain : gain->end;
+		inport->gain = gain->end;
+		inport->have_gain = true;
+
+		/* muted and silent inputs are not mixed */
+		if (gain->start == 0.0f && gain->end == 0.0f)
+			continue;
+		if (inb->h && SPA_FLAG_IS_SET(inb->h->flags, SPA_META_HEADER_FLAG_GAP))
+			continue;
+		if (gain->start != 1.0f || gain->end != 1.0f)
+			unity = false;
+
 		datas[n_buffers] = inb->buffer->datas[0].data;
 		buffers[n_buffers++] = inb;
-		inio->status = SPA_STATUS_NEED_DATA;
 	}
 
 	outb = dequeue_buffer(this, outport);
@@ -725,19 +820,42 @@ static int impl_node_process(void *object)
 
 	n_samples = maxsize / sizeof(float);
 
-	if (n_buffers == 1) {
+	if (n_buffers == 1 && unity) {
 		*outb->buffer = *buffers[0]->buffer;
 	}
 	else {
+		void *data = SPA_PTR_ALIGN(this->empty, MAX_ALIGN, void);
+
+		outb->buffer->n_metas = outb->buf.n_metas;
+		outb->buffer->metas = outb->buf.metas;
 		outb->buffer->n_datas = 1;
 		outb->buffer->datas = outb->datas;
-		outb->datas[0].data = SPA_PTR_ALIGN(this->empty, MAX_ALIGN, void);
+		outb->datas[0].data = data;
 		outb->datas[0].chunk = outb->chunk;
 		outb->datas[0].chunk->offset = 0;
 		outb->datas[0].chunk->size = n_samples * sizeof(float);
 		outb->datas[0].chunk->stride = sizeof(float);
 
-		mix_ops_process(&this->ops, outb->datas[0].data, datas, n_buffers, n_samples);
+		if (n_buffers == 0) {
+			if (!this->empty_silent) {
+				memset(data, 0, MAX_SAMPLES * sizeof(float));
+				this->empty_silent = true;
+			}
+		} else {
+			if (unity)
+				mix_ops_process(&this->ops, data,
+						datas, n_buffers, n_samples);
+			else
+				mix_ops_process_gain(&this->ops, data,
+						datas, gains, n_buffers, n_samples);
+			this->empty_silent = false;
+		}
+		if (outb->h) {
+			if (n_buffers == 0)
+				SPA_FLAG_SET(outb->h->flags, SPA_META_HEADER_FLAG_GAP);
+			else
+				SPA_FLAG_CLEAR(outb->h->flags, SPA_META_HEADER_FLAG_GAP);
+		}
 	}
 
 	outio->buffer_id = outb->id;
@@ -323,6 +323,7 @@ static int make_buffer(struct impl *this)
 	struct spa_data *d;
 	uint32_t filled, avail;
 	uint32_t index, offset, l0, l1;
+	bool gap;
 
 	read_timer(this);
 
@@ -356,9 +357,17 @@ static int make_buffer(struct impl *this)
 	l0 = SPA_MIN(n_bytes, maxsize - offset) / port->bpf;
 	l1 = n_samples - l0;
 
-	port->render_func(this, SPA_MEMBER(data, offset, void), l0);
-	if (l1 > 0)
-		port->render_func(this, data, l1);
+	/* all formats are signed, zero is silence */
+	gap = this->props.volume == 0.0f;
+	if (gap) {
+		memset(SPA_MEMBER(data, offset, void), 0, l0 * port->bpf);
+		if (l1 > 0)
+			memset(data, 0, l1 * port->bpf);
+	} else {
+		port->render_func(this, SPA_MEMBER(data, offset, void), l0);
+		if (l1 > 0)
+			port->render_func(this, data, l1);
+	}
 
 	d[0].chunk->offset = index;
 	d[0].chunk->size = n_bytes;
@@ -368,6 +377,10 @@ static int make_buffer(struct impl *this)
 		b->h->seq = this->sample_count;
 		b->h->pts = this->start_time + this->elapsed_time;
 		b->h->dts_offset = 0;
+		if (gap)
+			SPA_FLAG_SET(b->h->flags, SPA_META_HEADER_FLAG_GAP);
+		else
+			SPA_FLAG_CLEAR(b->h->flags, SPA_META_HEADER_FLAG_GAP);
 	}
 
 	this->sample_count += n_samples;
@@ -0,0 +1,219 @@
+/* Spa
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/loop.h>
+#include <spa/support/system.h>
+#include <spa/utils/names.h>
+#include <spa/utils/type.h>
+#include <spa/utils/defs.h>
+
+#define N_INVOKES	100000
+#define N_LATENCY	10000
+#define MAX_THREADS	8
+
+struct data {
+	struct spa_handle *system_handle;
+	struct spa_handle *loop_handle;
+	struct spa_system *system;
+	struct spa_loop *loop;
+	struct spa_loop_control *control;
+
+	pthread_t thread;
+	bool running;
+	uint64_t count;
+	size_t size;
+};
+
+static const struct spa_handle_factory *find_factory(const char *name)
+{
+	uint32_t index = 0;
+	const struct spa_handle_factory *factory;
+
+	while (spa_handle_factory_enum(&factory, &index) == 1) {
+		if (strcmp(factory->name, name) == 0)
+			return factory;
+	}
+	return NULL;
+}
+
+static struct spa_handle *load_handle(const char *name,
+		const struct spa_support *support, uint32_t n_support)
+{
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+
+	factory = find_factory(name);
+	spa_assert(factory != NULL);
+	handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+	spa_assert(handle != NULL);
+	spa_assert(spa_handle_factory_init(factory, handle, NULL, support, n_support) >= 0);
+	return handle;
+}
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static int do_count(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	d->count++;
+	return 0;
+}
+
+static int do_stop(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	d->running = false;
+	return 0;
+}
+
+static void *loop_thread(void *arg)
+{
+	struct data *d = arg;
+
+	spa_loop_control_enter(d->control);
+	while (d->running)
+		spa_loop_control_iterate(d->control, -1);
+	spa_loop_control_leave(d->control);
+	return NULL;
+}
+
+static void *producer_thread(void *arg)
+{
+	struct data *d = arg;
+	uint8_t payload[4096];
+	int i;
+
+	spa_memzero(payload, sizeof(payload));
+	for (i = 0; i < N_INVOKES; i++)
+		spa_assert(spa_loop_invoke(d->loop, do_count, SPA_ID_INVALID,
+				payload, d->size, false, d) == 0);
+	return NULL;
+}
+
+static void test_throughput(struct data *d, uint32_t n_threads, size_t size)
+{
+	pthread_t threads[MAX_THREADS];
+	uint64_t t1, t2, total = (uint64_t)n_threads * N_INVOKES;
+	uint32_t i;
+
+	d->count = 0;
+	d->size = size;
+
+	t1 = get_time();
+	for (i = 0; i < n_threads; i++)
+		pthread_create(&threads[i], NULL, producer_thread, d);
+	for (i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+	/* items are handled in order, this one completes after all the others */
+	spa_loop_invoke(d->loop, NULL, 0, NULL, 0, true, d);
+	t2 = get_time();
+
+	spa_assert(d->count == total);
+
+	printf("throughput: threads %u, size %4zd: %10.0f invokes/s\n",
+			n_threads, size, total * (double)SPA_NSEC_PER_SEC / (t2 - t1));
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void test_latency(struct data *d)
+{
+	static uint64_t lat[N_LATENCY];
+	uint64_t t1, sum = 0;
+	int i;
+
+	for (i = 0; i < N_LATENCY; i++) {
+		t1 = get_time();
+		spa_loop_invoke(d->loop, do_count, 0, NULL, 0, true, d);
+		lat[i] = get_time() - t1;
+		sum += lat[i];
+	}
+	qsort(lat, N_LATENCY, sizeof(uint64_t), compare_u64);
+
+	printf("blocking latency (ns): min %"PRIu64", avg %"PRIu64", "
+			"p50 %"PRIu64", p99 %"PRIu64", max %"PRIu64"\n",
+			lat[0], sum / N_LATENCY, lat[N_LATENCY / 2],
+			lat[N_LATENCY * 99 / 100], lat[N_LATENCY - 1]);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 }, *d = &data;
+	struct spa_support support[1];
+	void *iface;
+
+	d->system_handle = load_handle(SPA_NAME_SUPPORT_SYSTEM, NULL, 0);
+	spa_assert(spa_handle_get_interface(d->system_handle,
+				SPA_TYPE_INTERFACE_System, &iface) >= 0);
+	d->system = iface;
+
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, d->system);
+	d->loop_handle = load_handle(SPA_NAME_SUPPORT_LOOP, support, 1);
+	spa_assert(spa_handle_get_interface(d->loop_handle,
+				SPA_TYPE_INTERFACE_Loop, &iface) >= 0);
+	d->loop = iface;
+	spa_assert(spa_handle_get_interface(d->loop_handle,
+				SPA_TYPE_INTERFACE_LoopControl, &iface) >= 0);
+	d->control = iface;
+
+	d->running = true;
+	pthread_create(&d->thread, NULL, loop_thread, d);
+
+	test_throughput(d, 1, 16);
+	test_throughput(d, 2, 16);
+	test_throughput(d, 4, 16);
+	test_throughput(d, 8, 16);
+	/* larger than the preallocated items */
+	test_throughput(d, 4, 1024);
+	test_latency(d);
+
+	spa_loop_invoke(d->loop, do_stop, 0, NULL, 0, true, d);
+	pthread_join(d->thread, NULL);
+
+	spa_handle_clear(d->loop_handle);
+	spa_handle_clear(d->system_handle);
+	free(d->loop_handle);
+	free(d->system_handle);
+
+	return 0;
+}
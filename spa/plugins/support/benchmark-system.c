@@ -0,0 +1,254 @@
+/* Spa
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/system.h>
+#include <spa/utils/names.h>
+#include <spa/utils/type.h>
+#include <spa/utils/defs.h>
+
+/* A driver wakes up N followers every cycle and waits until all of them
+ * signalled back, like a graph with N nodes. The system implementations are
+ * linked in and their calls into the kernel are counted with --wrap. */
+
+#define N_CYCLES	20000
+#define MAX_FOLLOWERS	8
+
+extern const struct spa_handle_factory spa_support_system_factory;
+extern const struct spa_handle_factory spa_support_uring_system_factory;
+
+static uint64_t n_syscalls;
+
+#define WRAP(ret,name,args,call)			\
+ret __real_##name args;					\
+ret __wrap_##name args					\
+{							\
+	__atomic_fetch_add(&n_syscalls, 1, __ATOMIC_RELAXED);	\
+	return __real_##name call;			\
+}
+
+WRAP(ssize_t, read, (int fd, void *buf, size_t count), (fd, buf, count))
+WRAP(ssize_t, write, (int fd, const void *buf, size_t count), (fd, buf, count))
+WRAP(int, epoll_wait, (int pfd, struct epoll_event *ev, int n_ev, int timeout),
+		(pfd, ev, n_ev, timeout))
+WRAP(int, timerfd_settime, (int fd, int flags, const struct itimerspec *new_value,
+		struct itimerspec *old_value), (fd, flags, new_value, old_value))
+WRAP(int, sched_getscheduler, (pid_t pid), (pid))
+
+long __real_syscall(long number, ...);
+long __wrap_syscall(long number, ...)
+{
+	va_list ap;
+	long a[6];
+	int i;
+
+	va_start(ap, number);
+	for (i = 0; i < 6; i++)
+		a[i] = va_arg(ap, long);
+	va_end(ap);
+
+	__atomic_fetch_add(&n_syscalls, 1, __ATOMIC_RELAXED);
+	return __real_syscall(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+struct follower {
+	struct data *data;
+	struct spa_handle *handle;
+	struct spa_system *system;
+	pthread_t thread;
+	int pfd;
+	int trigger;
+};
+
+struct data {
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	struct spa_system *system;
+	int pfd;
+	int done;
+	int timer;
+	bool running;
+
+	uint32_t n_followers;
+	struct follower followers[MAX_FOLLOWERS];
+};
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static struct spa_system *make_system(const struct spa_handle_factory *factory,
+		struct spa_handle **handle)
+{
+	void *iface;
+
+	*handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+	spa_assert(*handle != NULL);
+	spa_assert(spa_handle_factory_init(factory, *handle, NULL, NULL, 0) >= 0);
+	spa_assert(spa_handle_get_interface(*handle, SPA_TYPE_INTERFACE_System, &iface) >= 0);
+	return iface;
+}
+
+static void *follower_thread(void *arg)
+{
+	struct follower *f = arg;
+	struct data *d = f->data;
+	struct spa_poll_event ev[1];
+	uint64_t count;
+
+	while (__atomic_load_n(&d->running, __ATOMIC_RELAXED)) {
+		if (spa_system_pollfd_wait(f->system, f->pfd, ev, 1, -1) < 1)
+			continue;
+		spa_system_eventfd_read(f->system, f->trigger, &count);
+		spa_system_eventfd_write(f->system, d->done, 1);
+	}
+	return NULL;
+}
+
+static void run_cycles(struct data *d, uint32_t n_cycles, uint64_t *ns)
+{
+	struct spa_poll_event ev[1];
+	struct itimerspec its;
+	struct timespec now;
+	uint64_t count, t1;
+	uint32_t i, j, n_done;
+
+	spa_zero(its);
+	for (i = 0; i < n_cycles; i++) {
+		t1 = get_time();
+
+		/* the driver re-arms its timeout and triggers the graph */
+		spa_system_clock_gettime(d->system, CLOCK_MONOTONIC, &now);
+		its.it_value.tv_sec = now.tv_sec + 1;
+		its.it_value.tv_nsec = now.tv_nsec;
+		spa_system_timerfd_settime(d->system, d->timer,
+				SPA_FD_TIMER_ABSTIME, &its, NULL);
+		for (j = 0; j < d->n_followers; j++)
+			spa_system_eventfd_write(d->system, d->followers[j].trigger, 1);
+
+		for (n_done = 0; n_done < d->n_followers; n_done += count) {
+			while (spa_system_pollfd_wait(d->system, d->pfd, ev, 1, -1) < 1);
+			spa_system_eventfd_read(d->system, d->done, &count);
+		}
+		if (ns)
+			ns[i] = get_time() - t1;
+	}
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void test_cycle(const char *name, const struct spa_handle_factory *factory,
+		uint32_t n_followers)
+{
+	static uint64_t lat[N_CYCLES];
+	struct data data = { 0 }, *d = &data;
+	uint64_t sum = 0, calls;
+	uint32_t i;
+
+	d->system = make_system(factory, &d->handle);
+	d->pfd = spa_system_pollfd_create(d->system, SPA_FD_CLOEXEC);
+	d->done = spa_system_eventfd_create(d->system, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
+	d->timer = spa_system_timerfd_create(d->system, CLOCK_MONOTONIC,
+			SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
+	spa_system_pollfd_add(d->system, d->pfd, d->done, SPA_IO_IN, NULL);
+	d->n_followers = n_followers;
+	d->running = true;
+
+	for (i = 0; i < n_followers; i++) {
+		struct follower *f = &d->followers[i];
+
+		f->data = d;
+		f->system = make_system(factory, &f->handle);
+		f->pfd = spa_system_pollfd_create(f->system, SPA_FD_CLOEXEC);
+		f->trigger = spa_system_eventfd_create(f->system, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
+		spa_system_pollfd_add(f->system, f->pfd, f->trigger, SPA_IO_IN, NULL);
+		pthread_create(&f->thread, NULL, follower_thread, f);
+	}
+
+	/* warm up so that every thread went through its poll once */
+	run_cycles(d, 100, NULL);
+
+	n_syscalls = 0;
+	run_cycles(d, N_CYCLES, lat);
+	calls = __atomic_load_n(&n_syscalls, __ATOMIC_RELAXED);
+
+	for (i = 0; i < N_CYCLES; i++)
+		sum += lat[i];
+	qsort(lat, N_CYCLES, sizeof(uint64_t), compare_u64);
+
+	printf("%-6s followers %u: cycle (ns) avg %6"PRIu64", p50 %6"PRIu64
+			", p99 %6"PRIu64", syscalls/cycle %5.2f\n",
+			name, n_followers, sum / N_CYCLES, lat[N_CYCLES / 2],
+			lat[N_CYCLES * 99 / 100], (double)calls / N_CYCLES);
+
+	__atomic_store_n(&d->running, false, __ATOMIC_RELAXED);
+	for (i = 0; i < n_followers; i++) {
+		struct follower *f = &d->followers[i];
+		uint64_t one = 1;
+		/* directly, the driver does not poll anymore to flush */
+		spa_assert(write(f->trigger, &one, sizeof(one)) == sizeof(one));
+		pthread_join(f->thread, NULL);
+		spa_system_close(f->system, f->trigger);
+		spa_system_close(f->system, f->pfd);
+		spa_handle_clear(f->handle);
+		free(f->handle);
+	}
+	spa_system_close(d->system, d->timer);
+	spa_system_close(d->system, d->done);
+	spa_system_close(d->system, d->pfd);
+	spa_handle_clear(d->handle);
+	free(d->handle);
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t n_followers[] = { 1, 2, 4, 8 };
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(n_followers); i++) {
+		test_cycle("epoll", &spa_support_system_factory, n_followers[i]);
+		test_cycle("uring", &spa_support_uring_system_factory, n_followers[i]);
+	}
+	return 0;
+}
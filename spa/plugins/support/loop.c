@@ -28,7 +28,10 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 #include <pthread.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 #include <spa/support/loop.h>
 #include <spa/support/system.h>
@@ -38,23 +41,35 @@
 #include <spa/utils/names.h>
 #include <spa/utils/result.h>
 #include <spa/utils/type.h>
-#include <spa/utils/ringbuffer.h>
 
 #define NAME "loop"
 
-#define DATAS_SIZE (4096 * 8)
+#define MAX_ITEMS	256
+#define ITEM_DATA_SIZE	128
 
 /** \cond */
 
+/* filled in by the loop when a blocking invoke completes, lives on the
+ * stack of the invoking thread */
+struct invoke_done {
+	uint32_t state;		/* futex */
+#define DONE_PENDING	0
+#define DONE_WAITING	1
+#define DONE_COMPLETE	2
+	int res;
+};
+
 struct invoke_item {
-	size_t item_size;
+	struct invoke_item *next;
 	spa_invoke_func_t func;
 	uint32_t seq;
 	void *data;
 	size_t size;
-	bool block;
 	void *user_data;
-	int res;
+	struct invoke_done *done;
+	uint32_t index;		/* index + 1 in the pool, 0 when allocated */
+	uint32_t free_next;
+	uint8_t inline_data[ITEM_DATA_SIZE];
 };
 
 static int loop_signal_event(void *object, struct spa_source *source);
@@ -76,10 +91,17 @@ struct impl {
 	pthread_t thread;
 
 	struct spa_source *wakeup;
-	int ack_fd;
+	uint32_t wakeup_pending;
 
-	struct spa_ringbuffer buffer;
-	uint8_t buffer_data[DATAS_SIZE];
+	/* multi producer, single consumer queue of invoke items. Producers
+	 * only swap the head, the loop takes items from the tail. */
+	struct invoke_item *head;
+	struct invoke_item *tail;
+	struct invoke_item stub;
+
+	/* preallocated items, items are allocated when this runs out */
+	uint64_t free_head;	/* tag << 32 | index + 1 */
+	struct invoke_item items[MAX_ITEMS];
 };
 
 struct source_impl {
@@ -120,32 +142,134 @@ static int loop_remove_source(void *object, struct spa_source *source)
 	return spa_system_pollfd_del(impl->system, impl->poll_fd, source->fd);
 }
 
-static void flush_items(struct impl *impl, bool async)
+static inline long futex(uint32_t *uaddr, int op, uint32_t val)
 {
-	uint32_t index;
-	int res;
+	return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+static struct invoke_item *alloc_item(struct impl *impl, size_t size)
+{
+	struct invoke_item *item;
+	uint64_t head, next;
+
+	if (size <= ITEM_DATA_SIZE) {
+		head = __atomic_load_n(&impl->free_head, __ATOMIC_ACQUIRE);
+		while ((uint32_t)head != 0) {
+			item = &impl->items[(uint32_t)head - 1];
+			/* the tag changes on each update, so that we don't
+			 * take an item that was taken and returned meanwhile */
+			next = ((head >> 32) + 1) << 32 |
+				__atomic_load_n(&item->free_next, __ATOMIC_RELAXED);
+			if (__atomic_compare_exchange_n(&impl->free_head, &head, next,
+					false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+				item->data = item->inline_data;
+				return item;
+			}
+		}
+	}
+	/* the pool is empty or the data is too large, grow instead of
+	 * failing the invoke */
+	if ((item = malloc(sizeof(struct invoke_item) + size)) == NULL)
+		return NULL;
+	item->index = 0;
+	item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
+	spa_log_debug(impl->log, NAME " %p: allocated item %p size:%zd", impl, item, size);
+	return item;
+}
 
-	while (spa_ringbuffer_get_read_index(&impl->buffer, &index) > 0) {
-		struct invoke_item *item;
-		bool block;
+static void free_item(struct impl *impl, struct invoke_item *item)
+{
+	uint64_t head, next;
+
+	if (item->index == 0) {
+		free(item);
+		return;
+	}
+	head = __atomic_load_n(&impl->free_head, __ATOMIC_RELAXED);
+	do {
+		__atomic_store_n(&item->free_next, (uint32_t)head, __ATOMIC_RELAXED);
+		next = ((head >> 32) + 1) << 32 | item->index;
+	} while (!__atomic_compare_exchange_n(&impl->free_head, &head, next,
+			false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
 
-		item = SPA_MEMBER(impl->buffer_data, index & (DATAS_SIZE - 1), struct invoke_item);
-		block = item->block;
+static void push_item(struct impl *impl, struct invoke_item *item)
+{
+	struct invoke_item *prev;
+
+	__atomic_store_n(&item->next, NULL, __ATOMIC_RELAXED);
+	prev = __atomic_exchange_n(&impl->head, item, __ATOMIC_ACQ_REL);
+	/* between the exchange and this store the item is not reachable from
+	 * the tail yet, pop_item() will see an empty queue */
+	__atomic_store_n(&prev->next, item, __ATOMIC_RELEASE);
+}
 
-		item->res = item->func ? item->func(&impl->loop,
+static struct invoke_item *pop_item(struct impl *impl)
+{
+	struct invoke_item *tail = impl->tail, *next, *head;
+
+	next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (tail == &impl->stub) {
+		if (next == NULL)
+			return NULL;
+		impl->tail = tail = next;
+		next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	}
+	if (next != NULL) {
+		impl->tail = next;
+		return tail;
+	}
+	head = __atomic_load_n(&impl->head, __ATOMIC_ACQUIRE);
+	if (tail != head)
+		return NULL;
+	/* tail is the last item, put the stub behind it so that we can
+	 * take it */
+	push_item(impl, &impl->stub);
+	next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (next != NULL) {
+		impl->tail = next;
+		return tail;
+	}
+	return NULL;
+}
+
+static void flush_items(struct impl *impl)
+{
+	struct invoke_item *item;
+
+	while ((item = pop_item(impl)) != NULL) {
+		struct invoke_done *done = item->done;
+		int res;
+
+		res = item->func ? item->func(&impl->loop,
 				true, item->seq, item->data, item->size,
 			   item->user_data) : 0;
 
-		spa_ringbuffer_read_update(&impl->buffer, index + item->item_size);
+		free_item(impl, item);
 
-		if (block && async) {
-			if ((res = spa_system_eventfd_write(impl->system, impl->ack_fd, 1)) < 0)
-				spa_log_warn(impl->log, NAME " %p: failed to write event fd: %s",
-						impl, spa_strerror(res));
+		if (done) {
+			done->res = res;
+			/* only make the syscall when the invoker went to sleep */
+			if (__atomic_exchange_n(&done->state, DONE_COMPLETE,
+					__ATOMIC_SEQ_CST) == DONE_WAITING)
+				futex(&done->state, FUTEX_WAKE_PRIVATE, 1);
 		}
 	}
 }
 
+static void wait_done(struct impl *impl, struct invoke_done *done)
+{
+	uint32_t state = DONE_PENDING;
+
+	if (__atomic_compare_exchange_n(&done->state, &state, DONE_WAITING,
+			false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+		spa_loop_control_hook_before(&impl->hooks_list);
+		while (__atomic_load_n(&done->state, __ATOMIC_SEQ_CST) != DONE_COMPLETE)
+			futex(&done->state, FUTEX_WAIT_PRIVATE, DONE_WAITING);
+		spa_loop_control_hook_after(&impl->hooks_list);
+	}
+}
+
 static int
 loop_invoke(void *object,
 	    spa_invoke_func_t func,
@@ -158,65 +282,41 @@ loop_invoke(void *object,
 	struct impl *impl = object;
 	bool in_thread = pthread_equal(impl->thread, pthread_self());
 	struct invoke_item *item;
+	struct invoke_done done;
 	int res;
 
 	if (in_thread) {
-		flush_items(impl, false);
+		flush_items(impl);
 		res = func ? func(&impl->loop, false, seq, data, size, user_data) : 0;
 	} else {
-		int32_t filled;
-		uint32_t avail, idx, offset, l0;
-
-		filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
-		if (filled < 0 || filled > DATAS_SIZE) {
-			spa_log_warn(impl->log, NAME " %p: queue xrun %d", impl, filled);
-			return -EPIPE;
-		}
-		avail = DATAS_SIZE - filled;
-		if (avail < sizeof(struct invoke_item)) {
-			spa_log_warn(impl->log, NAME " %p: queue full %d", impl, avail);
-			return -EPIPE;
+		if ((item = alloc_item(impl, size)) == NULL) {
+			res = -errno;
+			spa_log_warn(impl->log, NAME " %p: can't allocate item: %m", impl);
+			return res;
 		}
-		offset = idx & (DATAS_SIZE - 1);
-
-		l0 = DATAS_SIZE - offset;
-
-		item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
 		item->func = func;
 		item->seq = seq;
 		item->size = size;
-		item->block = block;
 		item->user_data = user_data;
+		item->done = block ? &done : NULL;
+		if (size > 0)
+			memcpy(item->data, data, size);
 
-		spa_log_trace(impl->log, NAME " %p: add item %p filled:%d", impl, item, filled);
+		done.state = DONE_PENDING;
+		done.res = 0;
 
-		if (l0 > sizeof(struct invoke_item) + size) {
-			item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
-			item->item_size = sizeof(struct invoke_item) + size;
-			if (l0 < sizeof(struct invoke_item) + item->item_size)
-				item->item_size = l0;
-		} else {
-			item->data = impl->buffer_data;
-			item->item_size = l0 + size;
-		}
-		memcpy(item->data, data, size);
+		spa_log_trace(impl->log, NAME " %p: add item %p", impl, item);
 
-		spa_ringbuffer_write_update(&impl->buffer, idx + item->item_size);
+		push_item(impl, item);
 
-		loop_signal_event(impl, impl->wakeup);
+		/* only the first invoke after the loop started flushing needs
+		 * to wake it up, the others are picked up in the same flush */
+		if (!__atomic_exchange_n(&impl->wakeup_pending, 1, __ATOMIC_SEQ_CST))
+			loop_signal_event(impl, impl->wakeup);
 
 		if (block) {
-			uint64_t count = 1;
-
-			spa_loop_control_hook_before(&impl->hooks_list);
-
-			if ((res = spa_system_eventfd_read(impl->system, impl->ack_fd, &count)) < 0)
-				spa_log_warn(impl->log, NAME " %p: failed to read event fd: %s",
-						impl, spa_strerror(res));
-
-			spa_loop_control_hook_after(&impl->hooks_list);
-
-			res = item->res;
+			wait_done(impl, &done);
+			res = done.res;
 		}
 		else {
 			if (seq != SPA_ID_INVALID)
@@ -231,7 +331,10 @@ loop_invoke(void *object,
 static void wakeup_func(void *data, uint64_t count)
 {
 	struct impl *impl = data;
-	flush_items(impl, true);
+	/* clear before flushing, an invoke that comes in after we looked at
+	 * the queue will then signal again */
+	__atomic_store_n(&impl->wakeup_pending, 0, __ATOMIC_SEQ_CST);
+	flush_items(impl);
 }
 
 static int loop_get_fd(void *object)
@@ -693,6 +796,7 @@ static int impl_clear(struct spa_handle *handle)
 {
 	struct impl *impl;
 	struct source_impl *source;
+	struct invoke_item *item;
 
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
 
@@ -703,7 +807,9 @@ static int impl_clear(struct spa_handle *handle)
 
 	process_destroy(impl);
 
-	spa_system_close(impl->system, impl->ack_fd);
+	while ((item = pop_item(impl)) != NULL)
+		free_item(impl, item);
+
 	spa_system_close(impl->system, impl->poll_fd);
 
 	return 0;
@@ -774,7 +880,13 @@ impl_init(const struct spa_handle_factory *factory,
 	spa_list_init(&impl->destroy_list);
 	spa_hook_list_init(&impl->hooks_list);
 
-	spa_ringbuffer_init(&impl->buffer);
+	impl->stub.next = NULL;
+	impl->head = impl->tail = &impl->stub;
+	for (i = 0; i < MAX_ITEMS; i++) {
+		impl->items[i].index = i + 1;
+		impl->items[i].free_next = i + 1 < MAX_ITEMS ? i + 2 : 0;
+	}
+	impl->free_head = 1;
 
 	impl->wakeup = loop_add_event(impl, wakeup_func, impl);
 	if (impl->wakeup == NULL) {
@@ -782,20 +894,11 @@ impl_init(const struct spa_handle_factory *factory,
 		spa_log_error(impl->log, NAME " %p: can't create wakeup event: %m", impl);
 		goto error_exit_free_poll;
 	}
-	if ((res = spa_system_eventfd_create(impl->system,
-			SPA_FD_EVENT_SEMAPHORE | SPA_FD_CLOEXEC)) < 0) {
-		spa_log_error(impl->log, NAME " %p: can't create ack event: %s",
-				impl, spa_strerror(res));
-		goto error_exit_free_wakeup;
-	}
-	impl->ack_fd = res;
 
 	spa_log_debug(impl->log, NAME " %p: initialized", impl);
 
 	return 0;
 
-error_exit_free_wakeup:
-	loop_destroy_source(impl, impl->wakeup);
 error_exit_free_poll:
 	spa_system_close(impl->system, impl->poll_fd);
 error_exit:
@@ -0,0 +1,786 @@
+/* Spa
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+
+#include <linux/io_uring.h>
+
+#include <spa/support/log.h>
+#include <spa/support/system.h>
+#include <spa/support/plugin.h>
+#include <spa/utils/type.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+
+#define NAME "uring-system"
+
+/* This system is a drop-in replacement for the epoll based one. The
+ * readiness is still tracked with epoll but the eventfd signals and timerfd
+ * re-arms that the polling thread does while dispatching are queued and
+ * flushed in one io_uring submission right before it goes back to sleep.
+ * Calls from other threads go straight to the kernel, but first flush the
+ * operations that are queued for the same fd so that a close from another
+ * thread can never let a queued write hit a reused fd.
+ *
+ * The flush waits for the writes to complete. The kernel can hand a write
+ * to an io-wq worker and then the polling thread blocks until that worker
+ * ran. Threads with a realtime scheduling policy therefore never queue,
+ * they write directly like the epoll based system. */
+
+#define RING_ENTRIES	64
+#define MAX_PENDING	RING_ENTRIES
+
+/* how often the owner checks if it was made realtime */
+#define REALTIME_CHECK_NSEC	SPA_NSEC_PER_SEC
+
+enum op_type {
+	OP_EVENTFD_WRITE,
+	OP_TIMERFD_SETTIME,
+};
+
+struct pending_op {
+	uint32_t type;
+	int fd;
+	int flags;
+	uint64_t count;
+	struct itimerspec value;
+};
+
+struct ring {
+	int fd;
+	void *sq_ptr;
+	size_t sq_size;
+	void *cq_ptr;
+	size_t cq_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	uint32_t *sq_head;
+	uint32_t *sq_tail;
+	uint32_t *sq_mask;
+	uint32_t *sq_array;
+
+	uint32_t *cq_head;
+	uint32_t *cq_tail;
+	uint32_t *cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_system system;
+
+        struct spa_log *log;
+
+	struct ring ring;
+
+	pthread_t owner;
+	unsigned int have_owner:1;
+	unsigned int realtime:1;	/* the owner is realtime and doesn't queue */
+	uint64_t realtime_check;	/* time of the next realtime check */
+
+	pthread_mutex_t lock;		/* protects the ring and the pending ops */
+	struct pending_op pending[MAX_PENDING];
+	uint32_t n_pending;
+};
+
+static int ring_init(struct ring *r, uint32_t entries)
+{
+	struct io_uring_params p;
+	void *ptr;
+
+	spa_zero(*r);
+	spa_zero(p);
+	r->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (r->fd < 0)
+		return -errno;
+
+	r->sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		r->sq_size = r->cq_size = SPA_MAX(r->sq_size, r->cq_size);
+
+	ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto error;
+	r->sq_ptr = ptr;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ptr = NULL;
+	} else {
+		ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED)
+			goto error;
+		r->cq_ptr = ptr;
+	}
+
+	r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		goto error;
+	r->sqes = ptr;
+
+	ptr = r->sq_ptr;
+	r->sq_head = SPA_MEMBER(ptr, p.sq_off.head, uint32_t);
+	r->sq_tail = SPA_MEMBER(ptr, p.sq_off.tail, uint32_t);
+	r->sq_mask = SPA_MEMBER(ptr, p.sq_off.ring_mask, uint32_t);
+	r->sq_array = SPA_MEMBER(ptr, p.sq_off.array, uint32_t);
+
+	ptr = r->cq_ptr ? r->cq_ptr : r->sq_ptr;
+	r->cq_head = SPA_MEMBER(ptr, p.cq_off.head, uint32_t);
+	r->cq_tail = SPA_MEMBER(ptr, p.cq_off.tail, uint32_t);
+	r->cq_mask = SPA_MEMBER(ptr, p.cq_off.ring_mask, uint32_t);
+	r->cqes = SPA_MEMBER(ptr, p.cq_off.cqes, struct io_uring_cqe);
+
+	return 0;
+error:
+	return -errno;
+}
+
+/* IORING_OP_WRITE needs linux 5.6, older kernels set up the ring fine but
+ * fail every write */
+static int ring_probe(struct ring *r)
+{
+	uint8_t buffer[sizeof(struct io_uring_probe) +
+		256 * sizeof(struct io_uring_probe_op)];
+	struct io_uring_probe *p = (struct io_uring_probe *)buffer;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PROBE, p, 256) < 0)
+		return -errno;
+	if (p->last_op < IORING_OP_WRITE ||
+	    !(p->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED))
+		return -ENOTSUP;
+	return 0;
+}
+
+static void ring_clear(struct ring *r)
+{
+	if (r->sqes)
+		munmap(r->sqes, r->sqes_size);
+	if (r->cq_ptr)
+		munmap(r->cq_ptr, r->cq_size);
+	if (r->sq_ptr)
+		munmap(r->sq_ptr, r->sq_size);
+	if (r->fd >= 0)
+		close(r->fd);
+	spa_zero(*r);
+	r->fd = -1;
+}
+
+static inline struct io_uring_sqe *ring_get_sqe(struct ring *r)
+{
+	uint32_t tail = *r->sq_tail, idx = tail & *r->sq_mask;
+	struct io_uring_sqe *sqe = &r->sqes[idx];
+
+	spa_zero(*sqe);
+	r->sq_array[idx] = idx;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	return sqe;
+}
+
+static int ring_submit_and_wait(struct ring *r, uint32_t n)
+{
+	int res;
+
+	do {
+		res = syscall(__NR_io_uring_enter, r->fd, n, n,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+	} while (res < 0 && errno == EINTR);
+
+	return res < 0 ? -errno : res;
+}
+
+static void ring_reap(struct impl *impl)
+{
+	struct ring *r = &impl->ring;
+	uint32_t head = *r->cq_head;
+	uint32_t tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+		if (SPA_UNLIKELY(cqe->res < 0))
+			spa_log_warn(impl->log, NAME " %p: write on fd %d failed: %s",
+					impl, (int)cqe->user_data, spa_strerror(cqe->res));
+	}
+	__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static int flush_pending(struct impl *impl)
+{
+	struct ring *r = &impl->ring;
+	uint32_t i, n_writes = 0;
+	int res;
+
+	for (i = 0; i < impl->n_pending; i++) {
+		struct pending_op *op = &impl->pending[i];
+
+		switch (op->type) {
+		case OP_EVENTFD_WRITE:
+		{
+			struct io_uring_sqe *sqe;
+
+			if (impl->realtime) {
+				if (write(op->fd, &op->count, sizeof(uint64_t)) != sizeof(uint64_t))
+					spa_log_warn(impl->log, NAME " %p: write on fd %d failed: %m",
+							impl, op->fd);
+				break;
+			}
+			sqe = ring_get_sqe(r);
+			sqe->opcode = IORING_OP_WRITE;
+			sqe->fd = op->fd;
+			sqe->addr = (uint64_t)(uintptr_t)&op->count;
+			sqe->len = sizeof(uint64_t);
+			sqe->off = (uint64_t)-1;
+			sqe->user_data = op->fd;
+			n_writes++;
+			break;
+		}
+		case OP_TIMERFD_SETTIME:
+			/* there is no io_uring opcode for this, but re-arms
+			 * of the same timer during one iteration were merged */
+			if (timerfd_settime(op->fd, op->flags, &op->value, NULL) < 0)
+				spa_log_warn(impl->log, NAME " %p: settime on fd %d failed: %m",
+						impl, op->fd);
+			break;
+		}
+	}
+	__atomic_store_n(&impl->n_pending, 0, __ATOMIC_RELEASE);
+
+	if (n_writes == 0)
+		return 0;
+
+	/* wait for the completions so that the counts can be reused */
+	res = ring_submit_and_wait(r, n_writes);
+	ring_reap(impl);
+
+	return res < 0 ? res : 0;
+}
+
+static inline bool is_owner(struct impl *impl)
+{
+	return impl->have_owner && pthread_equal(impl->owner, pthread_self());
+}
+
+/* only the owner queues and only while it is not realtime */
+static inline bool can_queue(struct impl *impl)
+{
+	return is_owner(impl) && !impl->realtime;
+}
+
+static inline bool thread_is_realtime(void)
+{
+	int policy = sched_getscheduler(0) & ~SCHED_RESET_ON_FORK;
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+/* the thread can be made realtime after it started polling. Checking costs
+ * a syscall, so do it at most once every REALTIME_CHECK_NSEC with the
+ * coarse clock, which doesn't need one */
+static void check_realtime(struct impl *impl)
+{
+	struct timespec now;
+	uint64_t nsec;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+	nsec = SPA_TIMESPEC_TO_NSEC(&now);
+	if (nsec < impl->realtime_check)
+		return;
+	impl->realtime_check = nsec + REALTIME_CHECK_NSEC;
+
+	if (thread_is_realtime()) {
+		spa_log_info(impl->log, NAME " %p: realtime thread, batching disabled",
+				impl);
+		impl->realtime = true;
+	}
+}
+
+static inline struct pending_op *find_pending(struct impl *impl, uint32_t type, int fd)
+{
+	uint32_t i;
+	for (i = 0; i < impl->n_pending; i++) {
+		struct pending_op *op = &impl->pending[i];
+		if (op->fd == fd && op->type == type)
+			return op;
+	}
+	return NULL;
+}
+
+static inline struct pending_op *add_pending(struct impl *impl, uint32_t type, int fd)
+{
+	struct pending_op *op;
+
+	if ((op = find_pending(impl, type, fd)) != NULL)
+		return op;
+
+	if (impl->n_pending == MAX_PENDING)
+		flush_pending(impl);
+
+	op = &impl->pending[impl->n_pending];
+	op->type = type;
+	op->fd = fd;
+	op->count = 0;
+	__atomic_store_n(&impl->n_pending, impl->n_pending + 1, __ATOMIC_RELEASE);
+	return op;
+}
+
+/* make sure queued operations on @fd are done before it is used directly,
+ * this can be called from any thread */
+static inline void sync_fd(struct impl *impl, int fd)
+{
+	uint32_t i;
+
+	if (SPA_LIKELY(__atomic_load_n(&impl->n_pending, __ATOMIC_ACQUIRE) == 0))
+		return;
+
+	pthread_mutex_lock(&impl->lock);
+	for (i = 0; i < impl->n_pending; i++) {
+		if (impl->pending[i].fd == fd) {
+			flush_pending(impl);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&impl->lock);
+}
+
+static ssize_t impl_read(void *object, int fd, void *buf, size_t count)
+{
+	ssize_t res;
+	sync_fd(object, fd);
+	res = read(fd, buf, count);
+	return res < 0 ? -errno : res;
+}
+
+static ssize_t impl_write(void *object, int fd, const void *buf, size_t count)
+{
+	ssize_t res;
+	sync_fd(object, fd);
+	res = write(fd, buf, count);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_ioctl(void *object, int fd, unsigned long request, ...)
+{
+	int res;
+	va_list ap;
+	long arg;
+
+	va_start(ap, request);
+	arg = va_arg(ap, long);
+	res = ioctl(fd, request, arg);
+	va_end(ap);
+
+	return res < 0 ? -errno : res;
+}
+
+static int impl_close(void *object, int fd)
+{
+	int res;
+	sync_fd(object, fd);
+	res = close(fd);
+	return res < 0 ? -errno : res;
+}
+
+/* clock */
+static int impl_clock_gettime(void *object,
+			int clockid, struct timespec *value)
+{
+	int res = clock_gettime(clockid, value);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_clock_getres(void *object,
+			int clockid, struct timespec *res)
+{
+	int r = clock_getres(clockid, res);
+	return r < 0 ? -errno : r;
+}
+
+/* poll */
+static int impl_pollfd_create(void *object, int flags)
+{
+	int fl = 0, res;
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= EPOLL_CLOEXEC;
+	res = epoll_create1(fl);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_pollfd_add(void *object, int pfd, int fd, uint32_t events, void *data)
+{
+	struct epoll_event ep;
+	int res;
+
+	spa_zero(ep);
+	ep.events = events;
+	ep.data.ptr = data;
+
+	res = epoll_ctl(pfd, EPOLL_CTL_ADD, fd, &ep);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_pollfd_mod(void *object, int pfd, int fd, uint32_t events, void *data)
+{
+	struct epoll_event ep;
+	int res;
+
+	spa_zero(ep);
+	ep.events = events;
+	ep.data.ptr = data;
+
+	res = epoll_ctl(pfd, EPOLL_CTL_MOD, fd, &ep);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_pollfd_del(void *object, int pfd, int fd)
+{
+	int res = epoll_ctl(pfd, EPOLL_CTL_DEL, fd, NULL);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_pollfd_wait(void *object, int pfd,
+		struct spa_poll_event *ev, int n_ev, int timeout)
+{
+	struct impl *impl = object;
+	struct epoll_event ep[n_ev];
+	int i, nfds;
+
+	if (SPA_UNLIKELY(!is_owner(impl)) && impl->ring.fd >= 0) {
+		pthread_mutex_lock(&impl->lock);
+		flush_pending(impl);
+		impl->owner = pthread_self();
+		impl->have_owner = true;
+		impl->realtime = false;
+		impl->realtime_check = 0;
+		pthread_mutex_unlock(&impl->lock);
+	}
+	if (impl->n_pending > 0) {
+		pthread_mutex_lock(&impl->lock);
+		if (!impl->realtime)
+			check_realtime(impl);
+		flush_pending(impl);
+		pthread_mutex_unlock(&impl->lock);
+	}
+
+	if (SPA_UNLIKELY((nfds = epoll_wait(pfd, ep, n_ev, timeout)) < 0))
+		return -errno;
+
+        for (i = 0; i < nfds; i++) {
+                ev[i].events = ep[i].events;
+                ev[i].data = ep[i].data.ptr;
+        }
+	return nfds;
+}
+
+/* timers */
+static int impl_timerfd_create(void *object, int clockid, int flags)
+{
+	int fl = 0, res;
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= TFD_CLOEXEC;
+	if (flags & SPA_FD_NONBLOCK)
+		fl |= TFD_NONBLOCK;
+	res = timerfd_create(clockid, fl);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_timerfd_settime(void *object,
+			int fd, int flags,
+			const struct itimerspec *new_value,
+			struct itimerspec *old_value)
+{
+	struct impl *impl = object;
+	int fl = 0, res;
+
+	if (flags & SPA_FD_TIMER_ABSTIME)
+		fl |= TFD_TIMER_ABSTIME;
+	if (flags & SPA_FD_TIMER_CANCEL_ON_SET)
+		fl |= TFD_TIMER_CANCEL_ON_SET;
+
+	/* only absolute re-arms can be delayed without changing the deadline */
+	if (old_value == NULL && (fl & TFD_TIMER_ABSTIME) && can_queue(impl)) {
+		struct pending_op *op;
+
+		pthread_mutex_lock(&impl->lock);
+		op = add_pending(impl, OP_TIMERFD_SETTIME, fd);
+		op->flags = fl;
+		op->value = *new_value;
+		pthread_mutex_unlock(&impl->lock);
+		return 0;
+	}
+	sync_fd(impl, fd);
+	res = timerfd_settime(fd, fl, new_value, old_value);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_timerfd_gettime(void *object,
+			int fd, struct itimerspec *curr_value)
+{
+	int res;
+	sync_fd(object, fd);
+	res = timerfd_gettime(fd, curr_value);
+	return res < 0 ? -errno : res;
+
+}
+static int impl_timerfd_read(void *object, int fd, uint64_t *expirations)
+{
+	sync_fd(object, fd);
+	if (read(fd, expirations, sizeof(uint64_t)) != sizeof(uint64_t))
+		return -errno;
+	return 0;
+}
+
+/* events */
+static int impl_eventfd_create(void *object, int flags)
+{
+	int fl = 0, res;
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= EFD_CLOEXEC;
+	if (flags & SPA_FD_NONBLOCK)
+		fl |= EFD_NONBLOCK;
+	if (flags & SPA_FD_EVENT_SEMAPHORE)
+		fl |= EFD_SEMAPHORE;
+	res = eventfd(0, fl);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_eventfd_write(void *object, int fd, uint64_t count)
+{
+	struct impl *impl = object;
+
+	if (can_queue(impl)) {
+		/* counts add up so signals to the same fd are merged */
+		struct pending_op *op;
+
+		pthread_mutex_lock(&impl->lock);
+		op = add_pending(impl, OP_EVENTFD_WRITE, fd);
+		op->count += count;
+		pthread_mutex_unlock(&impl->lock);
+		return 0;
+	}
+	if (write(fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+		return -errno;
+	return 0;
+}
+
+static int impl_eventfd_read(void *object, int fd, uint64_t *count)
+{
+	sync_fd(object, fd);
+	if (read(fd, count, sizeof(uint64_t)) != sizeof(uint64_t))
+		return -errno;
+	return 0;
+}
+
+/* signals */
+static int impl_signalfd_create(void *object, int signal, int flags)
+{
+	sigset_t mask;
+	int res, fl = 0;
+
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= SFD_CLOEXEC;
+	if (flags & SPA_FD_NONBLOCK)
+		fl |= SFD_NONBLOCK;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, signal);
+	res = signalfd(-1, &mask, fl);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+
+	return res < 0 ? -errno : res;
+}
+
+static int impl_signalfd_read(void *object, int fd, int *signal)
+{
+	struct signalfd_siginfo signal_info;
+	int len;
+
+	len = read(fd, &signal_info, sizeof signal_info);
+	if (!(len == -1 && errno == EAGAIN) && len != sizeof signal_info)
+		return -errno;
+
+	*signal = signal_info.ssi_signo;
+
+	return 0;
+}
+
+static const struct spa_system_methods impl_system = {
+	SPA_VERSION_SYSTEM_METHODS,
+	.read = impl_read,
+	.write = impl_write,
+	.ioctl = impl_ioctl,
+	.close = impl_close,
+	.clock_gettime = impl_clock_gettime,
+	.clock_getres = impl_clock_getres,
+	.pollfd_create = impl_pollfd_create,
+	.pollfd_add = impl_pollfd_add,
+	.pollfd_mod = impl_pollfd_mod,
+	.pollfd_del = impl_pollfd_del,
+	.pollfd_wait = impl_pollfd_wait,
+	.timerfd_create = impl_timerfd_create,
+	.timerfd_settime = impl_timerfd_settime,
+	.timerfd_gettime = impl_timerfd_gettime,
+	.timerfd_read = impl_timerfd_read,
+	.eventfd_create = impl_eventfd_create,
+	.eventfd_write = impl_eventfd_write,
+	.eventfd_read = impl_eventfd_read,
+	.signalfd_create = impl_signalfd_create,
+	.signalfd_read = impl_signalfd_read,
+};
+
+static int impl_get_interface(struct spa_handle *handle, uint32_t type, void **interface)
+{
+	struct impl *impl;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	impl = (struct impl *) handle;
+
+	switch (type) {
+	case SPA_TYPE_INTERFACE_System:
+		*interface = &impl->system;
+		break;
+	default:
+		return -ENOENT;
+	}
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *impl;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	impl = (struct impl *) handle;
+
+	if (impl->ring.fd >= 0)
+		flush_pending(impl);
+	ring_clear(&impl->ring);
+	pthread_mutex_destroy(&impl->lock);
+
+	return 0;
+}
+
+static size_t
+impl_get_size(const struct spa_handle_factory *factory,
+	      const struct spa_dict *params)
+{
+	return sizeof(struct impl);
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *impl;
+	uint32_t i;
+	int res;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	impl = (struct impl *) handle;
+	impl->system.iface = SPA_INTERFACE_INIT(
+			SPA_TYPE_INTERFACE_System,
+			SPA_VERSION_SYSTEM,
+			&impl_system, impl);
+
+	for (i = 0; i < n_support; i++) {
+		switch (support[i].type) {
+		case SPA_TYPE_INTERFACE_Log:
+			impl->log = support[i].data;
+			break;
+		}
+	}
+
+	pthread_mutex_init(&impl->lock, NULL);
+
+	/* without a ring nothing is queued and all calls go to the kernel */
+	if ((res = ring_init(&impl->ring, RING_ENTRIES)) < 0 ||
+	    (res = ring_probe(&impl->ring)) < 0) {
+		spa_log_warn(impl->log, NAME " %p: io_uring not available, "
+				"batching disabled: %s", impl, spa_strerror(res));
+		ring_clear(&impl->ring);
+	}
+
+	spa_log_debug(impl->log, NAME " %p: initialized", impl);
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE_INTERFACE_System,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	if (*index >= SPA_N_ELEMENTS(impl_interfaces))
+		return 0;
+
+	*info = &impl_interfaces[(*index)++];
+	return 1;
+}
+
+const struct spa_handle_factory spa_support_uring_system_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	SPA_NAME_SUPPORT_SYSTEM,
+	NULL,
+	impl_get_size,
+	impl_init,
+	impl_enum_interface_info
+};
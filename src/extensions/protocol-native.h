@@ -45,6 +45,17 @@ struct pw_protocol_native_message {
 	int seq;
 };
 
+/** The data of a received message that is kept alive after the message
+ * was handled. Pods in the message stay valid until the hold is released. */
+struct pw_protocol_native_hold {
+	void (*release) (struct pw_protocol_native_hold *hold);
+};
+
+static inline void pw_protocol_native_hold_release(struct pw_protocol_native_hold *hold)
+{
+	hold->release(hold);
+}
+
 struct pw_protocol_native_demarshal {
 	int (*func) (void *object, const struct pw_protocol_native_message *msg);
 	uint32_t permissions;
@@ -53,7 +64,7 @@ struct pw_protocol_native_demarshal {
 
 /** \ref pw_protocol_native_ext methods */
 struct pw_protocol_native_ext {
-#define PW_VERSION_PROTOCOL_NATIVE_EXT	0
+#define PW_VERSION_PROTOCOL_NATIVE_EXT	1
 	uint32_t version;
 
 	struct spa_pod_builder * (*begin_proxy) (struct pw_proxy *proxy,
@@ -73,6 +84,12 @@ struct pw_protocol_native_ext {
 
 	int (*end_resource) (struct pw_resource *resource,
 			     struct spa_pod_builder *builder);
+
+	/** Keep the data of the message that is being demarshalled alive
+	 * so that pods can be used without copying them. Returns NULL when
+	 * the message is better copied. Since version 1 */
+	struct pw_protocol_native_hold * (*hold_proxy) (struct pw_proxy *proxy);
+	struct pw_protocol_native_hold * (*hold_resource) (struct pw_resource *resource);
 };
 
 #define pw_protocol_native_begin_proxy(p,...)		pw_protocol_ext(pw_proxy_get_protocol(p),struct pw_protocol_native_ext,begin_proxy,p,__VA_ARGS__)
@@ -84,6 +101,8 @@ struct pw_protocol_native_ext {
 #define pw_protocol_native_add_resource_fd(r,...)	pw_protocol_ext(pw_resource_get_protocol(r),struct pw_protocol_native_ext,add_resource_fd,r,__VA_ARGS__)
 #define pw_protocol_native_get_resource_fd(r,...)	pw_protocol_ext(pw_resource_get_protocol(r),struct pw_protocol_native_ext,get_resource_fd,r,__VA_ARGS__)
 #define pw_protocol_native_end_resource(r,...)		pw_protocol_ext(pw_resource_get_protocol(r),struct pw_protocol_native_ext,end_resource,r,__VA_ARGS__)
+#define pw_protocol_native_hold_proxy(p)		pw_protocol_ext(pw_proxy_get_protocol(p),struct pw_protocol_native_ext,hold_proxy,p)
+#define pw_protocol_native_hold_resource(r)		pw_protocol_ext(pw_resource_get_protocol(r),struct pw_protocol_native_ext,hold_resource,r)
 
 #ifdef __cplusplus
 }  /* extern "C" */
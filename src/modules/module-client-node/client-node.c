@@ -38,6 +38,7 @@
 
 #include <pipewire/pipewire.h>
 #include "pipewire/private.h"
+#include "extensions/protocol-native.h"
 
 #include "modules/spa/spa-node.h"
 #include "client-node.h"
@@ -103,6 +104,7 @@ struct port {
 	unsigned int removed:1;
 	uint32_t n_params;
 	struct spa_pod **params;
+	struct pw_protocol_native_hold *params_hold;
 
 	struct mix mix[MAX_MIX+1];
 };
@@ -134,6 +136,7 @@ struct node {
 
 	uint32_t n_params;
 	struct spa_pod **params;
+	struct pw_protocol_native_hold *params_hold;
 };
 
 struct impl {
@@ -300,9 +303,13 @@ static int impl_node_enum_params(void *object, int seq,
 		if (param == NULL || !spa_pod_is_object_id(param, id))
 			continue;
 
-		spa_pod_builder_init(&b, buffer, sizeof(buffer));
-		if (spa_pod_filter(&b, &result.param, param, filter) != 0)
-			continue;
+		if (filter == NULL) {
+			result.param = param;
+		} else {
+			spa_pod_builder_init(&b, buffer, sizeof(buffer));
+			if (spa_pod_filter(&b, &result.param, param, filter) != 0)
+				continue;
+		}
 
 		pw_log_debug(NAME " %p: %d param %u", this, seq, result.index);
 		spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
@@ -441,6 +448,72 @@ impl_node_sync(void *object, int seq)
 	return pw_resource_ping(this->resource, seq);
 }
 
+static void clear_params(uint32_t n_params, struct spa_pod **params,
+		struct pw_protocol_native_hold *hold)
+{
+	uint32_t i;
+
+	if (hold != NULL) {
+		pw_protocol_native_hold_release(hold);
+		return;
+	}
+	for (i = 0; i < n_params; i++)
+		free(params[i]);
+}
+
+/* params in an update from the client are usually large enumerations,
+ * keep the message data alive and use them in place when the protocol
+ * allows, copy them otherwise. */
+static struct pw_protocol_native_hold *
+set_params(struct node *this, uint32_t n_params,
+		struct spa_pod **dst, const struct spa_pod **src)
+{
+	struct pw_protocol *protocol = NULL;
+	const struct pw_protocol_native_ext *ext = NULL;
+	struct pw_protocol_native_hold *hold = NULL;
+	uint32_t i;
+
+	if (n_params > 0 && this->resource != NULL)
+		protocol = pw_resource_get_protocol(this->resource);
+	if (protocol != NULL)
+		ext = pw_protocol_get_extension(protocol);
+	if (ext != NULL && ext->version >= 1 && ext->hold_resource != NULL)
+		hold = ext->hold_resource(this->resource);
+
+	for (i = 0; i < n_params; i++) {
+		if (src[i] == NULL)
+			dst[i] = NULL;
+		else if (hold != NULL)
+			dst[i] = (struct spa_pod *) src[i];
+		else
+			dst[i] = spa_pod_copy(src[i]);
+	}
+	return hold;
+}
+
+/* compare the EnumFormat params in both sets, in order */
+static bool enum_format_changed(uint32_t n_old, struct spa_pod **old,
+		uint32_t n_new, const struct spa_pod **new)
+{
+	uint32_t i = 0, j = 0;
+
+	while (true) {
+		while (i < n_old && (old[i] == NULL ||
+		    !spa_pod_is_object_id(old[i], SPA_PARAM_EnumFormat)))
+			i++;
+		while (j < n_new && (new[j] == NULL ||
+		    !spa_pod_is_object_id(new[j], SPA_PARAM_EnumFormat)))
+			j++;
+		if (i == n_old || j == n_new)
+			return i != n_old || j != n_new;
+		if (SPA_POD_SIZE(old[i]) != SPA_POD_SIZE(new[j]) ||
+		    memcmp(old[i], new[j], SPA_POD_SIZE(old[i])) != 0)
+			return true;
+		i++;
+		j++;
+	}
+}
+
 static void
 do_update_port(struct node *this,
 	       struct port *port,
@@ -452,20 +525,24 @@ do_update_port(struct node *this,
 	uint32_t i;
 
 	if (change_mask & PW_CLIENT_NODE_PORT_UPDATE_PARAMS) {
+		bool changed;
+
 		port->have_format = false;
 
 		spa_log_debug(this->log, NAME" %p: port %u update %d params", this, port->id, n_params);
-		for (i = 0; i < port->n_params; i++)
-			free(port->params[i]);
+		changed = enum_format_changed(port->n_params, port->params, n_params, params);
+		clear_params(port->n_params, port->params, port->params_hold);
 		port->n_params = n_params;
 		port->params = realloc(port->params, port->n_params * sizeof(struct spa_pod *));
+		port->params_hold = set_params(this, n_params, port->params, params);
 
 		for (i = 0; i < port->n_params; i++) {
-			port->params[i] = params[i] ? spa_pod_copy(params[i]) : NULL;
-
 			if (port->params[i] && spa_pod_is_object_id(port->params[i], SPA_PARAM_Format))
 				port->have_format = true;
 		}
+		/* the params are replaced without a port info */
+		if (changed && port->port)
+			pw_port_clear_enum_format(port->port);
 	}
 
 	if (change_mask & PW_CLIENT_NODE_PORT_UPDATE_INFO) {
@@ -590,9 +667,13 @@ impl_node_port_enum_params(void *object, int seq,
 		if (param == NULL || !spa_pod_is_object_id(param, id))
 			continue;
 
-		spa_pod_builder_init(&b, buffer, sizeof(buffer));
-		if (spa_pod_filter(&b, &result.param, param, filter) < 0)
-			continue;
+		if (filter == NULL) {
+			result.param = param;
+		} else {
+			spa_pod_builder_init(&b, buffer, sizeof(buffer));
+			if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+				continue;
+		}
 
 		pw_log_debug(NAME " %p: %d param %u", this, seq, result.index);
 		spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
@@ -881,7 +962,8 @@ static int impl_node_process(void *object)
 	n->rt.activation->status = PW_NODE_ACTIVATION_TRIGGERED;
 	n->rt.activation->signal_time = SPA_TIMESPEC_TO_NSEC(&ts);
 
-	if (spa_system_eventfd_write(this->data_system, this->writefd, 1) < 0)
+	if (pw_node_activation_wake(n->rt.activation) &&
+	    spa_system_eventfd_write(this->data_system, this->writefd, 1) < 0)
 		spa_log_warn(this->log, NAME" %p: error %m", this);
 
 	return SPA_STATUS_OK;
@@ -916,16 +998,12 @@ client_node_update(void *data,
 	struct node *this = &impl->node;
 
 	if (change_mask & PW_CLIENT_NODE_UPDATE_PARAMS) {
-		uint32_t i;
 		pw_log_debug(NAME" %p: update %d params", this, n_params);
 
-		for (i = 0; i < this->n_params; i++)
-			free(this->params[i]);
+		clear_params(this->n_params, this->params, this->params_hold);
 		this->n_params = n_params;
 		this->params = realloc(this->params, this->n_params * sizeof(struct spa_pod *));
-
-		for (i = 0; i < this->n_params; i++)
-			this->params[i] = params[i] ? spa_pod_copy(params[i]) : NULL;
+		this->params_hold = set_params(this, n_params, this->params, params);
 	}
 	if (change_mask & PW_CLIENT_NODE_UPDATE_INFO) {
 		spa_node_emit_info(&this->hooks, info);
@@ -963,6 +1041,8 @@ client_node_port_update(void *data,
 
 		if (port == NULL) {
 			target = &this->dummy;
+			clear_params(target->n_params, target->params, target->params_hold);
+			free(target->params);
 			spa_zero(this->dummy);
 			target->direction = direction;
 			target->id = port_id;
@@ -1142,10 +1222,7 @@ node_init(struct node *this,
 
 static int node_clear(struct node *this)
 {
-	uint32_t i;
-
-	for (i = 0; i < this->n_params; i++)
-		free(this->params[i]);
+	clear_params(this->n_params, this->params, this->params_hold);
 	free(this->params);
 
 	return 0;
@@ -1163,6 +1240,18 @@ static int do_remove_source(struct spa_loop *loop,
 	return 0;
 }
 
+static int do_add_source(struct spa_loop *loop,
+			 bool async,
+			 uint32_t seq,
+			 const void *data,
+			 size_t size,
+			 void *user_data)
+{
+	struct spa_source *source = user_data;
+	spa_loop_add_source(loop, source);
+	return 0;
+}
+
 static void client_node_resource_destroy(void *data)
 {
 	struct impl *impl = data;
@@ -1248,9 +1337,14 @@ static void node_initialized(void *data)
 	struct pw_client_node *this = &impl->this;
 	struct node *node = &impl->node;
 	struct pw_global *global;
-	struct spa_system *data_system = impl->node.data_system;
+	struct spa_system *data_system;
 	size_t size;
 
+	/* the node can be placed on another data loop than the first one that
+	 * the spa node was made with */
+	node->data_loop = this->node->data_loop->loop;
+	node->data_system = data_system = this->node->data_loop->system;
+
 	impl->fds[0] = spa_system_eventfd_create(data_system, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
 	impl->fds[1] = spa_system_eventfd_create(data_system, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
 	impl->other_fds[0] = impl->fds[1];
@@ -1266,6 +1360,7 @@ static void node_initialized(void *data)
 	impl->io_areas = pw_mempool_alloc(impl->core->pool,
 			PW_MEMBLOCK_FLAG_READWRITE |
 			PW_MEMBLOCK_FLAG_MAP |
+			PW_MEMBLOCK_FLAG_LOCK |
 			PW_MEMBLOCK_FLAG_SEAL,
 			SPA_DATA_MemFd, size);
 	if (impl->io_areas == NULL)
@@ -1585,6 +1680,25 @@ static void node_driver_changed(void *data, struct pw_node *old, struct pw_node
 	node_peer_added(data, driver);
 }
 
+static void node_data_loop_changed(void *data, struct pw_loop *loop)
+{
+	struct impl *impl = data;
+	struct node *this = &impl->node;
+
+	pw_log_debug(NAME " %p: data loop %p -> %p", this, this->data_loop, loop->loop);
+
+	if (this->data_source.fd != -1)
+		spa_loop_invoke(this->data_loop, do_remove_source,
+				SPA_ID_INVALID, NULL, 0, true, &this->data_source);
+
+	this->data_loop = loop->loop;
+	this->data_system = loop->system;
+
+	if (this->data_source.fd != -1)
+		spa_loop_invoke(this->data_loop, do_add_source,
+				SPA_ID_INVALID, NULL, 0, true, &this->data_source);
+}
+
 static const struct pw_node_events node_events = {
 	PW_VERSION_NODE_EVENTS,
 	.free = node_free,
@@ -1595,6 +1709,7 @@ static const struct pw_node_events node_events = {
 	.peer_added = node_peer_added,
 	.peer_removed = node_peer_removed,
 	.driver_changed = node_driver_changed,
+	.data_loop_changed = node_data_loop_changed,
 };
 
 static const struct pw_resource_events resource_events = {
@@ -210,6 +210,7 @@ pw_client_node0_transport_new(struct pw_core *core,
 	impl->mem = pw_mempool_alloc(core->pool,
 			PW_MEMBLOCK_FLAG_READWRITE |
 			PW_MEMBLOCK_FLAG_MAP |
+			PW_MEMBLOCK_FLAG_LOCK |
 			PW_MEMBLOCK_FLAG_SEAL,
 			SPA_DATA_MemFd, area_get_size(&area));
 	if (impl->mem == NULL)
@@ -87,6 +87,7 @@ struct client {
 
 	unsigned int disconnecting:1;
 	unsigned int flushing:1;
+	unsigned int ring:1;
 };
 
 struct server {
@@ -100,6 +101,7 @@ struct server {
 	struct spa_source *source;
 	struct spa_hook hook;
 	unsigned int activated:1;
+	unsigned int ring:1;
 };
 
 struct client_data {
@@ -374,6 +376,8 @@ static struct pw_client *client_new(struct server *s, int fd)
 	if (this->connection == NULL)
 		goto cleanup_client;
 
+	pw_protocol_native_connection_accept_ring(this->connection, s->ring);
+
 	pw_map_init(&this->compat_v2.types, 0, 32);
 
 	pw_protocol_native_connection_add_listener(this->connection,
@@ -699,6 +703,10 @@ static int impl_connect_fd(struct pw_protocol_client *client, int fd, bool do_cl
 		goto error_cleanup;
 	}
 
+	if (impl->ring &&
+	    (res = pw_protocol_native_connection_offer_ring(impl->connection, 0)) < 0)
+		pw_log_warn(NAME" %p: can't offer ring: %s", impl, spa_strerror(res));
+
 	impl->source = pw_loop_add_io(remote->core->main_loop,
 					fd,
 					SPA_IO_IN | SPA_IO_HUP | SPA_IO_ERR,
@@ -748,6 +756,18 @@ static void impl_destroy(struct pw_protocol_client *client)
 	free(impl);
 }
 
+static bool use_ring(const struct pw_properties *props,
+		const struct pw_properties *core_props)
+{
+	const char *str = NULL;
+
+	if (props)
+		str = pw_properties_get(props, PW_KEY_PROTOCOL_RING);
+	if (str == NULL)
+		str = pw_properties_get(core_props, PW_KEY_PROTOCOL_RING);
+	return str && pw_properties_parse_bool(str);
+}
+
 static struct pw_protocol_client *
 impl_new_client(struct pw_protocol *protocol,
 		struct pw_remote *remote,
@@ -769,6 +789,8 @@ impl_new_client(struct pw_protocol *protocol,
 	if (str == NULL)
 		str = "generic";
 
+	impl->ring = use_ring(properties, pw_core_get_properties(remote->core));
+
 	if (!strcmp(str, "screencast"))
 		this->connect = pw_protocol_native_connect_portal_screencast;
 	else
@@ -879,6 +901,8 @@ impl_add_server(struct pw_protocol *protocol,
 
 	pw_loop_add_hook(pw_core_get_main_loop(core), &s->hook, &impl_hooks, s);
 
+	s->ring = use_ring(NULL, pw_core_get_properties(core));
+
 	if ((res = init_socket_name(s, name)) < 0)
 		goto error;
 
@@ -957,6 +981,19 @@ static int impl_ext_end_resource(struct pw_resource *resource,
 	struct pw_client *client = resource->client;
 	return client->send_seq = pw_protocol_native_connection_end(data->connection, builder);
 }
+
+static struct pw_protocol_native_hold *impl_ext_hold_proxy(struct pw_proxy *proxy)
+{
+	struct client *impl = SPA_CONTAINER_OF(proxy->remote->conn, struct client, this);
+	return pw_protocol_native_connection_hold(impl->connection);
+}
+
+static struct pw_protocol_native_hold *impl_ext_hold_resource(struct pw_resource *resource)
+{
+	struct client_data *data = resource->client->user_data;
+	return pw_protocol_native_connection_hold(data->connection);
+}
+
 const static struct pw_protocol_native_ext protocol_ext_impl = {
 	PW_VERSION_PROTOCOL_NATIVE_EXT,
 	.begin_proxy = impl_ext_begin_proxy,
@@ -967,6 +1004,8 @@ const static struct pw_protocol_native_ext protocol_ext_impl = {
 	.add_resource_fd = impl_ext_add_resource_fd,
 	.get_resource_fd = impl_ext_get_resource_fd,
 	.end_resource = impl_ext_end_resource,
+	.hold_proxy = impl_ext_hold_proxy,
+	.hold_resource = impl_ext_hold_resource,
 };
 
 static void module_destroy(void *data)
@@ -0,0 +1,396 @@
+/* PipeWire
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include <spa/pod/builder.h>
+#include <spa/pod/parser.h>
+#include <spa/param/audio/format.h>
+#include <spa/utils/result.h>
+
+#include <pipewire/pipewire.h>
+
+#include "connection.h"
+
+#define N_MESSAGES	(1 << 20)
+#define N_BATCH		32
+#define N_SYNCS		(1 << 16)
+#define N_DUMP		(1 << 16)
+#define DUMP_SIZE	1024
+#define N_UPDATES	(1 << 14)
+#define N_FORMATS	32
+
+#define OP_HELLO	1
+#define OP_SYNC		2
+#define OP_DONE		3
+#define OP_UPDATE	4
+#define OP_QUIT		5
+#define OP_PARAMS	6
+
+struct data {
+	struct pw_core *core;
+	int fds[2];
+
+	struct pw_protocol_native_connection *client;
+	struct pw_protocol_native_connection *server;
+	uint32_t n_received;
+
+	uint8_t formats[N_FORMATS * 512];
+	struct spa_pod *format[N_FORMATS];
+
+	bool hold;
+	struct pw_protocol_native_hold *params_hold;
+	struct spa_pod *params[N_FORMATS];
+};
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void wait_fd(int fd, short events)
+{
+	struct pollfd pfd = { .fd = fd, .events = events };
+	while (poll(&pfd, 1, -1) < 0);
+}
+
+static void send_msg(struct pw_protocol_native_connection *conn,
+		uint8_t opcode, uint32_t val)
+{
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_connection_begin(conn, 0, opcode, NULL);
+	spa_pod_builder_add_struct(b,
+			SPA_POD_Int(0),
+			SPA_POD_Int(val));
+	pw_protocol_native_connection_end(conn, b);
+}
+
+/* like a registry dump or param enumeration, queued without flushing */
+static void send_dump(struct pw_protocol_native_connection *conn, uint32_t val)
+{
+	static uint8_t data[DUMP_SIZE];
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_connection_begin(conn, 0, OP_UPDATE, NULL);
+	spa_pod_builder_add_struct(b,
+			SPA_POD_Int(0),
+			SPA_POD_Int(val),
+			SPA_POD_Bytes(data, sizeof(data)));
+	pw_protocol_native_connection_end(conn, b);
+}
+
+/* a port update with the EnumFormat params of an audio device */
+static void build_formats(struct data *d)
+{
+	static const uint32_t positions[] = {
+		SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR,
+		SPA_AUDIO_CHANNEL_FC, SPA_AUDIO_CHANNEL_LFE,
+		SPA_AUDIO_CHANNEL_RL, SPA_AUDIO_CHANNEL_RR,
+		SPA_AUDIO_CHANNEL_SL, SPA_AUDIO_CHANNEL_SR };
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(d->formats, sizeof(d->formats));
+	uint32_t i, channels;
+
+	for (i = 0; i < N_FORMATS; i++) {
+		channels = i % 8 + 1;
+		d->format[i] = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat,
+			SPA_FORMAT_mediaType,		SPA_POD_Id(SPA_MEDIA_TYPE_audio),
+			SPA_FORMAT_mediaSubtype,	SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+			SPA_FORMAT_AUDIO_format,	SPA_POD_CHOICE_ENUM_Id(9,
+								SPA_AUDIO_FORMAT_S16,
+								SPA_AUDIO_FORMAT_S16,
+								SPA_AUDIO_FORMAT_S16P,
+								SPA_AUDIO_FORMAT_S24,
+								SPA_AUDIO_FORMAT_S24P,
+								SPA_AUDIO_FORMAT_S24_32,
+								SPA_AUDIO_FORMAT_S32,
+								SPA_AUDIO_FORMAT_F32,
+								SPA_AUDIO_FORMAT_F32P),
+			SPA_FORMAT_AUDIO_rate,		SPA_POD_CHOICE_ENUM_Int(7,
+								48000, 44100, 48000, 88200,
+								96000, 176400, 192000),
+			SPA_FORMAT_AUDIO_channels,	SPA_POD_Int(channels),
+			SPA_FORMAT_AUDIO_position,	SPA_POD_Array(sizeof(uint32_t),
+								SPA_TYPE_Id, channels,
+								positions));
+		spa_assert(d->format[i] != NULL);
+	}
+}
+
+static void send_params(struct data *d, uint32_t val)
+{
+	struct spa_pod_builder *b;
+	struct spa_pod_frame f;
+	uint32_t i;
+
+	b = pw_protocol_native_connection_begin(d->client, 0, OP_PARAMS, NULL);
+	spa_pod_builder_push_struct(b, &f);
+	spa_pod_builder_add(b,
+			SPA_POD_Int(0),
+			SPA_POD_Int(val),
+			SPA_POD_Int(N_FORMATS), NULL);
+	for (i = 0; i < N_FORMATS; i++)
+		spa_pod_builder_add(b, SPA_POD_Pod(d->format[i]), NULL);
+	spa_pod_builder_pop(b, &f);
+	pw_protocol_native_connection_end(d->client, b);
+}
+
+static void clear_params(struct data *d)
+{
+	uint32_t i;
+
+	if (d->params_hold) {
+		pw_protocol_native_hold_release(d->params_hold);
+		d->params_hold = NULL;
+	} else {
+		for (i = 0; i < N_FORMATS; i++)
+			free(d->params[i]);
+	}
+	spa_zero(d->params);
+}
+
+/* like the client-node, keep the params of the last update */
+static void handle_params(struct data *d, const struct pw_protocol_native_message *msg)
+{
+	struct spa_pod_parser prs;
+	struct spa_pod_frame f;
+	struct spa_pod *params[N_FORMATS];
+	uint32_t i, id, val, n_params;
+
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+	spa_assert(spa_pod_parser_push_struct(&prs, &f) == 0);
+	spa_assert(spa_pod_parser_get(&prs,
+			SPA_POD_Int(&id),
+			SPA_POD_Int(&val),
+			SPA_POD_Int(&n_params), NULL) == 3);
+	spa_assert(n_params == N_FORMATS);
+	for (i = 0; i < n_params; i++)
+		spa_assert(spa_pod_parser_get(&prs,
+				SPA_POD_PodObject(&params[i]), NULL) == 1);
+
+	clear_params(d);
+	if (d->hold)
+		d->params_hold = pw_protocol_native_connection_hold(d->server);
+	for (i = 0; i < n_params; i++)
+		d->params[i] = d->params_hold ? params[i] : spa_pod_copy(params[i]);
+}
+
+static void flush(struct pw_protocol_native_connection *conn)
+{
+	while (pw_protocol_native_connection_flush(conn) == -EAGAIN)
+		wait_fd(conn->fd, POLLOUT);
+}
+
+/* like the server side of the core, replies to sync with done */
+static void *server_thread(void *user_data)
+{
+	struct data *d = user_data;
+	struct pw_protocol_native_connection *conn = d->server;
+	const struct pw_protocol_native_message *msg;
+	struct spa_pod_parser prs;
+	uint32_t id, seq;
+	bool running = true;
+	int res;
+
+	while (running) {
+		wait_fd(conn->fd, POLLIN);
+
+		while ((res = pw_protocol_native_connection_get_next(conn, &msg)) == 1) {
+			switch (msg->opcode) {
+			case OP_SYNC:
+				spa_pod_parser_init(&prs, msg->data, msg->size);
+				spa_pod_parser_get_struct(&prs,
+						SPA_POD_Int(&id),
+						SPA_POD_Int(&seq));
+				send_msg(conn, OP_DONE, seq);
+				break;
+			case OP_UPDATE:
+				d->n_received++;
+				break;
+			case OP_PARAMS:
+				handle_params(d, msg);
+				d->n_received++;
+				break;
+			case OP_QUIT:
+				running = false;
+				break;
+			}
+		}
+		spa_assert(res == -EAGAIN);
+		flush(conn);
+	}
+	return NULL;
+}
+
+static void wait_done(struct pw_protocol_native_connection *conn, uint32_t seq)
+{
+	const struct pw_protocol_native_message *msg;
+	struct spa_pod_parser prs;
+	uint32_t id, val;
+	int res;
+
+	while (true) {
+		res = pw_protocol_native_connection_get_next(conn, &msg);
+		if (res == -EAGAIN) {
+			wait_fd(conn->fd, POLLIN);
+			continue;
+		}
+		spa_assert(res == 1);
+		if (msg->opcode != OP_DONE)
+			continue;
+		spa_pod_parser_init(&prs, msg->data, msg->size);
+		spa_pod_parser_get_struct(&prs,
+				SPA_POD_Int(&id),
+				SPA_POD_Int(&val));
+		if (val == seq)
+			break;
+	}
+}
+
+static void send_updates(struct data *d, uint32_t seq, bool hold)
+{
+	uint32_t i;
+
+	d->hold = hold;
+	for (i = 0; i < N_UPDATES; i++) {
+		send_params(d, i);
+		if ((i % N_BATCH) == N_BATCH - 1)
+			flush(d->client);
+	}
+	send_msg(d->client, OP_SYNC, seq);
+	flush(d->client);
+	wait_done(d->client, seq);
+}
+
+static void run_test(struct data *d, bool ring)
+{
+	pthread_t thread;
+	uint64_t t1, t2, t3, t4, t5, t6;
+	uint32_t i;
+
+	spa_assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, d->fds) == 0);
+
+	d->client = pw_protocol_native_connection_new(d->core, d->fds[0]);
+	d->server = pw_protocol_native_connection_new(d->core, d->fds[1]);
+	spa_assert(d->client != NULL && d->server != NULL);
+	d->n_received = 0;
+
+	if (ring)
+		spa_assert(pw_protocol_native_connection_offer_ring(d->client, 0) == 0);
+	pw_protocol_native_connection_accept_ring(d->server, true);
+
+	pthread_create(&thread, NULL, server_thread, d);
+
+	send_msg(d->client, OP_HELLO, 0);
+	send_msg(d->client, OP_SYNC, 0);
+	flush(d->client);
+	wait_done(d->client, 0);
+
+	t1 = get_time();
+	for (i = 0; i < N_MESSAGES; i++) {
+		send_msg(d->client, OP_UPDATE, i);
+		if ((i % N_BATCH) == N_BATCH - 1)
+			flush(d->client);
+	}
+	send_msg(d->client, OP_SYNC, 1);
+	flush(d->client);
+	wait_done(d->client, 1);
+	t2 = get_time();
+	spa_assert(d->n_received == N_MESSAGES);
+
+	for (i = 0; i < N_SYNCS; i++) {
+		send_msg(d->client, OP_SYNC, i + 2);
+		flush(d->client);
+		wait_done(d->client, i + 2);
+	}
+	t3 = get_time();
+
+	for (i = 0; i < N_DUMP; i++)
+		send_dump(d->client, i);
+	send_msg(d->client, OP_SYNC, 2 + N_SYNCS);
+	flush(d->client);
+	wait_done(d->client, 2 + N_SYNCS);
+	t4 = get_time();
+	spa_assert(d->n_received == N_MESSAGES + N_DUMP);
+
+	/* copy and then hold the params of port updates */
+	send_updates(d, 3 + N_SYNCS, false);
+	t5 = get_time();
+	send_updates(d, 4 + N_SYNCS, true);
+	t6 = get_time();
+	spa_assert(d->n_received == N_MESSAGES + N_DUMP + 2 * N_UPDATES);
+	spa_assert(d->params_hold != NULL);
+	for (i = 0; i < N_FORMATS; i++)
+		spa_assert(memcmp(d->params[i], d->format[i], SPA_POD_SIZE(d->format[i])) == 0);
+	clear_params(d);
+
+	send_msg(d->client, OP_QUIT, 0);
+	flush(d->client);
+	pthread_join(thread, NULL);
+
+	fprintf(stderr, "%s: %f messages/sec, sync round trip %f usec, dump %f MB/sec\n",
+			ring ? "ring  " : "socket",
+			(double)N_MESSAGES * SPA_NSEC_PER_SEC / (t2 - t1),
+			(double)(t3 - t2) / N_SYNCS / SPA_NSEC_PER_USEC,
+			(double)N_DUMP * DUMP_SIZE * SPA_NSEC_PER_SEC / (t4 - t3) / (1024 * 1024));
+	fprintf(stderr, "%s: %d EnumFormat params: copy %f updates/sec, hold %f updates/sec\n",
+			ring ? "ring  " : "socket", N_FORMATS,
+			(double)N_UPDATES * SPA_NSEC_PER_SEC / (t5 - t4),
+			(double)N_UPDATES * SPA_NSEC_PER_SEC / (t6 - t5));
+
+	pw_protocol_native_connection_destroy(d->client);
+	pw_protocol_native_connection_destroy(d->server);
+	close(d->fds[0]);
+	close(d->fds[1]);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_main_loop *loop;
+	struct data data = { 0, };
+
+	pw_init(&argc, &argv);
+
+	build_formats(&data);
+
+	loop = pw_main_loop_new(NULL);
+	data.core = pw_core_new(pw_main_loop_get_loop(loop), NULL, 0);
+
+	run_test(&data, false);
+	run_test(&data, true);
+
+	pw_core_destroy(data.core);
+	pw_main_loop_destroy(loop);
+
+	return 0;
+}
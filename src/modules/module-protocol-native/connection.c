@@ -28,9 +28,12 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 
 #include <spa/debug/pod.h>
+#include <spa/utils/ringbuffer.h>
 
 #include <pipewire/pipewire.h>
 #include "pipewire/private.h"
@@ -39,12 +42,68 @@
 
 #define MAX_BUFFER_SIZE (1024 * 32)
 #define MAX_FDS 1024
-#define MAX_FDS_MSG 28
+#define MAX_FDS_MSG 28u
+#define MAX_IOV 64
 
 #define HDR_SIZE	16
 
+#define HOLD_MIN_SIZE	1024	/* smaller messages are copied by the caller */
+#define HOLD_MAX_WASTE	8	/* max ratio of held memory and message size */
+
+#define RING_MAGIC		0x474e4952	/* "RING" */
+#define RING_VERSION		0
+#define RING_MIN_SIZE		(1024u * 4)
+#define RING_MAX_SIZE		(1024u * 1024)
+#define RING_DEFAULT_SIZE	(1024u * 64)
+
+/* connection level messages, sent with SPA_ID_INVALID as the id */
+#define RING_OP_ACCEPT		0	/* the offered rings are used from the next message */
+#define RING_OP_WAKEUP		1	/* new messages were published in the ring */
+
 static bool debug_messages = 0;
 
+/** One direction of the shared memory transport. Only complete messages,
+ * with the same header as on the socket, are published. */
+struct ring {
+	struct spa_ringbuffer rb;
+	uint32_t armed;			/**< the reader ran out of messages and needs
+					  *  a wakeup on the socket */
+	uint32_t sent;			/**< total bytes the writer sent on the socket */
+	uint32_t padding[12];
+};
+
+/** Layout of the memfd offered by the client, followed by the two data areas */
+struct ring_area {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;			/**< size of each data area, a power of 2 */
+	uint32_t padding[13];
+	struct ring ring[2];		/**< client to server and server to client */
+};
+
+/** A chunk of queued output, messages never span blocks */
+struct block {
+	struct spa_list link;
+	uint8_t *data;
+	size_t maxsize;
+	size_t size;			/**< queued bytes */
+	size_t sent;			/**< bytes already sent */
+};
+
+/** The fds of a queued message */
+struct fd_mark {
+	uint64_t start;			/**< stream position of the start of the message */
+	uint64_t end;			/**< stream position of the end of the message */
+	uint32_t n_fds;			/**< fds that still need to be sent */
+};
+
+/** Received data that is kept alive after the connection moved on */
+struct hold {
+	struct pw_protocol_native_hold hold;
+	int refcount;
+	void *data;
+};
+
 struct buffer {
 	uint8_t *buffer_data;
 	size_t buffer_size;
@@ -68,8 +127,34 @@ struct impl {
 	struct buffer in, out;
 	struct spa_pod_builder builder;
 
+	struct spa_list out_blocks;	/**< data of out */
+	uint64_t queued;		/**< total bytes queued for the socket */
+	uint64_t sent;			/**< total bytes sent on the socket */
+	struct fd_mark marks[MAX_FDS];
+	uint32_t n_marks;
+
 	uint32_t version;
 	size_t hdr_size;
+
+	struct pw_mempool *pool;
+	struct pw_memblock *ring_mem;
+	struct ring_area *area;
+	uint32_t ring_size;
+	struct ring *tx, *rx;
+	void *tx_data, *rx_data;
+	uint32_t tx_index;		/**< written but not yet published */
+	uint32_t tx_published;
+	uint32_t in_seq;		/**< next expected seq over socket and ring */
+	void *rx_msg;
+	size_t rx_msg_size;
+	uint32_t received;		/**< total bytes received from the socket */
+	struct hold *hold;		/**< hold on the data of the current message */
+
+	unsigned int ring_offer:1;	/**< attach the ring to the next message */
+	unsigned int ring_wait:1;	/**< waiting for the peer to accept */
+	unsigned int ring_accept:1;
+	unsigned int ring_check:1;	/**< check the first message for an offer */
+	unsigned int draining:1;	/**< the last get_next returned a message */
 };
 
 /** \endcond */
@@ -135,6 +220,13 @@ static void *connection_ensure_size(struct pw_protocol_native_connection *conn,
 {
 	int res;
 
+	if (buf->buffer_size + size > buf->buffer_maxsize && buf->offset > 0) {
+		/* the last message was handled, move the partial message to
+		 * the start instead of growing the buffer */
+		buf->buffer_size -= buf->offset;
+		memmove(buf->buffer_data, buf->buffer_data + buf->offset, buf->buffer_size);
+		buf->offset = 0;
+	}
 	if (buf->buffer_size + size > buf->buffer_maxsize) {
 		buf->buffer_maxsize = SPA_ROUND_UP_N(buf->buffer_size + size, MAX_BUFFER_SIZE);
 		buf->buffer_data = realloc(buf->buffer_data, buf->buffer_maxsize);
@@ -153,15 +245,84 @@ static void *connection_ensure_size(struct pw_protocol_native_connection *conn,
 	return (uint8_t *) buf->buffer_data + buf->buffer_size;
 }
 
+static struct block *block_new(size_t size)
+{
+	struct block *b;
+
+	if ((b = calloc(1, sizeof(struct block))) == NULL)
+		return NULL;
+	b->maxsize = SPA_ROUND_UP_N(size, MAX_BUFFER_SIZE);
+	if ((b->data = malloc(b->maxsize)) == NULL) {
+		free(b);
+		return NULL;
+	}
+	return b;
+}
+
+static void block_free(struct block *b)
+{
+	spa_list_remove(&b->link);
+	free(b->data);
+	free(b);
+}
+
+/* get room for \a size bytes at the end of the output. The last \a keep bytes
+ * of that room, a partially written message, are preserved. Instead of
+ * growing one buffer, a new block is started so that queued data is
+ * never moved. */
+static void *out_ensure_size(struct impl *impl, size_t size, size_t keep)
+{
+	struct block *b, *nb;
+	int res;
+
+	b = spa_list_last(&impl->out_blocks, struct block, link);
+	if (b->size + size <= b->maxsize)
+		return b->data + b->size;
+
+	if (b->size == 0) {
+		size_t maxsize = SPA_ROUND_UP_N(size, MAX_BUFFER_SIZE);
+		void *data = realloc(b->data, maxsize);
+		if (data == NULL)
+			goto error;
+		b->data = data;
+		b->maxsize = maxsize;
+	} else {
+		if ((nb = block_new(size)) == NULL)
+			goto error;
+		memcpy(nb->data, b->data + b->size, SPA_MIN(keep, b->maxsize - b->size));
+		spa_list_append(&impl->out_blocks, &nb->link);
+		b = nb;
+	}
+	pw_log_trace("connection %p: new block of %zd for %zd", &impl->this, b->maxsize, size);
+	return b->data + b->size;
+
+error:
+	res = -errno;
+	spa_hook_list_call(&impl->this.listener_list,
+			struct pw_protocol_native_connection_events,
+			error, 0, -res);
+	errno = -res;
+	return NULL;
+}
+
+static void out_commit(struct impl *impl, size_t size)
+{
+	struct block *b = spa_list_last(&impl->out_blocks, struct block, link);
+	b->size += size;
+	impl->queued += size;
+}
+
 static int refill_buffer(struct pw_protocol_native_connection *conn, struct buffer *buf)
 {
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 	ssize_t len;
 	struct cmsghdr *cmsg;
 	struct msghdr msg = { 0 };
 	struct iovec iov[1];
 	char cmsgbuf[CMSG_SPACE(MAX_FDS_MSG * sizeof(int))];
-	int n_fds = 0;
+	int n_fds = 0, i, *fds;
 	size_t avail;
+	bool overflow = false;
 
 	avail = buf->buffer_maxsize - buf->buffer_size;
 
@@ -188,6 +349,7 @@ static int refill_buffer(struct pw_protocol_native_connection *conn, struct buff
 	}
 
 	buf->buffer_size += len;
+	impl->received += len;
 
 	/* handle control messages */
 	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
@@ -196,15 +358,30 @@ static int refill_buffer(struct pw_protocol_native_connection *conn, struct buff
 
 		n_fds =
 		    (cmsg->cmsg_len - ((char *) CMSG_DATA(cmsg) - (char *) cmsg)) / sizeof(int);
-		memcpy(&buf->fds[buf->n_fds], CMSG_DATA(cmsg), n_fds * sizeof(int));
+		fds = (int *) CMSG_DATA(cmsg);
+
+		/* the fds are ours now, close what does not fit */
+		if (overflow || buf->n_fds + n_fds > MAX_FDS) {
+			for (i = 0; i < n_fds; i++)
+				close(fds[i]);
+			overflow = true;
+			continue;
+		}
+		memcpy(&buf->fds[buf->n_fds], fds, n_fds * sizeof(int));
 		buf->n_fds += n_fds;
 	}
+	if (overflow)
+		goto too_many_fds;
+
 	pw_log_trace("connection %p: %d read %zd bytes and %d fds", conn, conn->fd, len,
 		     n_fds);
 
 	return 0;
 
 	/* ERRORS */
+too_many_fds:
+	pw_log_error("connection %p: fd:%d received more than %d fds", conn, conn->fd, MAX_FDS);
+	return -EPROTO;
 recv_error:
 	pw_log_error("could not recvmsg on fd:%d: %s", conn->fd, strerror(errno));
 	return -errno;
@@ -218,6 +395,281 @@ static void clear_buffer(struct buffer *buf)
 	buf->fds_offset = 0;
 }
 
+static inline void *ring_data(struct impl *impl, uint32_t idx)
+{
+	return SPA_MEMBER(impl->area, sizeof(struct ring_area) + idx * impl->ring_size, void);
+}
+
+static int ensure_pool(struct impl *impl)
+{
+	if (impl->pool == NULL) {
+		impl->pool = pw_mempool_new(pw_properties_copy(impl->core->properties));
+		if (impl->pool == NULL)
+			return -errno;
+	}
+	return 0;
+}
+
+/* start using the rings, \a idx is the ring we write to */
+static void ring_activate(struct impl *impl, uint32_t idx)
+{
+	impl->tx = &impl->area->ring[idx];
+	impl->tx_data = ring_data(impl, idx);
+	impl->tx_index = impl->tx_published = impl->tx->rb.writeindex;
+	impl->rx = &impl->area->ring[idx ^ 1];
+	impl->rx_data = ring_data(impl, idx ^ 1);
+}
+
+static int ring_write(struct impl *impl, const void *data, uint32_t len)
+{
+	struct ring *r = impl->tx;
+	int32_t filled;
+
+	filled = impl->tx_index - __atomic_load_n(&r->rb.readindex, __ATOMIC_ACQUIRE);
+	if (filled < 0 || (uint32_t)filled > impl->ring_size)
+		return -EPROTO;
+	if (impl->ring_size - filled < len)
+		return -ENOSPC;
+
+	spa_ringbuffer_write_data(&r->rb, impl->tx_data, impl->ring_size,
+			impl->tx_index & (impl->ring_size - 1), data, len);
+	impl->tx_index += len;
+	return 0;
+}
+
+/* make the written messages visible, returns true when the reader needs
+ * a wakeup */
+static bool ring_publish(struct impl *impl)
+{
+	struct ring *r = impl->tx;
+
+	if (impl->tx_index == impl->tx_published)
+		return false;
+
+	spa_ringbuffer_write_update(&r->rb, impl->tx_index);
+	impl->tx_published = impl->tx_index;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return __atomic_exchange_n(&r->armed, 0, __ATOMIC_SEQ_CST) != 0;
+}
+
+/* read the next message from the ring when it is the one we expect,
+ * messages with fds and overflow travel on the socket and are merged back
+ * in order with the seq number. */
+static int ring_read(struct impl *impl)
+{
+	struct ring *r = impl->rx;
+	struct buffer *buf = &impl->in;
+	uint32_t index, size = impl->ring_size, hdr[4], len;
+	int32_t avail;
+
+	avail = spa_ringbuffer_get_read_index(&r->rb, &index);
+	if (avail == 0)
+		return 0;
+	if (avail < HDR_SIZE || (uint32_t)avail > size)
+		return -EPROTO;
+
+	spa_ringbuffer_read_data(&r->rb, impl->rx_data, size,
+			index & (size - 1), hdr, HDR_SIZE);
+	if (hdr[2] != impl->in_seq)
+		return 0;
+
+	len = hdr[1] & 0xffffff;
+	if (len > (uint32_t)avail - HDR_SIZE || hdr[3] != 0)
+		return -EPROTO;
+
+	if (len > impl->rx_msg_size) {
+		size_t s = SPA_ROUND_UP_N(len, 4096);
+		void *d = realloc(impl->rx_msg, s);
+		if (d == NULL)
+			return -errno;
+		impl->rx_msg = d;
+		impl->rx_msg_size = s;
+	}
+	spa_ringbuffer_read_data(&r->rb, impl->rx_data, size,
+			(index + HDR_SIZE) & (size - 1), impl->rx_msg, len);
+	spa_ringbuffer_read_update(&r->rb, index + HDR_SIZE + len);
+
+	buf->msg.id = hdr[0];
+	buf->msg.opcode = hdr[1] >> 24;
+	buf->msg.seq = hdr[2];
+	buf->msg.n_fds = 0;
+	buf->msg.fds = &buf->fds[buf->fds_offset];
+	buf->msg.size = len;
+	buf->msg.data = impl->rx_msg;
+
+	impl->in_seq = (hdr[2] + 1) & SPA_ASYNC_SEQ_MASK;
+	return 1;
+}
+
+/* we are about to sleep on the socket, ask for a wakeup and check again
+ * to not miss messages published in the meantime */
+static int ring_arm(struct impl *impl)
+{
+	__atomic_store_n(&impl->rx->armed, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return ring_read(impl);
+}
+
+static void append_control(struct impl *impl, uint8_t opcode)
+{
+	uint32_t *p;
+
+	if ((p = out_ensure_size(impl, HDR_SIZE, 0)) == NULL)
+		return;
+	p[0] = SPA_ID_INVALID;
+	p[1] = opcode << 24;
+	p[2] = 0;
+	p[3] = 0;
+	out_commit(impl, HDR_SIZE);
+}
+
+/* the first message from the client can carry a ring offer as its only fd */
+static void check_ring_offer(struct impl *impl, struct pw_protocol_native_message *msg)
+{
+	struct pw_protocol_native_connection *conn = &impl->this;
+	struct ring_area hdr;
+	struct pw_memblock *mem;
+	struct pw_memmap *map;
+	struct spa_pod_builder *b;
+	struct stat st;
+	size_t size;
+	bool sealed = true;
+	int fd;
+
+	if (impl->version < 3 || msg->n_fds != 1)
+		return;
+
+	fd = msg->fds[0];
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(hdr) ||
+	    pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	    hdr.magic != RING_MAGIC)
+		return;
+
+	/* it's an offer, the fd is ours now */
+	msg->n_fds = 0;
+
+#ifdef F_GET_SEALS
+	{
+		/* the client must not be able to truncate the memory under us */
+		int seals = fcntl(fd, F_GET_SEALS);
+		sealed = seals >= 0 && (seals & F_SEAL_SHRINK);
+	}
+#endif
+	size = sizeof(hdr) + 2 * (size_t)hdr.size;
+	if (!impl->ring_accept || !sealed ||
+	    hdr.version != RING_VERSION ||
+	    hdr.size < RING_MIN_SIZE || hdr.size > RING_MAX_SIZE ||
+	    (hdr.size & (hdr.size - 1)) != 0 ||
+	    st.st_size < (off_t)size) {
+		pw_log_info("connection %p: ignore ring offer", conn);
+		close(fd);
+		return;
+	}
+	if (ensure_pool(impl) < 0)
+		goto error_close;
+
+	mem = pw_mempool_import(impl->pool, PW_MEMBLOCK_FLAG_READWRITE,
+			SPA_DATA_MemFd, fd);
+	if (mem == NULL)
+		goto error_close;
+
+	map = pw_memblock_map(mem, PW_MEMMAP_FLAG_READWRITE, 0, size, NULL);
+	if (map == NULL) {
+		pw_memblock_unref(mem);
+		return;
+	}
+	impl->ring_mem = mem;
+	impl->area = map->ptr;
+	impl->ring_size = hdr.size;
+
+	/* tell the client on the socket, our messages after this one can
+	 * go through the ring */
+	b = pw_protocol_native_connection_begin(conn, SPA_ID_INVALID, RING_OP_ACCEPT, NULL);
+	pw_protocol_native_connection_end(conn, b);
+	ring_activate(impl, 1);
+
+	pw_log_debug("connection %p: using rings of %u bytes", conn, impl->ring_size);
+	return;
+
+error_close:
+	pw_log_warn("connection %p: can't use ring: %m", conn);
+	close(fd);
+}
+
+/** Offer shared memory rings to the server
+ *
+ * \param conn the connection
+ * \param size the size of each ring or 0 for the default size
+ * \return 0 on success, < 0 on error
+ *
+ * The rings are attached to the next message, which should be the
+ * hello message. Once the server accepts them, messages without fds
+ * are exchanged through the rings and the socket is used for fds and
+ * wakeups only.
+ *
+ * \memberof pw_protocol_native_connection
+ */
+int pw_protocol_native_connection_offer_ring(struct pw_protocol_native_connection *conn,
+		uint32_t size)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct pw_memblock *mem;
+	struct ring_area *a;
+	uint32_t s;
+	int res;
+
+	if (impl->ring_mem != NULL)
+		return -EBUSY;
+
+	if (size == 0)
+		size = RING_DEFAULT_SIZE;
+	size = SPA_CLAMP(size, RING_MIN_SIZE, RING_MAX_SIZE);
+	for (s = RING_MIN_SIZE; s < size; s <<= 1);
+
+	if ((res = ensure_pool(impl)) < 0)
+		return res;
+
+	mem = pw_mempool_alloc(impl->pool,
+			PW_MEMBLOCK_FLAG_READWRITE |
+			PW_MEMBLOCK_FLAG_MAP |
+			PW_MEMBLOCK_FLAG_SEAL,
+			SPA_DATA_MemFd, sizeof(struct ring_area) + 2 * s);
+	if (mem == NULL)
+		return -errno;
+
+	a = mem->map->ptr;
+	spa_zero(*a);
+	a->magic = RING_MAGIC;
+	a->version = RING_VERSION;
+	a->size = s;
+	a->ring[0].armed = a->ring[1].armed = 1;
+
+	impl->ring_mem = mem;
+	impl->area = a;
+	impl->ring_size = s;
+	impl->ring_offer = true;
+
+	return 0;
+}
+
+/** Handle ring offers from the client
+ *
+ * \param conn the connection
+ * \param accept if offered rings should be used
+ *
+ * Offered rings are closed when \a accept is false
+ *
+ * \memberof pw_protocol_native_connection
+ */
+void pw_protocol_native_connection_accept_ring(struct pw_protocol_native_connection *conn,
+		bool accept)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	impl->ring_check = true;
+	impl->ring_accept = accept;
+}
+
 /** Make a new connection object for the given socket
  *
  * \param fd the socket
@@ -229,6 +681,7 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(struct p
 {
 	struct impl *impl;
 	struct pw_protocol_native_connection *this;
+	struct block *b;
 
 	impl = calloc(1, sizeof(struct impl));
 	if (impl == NULL)
@@ -247,20 +700,24 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(struct p
 	impl->hdr_size = HDR_SIZE;
 	impl->version = 3;
 
-	impl->out.buffer_data = calloc(1, MAX_BUFFER_SIZE);
-	impl->out.buffer_maxsize = MAX_BUFFER_SIZE;
+	spa_list_init(&impl->out_blocks);
+	if ((b = block_new(MAX_BUFFER_SIZE)) == NULL)
+		goto no_mem;
+	spa_list_append(&impl->out_blocks, &b->link);
+
 	impl->in.buffer_data = calloc(1, MAX_BUFFER_SIZE);
 	impl->in.buffer_maxsize = MAX_BUFFER_SIZE;
 	impl->in.update = true;
 	impl->in.first = true;
 
-	if (impl->out.buffer_data == NULL || impl->in.buffer_data == NULL)
+	if (impl->in.buffer_data == NULL)
 		goto no_mem;
 
 	return this;
 
 no_mem:
-	free(impl->out.buffer_data);
+	spa_list_consume(b, &impl->out_blocks, link)
+		block_free(b);
 	free(impl->in.buffer_data);
 	free(impl);
 	return NULL;
@@ -275,12 +732,19 @@ no_mem:
 void pw_protocol_native_connection_destroy(struct pw_protocol_native_connection *conn)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct block *b;
 
 	pw_log_debug("connection %p: destroy", conn);
 
 	spa_hook_list_call(&conn->listener_list, struct pw_protocol_native_connection_events, destroy, 0);
 
-	free(impl->out.buffer_data);
+	if (impl->ring_mem)
+		pw_memblock_unref(impl->ring_mem);
+	if (impl->pool)
+		pw_mempool_destroy(impl->pool);
+	free(impl->rx_msg);
+	spa_list_consume(b, &impl->out_blocks, link)
+		block_free(b);
 	free(impl->in.buffer_data);
 	free(impl);
 }
@@ -292,6 +756,18 @@ static int prepare_packet(struct pw_protocol_native_connection *conn, struct buf
 	size_t size, len;
 	uint32_t *p;
 
+	if (buf->offset > 0 && buf->offset >= buf->buffer_size) {
+		/* the fds of a message can arrive with an earlier packet,
+		 * keep the ones we did not use yet. This is done here and
+		 * not after the last message so that its fds stay valid. */
+		uint32_t n_fds = buf->n_fds > buf->fds_offset ?
+			buf->n_fds - buf->fds_offset : 0;
+		if (n_fds > 0)
+			memmove(buf->fds, &buf->fds[buf->fds_offset], n_fds * sizeof(int));
+		clear_buffer(buf);
+		buf->n_fds = n_fds;
+	}
+
 	data = buf->buffer_data + buf->offset;
 	size = buf->buffer_size - buf->offset;
 
@@ -339,12 +815,31 @@ static int prepare_packet(struct pw_protocol_native_connection *conn, struct buf
 	buf->offset += impl->hdr_size + len;
 	buf->fds_offset += buf->msg.n_fds;
 
-	if (buf->offset >= buf->buffer_size)
-		clear_buffer(buf);
 
 	return 0;
 }
 
+static void handle_control(struct impl *impl, const struct pw_protocol_native_message *msg)
+{
+	switch (msg->opcode) {
+	case RING_OP_ACCEPT:
+		if (impl->ring_wait) {
+			impl->ring_wait = false;
+			impl->in_seq = (msg->seq + 1) & SPA_ASYNC_SEQ_MASK;
+			ring_activate(impl, 0);
+			pw_log_debug("connection %p: using rings of %u bytes",
+					&impl->this, impl->ring_size);
+		}
+		break;
+	case RING_OP_WAKEUP:
+		break;
+	default:
+		pw_log_warn("connection %p: unknown control message %u",
+				&impl->this, msg->opcode);
+		break;
+	}
+}
+
 /** Move to the next packet in the connection
  *
  * \param conn the connection
@@ -368,30 +863,141 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 	struct buffer *buf;
 
 	buf = &impl->in;
+	impl->hold = NULL;
 
 	while (1) {
+		if (impl->rx && (res = ring_read(impl)) != 0) {
+			if (res < 0)
+				return res;
+			goto found;
+		}
+
 		len = prepare_packet(conn, buf);
 		if (len < 0)
 			return len;
-		if (len == 0)
+		if (len == 0) {
+			if (buf->msg.id == SPA_ID_INVALID &&
+			    (impl->ring_wait || impl->rx)) {
+				handle_control(impl, &buf->msg);
+				continue;
+			}
 			break;
+		}
 
 		if (connection_ensure_size(conn, buf, len) == NULL)
 			return -errno;
-		if ((res = refill_buffer(conn, buf)) < 0)
-			return res;
+
+		/* while draining, don't poll the socket when the peer did not
+		 * send anything since we last read from it */
+		if (impl->rx && impl->draining &&
+		    __atomic_load_n(&impl->rx->sent, __ATOMIC_ACQUIRE) == impl->received)
+			res = -EAGAIN;
+		else
+			res = refill_buffer(conn, buf);
+
+		if (res < 0) {
+			if (res == -EAGAIN && impl->rx &&
+			    (res = ring_arm(impl)) > 0)
+				goto found;
+			impl->draining = false;
+			return res < 0 ? res : -EAGAIN;
+		}
 	}
+	impl->in_seq = (buf->msg.seq + 1) & SPA_ASYNC_SEQ_MASK;
+
+	if (impl->ring_check) {
+		impl->ring_check = false;
+		check_ring_offer(impl, &buf->msg);
+	}
+found:
+	impl->draining = true;
 	*msg = &buf->msg;
 	return 1;
 }
 
-static inline void *begin_write(struct pw_protocol_native_connection *conn, uint32_t size)
+static void hold_release(struct pw_protocol_native_hold *hold)
+{
+	struct hold *h = SPA_CONTAINER_OF(hold, struct hold, hold);
+	if (--h->refcount > 0)
+		return;
+	free(h->data);
+	free(h);
+}
+
+/** Keep the data of the last message alive
+ *
+ * \param conn the connection
+ * \return a hold on the message data or NULL when the message should be
+ *	copied instead
+ *
+ * The buffer with the last message returned by get_next is handed over
+ * to the hold and the connection continues with a new buffer. Pods in the
+ * message stay valid until the hold is released with
+ * pw_protocol_native_hold_release(). Small messages are not held because
+ * that would keep much more memory alive than a copy.
+ *
+ * \memberof pw_protocol_native_connection
+ */
+struct pw_protocol_native_hold *
+pw_protocol_native_connection_hold(struct pw_protocol_native_connection *conn)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct buffer *buf = &impl->in;
+	struct hold *h;
+	bool ring;
+	size_t maxsize, tail;
+	void *data;
+
+	if ((h = impl->hold) != NULL) {
+		h->refcount++;
+		return &h->hold;
+	}
+	if (!impl->draining)
+		return NULL;
+
+	ring = buf->msg.data == impl->rx_msg;
+	maxsize = ring ? impl->rx_msg_size : buf->buffer_maxsize;
+	if (buf->msg.size < HOLD_MIN_SIZE || buf->msg.size * HOLD_MAX_WASTE < maxsize)
+		return NULL;
+
+	if ((h = calloc(1, sizeof(struct hold))) == NULL)
+		return NULL;
+
+	if (ring) {
+		h->data = impl->rx_msg;
+		impl->rx_msg = NULL;
+		impl->rx_msg_size = 0;
+	} else {
+		/* continue with the data after the message in a new buffer */
+		tail = buf->buffer_size - buf->offset;
+		maxsize = SPA_ROUND_UP_N(SPA_MAX(tail, 1u), MAX_BUFFER_SIZE);
+		if ((data = malloc(maxsize)) == NULL) {
+			free(h);
+			return NULL;
+		}
+		memcpy(data, buf->buffer_data + buf->offset, tail);
+		h->data = buf->buffer_data;
+		buf->buffer_data = data;
+		buf->buffer_maxsize = maxsize;
+		buf->buffer_size = tail;
+		buf->offset = 0;
+	}
+	h->hold.release = hold_release;
+	h->refcount = 1;
+	impl->hold = h;
+
+	pw_log_trace("connection %p: hold %p message of %u bytes", conn, h, buf->msg.size);
+
+	return &h->hold;
+}
+
+static inline void *begin_write(struct pw_protocol_native_connection *conn, uint32_t size,
+		uint32_t keep)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 	uint32_t *p;
-	struct buffer *buf = &impl->out;
 	/* header and size for payload */
-	if ((p = connection_ensure_size(conn, buf, impl->hdr_size + size)) == NULL)
+	if ((p = out_ensure_size(impl, impl->hdr_size + size, impl->hdr_size + keep)) == NULL)
 		return NULL;
 
 	return SPA_MEMBER(p, impl->hdr_size, void);
@@ -401,9 +1007,10 @@ static int builder_overflow(void *data, uint32_t size)
 {
 	struct impl *impl = data;
 	struct spa_pod_builder *b = &impl->builder;
+	uint32_t keep = SPA_MIN(b->state.offset, b->size);
 
 	b->size = SPA_ROUND_UP_N(size, 4096);
-	if ((b->data = begin_write(&impl->this, b->size)) == NULL)
+	if ((b->data = begin_write(&impl->this, b->size, keep)) == NULL)
 		return -errno;
         return 0;
 }
@@ -436,6 +1043,12 @@ pw_protocol_native_connection_begin(struct pw_protocol_native_connection *conn,
 	buf->msg.seq = buf->seq;
 	if (msg)
 		*msg = &buf->msg;
+
+	if (impl->ring_offer) {
+		impl->ring_offer = false;
+		impl->ring_wait = true;
+		pw_protocol_native_connection_add_fd(conn, impl->ring_mem->fd);
+	}
 	return &impl->builder;
 }
 
@@ -444,11 +1057,11 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 				  struct spa_pod_builder *builder)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
-	uint32_t *p, size = builder->state.offset;
+	uint32_t *p, size = builder->state.offset, n_fds;
 	struct buffer *buf = &impl->out;
 	int res;
 
-	if ((p = connection_ensure_size(conn, buf, impl->hdr_size + size)) == NULL)
+	if ((p = out_ensure_size(impl, impl->hdr_size + size, impl->hdr_size + size)) == NULL)
 		return -errno;
 
 	p[0] = buf->msg.id;
@@ -458,11 +1071,25 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 		p[3] = buf->msg.n_fds;
 	}
 
-	buf->buffer_size += impl->hdr_size + size;
-	if (impl->version >= 3)
-		buf->n_fds += buf->msg.n_fds;
-	else
-		buf->n_fds = buf->msg.n_fds;
+	if (impl->tx && buf->msg.n_fds == 0 &&
+	    ring_write(impl, p, impl->hdr_size + size) == 0) {
+		/* published on flush */
+	} else {
+		out_commit(impl, impl->hdr_size + size);
+		if (impl->version >= 3) {
+			n_fds = buf->msg.n_fds;
+			buf->n_fds += n_fds;
+		} else {
+			n_fds = buf->msg.n_fds - buf->n_fds;
+			buf->n_fds = buf->msg.n_fds;
+		}
+		if (n_fds > 0) {
+			impl->marks[impl->n_marks].start = impl->queued - (impl->hdr_size + size);
+			impl->marks[impl->n_marks].end = impl->queued;
+			impl->marks[impl->n_marks].n_fds = n_fds;
+			impl->n_marks++;
+		}
+	}
 
 	if (debug_messages) {
 		fprintf(stderr, ">>>>>>>>> out: id:%d op:%d size:%d seq:%d\n",
@@ -493,36 +1120,76 @@ int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *co
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 	ssize_t sent, outsize;
 	struct msghdr msg = { 0 };
-	struct iovec iov[1];
+	struct iovec iov[MAX_IOV];
 	struct cmsghdr *cmsg;
 	char cmsgbuf[CMSG_SPACE(MAX_FDS_MSG * sizeof(int))];
 	int res = 0, *fds;
-	uint32_t fds_len, n_fds, outfds;
+	uint32_t i, fds_len, n_fds, outfds, n_iov, n_marks, left;
+	struct fd_mark *marks;
+	struct block *b, *t;
 	struct buffer *buf;
-	void *data;
-	size_t size;
+	uint64_t limit;
+	size_t avail;
 
 	buf = &impl->out;
-	data = buf->buffer_data;
-	size = buf->buffer_size;
+
+	/* publish the ring before sending the messages with fds so that the
+	 * peer always sees the messages it needs to keep the order */
+	if (impl->tx && ring_publish(impl))
+		append_control(impl, RING_OP_WAKEUP);
+
 	fds = buf->fds;
 	n_fds = buf->n_fds;
+	marks = impl->marks;
+	n_marks = impl->n_marks;
+
+	while (impl->sent < impl->queued) {
+		/* the fds of a message go in the packet that completes it, older
+		 * peers drop the fds that are left when they run out of data.
+		 * Take the fds of as many messages as fit and stop after the
+		 * last of those messages. */
+		limit = impl->queued;
+		for (i = 0, outfds = 0; i < n_marks; i++) {
+			if (outfds + marks[i].n_fds > MAX_FDS_MSG)
+				break;
+			outfds += marks[i].n_fds;
+		}
+		if (i > 0 && i < n_marks) {
+			limit = marks[i - 1].end;
+		} else if (i == 0 && n_marks > 0) {
+			/* a message with more fds than fit in a packet, send the
+			 * data before it, then the fds in chunks with a part of
+			 * the message, leaving a byte for each chunk after this
+			 * one */
+			if (impl->sent < marks[0].start) {
+				outfds = 0;
+				limit = marks[0].start;
+			} else {
+				left = marks[0].n_fds - MAX_FDS_MSG;
+				outfds = MAX_FDS_MSG;
+				limit = SPA_MAX(marks[0].end - (left + MAX_FDS_MSG - 1) / MAX_FDS_MSG,
+						impl->sent + 1);
+			}
+		}
 
-	while (size > 0) {
-		if (n_fds > MAX_FDS_MSG) {
-			outfds = MAX_FDS_MSG;
-			outsize = SPA_MIN(sizeof(uint32_t), size);
-		} else {
-			outfds = n_fds;
-			outsize = size;
+		/* gather the queued blocks */
+		outsize = 0;
+		n_iov = 0;
+		spa_list_for_each(b, &impl->out_blocks, link) {
+			avail = SPA_MIN(b->size - b->sent, limit - impl->sent - outsize);
+			if (avail == 0)
+				continue;
+			iov[n_iov].iov_base = b->data + b->sent;
+			iov[n_iov].iov_len = avail;
+			outsize += avail;
+			if (++n_iov == MAX_IOV || impl->sent + outsize == limit)
+				break;
 		}
 
 		fds_len = outfds * sizeof(int);
 
-		iov[0].iov_base = data;
-		iov[0].iov_len = outsize;
 		msg.msg_iov = iov;
-		msg.msg_iovlen = 1;
+		msg.msg_iovlen = n_iov;
 
 		if (outfds > 0) {
 			msg.msg_control = cmsgbuf;
@@ -538,6 +1205,12 @@ int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *co
 			msg.msg_controllen = 0;
 		}
 
+		/* announce the bytes before sending, the reader might otherwise
+		 * skip reading them */
+		if (impl->tx)
+			__atomic_store_n(&impl->tx->sent, (uint32_t)(impl->sent + outsize),
+					__ATOMIC_RELEASE);
+
 		while (true) {
 			sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
 			if (sent < 0) {
@@ -545,29 +1218,57 @@ int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *co
 					continue;
 				else {
 					res = -errno;
-					goto exit;
+					sent = 0;
+					break;
 				}
 			}
 			break;
 		}
-		pw_log_trace("connection %p: %d written %zd bytes and %u fds", conn, conn->fd, sent,
-			     outfds);
+		impl->sent += sent;
+		if (impl->tx && sent != outsize)
+			__atomic_store_n(&impl->tx->sent, (uint32_t)impl->sent, __ATOMIC_RELEASE);
+		if (res < 0)
+			goto exit;
+
+		pw_log_trace("connection %p: %d written %zd bytes in %u blocks and %u fds",
+				conn, conn->fd, sent, n_iov, outfds);
+
+		/* release the sent blocks, the last one is reused */
+		spa_list_for_each_safe(b, t, &impl->out_blocks, link) {
+			avail = SPA_MIN(b->size - b->sent, (size_t)sent);
+			b->sent += avail;
+			sent -= avail;
+			if (b->sent < b->size || b->link.next == &impl->out_blocks)
+				break;
+			block_free(b);
+		}
 
-		size -= sent;
-		data = SPA_MEMBER(data, sent, void);
+		/* all fds go with the first byte */
 		n_fds -= outfds;
 		fds += outfds;
+		for (left = outfds; left > 0; ) {
+			if (marks[0].n_fds > left) {
+				marks[0].n_fds -= left;
+				break;
+			}
+			left -= marks[0].n_fds;
+			marks++;
+			n_marks--;
+		}
 	}
 
 	res = 0;
 
 exit:
-	if (size > 0)
-		memmove(buf->buffer_data, data, size);
-	buf->buffer_size = size;
-	if (n_fds > 0)
+	b = spa_list_last(&impl->out_blocks, struct block, link);
+	if (b->sent == b->size)
+		b->size = b->sent = 0;
+	if (n_fds > 0 && fds != buf->fds)
 		memmove(buf->fds, fds, n_fds * sizeof(int));
 	buf->n_fds = n_fds;
+	if (n_marks > 0 && marks != impl->marks)
+		memmove(impl->marks, marks, n_marks * sizeof(struct fd_mark));
+	impl->n_marks = n_marks;
 	return res;
 }
 
@@ -583,7 +1284,16 @@ exit:
 int pw_protocol_native_connection_clear(struct pw_protocol_native_connection *conn)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct block *b, *t;
 
+	spa_list_for_each_safe(b, t, &impl->out_blocks, link) {
+		if (b->link.next == &impl->out_blocks)
+			b->size = b->sent = 0;
+		else
+			block_free(b);
+	}
+	impl->queued = impl->sent;
+	impl->n_marks = 0;
 	clear_buffer(&impl->out);
 	clear_buffer(&impl->in);
 	impl->in.update = true;
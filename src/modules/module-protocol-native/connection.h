@@ -94,6 +94,17 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 int
 pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn);
 
+int
+pw_protocol_native_connection_offer_ring(struct pw_protocol_native_connection *conn,
+					 uint32_t size);
+
+void
+pw_protocol_native_connection_accept_ring(struct pw_protocol_native_connection *conn,
+					  bool accept);
+
+struct pw_protocol_native_hold *
+pw_protocol_native_connection_hold(struct pw_protocol_native_connection *conn);
+
 int
 pw_protocol_native_connection_clear(struct pw_protocol_native_connection *conn);
 
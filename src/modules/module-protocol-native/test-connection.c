@@ -22,6 +22,8 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <string.h>
+#include <unistd.h>
 #include <sys/socket.h>
 
 #include <spa/pod/builder.h>
@@ -120,6 +122,223 @@ static void test_read_write(struct pw_protocol_native_connection *in,
 	spa_assert(read_message(in) == -1);
 }
 
+static void test_many_fds(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out)
+{
+	const struct pw_protocol_native_message *msg;
+	struct spa_pod_builder *b;
+	struct spa_pod_frame f;
+	int i, j, fds[40];
+
+	for (j = 0; j < 40; j++)
+		fds[j] = dup(2);
+
+	/* more fds than fit in one packet, followed by a message with more
+	 * fds than fit in one packet */
+	for (i = 0; i < 11; i++) {
+		int n = i < 10 ? 10 : 40;
+		b = pw_protocol_native_connection_begin(out, 1, 7, NULL);
+		spa_pod_builder_push_struct(b, &f);
+		for (j = 0; j < n; j++)
+			spa_pod_builder_int(b, pw_protocol_native_connection_add_fd(out, fds[j]));
+		spa_pod_builder_pop(b, &f);
+		pw_protocol_native_connection_end(out, b);
+	}
+	spa_assert(pw_protocol_native_connection_flush(out) == 0);
+
+	for (i = 0; i < 11; i++) {
+		int n = i < 10 ? 10 : 40;
+		spa_assert(pw_protocol_native_connection_get_next(in, &msg) == 1);
+		spa_assert(msg->opcode == 7);
+		spa_assert(msg->n_fds == (uint32_t)n);
+		for (j = 0; j < n; j++) {
+			int fd = pw_protocol_native_connection_get_fd(in, j);
+			spa_assert(fd >= 0);
+			close(fd);
+		}
+	}
+	spa_assert(pw_protocol_native_connection_get_next(in, &msg) != 1);
+
+	for (j = 0; j < 40; j++)
+		close(fds[j]);
+}
+
+/* a peer that keeps sending fds for a message it never completes must not
+ * overflow the fd array, the connection fails instead */
+static void test_too_many_fds(struct pw_core *core)
+{
+	struct pw_protocol_native_connection *in;
+	const struct pw_protocol_native_message *msg;
+	struct msghdr m = { 0 };
+	struct iovec iov[1];
+	struct cmsghdr *cmsg;
+	char cmsgbuf[CMSG_SPACE(28 * sizeof(int))];
+	uint32_t hdr[4] = { 1, (7 << 24) | 0xffff, 0, 0 };
+	int i, fds[2], *cfds;
+
+	spa_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	in = pw_protocol_native_connection_new(core, fds[0]);
+	spa_assert(in != NULL);
+
+	spa_assert(write(fds[1], hdr, sizeof(hdr)) == sizeof(hdr));
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = sizeof(uint32_t);
+	m.msg_iov = iov;
+	m.msg_iovlen = 1;
+	m.msg_control = cmsgbuf;
+	m.msg_controllen = sizeof(cmsgbuf);
+	cmsg = CMSG_FIRSTHDR(&m);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(28 * sizeof(int));
+	cfds = (int *) CMSG_DATA(cmsg);
+	for (i = 0; i < 28; i++)
+		cfds[i] = 2;
+
+	/* 37 * 28 fds is more than the 1024 a connection holds */
+	for (i = 0; i < 37; i++)
+		spa_assert(sendmsg(fds[1], &m, 0) == sizeof(uint32_t));
+
+	spa_assert(pw_protocol_native_connection_get_next(in, &msg) == -EPROTO);
+
+	pw_protocol_native_connection_destroy(in);
+	close(fds[1]);
+}
+
+static void test_hold(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out)
+{
+	const struct pw_protocol_native_message *msg;
+	struct pw_protocol_native_hold *hold;
+	struct spa_pod_builder *b;
+	static uint8_t data[8192];
+	const void *d;
+	uint32_t i, size;
+	struct spa_pod_parser prs;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i;
+
+	/* a small and a large message, followed by more data */
+	for (i = 0; i < 4; i++) {
+		b = pw_protocol_native_connection_begin(out, 1, 8, NULL);
+		spa_pod_builder_add_struct(b,
+				SPA_POD_Bytes(data, i == 1 ? sizeof(data) : 16));
+		pw_protocol_native_connection_end(out, b);
+	}
+	spa_assert(pw_protocol_native_connection_flush(out) == 0);
+
+	spa_assert(pw_protocol_native_connection_get_next(in, &msg) == 1);
+	spa_assert(pw_protocol_native_connection_hold(in) == NULL);
+
+	spa_assert(pw_protocol_native_connection_get_next(in, &msg) == 1);
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+	spa_assert(spa_pod_parser_get_struct(&prs,
+			SPA_POD_Bytes(&d, &size)) == 1);
+	spa_assert(size == sizeof(data));
+	hold = pw_protocol_native_connection_hold(in);
+	spa_assert(hold != NULL);
+	spa_assert(pw_protocol_native_connection_hold(in) == hold);
+
+	/* the held data stays valid while the connection moves on */
+	for (i = 0; i < 2; i++) {
+		spa_assert(pw_protocol_native_connection_get_next(in, &msg) == 1);
+		spa_assert(msg->opcode == 8);
+	}
+	spa_assert(pw_protocol_native_connection_get_next(in, &msg) != 1);
+	test_read_write(in, out);
+	spa_assert(memcmp(d, data, sizeof(data)) == 0);
+
+	pw_protocol_native_hold_release(hold);
+	spa_assert(memcmp(d, data, sizeof(data)) == 0);
+	pw_protocol_native_hold_release(hold);
+}
+
+static void write_ring_message(struct pw_protocol_native_connection *conn, int i)
+{
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_connection_begin(conn, 1, 6, NULL);
+	spa_assert(b != NULL);
+	/* every third message has an fd and needs to go over the socket */
+	spa_pod_builder_add_struct(b,
+			SPA_POD_Int(i),
+			SPA_POD_Int(i % 3 ? SPA_IDX_INVALID :
+				pw_protocol_native_connection_add_fd(conn, 1)));
+	pw_protocol_native_connection_end(conn, b);
+}
+
+static int read_ring_message(struct pw_protocol_native_connection *conn)
+{
+	struct spa_pod_parser prs;
+	const struct pw_protocol_native_message *msg;
+	uint32_t v_int, fdidx;
+	int res;
+
+	res = pw_protocol_native_connection_get_next(conn, &msg);
+	if (res != 1)
+		return -1;
+
+	spa_assert(msg->opcode == 6);
+	spa_assert(msg->id == 1);
+
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+	if (spa_pod_parser_get_struct(&prs,
+			SPA_POD_Int(&v_int),
+			SPA_POD_Int(&fdidx)) < 0)
+		spa_assert_not_reached();
+
+	spa_assert((v_int % 3 == 0) == (msg->n_fds == 1));
+	if (msg->n_fds > 0)
+		close(pw_protocol_native_connection_get_fd(conn, fdidx));
+	return v_int;
+}
+
+static void test_ring(struct pw_core *core)
+{
+	struct pw_protocol_native_connection *client, *server;
+	const struct pw_protocol_native_message *msg;
+	int fds[2], i, j;
+
+	spa_assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+
+	client = pw_protocol_native_connection_new(core, fds[0]);
+	spa_assert(client != NULL);
+	server = pw_protocol_native_connection_new(core, fds[1]);
+	spa_assert(server != NULL);
+
+	spa_assert(pw_protocol_native_connection_offer_ring(client, 0) == 0);
+	pw_protocol_native_connection_accept_ring(server, true);
+
+	/* the offer goes with the first message and is not seen by the reader */
+	write_ring_message(client, 1);
+	pw_protocol_native_connection_flush(client);
+	spa_assert(pw_protocol_native_connection_get_next(server, &msg) == 1);
+	spa_assert(msg->n_fds == 0);
+	pw_protocol_native_connection_flush(server);
+	spa_assert(pw_protocol_native_connection_get_next(client, &msg) == -EAGAIN);
+
+	/* messages with and without fds arrive in order in both directions */
+	for (i = 0; i < 2; i++) {
+		struct pw_protocol_native_connection *out = i ? server : client;
+		struct pw_protocol_native_connection *in = i ? client : server;
+
+		for (j = 0; j < 100; j++)
+			write_ring_message(out, j);
+		pw_protocol_native_connection_flush(out);
+
+		for (j = 0; j < 100; j++)
+			spa_assert(read_ring_message(in) == j);
+		spa_assert(read_ring_message(in) == -1);
+	}
+
+	pw_protocol_native_connection_destroy(client);
+	pw_protocol_native_connection_destroy(server);
+	close(fds[0]);
+	close(fds[1]);
+}
+
 int main(int argc, char *argv[])
 {
 	struct pw_main_loop *loop;
@@ -145,6 +364,10 @@ int main(int argc, char *argv[])
 	test_create(in);
 	test_create(out);
 	test_read_write(in, out);
+	test_many_fds(in, out);
+	test_too_many_fds(core);
+	test_hold(in, out);
+	test_ring(core);
 
 	return 0;
 }
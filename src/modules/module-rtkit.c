@@ -48,11 +48,13 @@ static const struct spa_dict_item module_props[] = {
 	{ PW_KEY_MODULE_VERSION, PACKAGE_VERSION },
 };
 
+#define MAX_LOOPS	16
+
 struct impl {
 	struct pw_core *core;
 
-	struct spa_loop *loop;
-	struct spa_source source;
+	uint32_t n_sources;
+	struct spa_source sources[MAX_LOOPS];
 
 	struct spa_hook module_listener;
 };
@@ -400,19 +402,22 @@ static int do_remove_source(struct spa_loop *loop,
 static void module_destroy(void *data)
 {
 	struct impl *impl = data;
+	uint32_t i;
 
 	spa_hook_remove(&impl->module_listener);
 
-	if (impl->source.fd != -1) {
-		spa_loop_invoke(impl->loop,
+	for (i = 0; i < impl->n_sources; i++) {
+		struct spa_source *source = &impl->sources[i];
+
+		spa_loop_invoke(source->loop,
 				do_remove_source,
 				SPA_ID_INVALID,
 				NULL,
 				0,
 				true,
-				&impl->source);
-		close(impl->source.fd);
-		impl->source.fd = -1;
+				source);
+		close(source->fd);
+		source->fd = -1;
 	}
 	free(impl);
 }
@@ -424,7 +429,6 @@ static const struct pw_module_events module_events = {
 
 static void idle_func(struct spa_source *source)
 {
-	struct impl *impl = source->data;
 	struct sched_param sp;
 	struct pw_rtkit_bus *system_bus;
 	struct rlimit rl;
@@ -432,7 +436,7 @@ static void idle_func(struct spa_source *source)
 	long long rttime;
 	uint64_t count;
 
-	read(impl->source.fd, &count, sizeof(uint64_t));
+	read(source->fd, &count, sizeof(uint64_t));
 
 	rtprio = 20;
 	rttime = 20000;
@@ -477,15 +481,12 @@ int pipewire__module_init(struct pw_module *module, const char *args)
 {
 	struct pw_core *core = pw_module_get_core(module);
 	struct impl *impl;
-	struct spa_loop *loop;
-	const struct spa_support *support;
-	uint32_t n_support;
+	struct pw_loop *loop;
+	uint32_t i, n_loops;
 	int res;
 
-	support = pw_core_get_support(core, &n_support);
-
-	loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
-        if (loop == NULL)
+	n_loops = SPA_MIN(pw_core_get_n_data_loops(core), MAX_LOOPS);
+        if (n_loops == 0)
                 return -ENOTSUP;
 
 	impl = calloc(1, sizeof(struct impl));
@@ -495,19 +496,25 @@ int pipewire__module_init(struct pw_module *module, const char *args)
 	pw_log_debug("module %p: new", impl);
 
 	impl->core = core;
-	impl->loop = loop;
-
-	impl->source.loop = loop;
-	impl->source.func = idle_func;
-	impl->source.data = impl;
-	impl->source.fd = eventfd(1, EFD_CLOEXEC | EFD_NONBLOCK);
-	impl->source.mask = SPA_IO_IN;
-	if (impl->source.fd == -1) {
-		res = -errno;
-		goto error;
-	}
 
-	spa_loop_add_source(impl->loop, &impl->source);
+	/* make the thread of each data loop realtime */
+	for (i = 0; i < n_loops; i++) {
+		struct spa_source *source = &impl->sources[i];
+
+		loop = pw_core_get_data_loop(core, i);
+
+		source->loop = loop->loop;
+		source->func = idle_func;
+		source->data = impl;
+		source->fd = eventfd(1, EFD_CLOEXEC | EFD_NONBLOCK);
+		source->mask = SPA_IO_IN;
+		if (source->fd == -1) {
+			res = -errno;
+			goto error;
+		}
+		spa_loop_add_source(loop->loop, source);
+		impl->n_sources++;
+	}
 
 	pw_module_add_listener(module, &impl->module_listener, &module_events, impl);
 
@@ -516,6 +523,11 @@ int pipewire__module_init(struct pw_module *module, const char *args)
 	return 0;
 
 error:
+	for (i = 0; i < impl->n_sources; i++) {
+		spa_loop_invoke(impl->sources[i].loop, do_remove_source,
+				SPA_ID_INVALID, NULL, 0, true, &impl->sources[i]);
+		close(impl->sources[i].fd);
+	}
 	free(impl);
 	return res;
 }
@@ -236,7 +236,8 @@ static void pool_added(void *data, struct pw_memblock *block)
 	if (client->core_resource) {
 		pw_core_resource_add_mem(client->core_resource,
 				block->id, block->type, block->fd,
-				block->flags & PW_MEMBLOCK_FLAG_READWRITE);
+				block->flags & (PW_MEMBLOCK_FLAG_READWRITE |
+					PW_MEMBLOCK_FLAG_LOCK));
 	}
 }
 
@@ -319,7 +320,7 @@ struct pw_client *pw_client_new(struct pw_core *core,
 	p->id = SPA_ID_INVALID;
 	p->permissions = 0;
 
-	this->pool = pw_mempool_new(NULL);
+	this->pool = pw_mempool_new(pw_properties_copy(core->properties));
 	if (this->pool == NULL) {
 		res = -errno;
 		goto error_clear_array;
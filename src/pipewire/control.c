@@ -188,6 +188,7 @@ int pw_control_add_link(struct pw_control *control, uint32_t cmix,
 		impl->mem = pw_mempool_alloc(control->core->pool,
 						PW_MEMBLOCK_FLAG_READWRITE |
 						PW_MEMBLOCK_FLAG_SEAL |
+						PW_MEMBLOCK_FLAG_LOCK |
 						PW_MEMBLOCK_FLAG_MAP,
 						SPA_DATA_MemFd, size);
 		if (impl->mem == NULL) {
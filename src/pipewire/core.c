@@ -32,6 +32,7 @@
 #include <spa/support/cpu.h>
 #include <spa/support/dbus.h>
 #include <spa/node/utils.h>
+#include <spa/pod/filter.h>
 #include <spa/utils/names.h>
 #include <spa/debug/format.h>
 #include <spa/debug/types.h>
@@ -54,6 +55,7 @@
 struct impl {
 	struct pw_core this;
 	struct spa_handle *dbus_handle;
+	struct spa_source *profiler_event;
 };
 
 
@@ -461,6 +463,135 @@ static const struct pw_global_events global_events = {
 	.destroy = global_destroy,
 };
 
+/* runs from the main loop once the daemon loaded its configuration, the
+ * profiler file has the name of the socket so it is only created when
+ * this daemon owns the socket */
+static void start_profiler(void *data, uint64_t count)
+{
+	struct pw_core *core = data;
+	struct impl *impl = SPA_CONTAINER_OF(core, struct impl, this);
+	struct pw_protocol *protocol;
+	struct pw_profiler *profiler;
+	bool have_server = false;
+
+	pw_loop_destroy_source(core->main_loop, impl->profiler_event);
+	impl->profiler_event = NULL;
+
+	spa_list_for_each(protocol, &core->protocol_list, link)
+		have_server |= !spa_list_is_empty(&protocol->server_list);
+	if (!have_server) {
+		pw_log_info(NAME" %p: no server socket, not starting profiler", core);
+		return;
+	}
+
+	if ((profiler = pw_profiler_new(core->info.name)) == NULL) {
+		pw_log_warn(NAME" %p: can't create profiler: %m", core);
+		return;
+	}
+	/* the data loops are already running */
+	__atomic_store_n(&core->profiler, profiler, __ATOMIC_RELEASE);
+}
+
+/** Check the load of the drivers and adapt their quantum
+ *
+ * \param core a core object with core.quantum-adapt enabled
+ * \return the number of drivers with a new quantum
+ *
+ * This runs every core.quantum-adapt.interval msec on the main loop. With
+ * an interval of 0 it only runs when called.
+ *
+ * \memberof pw_core
+ */
+SPA_EXPORT
+int pw_core_adapt_quantum(struct pw_core *core)
+{
+	struct pw_quantum_adapt *adapt = &core->quantum_adapt;
+	struct pw_node *n;
+	int changed = 0;
+
+	if (!core->quantum_adapt_enabled)
+		return 0;
+
+	spa_list_for_each(n, &core->driver_list, driver_link) {
+		struct pw_node_activation *a = n->rt.activation;
+		uint32_t quantum, max_quantum;
+
+		if (!n->master || !n->active || a == NULL) {
+			spa_zero(n->adapt);
+			continue;
+		}
+		max_quantum = n->max_quantum ? n->max_quantum : adapt->max_quantum;
+
+		quantum = n->adapt.quantum;
+		if (pw_quantum_adapt_update(adapt, &n->adapt, n->quantum_current,
+				max_quantum, a->cpu_load[1], a->xrun_count) != quantum) {
+			pw_log_info(NAME" %p: driver %p '%s' load:%f adapt quantum %u -> %u",
+					core, n, n->name, a->cpu_load[1],
+					quantum, n->adapt.quantum);
+			changed++;
+		}
+	}
+	if (changed)
+		pw_core_recalc_graph(core);
+
+	return changed;
+}
+
+static void adapt_timeout(void *data, uint64_t expirations)
+{
+	pw_core_adapt_quantum(data);
+}
+
+static void check_quantum_adapt(struct pw_core *this)
+{
+	struct pw_quantum_adapt *adapt = &this->quantum_adapt;
+	struct pw_properties *props = this->properties;
+	struct timespec value;
+	const char *str;
+
+	if ((str = pw_properties_get(props, PW_KEY_CORE_QUANTUM_ADAPT)) == NULL ||
+	    !pw_properties_parse_bool(str))
+		return;
+
+	adapt->high_load = 0.75f;
+	adapt->low_load = 0.3f;
+	adapt->hold = 4;
+	adapt->max_quantum = DEFAULT_QUANTUM;
+	adapt->interval = 500;
+
+	if ((str = pw_properties_get(props, PW_KEY_CORE_QUANTUM_ADAPT ".high-load")))
+		adapt->high_load = pw_properties_parse_float(str);
+	if ((str = pw_properties_get(props, PW_KEY_CORE_QUANTUM_ADAPT ".low-load")))
+		adapt->low_load = pw_properties_parse_float(str);
+	if ((str = pw_properties_get(props, PW_KEY_CORE_QUANTUM_ADAPT ".hold")))
+		adapt->hold = SPA_MAX(pw_properties_parse_int(str), 1);
+	if ((str = pw_properties_get(props, PW_KEY_CORE_QUANTUM_ADAPT ".max-quantum")))
+		adapt->max_quantum = SPA_CLAMP((uint32_t)pw_properties_parse_int(str),
+				MIN_QUANTUM, MAX_QUANTUM);
+	if ((str = pw_properties_get(props, PW_KEY_CORE_QUANTUM_ADAPT ".interval"))) {
+		adapt->interval = pw_properties_parse_int(str);
+		if (adapt->interval > 0)
+			adapt->interval = SPA_MAX(adapt->interval, 10u);
+	}
+
+	pw_log_info(NAME" %p: quantum adapt load:%f/%f hold:%u max:%u interval:%u", this,
+			adapt->low_load, adapt->high_load, adapt->hold,
+			adapt->max_quantum, adapt->interval);
+
+	this->quantum_adapt_enabled = true;
+	if (adapt->interval == 0)
+		return;
+
+	this->adapt_timer = pw_loop_add_timer(this->main_loop, adapt_timeout, this);
+	if (this->adapt_timer == NULL) {
+		pw_log_warn(NAME" %p: can't create quantum adapt timer: %m", this);
+		return;
+	}
+	value.tv_sec = adapt->interval / 1000;
+	value.tv_nsec = (adapt->interval % 1000) * SPA_NSEC_PER_MSEC;
+	pw_loop_update_timer(this->main_loop, this->adapt_timer, &value, &value, false);
+}
+
 /** Create a new core object
  *
  * \param main_loop the main loop to use
@@ -469,6 +600,16 @@ static const struct pw_global_events global_events = {
  *
  * \memberof pw_core
  */
+/* stop the loop before its executor, the loop runs the regions */
+static void destroy_data_loop(struct pw_data_loop *loop)
+{
+	struct pw_executor *executor = loop->executor;
+
+	pw_data_loop_destroy(loop);
+	if (executor)
+		pw_executor_destroy(executor);
+}
+
 SPA_EXPORT
 struct pw_core *pw_core_new(struct pw_loop *main_loop,
 			    struct pw_properties *properties,
@@ -478,7 +619,8 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop,
 	struct pw_core *this;
 	const char *name, *lib, *str;
 	void *dbus_iface = NULL;
-	uint32_t n_support;
+	uint32_t i, n_support, n_data_loops;
+	int n_workers;
 	struct pw_properties *pr;
 	struct spa_cpu *cpu;
 	int res = 0;
@@ -509,13 +651,45 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop,
 	if ((str = pw_properties_get(pr, "core.data-loop." PW_KEY_LIBRARY_NAME_SYSTEM)))
 		pw_properties_set(pr, PW_KEY_LIBRARY_NAME_SYSTEM, str);
 
-	this->data_loop_impl = pw_data_loop_new(pr);
-	if (this->data_loop_impl == NULL)  {
-		res = -errno;
-		goto error_free;
+	n_data_loops = 1;
+	if ((str = pw_properties_get(properties, PW_KEY_CORE_DATA_LOOPS)))
+		n_data_loops = SPA_CLAMP(pw_properties_parse_int(str), 1, MAX_DATA_LOOPS);
+
+	for (i = 0; i < n_data_loops; i++) {
+		struct pw_properties *lp = pw_properties_copy(pr);
+		char key[64];
+
+		snprintf(key, sizeof(key), "core.data-loop.%u." PW_KEY_CPU_AFFINITY, i);
+		if ((str = pw_properties_get(properties, key)))
+			pw_properties_set(lp, PW_KEY_CPU_AFFINITY, str);
+
+		this->data_loops[i] = pw_data_loop_new(lp);
+		if (this->data_loops[i] == NULL)  {
+			res = -errno;
+			pw_properties_free(pr);
+			goto error_free_loop;
+		}
+		this->n_data_loops++;
+	}
+	pw_properties_free(pr);
+
+	pw_log_debug(NAME" %p: %u data loops", this, this->n_data_loops);
+
+	/* each data loop gets its own workers so that the graphs of the loops
+	 * never run each other's branches */
+	if ((str = pw_properties_get(properties, PW_KEY_CORE_GRAPH_WORKERS)) &&
+	    (n_workers = pw_properties_parse_int(str)) > 0) {
+		for (i = 0; i < this->n_data_loops; i++) {
+			struct pw_executor *e = pw_executor_new(n_workers);
+			if (e == NULL)
+				pw_log_warn(NAME" %p: can't create executor: %m", this);
+			this->data_loops[i]->executor = e;
+		}
 	}
 
-	this->pool = pw_mempool_new(NULL);
+	this->data_loop_impl = this->data_loops[0];
+
+	this->pool = pw_mempool_new(pw_properties_copy(properties));
 
 	this->data_loop = pw_data_loop_get_loop(this->data_loop_impl);
 	this->data_system = this->data_loop->system;
@@ -548,8 +722,10 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop,
 	}
 	this->n_support = n_support;
 
-	if ((res = pw_data_loop_start(this->data_loop_impl)) < 0)
-		goto error_free_loop;
+	for (i = 0; i < this->n_data_loops; i++) {
+		if ((res = pw_data_loop_start(this->data_loops[i])) < 0)
+			goto error_free_loop;
+	}
 
 	pw_array_init(&this->factory_lib, 32);
 	pw_map_init(&this->globals, 128, 32);
@@ -603,6 +779,25 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop,
 		goto error_free_loop;
 	}
 	this->info.id = this->global->id;
+
+	if ((str = pw_properties_get(properties, PW_KEY_CORE_DAEMON)) &&
+	    pw_properties_parse_bool(str) &&
+	    ((str = pw_properties_get(properties, PW_KEY_CORE_PROFILER)) == NULL ||
+	     pw_properties_parse_bool(str))) {
+		impl->profiler_event = pw_loop_add_event(this->main_loop,
+				start_profiler, this);
+		if (impl->profiler_event != NULL)
+			pw_loop_signal_event(this->main_loop, impl->profiler_event);
+	}
+	if ((str = pw_properties_get(properties, PW_KEY_CORE_POWER_SAVE)) &&
+	    pw_properties_parse_bool(str)) {
+		this->power_save_quantum = MAX_QUANTUM;
+		if ((str = pw_properties_get(properties, PW_KEY_CORE_POWER_SAVE ".quantum")))
+			this->power_save_quantum = SPA_CLAMP((uint32_t)pw_properties_parse_int(str),
+					MIN_QUANTUM, MAX_QUANTUM);
+		pw_log_info(NAME" %p: power save quantum:%u", this, this->power_save_quantum);
+	}
+	check_quantum_adapt(this);
 	pw_properties_setf(this->properties, PW_KEY_OBJECT_ID, "%d", this->info.id);
 	this->info.props = &this->properties->dict;
 
@@ -612,7 +807,8 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop,
 	return this;
 
 error_free_loop:
-	pw_data_loop_destroy(this->data_loop_impl);
+	for (i = 0; i < this->n_data_loops; i++)
+		destroy_data_loop(this->data_loops[i]);
 error_free:
 	free(this);
 error_cleanup:
@@ -639,12 +835,18 @@ void pw_core_destroy(struct pw_core *core)
 	struct pw_resource *resource;
 	struct pw_node *node;
 	struct factory_entry *entry;
+	uint32_t i;
 
 	pw_log_debug(NAME" %p: destroy", core);
 	pw_core_emit_destroy(core);
 
 	spa_hook_remove(&core->global_listener);
 
+	if (core->adapt_timer)
+		pw_loop_destroy_source(core->main_loop, core->adapt_timer);
+	if (impl->profiler_event)
+		pw_loop_destroy_source(core->main_loop, impl->profiler_event);
+
 	spa_list_consume(remote, &core->remote_list, link)
 		pw_remote_destroy(remote);
 
@@ -668,7 +870,13 @@ void pw_core_destroy(struct pw_core *core)
 
 	pw_mempool_destroy(core->pool);
 
-	pw_data_loop_destroy(core->data_loop_impl);
+	for (i = 0; i < core->n_data_loops; i++)
+		destroy_data_loop(core->data_loops[i]);
+	if (core->profiler)
+		pw_profiler_destroy(core->profiler);
+
+	for (i = 0; i < MAX_FORMAT_MEMO; i++)
+		free(core->format_memo[i].format);
 
 	pw_properties_free(core->properties);
 
@@ -726,6 +934,61 @@ struct pw_loop *pw_core_get_main_loop(struct pw_core *core)
 	return core->main_loop;
 }
 
+SPA_EXPORT
+uint32_t pw_core_get_n_data_loops(struct pw_core *core)
+{
+	return core->n_data_loops;
+}
+
+SPA_EXPORT
+struct pw_loop *pw_core_get_data_loop(struct pw_core *core, uint32_t index)
+{
+	if (index >= core->n_data_loops)
+		return NULL;
+	return pw_data_loop_get_loop(core->data_loops[index]);
+}
+
+/** Select a data loop for a node
+ *
+ * \param core the core object
+ * \param props the node properties or NULL
+ *
+ * Nodes are placed on the data loop in the PW_KEY_NODE_DATA_LOOP property.
+ * Drivers without an explicit loop are spread over the pool based on
+ * their name so that independent graphs run on separate threads. All
+ * other nodes start on the first loop and are moved to the loop of
+ * their driver when they join a graph.
+ *
+ * The selection only depends on \a props so that the spa node and the
+ * pw_node made with the same properties end up on the same loop.
+ */
+struct pw_data_loop *pw_core_select_data_loop(struct pw_core *core, const struct spa_dict *props)
+{
+	const char *str;
+	uint32_t index = 0, hash = 5381;
+
+	if (props == NULL || core->n_data_loops == 1)
+		goto done;
+
+	if ((str = spa_dict_lookup(props, PW_KEY_NODE_DATA_LOOP)) != NULL) {
+		index = pw_properties_parse_int(str) % core->n_data_loops;
+		goto done;
+	}
+	if ((str = spa_dict_lookup(props, PW_KEY_NODE_DRIVER)) == NULL ||
+	    !pw_properties_parse_bool(str))
+		goto done;
+
+	if ((str = spa_dict_lookup(props, PW_KEY_NODE_NAME)) == NULL &&
+	    (str = spa_dict_lookup(props, PW_KEY_OBJECT_PATH)) == NULL)
+		goto done;
+
+	while (*str)
+		hash = hash * 33 + *str++;
+	index = hash % core->n_data_loops;
+done:
+	return core->data_loops[index];
+}
+
 SPA_EXPORT
 const struct pw_properties *pw_core_get_properties(struct pw_core *core)
 {
@@ -900,6 +1163,57 @@ struct pw_port *pw_core_find_port(struct pw_core *core,
 	return best;
 }
 
+/* the first EnumFormat of the port that is compatible with filter */
+static int filter_enum_format(struct pw_port *port, const struct spa_pod *filter,
+		struct spa_pod **format, struct spa_pod_builder *builder)
+{
+	struct spa_pod *param;
+	uint32_t i;
+
+	pw_port_enum_format_for_each(port, i, param) {
+		if (spa_pod_filter(builder, format, param, filter) >= 0)
+			return 1;
+	}
+	return 0;
+}
+
+static struct pw_format_memo *find_format_memo(struct pw_core *core,
+		struct pw_port *output, struct pw_port *input)
+{
+	uint32_t i;
+
+	for (i = 0; i < MAX_FORMAT_MEMO; i++) {
+		struct pw_format_memo *m = &core->format_memo[i];
+		if (m->output_serial == output->enum_format.serial &&
+		    m->input_serial == input->enum_format.serial)
+			return m;
+	}
+	return NULL;
+}
+
+/* remember the result for the pair of ports, the serials of the caches are
+ * unique so entries of old or destroyed ports never match again and are
+ * replaced in turn */
+static void add_format_memo(struct pw_core *core,
+		struct pw_port *output, struct pw_port *input,
+		const struct spa_pod *format)
+{
+	struct pw_format_memo *m = &core->format_memo[core->format_memo_next];
+
+	core->format_memo_next = (core->format_memo_next + 1) % MAX_FORMAT_MEMO;
+
+	free(m->format);
+	spa_zero(*m);
+
+	if (format != NULL) {
+		if ((m->format = malloc(SPA_POD_SIZE(format))) == NULL)
+			return;
+		memcpy(m->format, format, SPA_POD_SIZE(format));
+	}
+	m->output_serial = output->enum_format.serial;
+	m->input_serial = input->enum_format.serial;
+}
+
 /** Find a common format between two ports
  *
  * \param core a core object
@@ -914,6 +1228,10 @@ struct pw_port *pw_core_find_port(struct pw_core *core,
  * Find a common format between the given ports. The format will
  * be restricted to a subset given with the format filters.
  *
+ * The EnumFormat params of the ports are cached on the ports and the
+ * result for a pair of unconfigured ports is remembered until one of the
+ * ports changes its EnumFormat param.
+ *
  * \memberof pw_core
  */
 int pw_core_find_format(struct pw_core *core,
@@ -963,14 +1281,12 @@ int pw_core_find_format(struct pw_core *core,
 		if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
 			spa_debug_format(2, NULL, filter);
 
-		if ((res = spa_node_port_enum_params_sync(input->node->node,
-						     input->direction, input->port_id,
-						     SPA_PARAM_EnumFormat, &iidx,
-						     filter, format, builder)) <= 0) {
-			if (res < 0)
-				asprintf(error, "error input enum formats: %s", spa_strerror(res));
-			else
-				asprintf(error, "no input formats");
+		if ((res = pw_port_update_enum_format(input)) < 0) {
+			asprintf(error, "error input enum formats: %s", spa_strerror(res));
+			goto error;
+		}
+		if ((res = filter_enum_format(input, filter, format, builder)) <= 0) {
+			asprintf(error, "no input formats");
 			goto error;
 		}
 	} else if (out_state >= PW_PORT_STATE_CONFIGURE && in_state > PW_PORT_STATE_CONFIGURE) {
@@ -990,48 +1306,69 @@ int pw_core_find_format(struct pw_core *core,
 		if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
 			spa_debug_format(2, NULL, filter);
 
-		if ((res = spa_node_port_enum_params_sync(output->node->node,
-						     output->direction, output->port_id,
-						     SPA_PARAM_EnumFormat, &oidx,
-						     filter, format, builder)) <= 0) {
-			if (res < 0)
-				asprintf(error, "error output enum formats: %s", spa_strerror(res));
-			else
-				asprintf(error, "no output format");
+		if ((res = pw_port_update_enum_format(output)) < 0) {
+			asprintf(error, "error output enum formats: %s", spa_strerror(res));
+			goto error;
+		}
+		if ((res = filter_enum_format(output, filter, format, builder)) <= 0) {
+			asprintf(error, "no output format");
 			goto error;
 		}
 	} else if (in_state == PW_PORT_STATE_CONFIGURE && out_state == PW_PORT_STATE_CONFIGURE) {
-	      again:
+		struct pw_format_memo *memo;
+		struct spa_pod_builder_state state;
+		struct spa_pod *in, *out;
+		uint32_t i, j;
+
 		/* both ports need a format */
-		pw_log_debug(NAME" %p: do enum input %d", core, iidx);
-		spa_pod_builder_init(&fb, fbuf, sizeof(fbuf));
-		if ((res = spa_node_port_enum_params_sync(input->node->node,
-						     input->direction, input->port_id,
-						     SPA_PARAM_EnumFormat, &iidx,
-						     NULL, &filter, &fb)) != 1) {
-			if (res == 0 && iidx == 0) {
+		if ((res = pw_port_update_enum_format(input)) < 0) {
+			asprintf(error, "error input enum formats: %s", spa_strerror(res));
+			goto error;
+		}
+		if ((res = pw_port_update_enum_format(output)) < 0) {
+			asprintf(error, "error output enum formats: %s", spa_strerror(res));
+			goto error;
+		}
+
+		if ((memo = find_format_memo(core, output, input)) != NULL) {
+			pw_log_debug(NAME" %p: cached format %p", core, memo->format);
+			core->format_memo_hits++;
+			if (memo->format == NULL) {
+				res = 0;
 				asprintf(error, "no compatible formats");
 				goto error;
 			}
-			if (res < 0)
-				asprintf(error, "error input enum formats: %s", spa_strerror(res));
-			else
-				asprintf(error, "no more input formats");
-			goto error;
+			spa_pod_builder_get_state(builder, &state);
+			if ((res = spa_pod_builder_raw_padded(builder, memo->format,
+						SPA_POD_SIZE(memo->format))) < 0) {
+				asprintf(error, "error copy format: %s", spa_strerror(res));
+				goto error;
+			}
+			*format = spa_pod_builder_deref(builder, state.offset);
+			return 1;
 		}
-		pw_log_debug(NAME" %p: enum output %d with filter: %p", core, oidx, filter);
-		if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
-			spa_debug_format(2, NULL, filter);
 
-		if ((res = spa_node_port_enum_params_sync(output->node->node,
-						     output->direction, output->port_id,
-						     SPA_PARAM_EnumFormat, &oidx,
-						     filter, format, builder)) != 1) {
-			if (res == 0) {
-				oidx = 0;
-				goto again;
+		core->format_memo_misses++;
+
+		res = 0;
+		pw_port_enum_format_for_each(input, i, in) {
+			pw_log_debug(NAME" %p: enum output with filter %u", core, i);
+			if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
+				spa_debug_format(2, NULL, in);
+
+			pw_port_enum_format_for_each(output, j, out) {
+				if (spa_pod_filter(builder, format, out, in) >= 0) {
+					res = 1;
+					break;
+				}
 			}
-			asprintf(error, "error output enum formats: %s", spa_strerror(res));
+			if (res == 1)
+				break;
+		}
+		add_format_memo(core, output, input, res == 1 ? *format : NULL);
+
+		if (res != 1) {
+			asprintf(error, "no compatible formats");
 			goto error;
 		}
 
@@ -1083,6 +1420,7 @@ static int collect_nodes(struct pw_node *driver)
 	uint32_t max_quantum = 0;
 	uint32_t min_quantum = 0;
 	uint32_t quantum;
+	uint32_t n_tolerant = 0, n_interactive = 0;
 
 	spa_list_consume(t, &driver->slave_list, slave_link) {
 		spa_list_remove(&t->slave_link);
@@ -1099,6 +1437,15 @@ static int collect_nodes(struct pw_node *driver)
 		spa_list_remove(&n->sort_link);
 		pw_node_set_driver(n, driver);
 
+		/* streams and nodes that ask for a latency need it unless
+		 * they said otherwise */
+		if (n != driver) {
+			if (n->latency_tolerant)
+				n_tolerant++;
+			else if (n->stream || n->quantum_size > 0)
+				n_interactive++;
+		}
+
 		if (n->quantum_size > 0) {
 			if (min_quantum == 0 || n->quantum_size < min_quantum)
 				min_quantum = n->quantum_size;
@@ -1130,9 +1477,17 @@ static int collect_nodes(struct pw_node *driver)
 	if (quantum == 0)
 		quantum = DEFAULT_QUANTUM;
 
-	/* for now, we try to limit the latency between min and default, We can
-	 * go to max but we should really only do this when in power save mode */
-	driver->quantum_current = SPA_CLAMP(quantum, MIN_QUANTUM, DEFAULT_QUANTUM);
+	/* we try to limit the latency between min and default. In power save
+	 * mode we go up to max when nobody needs a low latency */
+	if (driver->core->power_save_quantum > 0 && n_tolerant > 0 && n_interactive == 0) {
+		quantum = driver->core->power_save_quantum;
+		if (driver->max_quantum > 0)
+			quantum = SPA_MIN(quantum, driver->max_quantum);
+		driver->quantum_current = SPA_CLAMP(quantum, MIN_QUANTUM, MAX_QUANTUM);
+		pw_log_info("driver %p: power save quantum:%u", driver, driver->quantum_current);
+	} else {
+		driver->quantum_current = SPA_CLAMP(quantum, MIN_QUANTUM, DEFAULT_QUANTUM);
+	}
 
 	return 0;
 }
@@ -1190,7 +1545,8 @@ int pw_core_recalc_graph(struct pw_core *core)
 				continue;
 
 			if (target != NULL) {
-				if (n->quantum_size > 0 && n->quantum_size < target->quantum_current)
+				if (n->quantum_size > 0 && n->quantum_size < target->quantum_current &&
+				    !(n->latency_tolerant && core->power_save_quantum > 0))
 					target->quantum_current = SPA_MAX(MIN_QUANTUM, n->quantum_size);
 			}
 			pw_node_set_driver(n, target);
@@ -1205,15 +1561,25 @@ int pw_core_recalc_graph(struct pw_core *core)
 		if (!n->master)
 			continue;
 
+		/* the quantum adaptation raised the quantum of this driver */
+		if (n->adapt.quantum > n->quantum_current)
+			n->quantum_current = n->adapt.quantum;
+
 		if (n->rt.position && n->quantum_current != n->rt.position->clock.duration)
 			n->rt.position->clock.duration = n->quantum_current;
 
-		pw_log_info(NAME" %p: master %p quantum:%u '%s'", core, n,
-				n->quantum_current, n->name);
+		pw_log_info(NAME" %p: master %p quantum:%u loop:%p '%s'", core, n,
+				n->quantum_current, n->data_loop, n->name);
 
-		spa_list_for_each(s, &n->slave_list, slave_link)
+		spa_list_for_each(s, &n->slave_list, slave_link) {
 			pw_log_info(NAME" %p: slave %p: active:%d '%s'",
 					core, s, s->active, s->name);
+
+			/* the whole group is scheduled from the loop of the master */
+			if (s->data_loop != n->data_loop)
+				pw_log_warn(NAME" %p: slave %p '%s' on loop %p, master on %p",
+						core, s, s->name, s->data_loop, n->data_loop);
+		}
 	}
 	return 0;
 }
@@ -1261,8 +1627,9 @@ struct spa_handle *pw_core_load_spa_handle(struct pw_core *core,
 		const struct spa_dict *info)
 {
 	const char *lib;
-	const struct spa_support *support;
-	uint32_t n_support;
+	struct spa_support support[SPA_N_ELEMENTS(core->support)];
+	struct pw_loop *data_loop;
+	uint32_t i, n_support;
 	struct spa_handle *handle;
 
 	pw_log_debug(NAME" %p: load factory %s", core, factory_name);
@@ -1277,7 +1644,18 @@ struct spa_handle *pw_core_load_spa_handle(struct pw_core *core,
 		return NULL;
 	}
 
-	support = pw_core_get_support(core, &n_support);
+	n_support = core->n_support;
+	memcpy(support, core->support, n_support * sizeof(struct spa_support));
+
+	data_loop = pw_data_loop_get_loop(pw_core_select_data_loop(core, info));
+	if (data_loop != core->data_loop) {
+		for (i = 0; i < n_support; i++) {
+			if (support[i].type == SPA_TYPE_INTERFACE_DataLoop)
+				support[i].data = data_loop->loop;
+			else if (support[i].type == SPA_TYPE_INTERFACE_DataSystem)
+				support[i].data = data_loop->system;
+		}
+	}
 
 	handle = pw_load_spa_handle(lib, factory_name,
 			info, n_support, support);
@@ -130,6 +130,12 @@ const struct spa_support *pw_core_get_support(struct pw_core *core, uint32_t *n_
 /** get the core main loop */
 struct pw_loop *pw_core_get_main_loop(struct pw_core *core);
 
+/** get the number of data loops of the core */
+uint32_t pw_core_get_n_data_loops(struct pw_core *core);
+
+/** get a data loop of the core, NULL when \a index is out of range */
+struct pw_loop *pw_core_get_data_loop(struct pw_core *core, uint32_t index);
+
 /** Iterate the globals of the core. The callback should return
  * 0 to fetch the next item, any other value stops the iteration and returns
  * the value. When all callbacks return 0, this function returns 0 when all
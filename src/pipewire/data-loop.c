@@ -23,11 +23,15 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <sys/resource.h>
 
 #include "pipewire/log.h"
 #include "pipewire/data-loop.h"
+#include "pipewire/keys.h"
 #include "pipewire/private.h"
 
 #define NAME "data-loop"
@@ -95,6 +99,7 @@ SPA_EXPORT
 struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 {
 	struct pw_data_loop *this;
+	const char *str;
 	int res;
 
 	this = calloc(1, sizeof(struct pw_data_loop));
@@ -105,6 +110,10 @@ struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 
 	pw_log_debug(NAME" %p: new", this);
 
+	if (properties != NULL &&
+	    (str = pw_properties_get(properties, PW_KEY_CPU_AFFINITY)) != NULL)
+		this->affinity = strdup(str);
+
 	this->loop = pw_loop_new(properties);
 	properties = NULL;
 	if (this->loop == NULL) {
@@ -127,6 +136,7 @@ struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 error_loop_destroy:
 	pw_loop_destroy(this->loop);
 error_free:
+	free(this->affinity);
 	free(this);
 error_cleanup:
 	if (properties)
@@ -150,6 +160,7 @@ void pw_data_loop_destroy(struct pw_data_loop *loop)
 
 	pw_loop_destroy_source(loop->loop, loop->event);
 	pw_loop_destroy(loop->loop);
+	free(loop->affinity);
 	free(loop);
 }
 
@@ -168,11 +179,43 @@ pw_data_loop_get_loop(struct pw_data_loop *loop)
 	return loop->loop;
 }
 
+static void set_affinity(struct pw_data_loop *loop)
+{
+	cpu_set_t cpuset;
+	const char *p = loop->affinity;
+	char *end;
+	long cpu;
+	int err;
+
+	CPU_ZERO(&cpuset);
+	while (*p) {
+		cpu = strtol(p, &end, 10);
+		if (end == p)
+			break;
+		if (cpu >= 0 && cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &cpuset);
+		p = end;
+		while (*p == ',' || *p == ' ')
+			p++;
+	}
+	if (CPU_COUNT(&cpuset) == 0) {
+		pw_log_warn(NAME" %p: invalid affinity '%s'", loop, loop->affinity);
+		return;
+	}
+	if ((err = pthread_setaffinity_np(loop->thread, sizeof(cpuset), &cpuset)) != 0)
+		pw_log_warn(NAME" %p: can't set affinity '%s': %s", loop,
+				loop->affinity, strerror(err));
+	else
+		pw_log_debug(NAME" %p: affinity '%s'", loop, loop->affinity);
+}
+
 /** Start a data loop
  * \param loop the data loop to start
  * \return 0 if ok, -1 on error
  *
- * This will start the realtime thread that manages the loop.
+ * This will start the realtime thread that manages the loop. When the
+ * loop was created with the PW_KEY_CPU_AFFINITY property, the thread
+ * is pinned to the given cpus.
  *
  * \memberof pw_data_loop
  */
@@ -188,6 +231,8 @@ int pw_data_loop_start(struct pw_data_loop *loop)
 			loop->running = false;
 			return -err;
 		}
+		if (loop->affinity)
+			set_affinity(loop);
 	}
 	return 0;
 }
@@ -0,0 +1,375 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "pipewire/log.h"
+#include "pipewire/private.h"
+
+#define NAME "executor"
+
+#define MAX_WORKERS	16u
+#define QUEUE_SIZE	256
+#define QUEUE_MASK	(QUEUE_SIZE - 1)
+#define SPIN_COUNT	64
+
+/* set in the pending count of a region when its owner sleeps on it */
+#define REGION_WAITING	(1 << 30)
+
+struct task {
+	struct pw_node_target *target;
+	struct pw_executor_region *region;
+};
+
+/* A deque of tasks. The owner pushes and pops at the head, thieves take
+ * from the tail so that they pick up the oldest, widest branches. */
+struct queue {
+	pthread_spinlock_t lock;
+	uint32_t head;
+	uint32_t tail;
+	struct task tasks[QUEUE_SIZE];
+};
+
+struct worker {
+	struct pw_executor *executor;
+	uint32_t index;
+	pthread_t thread;
+	struct queue queue;
+};
+
+struct pw_executor {
+	uint32_t n_workers;
+	struct worker workers[MAX_WORKERS];
+
+	/* tasks pushed from threads that are not workers, like the data loops */
+	struct queue inject;
+
+	uint32_t seq;		/* futex, incremented for each push */
+	uint32_t sleepers;
+	uint32_t running;
+	pthread_mutex_t start_lock;
+	unsigned int started:1;
+};
+
+static __thread struct worker *current_worker;
+static __thread struct pw_executor_region *current_region;
+
+static inline long futex(uint32_t *uaddr, int op, uint32_t val)
+{
+	return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+static inline bool queue_push(struct queue *q, const struct task *t)
+{
+	bool res = false;
+
+	pthread_spin_lock(&q->lock);
+	if (q->head - q->tail < QUEUE_SIZE) {
+		q->tasks[q->head & QUEUE_MASK] = *t;
+		q->head++;
+		res = true;
+	}
+	pthread_spin_unlock(&q->lock);
+	return res;
+}
+
+static inline bool queue_pop(struct queue *q, struct task *t)
+{
+	bool res = false;
+
+	if (ATOMIC_LOAD(q->head) == ATOMIC_LOAD(q->tail))
+		return false;
+
+	pthread_spin_lock(&q->lock);
+	if (q->head != q->tail) {
+		q->head--;
+		*t = q->tasks[q->head & QUEUE_MASK];
+		res = true;
+	}
+	pthread_spin_unlock(&q->lock);
+	return res;
+}
+
+static inline bool queue_steal(struct queue *q, struct task *t)
+{
+	bool res = false;
+
+	if (ATOMIC_LOAD(q->head) == ATOMIC_LOAD(q->tail))
+		return false;
+
+	pthread_spin_lock(&q->lock);
+	if (q->head != q->tail) {
+		*t = q->tasks[q->tail & QUEUE_MASK];
+		q->tail++;
+		res = true;
+	}
+	pthread_spin_unlock(&q->lock);
+	return res;
+}
+
+static bool find_task(struct pw_executor *e, struct worker *self, struct task *t)
+{
+	uint32_t i, start;
+
+	if (self && queue_pop(&self->queue, t))
+		return true;
+	if (queue_steal(&e->inject, t))
+		return true;
+
+	start = self ? self->index + 1 : 0;
+	for (i = 0; i < e->n_workers; i++) {
+		struct worker *w = &e->workers[(start + i) % e->n_workers];
+		if (w != self && queue_steal(&w->queue, t))
+			return true;
+	}
+	return false;
+}
+
+static inline void run_task(struct task *t)
+{
+	struct pw_executor_region *old = current_region;
+	struct pw_executor_region *region = t->region;
+
+	current_region = region;
+	t->target->signal(t->target->data);
+	current_region = old;
+
+	/* the last task wakes up the owner when it went to sleep */
+	if (__atomic_sub_fetch(&region->pending, 1, __ATOMIC_SEQ_CST) == REGION_WAITING)
+		futex((uint32_t*)&region->pending, FUTEX_WAKE_PRIVATE, 1);
+}
+
+static void *do_worker(void *data)
+{
+	struct worker *w = data;
+	struct pw_executor *e = w->executor;
+	struct task t;
+	uint32_t seq, spin = 0;
+
+	current_worker = w;
+
+	pw_log_debug(NAME" %p: worker %u started", e, w->index);
+
+	while (ATOMIC_LOAD(e->running)) {
+		seq = ATOMIC_LOAD(e->seq);
+
+		if (find_task(e, w, &t)) {
+			run_task(&t);
+			spin = 0;
+			continue;
+		}
+		if (spin++ < SPIN_COUNT) {
+			sched_yield();
+			continue;
+		}
+		ATOMIC_INC(e->sleepers);
+		futex(&e->seq, FUTEX_WAIT_PRIVATE, seq);
+		ATOMIC_DEC(e->sleepers);
+		spin = 0;
+	}
+	pw_log_debug(NAME" %p: worker %u stopped", e, w->index);
+	return NULL;
+}
+
+static void wakeup(struct pw_executor *e)
+{
+	ATOMIC_INC(e->seq);
+	if (ATOMIC_LOAD(e->sleepers) > 0)
+		futex(&e->seq, FUTEX_WAKE_PRIVATE, 1);
+}
+
+/* The workers are started from the first thread that runs a region, which
+ * is a data loop. They copy its scheduling parameters so that they run with
+ * the same realtime priority. */
+static void start_workers(struct pw_executor *e)
+{
+	pthread_attr_t attr;
+	struct sched_param sp;
+	int policy, err;
+	uint32_t i;
+
+	pthread_mutex_lock(&e->start_lock);
+	if (e->started)
+		goto done;
+
+	pthread_attr_init(&attr);
+	if (pthread_getschedparam(pthread_self(), &policy, &sp) == 0 &&
+	    policy != SCHED_OTHER) {
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, policy);
+		pthread_attr_setschedparam(&attr, &sp);
+	}
+
+	ATOMIC_STORE(e->running, 1);
+	for (i = 0; i < e->n_workers; i++) {
+		struct worker *w = &e->workers[i];
+
+		if ((err = pthread_create(&w->thread, &attr, do_worker, w)) != 0 &&
+		    (err = pthread_create(&w->thread, NULL, do_worker, w)) != 0) {
+			pw_log_error(NAME" %p: can't create worker: %s", e, strerror(err));
+			break;
+		}
+	}
+	pthread_attr_destroy(&attr);
+
+	/* only keep the workers that were started */
+	e->n_workers = i;
+	e->started = true;
+done:
+	pthread_mutex_unlock(&e->start_lock);
+}
+
+/** Create a new executor with \a n_workers threads
+ *
+ * The executor runs node targets that became ready at the same time
+ * on a set of worker threads. Each worker has its own queue and steals
+ * work from the other workers when it runs out.
+ */
+struct pw_executor *pw_executor_new(uint32_t n_workers)
+{
+	struct pw_executor *e;
+	uint32_t i;
+
+	if (n_workers == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	e = calloc(1, sizeof(struct pw_executor));
+	if (e == NULL)
+		return NULL;
+
+	e->n_workers = SPA_MIN(n_workers, MAX_WORKERS);
+	pthread_spin_init(&e->inject.lock, PTHREAD_PROCESS_PRIVATE);
+	pthread_mutex_init(&e->start_lock, NULL);
+
+	for (i = 0; i < MAX_WORKERS; i++) {
+		struct worker *w = &e->workers[i];
+		w->executor = e;
+		w->index = i;
+		pthread_spin_init(&w->queue.lock, PTHREAD_PROCESS_PRIVATE);
+	}
+	pw_log_debug(NAME" %p: new %u workers", e, e->n_workers);
+
+	return e;
+}
+
+void pw_executor_destroy(struct pw_executor *e)
+{
+	uint32_t i;
+
+	pw_log_debug(NAME" %p: destroy", e);
+
+	if (e->started) {
+		ATOMIC_STORE(e->running, 0);
+		ATOMIC_INC(e->seq);
+		futex(&e->seq, FUTEX_WAKE_PRIVATE, INT_MAX);
+		for (i = 0; i < e->n_workers; i++)
+			pthread_join(e->workers[i].thread, NULL);
+	}
+	for (i = 0; i < MAX_WORKERS; i++)
+		pthread_spin_destroy(&e->workers[i].queue.lock);
+	pthread_spin_destroy(&e->inject.lock);
+	pthread_mutex_destroy(&e->start_lock);
+	free(e);
+}
+
+/** Start a region
+ *
+ * Returns true when a new region was started. When the calling thread is
+ * already running a task, its region is reused and false is returned so
+ * that only the outermost caller waits in \ref pw_executor_end.
+ */
+bool pw_executor_begin(struct pw_executor *e, struct pw_executor_region *region)
+{
+	if (current_region != NULL)
+		return false;
+
+	if (SPA_UNLIKELY(!e->started))
+		start_workers(e);
+
+	region->pending = 0;
+	current_region = region;
+	return true;
+}
+
+/** Queue a ready target in the current region */
+void pw_executor_push(struct pw_executor *e, struct pw_node_target *target)
+{
+	struct task t;
+	struct queue *q;
+
+	t.target = target;
+	t.region = current_region;
+
+	ATOMIC_INC(t.region->pending);
+
+	q = current_worker ? &current_worker->queue : &e->inject;
+	if (SPA_UNLIKELY(!queue_push(q, &t))) {
+		/* queue full, run it now */
+		run_task(&t);
+		return;
+	}
+	wakeup(e);
+}
+
+/** Help running tasks until all tasks of \a region completed
+ *
+ * When there is nothing left to take, the caller spins for a short while
+ * and then sleeps until the worker that finishes the last task of the
+ * region wakes it up, so that workers on the same cpu can make progress.
+ */
+void pw_executor_end(struct pw_executor *e, struct pw_executor_region *region)
+{
+	struct task t;
+	uint32_t spin = 0;
+	int pending;
+
+	while ((pending = ATOMIC_LOAD(region->pending)) & ~REGION_WAITING) {
+		if (find_task(e, current_worker, &t)) {
+			run_task(&t);
+			spin = 0;
+			continue;
+		}
+		if (spin++ < SPIN_COUNT)
+			continue;
+
+		if (pending & REGION_WAITING ||
+		    __atomic_compare_exchange_n(&region->pending, &pending,
+				    pending | REGION_WAITING, false,
+				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			futex((uint32_t*)&region->pending, FUTEX_WAIT_PRIVATE,
+					pending | REGION_WAITING);
+		spin = 0;
+	}
+	current_region = NULL;
+}
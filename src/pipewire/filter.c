@@ -478,9 +478,13 @@ static int impl_port_enum_params(void *object, int seq,
 		if (param == NULL || p->id != id)
 			continue;
 
-		spa_pod_builder_init(&b, buffer, sizeof(buffer));
-		if (spa_pod_filter(&b, &result.param, param, filter) != 0)
-			continue;
+		if (filter == NULL) {
+			result.param = param;
+		} else {
+			spa_pod_builder_init(&b, buffer, sizeof(buffer));
+			if (spa_pod_filter(&b, &result.param, param, filter) != 0)
+				continue;
+		}
 
 		spa_node_emit_result(&d->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
 
@@ -53,6 +53,8 @@ extern "C" {
  * PipeWire */
 #define PW_KEY_PROTOCOL			"pipewire.protocol"
 #define PW_KEY_ACCESS			"pipewire.access"	/**< how the client access is controlled */
+#define PW_KEY_PROTOCOL_RING		"pipewire.protocol.ring"	/**< exchange messages without fds
+									  *  through shared memory rings */
 
 /** Various keys related to the identity of a client process and its security.
  * Must be obtained from trusted sources by the protocol and placed as
@@ -71,11 +73,38 @@ extern "C" {
 
 #define PW_KEY_CORE_ID			"core.id"		/**< the core id */
 #define PW_KEY_CORE_MONITORS		"core.monitors"		/**< the apis monitored by core. */
+#define PW_KEY_CORE_DATA_LOOPS		"core.data-loops"	/**< number of realtime data loops to run
+								  *  driver graphs on, default 1 */
+#define PW_KEY_CORE_GRAPH_WORKERS	"core.graph-workers"	/**< number of threads per data loop that run
+								  *  independent branches of a graph in
+								  *  parallel, default 0 */
+#define PW_KEY_CORE_PROFILER		"core.profiler"		/**< publish cycle timings for
+								  *  pipewire-profiler, default true in
+								  *  the daemon */
+#define PW_KEY_CORE_POWER_SAVE		"core.power-save"	/**< run graphs with only latency tolerant
+								  *  nodes at a large quantum, default false.
+								  *  The quantum is set with the .quantum
+								  *  subkey, default 8192 */
+#define PW_KEY_CORE_QUANTUM_ADAPT	"core.quantum-adapt"	/**< raise the quantum of drivers under
+								  *  load, default false. Tuned with the
+								  *  .high-load, .low-load, .hold,
+								  *  .max-quantum and .interval subkeys,
+								  *  an interval of 0 disables the timer */
+
+/* memory */
+#define PW_KEY_MEM_PREFAULT		"mem.prefault"		/**< prefault mapped memory, default false */
+#define PW_KEY_MEM_MLOCK		"mem.mlock"		/**< lock the memory that the realtime threads
+								  *  use so that they don't page fault,
+								  *  default false */
+#define PW_KEY_MEM_HUGEPAGES		"mem.hugepages"		/**< use huge pages for large allocations,
+								  *  default false */
 
 /* cpu */
 #define PW_KEY_CPU_MAX_ALIGN		"cpu.max-align"		/**< maximum alignment needed to support
 								  *  all CPU optimizations */
 #define PW_KEY_CPU_CORES		"cpu.cores"		/**< number of cores */
+#define PW_KEY_CPU_AFFINITY		"cpu.affinity"		/**< comma separated list of cpus a thread
+								  *  should run on. Ex: "2,3" */
 
 /* priorities */
 #define PW_KEY_PRIORITY_SESSION		"priority.session"	/**< priority in session manager */
@@ -137,8 +166,22 @@ extern "C" {
 #define PW_KEY_NODE_ALWAYS_PROCESS	"node.always-process"	/**< process even when unlinked */
 #define PW_KEY_NODE_PAUSE_ON_IDLE	"node.pause-on-idle"	/**< pause the node when idle */
 #define PW_KEY_NODE_DRIVER		"node.driver"		/**< node can drive the graph */
+#define PW_KEY_NODE_DATA_LOOP		"node.data-loop"	/**< index of the data loop that runs the
+								  *  graph of this driver */
 #define PW_KEY_NODE_STREAM		"node.stream"		/**< node is a stream, the server side should
 								  *  add a converter */
+#define PW_KEY_NODE_WAKEUP		"node.wakeup"		/**< how the data thread waits for the node
+								  *  to be triggered, "eventfd" (default),
+								  *  "spin" or "futex". The last two keep the
+								  *  data loop busy between cycles */
+#define PW_KEY_NODE_MAX_QUANTUM		"node.max-quantum"	/**< largest quantum the quantum adaptation
+								  *  or power save may select for this
+								  *  driver */
+#define PW_KEY_NODE_LATENCY_TOLERANT	"node.latency-tolerant"	/**< the node does not need low latency and
+								  *  allows the power save quantum */
+#define PW_KEY_NODE_MIX_VOLUME		"node.mix-volume"	/**< the volume and mute of the Props of the
+								  *  node are applied by the mixers of the
+								  *  input ports its outputs are linked to */
 /** Port keys */
 #define PW_KEY_PORT_ID			"port.id"		/**< port id */
 #define PW_KEY_PORT_NAME		"port.name"		/**< port name */
@@ -159,6 +202,10 @@ extern "C" {
 #define PW_KEY_LINK_PASSIVE		"link.passive"		/**< indicate that a link is passive and
 								  *  does not cause the graph to be
 								  *  runnable. */
+#define PW_KEY_LINK_VOLUME		"link.volume"		/**< gain applied by the mixer of the
+								  *  input port, as a float */
+#define PW_KEY_LINK_MUTE		"link.mute"		/**< mute the link in the mixer of the
+								  *  input port */
 /** device properties */
 #define PW_KEY_DEVICE_ID		"device.id"		/**< device id */
 #define PW_KEY_DEVICE_NAME		"device.name"		/**< device name */
@@ -794,6 +794,21 @@ int pw_link_deactivate(struct pw_link *this)
 	return 0;
 }
 
+/* the mixer of the input port applies the volume of the link and, with
+ * node.mix-volume, the volume of the output node */
+void pw_link_update_volume(struct pw_link *this)
+{
+	struct pw_node *node = this->output->node;
+	float volume = this->volume;
+	bool mute = this->mute;
+
+	if (node->mix_volume) {
+		volume *= node->volume;
+		mute |= node->mute;
+	}
+	pw_port_set_mix_volume(this->input, &this->rt.in_mix, volume, mute);
+}
+
 static void link_unbind_func(void *data)
 {
 	struct pw_resource *resource = data;
@@ -1119,6 +1134,13 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	impl->io.buffer_id = SPA_ID_INVALID;
 	impl->io.status = SPA_STATUS_NEED_DATA;
 
+	this->volume = 1.0f;
+	if ((str = pw_properties_get(properties, PW_KEY_LINK_VOLUME)) != NULL)
+		this->volume = pw_properties_parse_float(str);
+	if ((str = pw_properties_get(properties, PW_KEY_LINK_MUTE)) != NULL)
+		this->mute = pw_properties_parse_bool(str);
+	pw_link_update_volume(this);
+
 	pw_port_init_mix(output, &this->rt.out_mix);
 	pw_port_init_mix(input, &this->rt.in_mix);
 
@@ -32,11 +32,14 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #include <sys/syscall.h>
 
 #include <spa/utils/list.h>
 #include <spa/buffer/buffer.h>
 
+#include <pipewire/keys.h>
 #include <pipewire/log.h>
 #include <pipewire/map.h>
 #include <pipewire/mem.h>
@@ -70,6 +73,10 @@ static inline int memfd_create(const char *name, unsigned int flags)
 #define MFD_ALLOW_SEALING 0x0002U
 #endif
 
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB       0x0004U
+#endif
+
 /* fcntl() seals-related flags */
 
 #ifndef F_LINUX_SPECIFIC_BASE
@@ -88,11 +95,103 @@ static inline int memfd_create(const char *name, unsigned int flags)
 
 static struct spa_list _mempools = SPA_LIST_INIT(&_mempools);
 
+#define DEFAULT_HUGEPAGE_SIZE	(2 * 1024 * 1024)
+
 #define pw_mempool_emit(p,m,v,...) spa_hook_list_call(&p->listener_list, struct pw_mempool_events, m, v, ##__VA_ARGS__)
 #define pw_mempool_emit_destroy(p)	pw_mempool_emit(p, destroy, 0)
 #define pw_mempool_emit_added(p,b)	pw_mempool_emit(p, added, 0, b)
 #define pw_mempool_emit_removed(p,b)	pw_mempool_emit(p, removed, 0, b)
 
+struct hash_entry {
+	struct spa_list link;
+	uint32_t hash;
+};
+
+/* chained hash table that grows when the chains get long */
+struct hash {
+	struct spa_list *buckets;
+	uint32_t mask;
+	uint32_t count;
+};
+
+#define HASH_MIN_BUCKETS	64
+
+static inline uint32_t hash_u32(uint32_t h, uint32_t v)
+{
+	h ^= v;
+	return h * 0x9e3779b1u;
+}
+
+static int hash_init(struct hash *h)
+{
+	uint32_t i;
+
+	h->buckets = malloc(HASH_MIN_BUCKETS * sizeof(struct spa_list));
+	if (h->buckets == NULL)
+		return -errno;
+	for (i = 0; i < HASH_MIN_BUCKETS; i++)
+		spa_list_init(&h->buckets[i]);
+	h->mask = HASH_MIN_BUCKETS - 1;
+	h->count = 0;
+	return 0;
+}
+
+static void hash_clear(struct hash *h)
+{
+	free(h->buckets);
+	h->buckets = NULL;
+}
+
+static void hash_grow(struct hash *h)
+{
+	uint32_t i, n_buckets = (h->mask + 1) * 2;
+	struct spa_list *buckets;
+	struct hash_entry *e;
+
+	buckets = malloc(n_buckets * sizeof(struct spa_list));
+	if (buckets == NULL)
+		return;
+	for (i = 0; i < n_buckets; i++)
+		spa_list_init(&buckets[i]);
+	for (i = 0; i <= h->mask; i++) {
+		spa_list_consume(e, &h->buckets[i], link) {
+			spa_list_remove(&e->link);
+			spa_list_append(&buckets[e->hash & (n_buckets - 1)], &e->link);
+		}
+	}
+	free(h->buckets);
+	h->buckets = buckets;
+	h->mask = n_buckets - 1;
+}
+
+static void hash_insert(struct hash *h, struct hash_entry *e, uint32_t hash)
+{
+	if (h->count >= (h->mask + 1) * 2)
+		hash_grow(h);
+	e->hash = hash;
+	spa_list_append(&h->buckets[hash & h->mask], &e->link);
+	h->count++;
+}
+
+static void hash_remove(struct hash *h, struct hash_entry *e)
+{
+	spa_list_remove(&e->link);
+	h->count--;
+}
+
+static inline bool has_tag(const uint32_t tag[5])
+{
+	return (tag[0] | tag[1] | tag[2] | tag[3] | tag[4]) != 0;
+}
+
+static inline uint32_t hash_tag(const uint32_t tag[5])
+{
+	uint32_t i, h = 0;
+	for (i = 0; i < 5; i++)
+		h = hash_u32(h, tag[i]);
+	return h;
+}
+
 struct mempool {
 	struct pw_mempool this;
 
@@ -102,14 +201,26 @@ struct mempool {
 
 	struct pw_map map;
 	struct spa_list blocks;
+	struct hash fd_hash;		/* memblock by fd */
+	struct hash tag_hash;		/* memmap by tag */
+	struct pw_array mappings;	/* struct mapping_ref sorted by ptr */
 	uint32_t pagesize;
+	uint32_t hugepage_size;		/* 0 when huge pages are not used */
+
+	unsigned int prefault:1;
+	unsigned int mlock:1;
+	unsigned int mlock_warned:1;
+
+	struct pw_mempool_stats stats;
 };
 
 struct memblock {
 	struct pw_memblock this;
 	struct spa_list link;
+	struct hash_entry fd_entry;
 	struct spa_list mappings;
 	struct spa_list maps;
+	uint32_t pagesize;
 };
 
 struct mapping {
@@ -118,6 +229,7 @@ struct mapping {
 	uint32_t offset;
 	uint32_t size;
 	unsigned int do_unmap:1;
+	unsigned int locked:1;
 	struct spa_list link;
 	void *ptr;
 };
@@ -126,8 +238,115 @@ struct memmap {
 	struct pw_memmap this;
 	struct mapping *mapping;
 	struct spa_list link;
+	struct hash_entry tag_entry;	/* only used for maps with a tag */
+	unsigned int tagged:1;
 };
 
+/* the start address is kept next to the mapping so that the binary
+ * search doesn't need to touch the mappings */
+struct mapping_ref {
+	const void *ptr;
+	struct mapping *mapping;
+};
+
+/* upper bound of ptr in the sorted mappings, written without branches
+ * in the loop because the outcome of the compares is not predictable */
+static uint32_t mappings_upper_bound(struct mempool *p, const void *ptr)
+{
+	const struct mapping_ref *ms = p->mappings.data, *base = ms;
+	uint32_t n = pw_array_get_len(&p->mappings, struct mapping_ref);
+
+	if (n == 0)
+		return 0;
+
+	while (n > 1) {
+		uint32_t half = n / 2;
+		base = ((uintptr_t)base[half].ptr <= (uintptr_t)ptr) ? base + half : base;
+		n -= half;
+	}
+	return (base - ms) + ((uintptr_t)base->ptr <= (uintptr_t)ptr);
+}
+
+static int mappings_insert(struct mempool *p, struct mapping *m)
+{
+	uint32_t pos = mappings_upper_bound(p, m->ptr), len;
+	struct mapping_ref *ms;
+
+	if (pw_array_add(&p->mappings, sizeof(struct mapping_ref)) == NULL)
+		return -errno;
+
+	ms = p->mappings.data;
+	len = pw_array_get_len(&p->mappings, struct mapping_ref);
+	memmove(&ms[pos + 1], &ms[pos], (len - pos - 1) * sizeof(struct mapping_ref));
+	ms[pos].ptr = m->ptr;
+	ms[pos].mapping = m;
+	return 0;
+}
+
+static void mappings_remove(struct mempool *p, struct mapping *m)
+{
+	uint32_t pos = mappings_upper_bound(p, m->ptr), len;
+	struct mapping_ref *ms = p->mappings.data;
+
+	while (pos > 0 && ms[pos - 1].mapping != m)
+		pos--;
+	if (pos == 0)
+		return;
+
+	len = pw_array_get_len(&p->mappings, struct mapping_ref);
+	memmove(&ms[pos - 1], &ms[pos], (len - pos) * sizeof(struct mapping_ref));
+	p->mappings.size -= sizeof(struct mapping_ref);
+}
+
+static uint32_t get_hugepage_size(void)
+{
+	FILE *f;
+	char line[128];
+	unsigned long kb;
+	uint32_t size = DEFAULT_HUGEPAGE_SIZE;
+
+	if ((f = fopen("/proc/meminfo", "re")) == NULL)
+		return size;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+			size = kb * 1024;
+			break;
+		}
+	}
+	fclose(f);
+	return size;
+}
+
+static void mempool_parse_props(struct mempool *impl, struct pw_properties *props)
+{
+	const char *str;
+
+	if (props == NULL)
+		return;
+
+	if ((str = pw_properties_get(props, PW_KEY_MEM_PREFAULT)) != NULL)
+		impl->prefault = pw_properties_parse_bool(str);
+	if ((str = pw_properties_get(props, PW_KEY_MEM_MLOCK)) != NULL)
+		impl->mlock = pw_properties_parse_bool(str);
+	if ((str = pw_properties_get(props, PW_KEY_MEM_HUGEPAGES)) != NULL &&
+	    pw_properties_parse_bool(str))
+		impl->hugepage_size = get_hugepage_size();
+
+	if (impl->mlock) {
+		struct rlimit rl;
+		if (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+			pw_log_info(NAME" %p: locking memory, RLIMIT_MEMLOCK is %"PRIu64" bytes",
+					impl, (uint64_t)rl.rlim_cur);
+	}
+}
+
+/** Create a new memory pool
+ * \param props properties for the pool, ownership is taken. The keys
+ *    PW_KEY_MEM_PREFAULT, PW_KEY_MEM_MLOCK and PW_KEY_MEM_HUGEPAGES
+ *    configure how memory of the pool is allocated and mapped. Only
+ *    blocks with PW_MEMBLOCK_FLAG_LOCK are locked.
+ * \return a new pool or NULL with errno on error
+ */
 struct pw_mempool *pw_mempool_new(struct pw_properties *props)
 {
 	struct mempool *impl;
@@ -141,12 +360,21 @@ struct pw_mempool *pw_mempool_new(struct pw_properties *props)
 	this->props = props;
 
 	impl->pagesize = sysconf(_SC_PAGESIZE);
+	mempool_parse_props(impl, props);
 
-	pw_log_debug(NAME" %p: new", this);
+	pw_log_debug(NAME" %p: new prefault:%d mlock:%d hugepage-size:%u", this,
+			impl->prefault, impl->mlock, impl->hugepage_size);
 
 	spa_hook_list_init(&impl->listener_list);
 	pw_map_init(&impl->map, 64, 64);
 	spa_list_init(&impl->blocks);
+	pw_array_init(&impl->mappings, 64 * sizeof(struct mapping_ref));
+	if (hash_init(&impl->fd_hash) < 0 || hash_init(&impl->tag_hash) < 0) {
+		hash_clear(&impl->fd_hash);
+		pw_map_clear(&impl->map);
+		free(impl);
+		return NULL;
+	}
 
 	spa_list_append(&_mempools, &impl->link);
 
@@ -168,6 +396,9 @@ void pw_mempool_destroy(struct pw_mempool *pool)
 		pw_memblock_free(&b->this);
 
 	pw_map_clear(&impl->map);
+	pw_array_clear(&impl->mappings);
+	hash_clear(&impl->fd_hash);
+	hash_clear(&impl->tag_hash);
 	if (pool->props)
 		pw_properties_free(pool->props);
 	free(impl);
@@ -261,6 +492,32 @@ static struct mapping * memblock_find_mapping(struct memblock *b,
 	return NULL;
 }
 
+static void mapping_lock(struct mempool *p, struct mapping *m)
+{
+	struct rlimit rl;
+
+	if (mlock(m->ptr, m->size) == 0) {
+		m->locked = true;
+		p->stats.locked += m->size;
+		pw_log_debug(NAME" %p: locked %u bytes, %"PRIu64" bytes locked",
+				p, m->size, p->stats.locked);
+		return;
+	}
+	if (getrlimit(RLIMIT_MEMLOCK, &rl) < 0)
+		rl.rlim_cur = 0;
+
+	/* the memory is still usable but can fault, later mappings are
+	 * locked again when there is room */
+	if (!p->mlock_warned) {
+		pw_log_warn(NAME" %p: can't lock %u bytes (%"PRIu64" locked, RLIMIT_MEMLOCK %"PRIu64"): %m, "
+				"continuing with unlocked memory", p, m->size,
+				p->stats.locked, (uint64_t)rl.rlim_cur);
+		p->mlock_warned = true;
+	} else {
+		pw_log_debug(NAME" %p: can't lock %u bytes: %m", p, m->size);
+	}
+}
+
 static struct mapping * memblock_map(struct memblock *b,
 		enum pw_memmap_flags flags, uint32_t offset, uint32_t size)
 {
@@ -278,6 +535,8 @@ static struct mapping * memblock_map(struct memblock *b,
 		fl |= MAP_PRIVATE;
 	else
 		fl |= MAP_SHARED;
+	if (p->prefault)
+		fl |= MAP_POPULATE;
 
 	if (flags & PW_MEMMAP_FLAG_TWICE) {
 		pw_log_error(NAME" %p: implement me PW_MEMMAP_FLAG_TWICE", p);
@@ -303,9 +562,19 @@ static struct mapping * memblock_map(struct memblock *b,
 	m->block = b;
 	m->offset = offset;
 	m->size = size;
+	if (mappings_insert(p, m) < 0) {
+		munmap(ptr, size);
+		free(m);
+		return NULL;
+	}
 	b->this.ref++;
 	spa_list_append(&b->mappings, &m->link);
 
+	p->stats.mapped += size;
+	p->stats.n_mappings++;
+	if (p->mlock && (b->this.flags & PW_MEMBLOCK_FLAG_LOCK))
+		mapping_lock(p, m);
+
         pw_log_debug(NAME" %p: fd:%d map:%p ptr:%p (%d %d)", p,
 			b->this.fd, m, m->ptr, offset, size);
 
@@ -320,8 +589,16 @@ static void mapping_unmap(struct mapping *m)
         pw_log_debug(NAME" %p: mapping:%p fd:%d ptr:%p size:%d block-ref:%d",
 			p, m, b->this.fd, m->ptr, m->size, b->this.ref);
 
-	if (m->do_unmap)
+	mappings_remove(p, m);
+
+	if (m->do_unmap) {
+		/* munmap also unlocks */
 		munmap(m->ptr, m->size);
+		p->stats.mapped -= m->size;
+		p->stats.n_mappings--;
+		if (m->locked)
+			p->stats.locked -= m->size;
+	}
 	spa_list_remove(&m->link);
 	free(m);
 
@@ -338,7 +615,7 @@ struct pw_memmap * pw_memblock_map(struct pw_memblock *block,
 	struct memmap *mm;
 	struct pw_map_range range;
 
-	pw_map_range_init(&range, offset, size, p->pagesize);
+	pw_map_range_init(&range, offset, size, b->pagesize);
 
 	m = memblock_find_mapping(b, flags, range.offset, range.size);
 	if (m == NULL)
@@ -364,6 +641,11 @@ struct pw_memmap * pw_memblock_map(struct pw_memblock *block,
 		memcpy(mm->this.tag, tag, sizeof(mm->this.tag));
 
 	spa_list_append(&b->maps, &mm->link);
+	/* untagged maps would all end up in the same bucket */
+	if (has_tag(mm->this.tag)) {
+		hash_insert(&p->tag_hash, &mm->tag_entry, hash_tag(mm->this.tag));
+		mm->tagged = true;
+	}
 
         pw_log_debug(NAME" %p: map:%p fd:%d ptr:%p (%d %d) mapping:%p ref:%d", p,
 			&mm->this, b->this.fd, mm->this.ptr, offset, size, m, m->ref);
@@ -398,6 +680,8 @@ int pw_memmap_free(struct pw_memmap *map)
 			&mm->this, b->this.fd, mm->this.ptr, m, m->ref);
 
 	spa_list_remove(&mm->link);
+	if (mm->tagged)
+		hash_remove(&p->tag_hash, &mm->tag_entry);
 
 	if (--m->ref == 0)
 		mapping_unmap(m);
@@ -419,6 +703,41 @@ static inline enum pw_memmap_flags block_flags_to_mem(enum pw_memblock_flags fla
 	return fl;
 }
 
+#ifdef USE_MEMFD
+/* Make a memfd backed by huge pages. The pages are reserved when the file
+ * is first mapped so do that here, allocating from the block would
+ * otherwise fail later with SIGBUS when the pool of huge pages is empty. */
+static int memfd_create_huge(struct mempool *impl, size_t size)
+{
+	size_t rsize = SPA_ROUND_UP_N(size, impl->hugepage_size);
+	void *ptr;
+	int fd, res;
+
+	fd = memfd_create("pipewire-memfd-huge",
+			MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGETLB);
+	if (fd == -1)
+		goto error;
+	if (ftruncate(fd, rsize) < 0)
+		goto error_close;
+
+	ptr = mmap(NULL, rsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED)
+		goto error_close;
+	munmap(ptr, rsize);
+
+	return fd;
+
+error_close:
+	res = errno;
+	close(fd);
+	errno = res;
+error:
+	pw_log_warn(NAME" %p: can't allocate %zd bytes of huge pages, "
+			"using normal pages: %m", impl, size);
+	return -1;
+}
+#endif
+
 /** Create a new memblock
  * \param pool the pool to use
  * \param flags memblock flags
@@ -446,8 +765,14 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 	b->this.size = size;
 	spa_list_init(&b->mappings);
 	spa_list_init(&b->maps);
+	b->pagesize = impl->pagesize;
 
 #ifdef USE_MEMFD
+	if (impl->hugepage_size > 0 && size >= impl->hugepage_size &&
+	    (b->this.fd = memfd_create_huge(impl, size)) != -1) {
+		b->pagesize = impl->hugepage_size;
+		goto sized;
+	}
 	b->this.fd = memfd_create("pipewire-memfd", MFD_CLOEXEC | MFD_ALLOW_SEALING);
 	if (b->this.fd == -1) {
 		res = -errno;
@@ -471,6 +796,7 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 		goto error_close;
 	}
 #ifdef USE_MEMFD
+sized:
 	if (flags & PW_MEMBLOCK_FLAG_SEAL) {
 		unsigned int seals = F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL;
 		if (fcntl(b->this.fd, F_ADD_SEALS, seals) == -1) {
@@ -491,6 +817,7 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 
 	b->this.id = pw_map_insert_new(&impl->map, b);
 	spa_list_append(&impl->blocks, &b->link);
+	hash_insert(&impl->fd_hash, &b->fd_entry, hash_u32(0, b->this.fd));
 	pw_log_debug(NAME" %p: mem %p alloc id:%d type:%u", pool, &b->this, b->this.id, type);
 
 	pw_mempool_emit_added(impl, &b->this);
@@ -508,10 +835,12 @@ error_free:
 static struct memblock * mempool_find_fd(struct pw_mempool *pool, int fd)
 {
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
-	struct memblock *b;
+	uint32_t hash = hash_u32(0, fd);
+	struct hash_entry *e;
 
-	spa_list_for_each(b, &impl->blocks, link) {
-		if (fd == b->this.fd) {
+	spa_list_for_each(e, &impl->fd_hash.buckets[hash & impl->fd_hash.mask], link) {
+		struct memblock *b = SPA_CONTAINER_OF(e, struct memblock, fd_entry);
+		if (e->hash == hash && fd == b->this.fd) {
 			pw_log_debug(NAME" %p: found %p id:%d fd:%d ref:%d",
 					pool, &b->this, b->this.id, fd, b->this.ref);
 			return b;
@@ -545,8 +874,17 @@ struct pw_memblock * pw_mempool_import(struct pw_mempool *pool,
 	b->this.type = type;
 	b->this.fd = fd;
 	b->this.flags = flags;
+	b->pagesize = impl->pagesize;
+
+	/* this is the huge page size for hugetlbfs */
+	if (type == SPA_DATA_MemFd) {
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_blksize > (blksize_t)b->pagesize)
+			b->pagesize = st.st_blksize;
+	}
 	b->this.id = pw_map_insert_new(&impl->map, b);
 	spa_list_append(&impl->blocks, &b->link);
+	hash_insert(&impl->fd_hash, &b->fd_entry, hash_u32(0, b->this.fd));
 
 	pw_log_debug(NAME" %p: import %p id:%u flags:%08x type:%u fd:%d",
 			pool, b, b->this.id, flags, type, fd);
@@ -597,6 +935,11 @@ struct pw_memmap * pw_mempool_import_map(struct pw_mempool *pool,
 		m->block = b;
 		m->offset = old->map->offset;
 		m->size = old->map->size;
+		if (mappings_insert(SPA_CONTAINER_OF(pool, struct mempool, this), m) < 0) {
+			free(m);
+			pw_memblock_unref(block);
+			return NULL;
+		}
 		spa_list_append(&b->mappings, &m->link);
 	} else {
 		block->ref--;
@@ -649,6 +992,7 @@ void pw_memblock_free(struct pw_memblock *block)
 
 	pw_map_remove(&impl->map, block->id);
 	spa_list_remove(&b->link);
+	hash_remove(&impl->fd_hash, &b->fd_entry);
 
 	pw_mempool_emit_removed(impl, block);
 
@@ -666,17 +1010,21 @@ SPA_EXPORT
 struct pw_memblock * pw_mempool_find_ptr(struct pw_mempool *pool, const void *ptr)
 {
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
-	struct memblock *b;
+	struct mapping_ref *ms = impl->mappings.data;
 	struct mapping *m;
-
-	spa_list_for_each(b, &impl->blocks, link) {
-		spa_list_for_each(m, &b->mappings, link) {
-			if (ptr >= m->ptr && ptr < SPA_MEMBER(m->ptr, m->size, void)) {
-				pw_log_debug(NAME" %p: found %p id:%d for %p", pool,
-						m->block, b->this.id, ptr);
-				return &b->this;
-			}
+	uint32_t i;
+
+	/* mappings don't overlap, only the last one that starts before
+	 * ptr or the ones at the same address can contain it */
+	for (i = mappings_upper_bound(impl, ptr); i > 0; i--) {
+		m = ms[i - 1].mapping;
+		if (ptr < SPA_MEMBER(m->ptr, m->size, void)) {
+			pw_log_debug(NAME" %p: found %p id:%d for %p", pool,
+					m->block, m->block->this.id, ptr);
+			return &m->block->this;
 		}
+		if (i < 2 || ms[i - 2].ptr != m->ptr)
+			break;
 	}
 	return NULL;
 }
@@ -716,6 +1064,21 @@ struct pw_memmap * pw_mempool_find_tag(struct pw_mempool *pool, uint32_t tag[5],
 
 	pw_log_debug(NAME" %p: find tag %zd", pool, size);
 
+	if (size == sizeof(mm->this.tag) && has_tag(tag)) {
+		uint32_t hash = hash_tag(tag);
+		struct hash_entry *e;
+
+		spa_list_for_each(e, &impl->tag_hash.buckets[hash & impl->tag_hash.mask], link) {
+			mm = SPA_CONTAINER_OF(e, struct memmap, tag_entry);
+			if (e->hash == hash && memcmp(tag, mm->this.tag, size) == 0) {
+				pw_log_debug(NAME" %p: found %p", pool, mm);
+				return &mm->this;
+			}
+		}
+		return NULL;
+	}
+
+	/* partial and empty tags can only be found by looking at all maps */
 	spa_list_for_each(b, &impl->blocks, link) {
 		spa_list_for_each(mm, &b->maps, link) {
 			if (memcmp(tag, mm->this.tag, size) == 0) {
@@ -726,3 +1089,11 @@ struct pw_memmap * pw_mempool_find_tag(struct pw_mempool *pool, uint32_t tag[5],
 	}
 	return NULL;
 }
+
+SPA_EXPORT
+int pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats)
+{
+	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
+	*stats = impl->stats;
+	return 0;
+}
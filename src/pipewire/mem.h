@@ -25,6 +25,8 @@
 #ifndef PIPEWIRE_MEM_H
 #define PIPEWIRE_MEM_H
 
+#include <spa/utils/hook.h>
+
 #include <pipewire/properties.h>
 
 #ifdef __cplusplus
@@ -39,6 +41,8 @@ enum pw_memblock_flags {
 	PW_MEMBLOCK_FLAG_SEAL = (1 << 2),
 	PW_MEMBLOCK_FLAG_MAP = (1 << 3),
 	PW_MEMBLOCK_FLAG_DONT_CLOSE = (1 << 4),
+	PW_MEMBLOCK_FLAG_LOCK = (1 << 5),	/**< used from realtime threads, lock the
+						  *  mappings when the pool locks memory */
 
 	PW_MEMBLOCK_FLAG_READWRITE = PW_MEMBLOCK_FLAG_READABLE | PW_MEMBLOCK_FLAG_WRITABLE,
 };
@@ -82,6 +86,13 @@ struct pw_memmap {
 	uint32_t tag[5];		/**< user tag */
 };
 
+/** Memory statistics of a pool */
+struct pw_mempool_stats {
+	uint64_t mapped;		/**< bytes mapped by the pool */
+	uint64_t locked;		/**< bytes of the mappings locked in memory */
+	uint32_t n_mappings;		/**< number of mappings */
+};
+
 struct pw_mempool_events {
 #define PW_VERSION_MEMPOOL_EVENTS	0
 	uint32_t version;
@@ -109,6 +120,9 @@ void pw_mempool_add_listener(struct pw_mempool *pool,
 void pw_mempool_destroy(struct pw_mempool *pool);
 
 
+/** Get the memory statistics of a pool */
+int pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats);
+
 /** Allocate a memory block from the pool */
 struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool,
 		enum pw_memblock_flags flags, uint32_t type, size_t size);
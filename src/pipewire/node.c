@@ -30,6 +30,7 @@
 #include <time.h>
 #include <sys/eventfd.h>
 
+#include <spa/support/cpu.h>
 #include <spa/support/system.h>
 #include <spa/pod/parser.h>
 #include <spa/node/utils.h>
@@ -47,6 +48,10 @@
 
 #define NAME "node"
 
+#define WAKEUP_SPIN_NSEC	(20 * SPA_NSEC_PER_USEC)
+#define WAKEUP_FUTEX_MAX_NSEC	(100 * SPA_NSEC_PER_MSEC)
+#define WAKEUP_MAX_CYCLES	8
+
 /** \cond */
 struct impl {
 	struct pw_node this;
@@ -437,6 +442,44 @@ static void result_node_sync(void *data, int seq, int res, uint32_t type, const
 	}
 }
 
+/* with node.mix-volume, the volume and mute are taken out of the Props and
+ * applied by the mixers of the peers. Returns the Props that are left for
+ * the node or NULL when there are none. */
+static struct spa_pod *take_mix_volume(struct pw_node *node,
+		struct spa_pod_builder *b, const struct spa_pod *param)
+{
+	struct spa_pod_object *obj = (struct spa_pod_object *) param;
+	struct spa_pod_prop *prop;
+	struct spa_pod_frame f;
+	float volume = node->volume;
+	bool mute = node->mute, changed = false;
+	uint32_t n_props = 0;
+
+	spa_pod_builder_push_object(b, &f, SPA_TYPE_OBJECT_Props, obj->body.id);
+	SPA_POD_OBJECT_FOREACH(obj, prop) {
+		switch (prop->key) {
+		case SPA_PROP_volume:
+			if (spa_pod_get_float(&prop->value, &volume) == 0)
+				changed = true;
+			break;
+		case SPA_PROP_mute:
+			if (spa_pod_get_bool(&prop->value, &mute) == 0)
+				changed = true;
+			break;
+		default:
+			spa_pod_builder_raw_padded(b, prop, SPA_POD_PROP_SIZE(prop));
+			n_props++;
+			break;
+		}
+	}
+	param = spa_pod_builder_pop(b, &f);
+
+	if (changed)
+		pw_node_set_mix_volume(node, volume, mute);
+
+	return n_props > 0 ? (struct spa_pod *) param : NULL;
+}
+
 static int node_set_param(void *object, uint32_t id, uint32_t flags,
 		const struct spa_pod *param)
 {
@@ -453,6 +496,15 @@ static int node_set_param(void *object, uint32_t id, uint32_t flags,
 	pw_log_debug(NAME" %p: resource %p set param %s %08x", node, resource,
 			spa_debug_type_find_name(spa_type_param, id), flags);
 
+	if (id == SPA_PARAM_Props && node->mix_volume && param != NULL &&
+	    spa_pod_is_object_type(param, SPA_TYPE_OBJECT_Props)) {
+		uint32_t size = SPA_POD_SIZE(param);
+		struct spa_pod_builder b = SPA_POD_BUILDER_INIT(alloca(size), size);
+
+		if ((param = take_mix_volume(node, &b, param)) == NULL)
+			return 0;
+	}
+
 	res = spa_node_set_param(node->node, id, flags, param);
 
 	if (res < 0) {
@@ -659,6 +711,30 @@ do_move_nodes(struct spa_loop *loop,
 	return 0;
 }
 
+/* The graph of a driver is scheduled from the data loop of the driver, move
+ * the node to that loop so that all updates to the rt lists are done from
+ * the thread that walks them. The implementation moves its own sources,
+ * like the socket of a client node, while the node is removed. */
+static void move_data_loop(struct pw_node *this, struct pw_loop *loop,
+		struct pw_executor *executor)
+{
+	bool added = this->source.loop != NULL;
+
+	pw_log_debug(NAME" %p: data loop %p->%p added:%d", this,
+			this->data_loop, loop, added);
+
+	if (added)
+		pw_loop_invoke(this->data_loop, do_node_remove, 1, NULL, 0, true, this);
+
+	this->data_loop = loop;
+	this->data_system = loop->system;
+	this->executor = executor;
+	pw_node_emit_data_loop_changed(this, loop);
+
+	if (added)
+		pw_loop_invoke(this->data_loop, do_node_add, 1, NULL, 0, true, this);
+}
+
 static void remove_segment_master(struct pw_node *driver, uint32_t node_id)
 {
 	struct pw_node_activation *a = driver->rt.activation;
@@ -701,9 +777,30 @@ int pw_node_set_driver(struct pw_node *node, struct pw_node *driver)
 		node->rt.position = &driver->rt.activation->position;
 	}
 
-	pw_loop_invoke(node->data_loop,
-		       do_move_nodes, SPA_ID_INVALID, &driver, sizeof(struct pw_node *),
-		       true, impl);
+	if (node->data_loop == driver->data_loop) {
+		pw_loop_invoke(node->data_loop,
+			       do_move_nodes, SPA_ID_INVALID, &driver, sizeof(struct pw_node *),
+			       true, impl);
+	} else {
+		move_data_loop(node, driver->data_loop, driver->executor);
+	}
+	return 0;
+}
+
+SPA_EXPORT
+int pw_node_set_mix_volume(struct pw_node *node, float volume, bool mute)
+{
+	struct pw_port *p;
+	struct pw_link *l;
+
+	pw_log_debug(NAME" %p: mix volume:%f mute:%d", node, volume, mute);
+
+	node->volume = volume;
+	node->mute = mute;
+
+	spa_list_for_each(p, &node->output_ports, link)
+		spa_list_for_each(l, &p->links, output_link)
+			pw_link_update_volume(l);
 	return 0;
 }
 
@@ -721,7 +818,7 @@ static void check_properties(struct pw_node *node)
 {
 	struct impl *impl = SPA_CONTAINER_OF(node, struct impl, this);
 	const char *str;
-	bool driver, do_recalc = false;
+	bool driver, stream, latency_tolerant, mix_volume, do_recalc = false;
 
 	if ((str = pw_properties_get(node->properties, PW_KEY_PRIORITY_MASTER))) {
 		node->priority_master = pw_properties_parse_int(str);
@@ -739,6 +836,22 @@ static void check_properties(struct pw_node *node)
 	else
 		impl->pause_on_idle = true;
 
+	if ((str = pw_properties_get(node->properties, PW_KEY_NODE_WAKEUP)) == NULL)
+		node->wakeup = PW_NODE_WAKEUP_EVENTFD;
+	else if (strcmp(str, "spin") == 0) {
+		struct spa_cpu *cpu = spa_support_find(node->core->support,
+				node->core->n_support, SPA_TYPE_INTERFACE_CPU);
+		/* spinning on one CPU only delays the peer */
+		if (cpu != NULL && spa_cpu_get_count(cpu) > 1)
+			node->wakeup = PW_NODE_WAKEUP_SPIN;
+		else
+			node->wakeup = PW_NODE_WAKEUP_EVENTFD;
+	}
+	else if (strcmp(str, "futex") == 0)
+		node->wakeup = PW_NODE_WAKEUP_FUTEX;
+	else
+		node->wakeup = PW_NODE_WAKEUP_EVENTFD;
+
 	if ((str = pw_properties_get(node->properties, PW_KEY_NODE_DRIVER)))
 		driver = pw_properties_parse_bool(str);
 	else
@@ -775,6 +888,38 @@ static void check_properties(struct pw_node *node)
 			}
 		}
 	}
+	if ((str = pw_properties_get(node->properties, PW_KEY_MEDIA_CLASS)))
+		stream = strncmp(str, "Stream/", 7) == 0;
+	else
+		stream = false;
+
+	if ((str = pw_properties_get(node->properties, PW_KEY_NODE_LATENCY_TOLERANT)))
+		latency_tolerant = pw_properties_parse_bool(str);
+	else
+		latency_tolerant = false;
+
+	if (node->stream != stream || node->latency_tolerant != latency_tolerant) {
+		node->stream = stream;
+		node->latency_tolerant = latency_tolerant;
+		do_recalc |= node->active;
+	}
+
+	if ((str = pw_properties_get(node->properties, PW_KEY_NODE_MAX_QUANTUM)))
+		node->max_quantum = SPA_CLAMP((uint32_t)pw_properties_parse_int(str),
+				MIN_QUANTUM, MAX_QUANTUM);
+	else
+		node->max_quantum = 0;
+
+	if ((str = pw_properties_get(node->properties, PW_KEY_NODE_MIX_VOLUME)))
+		mix_volume = pw_properties_parse_bool(str);
+	else
+		mix_volume = false;
+
+	if (node->mix_volume != mix_volume) {
+		node->mix_volume = mix_volume;
+		pw_node_set_mix_volume(node, node->volume, node->mute);
+	}
+
 	pw_log_debug(NAME" %p: driver:%d recalc:%d", node, node->driver, do_recalc);
 
 	if (do_recalc)
@@ -802,12 +947,17 @@ static void dump_states(struct pw_node *driver)
 	}
 }
 
+static inline int process_node(void *data);
+
 static inline int resume_node(struct pw_node *this, int status)
 {
 	struct pw_node_target *t;
 	struct timespec ts;
 	struct pw_node_activation *activation = this->rt.activation;
-	struct spa_system *data_system = this->core->data_system;
+	struct spa_system *data_system = this->data_system;
+	struct pw_executor *executor = this->executor;
+	struct pw_executor_region region;
+	bool owner = false;
 	uint64_t nsec;
 
 	spa_system_clock_gettime(data_system, CLOCK_MONOTONIC, &ts);
@@ -817,6 +967,9 @@ static inline int resume_node(struct pw_node *this, int status)
 
 	pw_log_trace_fp(NAME" %p: trigger peers %"PRIu64, this, nsec);
 
+	if (executor)
+		owner = pw_executor_begin(executor, &region);
+
 	spa_list_for_each(t, &this->rt.target_list, link) {
 		struct pw_node_activation_state *state;
 
@@ -828,9 +981,19 @@ static inline int resume_node(struct pw_node *this, int status)
 		if (pw_node_activation_state_dec(state, 1)) {
 			t->activation->status = PW_NODE_ACTIVATION_TRIGGERED;
 			t->activation->signal_time = nsec;
-			t->signal(t->data);
+			/* local nodes that became ready together can run in
+			 * parallel, remote nodes are woken up right away */
+			if (executor && t->signal == process_node)
+				pw_executor_push(executor, t);
+			else
+				t->signal(t->data);
 		}
 	}
+	/* wait for the local part of the graph, the thread that started
+	 * the cycle helps running it */
+	if (owner)
+		pw_executor_end(executor, &region);
+
 	return 0;
 }
 
@@ -852,7 +1015,7 @@ static inline int process_node(void *data)
 	struct timespec ts;
         struct pw_port *p;
 	struct pw_node_activation *a = this->rt.activation;
-	struct spa_system *data_system = this->core->data_system;
+	struct spa_system *data_system = this->data_system;
 	int status;
 
 	spa_system_clock_gettime(data_system, CLOCK_MONOTONIC, &ts);
@@ -901,10 +1064,35 @@ static inline int process_node(void *data)
 	return 0;
 }
 
+/* wait in the activation for the next trigger instead of going back to the
+ * loop. The spin only covers triggers that come right after this cycle, the
+ * futex a cycle of the graph. */
+static inline bool wait_trigger(struct pw_node *this)
+{
+	struct spa_io_position *pos = this->rt.position;
+	uint64_t period;
+
+	/* drivers start the cycle from their own sources in the loop */
+	if (this->driver)
+		return false;
+
+	if (this->wakeup == PW_NODE_WAKEUP_SPIN)
+		return pw_node_activation_wait(this->rt.activation, WAKEUP_SPIN_NSEC, 0);
+
+	if (pos == NULL || pos->clock.rate.denom == 0)
+		return false;
+
+	period = pos->clock.duration * pos->clock.rate.num *
+		SPA_NSEC_PER_SEC / pos->clock.rate.denom;
+
+	return pw_node_activation_wait(this->rt.activation, 0,
+			SPA_MIN(period * 2, (uint64_t)WAKEUP_FUTEX_MAX_NSEC));
+}
+
 static void node_on_fd_events(struct spa_source *source)
 {
 	struct pw_node *this = source->data;
-	struct spa_system *data_system = this->core->data_system;
+	struct spa_system *data_system = this->data_system;
 
 	if (source->rmask & (SPA_IO_ERR | SPA_IO_HUP)) {
 		pw_log_warn(NAME" %p: got socket error %08x", this, source->rmask);
@@ -919,6 +1107,16 @@ static void node_on_fd_events(struct spa_source *source)
 
 		pw_log_trace_fp(NAME" %p: got process", this);
 		this->rt.target.signal(this->rt.target.data);
+
+		/* go back to the loop now and then so that its other
+		 * sources are handled */
+		if (this->wakeup != PW_NODE_WAKEUP_EVENTFD) {
+			uint32_t count = 0;
+			while (count++ < WAKEUP_MAX_CYCLES && wait_trigger(this)) {
+				pw_log_trace_fp(NAME" %p: got process in activation", this);
+				this->rt.target.signal(this->rt.target.data);
+			}
+		}
 	}
 }
 
@@ -949,7 +1147,7 @@ struct pw_node *pw_node_new(struct pw_core *core,
 	struct impl *impl;
 	struct pw_node *this;
 	size_t size;
-	struct spa_system *data_system = core->data_system;
+	struct pw_data_loop *data_loop;
 	int res;
 
 	impl = calloc(1, sizeof(struct impl) + user_data_size);
@@ -960,6 +1158,7 @@ struct pw_node *pw_node_new(struct pw_core *core,
 
 	this = &impl->this;
 	this->core = core;
+	this->source.fd = -1;
 
 	if (user_data_size > 0)
                 this->user_data = SPA_MEMBER(impl, sizeof(struct impl), void);
@@ -975,7 +1174,13 @@ struct pw_node *pw_node_new(struct pw_core *core,
 
 	this->properties = properties;
 
-	if ((res = spa_system_eventfd_create(data_system, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0)
+	data_loop = pw_core_select_data_loop(core, &properties->dict);
+	this->data_loop = pw_data_loop_get_loop(data_loop);
+	this->data_system = this->data_loop->system;
+	this->executor = data_loop->executor;
+
+	if ((res = spa_system_eventfd_create(this->data_system,
+					SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0)
 		goto error_clean;
 
 	this->source.fd = res;
@@ -986,9 +1191,12 @@ struct pw_node *pw_node_new(struct pw_core *core,
 
 	size = sizeof(struct pw_node_activation);
 
+	/* the activation is shared with the clients of the node and its peers
+	 * so it gets a block of its own */
 	this->activation = pw_mempool_alloc(this->core->pool,
 			PW_MEMBLOCK_FLAG_READWRITE |
 			PW_MEMBLOCK_FLAG_SEAL |
+			PW_MEMBLOCK_FLAG_LOCK |
 			PW_MEMBLOCK_FLAG_MAP,
 			SPA_DATA_MemFd, size);
 	if (this->activation == NULL) {
@@ -1002,12 +1210,12 @@ struct pw_node *pw_node_new(struct pw_core *core,
 		goto error_clean;
 	}
 
-	this->data_loop = core->data_loop;
-
 	spa_list_init(&this->slave_list);
 
 	spa_hook_list_init(&this->listener_list);
 
+	this->volume = 1.0f;
+
 	this->info.state = PW_NODE_STATE_CREATING;
 	this->info.props = &this->properties->dict;
 	this->info.params = this->params;
@@ -1044,7 +1252,7 @@ error_clean:
 	if (this->activation)
 		pw_memblock_unref(this->activation);
 	if (this->source.fd != -1)
-		spa_system_close(this->core->data_system, this->source.fd);
+		spa_system_close(this->data_system, this->source.fd);
 	free(impl);
 error_exit:
 	if (properties)
@@ -1320,6 +1528,7 @@ static int node_ready(void *data, int status)
 
 	if (node == driver) {
 		struct pw_node_activation *a = node->rt.activation;
+		struct pw_profiler *profiler;
 		int sync_type, all_ready, update_sync, target_sync;
 		uint32_t owner[2], reposition_owner;
 
@@ -1336,6 +1545,9 @@ static int node_ready(void *data, int status)
 		update_sync = !all_ready;
 		target_sync = sync_type == SYNC_START ? true : false;
 
+		if ((profiler = __atomic_load_n(&node->core->profiler, __ATOMIC_ACQUIRE)) != NULL)
+			pw_profiler_process(profiler, node);
+
 		spa_list_for_each(t, &driver->rt.target_list, link) {
 			struct pw_node_activation *ta = t->activation;
 
@@ -1547,7 +1759,7 @@ void pw_node_destroy(struct pw_node *node)
 
 	clear_info(node);
 
-	spa_system_close(node->core->data_system, node->source.fd);
+	spa_system_close(node->data_system, node->source.fd);
 	free(impl);
 }
 
@@ -54,7 +54,7 @@ struct pw_node;
 
 /** Node events, listen to them with \ref pw_node_add_listener */
 struct pw_node_events {
-#define PW_VERSION_NODE_EVENTS	0
+#define PW_VERSION_NODE_EVENTS	1
 	uint32_t version;
 
 	/** the node is destroyed */
@@ -98,6 +98,10 @@ struct pw_node_events {
 	void (*peer_added) (void *data, struct pw_node *peer);
 	/** a peer was removed */
 	void (*peer_removed) (void *data, struct pw_node *peer);
+
+	/** the node moved to another data loop, sources of the implementation
+	 * should be moved to \a loop as well. Since version 1 */
+	void (*data_loop_changed) (void *data, struct pw_loop *loop);
 };
 
 /** Create a new node \memberof pw_node */
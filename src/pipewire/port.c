@@ -189,6 +189,45 @@ static const struct spa_node_methods schedule_mix_node = {
 	.port_reuse_buffer = schedule_mix_reuse_buffer,
 };
 
+/* the mixer resets the props when a port is added, apply them again */
+static void mix_set_volume(struct pw_port *port, struct pw_port_mix *mix)
+{
+	uint8_t buffer[256];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod *param;
+	int res;
+
+	if (!mix->have_volume)
+		return;
+
+	param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_Props, SPA_PARAM_Props,
+			SPA_PROP_volume, SPA_POD_Float(mix->volume),
+			SPA_PROP_mute,   SPA_POD_Bool(mix->mute));
+
+	if ((res = spa_node_port_set_param(port->mix,
+				mix->port.direction, mix->port.port_id,
+				SPA_PARAM_Props, 0, param)) < 0)
+		pw_log_debug(NAME" %p: can't set volume on mix %d: %s", port,
+				mix->port.port_id, spa_strerror(res));
+}
+
+int pw_port_set_mix_volume(struct pw_port *port, struct pw_port_mix *mix,
+		float volume, bool mute)
+{
+	if (!mix->have_volume && volume == 1.0f && !mute)
+		return 0;
+
+	mix->volume = volume;
+	mix->mute = mute;
+	mix->have_volume = true;
+
+	/* a mix port that is not added yet gets the volume when it is */
+	if (mix->p == port)
+		mix_set_volume(port, mix);
+	return 0;
+}
+
 SPA_EXPORT
 int pw_port_init_mix(struct pw_port *port, struct pw_port_mix *mix)
 {
@@ -207,6 +246,7 @@ int pw_port_init_mix(struct pw_port *port, struct pw_port_mix *mix)
 	mix->p = port;
 
 	spa_node_add_port(port->mix, port->direction, port_id, NULL);
+	mix_set_volume(port, mix);
 
 	res = pw_port_call_init_mix(port, mix);
 
@@ -348,6 +388,9 @@ static void update_info(struct pw_port *port, const struct spa_port_info *info)
 			if (info->params[i].flags & SPA_PARAM_INFO_READ)
 				changed_ids[n_changed_ids++] = info->params[i].id;
 
+			if (info->params[i].id == SPA_PARAM_EnumFormat)
+				pw_port_clear_enum_format(port);
+
 			port->info.params[i] = info->params[i];
 		}
 	}
@@ -474,8 +517,10 @@ int pw_port_set_mix(struct pw_port *port, struct spa_node *node, uint32_t flags)
 	port->mix = node;
 
 	if (port->mix) {
-		spa_list_for_each(mix, &port->mix_list, link)
+		spa_list_for_each(mix, &port->mix_list, link) {
 			spa_node_add_port(port->mix, mix->port.direction, mix->port.port_id, NULL);
+			mix_set_volume(port, mix);
+		}
 
 		spa_node_port_set_io(port->mix,
 			     pw_direction_reverse(port->direction), 0,
@@ -998,6 +1043,7 @@ void pw_port_destroy(struct pw_port *port)
 
 	pw_buffers_clear(&port->buffers);
 	pw_buffers_clear(&port->mix_buffers);
+	pw_port_clear_enum_format(port);
 	free((void*)port->error);
 
 	pw_map_clear(&port->mix_port_map);
@@ -1136,6 +1182,60 @@ int pw_port_is_linked(struct pw_port *port)
 	return spa_list_is_empty(&port->links) ? 0 : 1;
 }
 
+int pw_port_update_enum_format(struct pw_port *port)
+{
+	struct pw_node *node = port->node;
+	uint8_t buffer[4096];
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod *param;
+	uint32_t index = 0, n_params = 0, size = 0, len;
+	void *data = NULL, *d;
+	int res;
+
+	if (port->enum_format.serial != 0)
+		return 0;
+
+	while (true) {
+		spa_pod_builder_init(&b, buffer, sizeof(buffer));
+		if ((res = spa_node_port_enum_params_sync(node->node,
+						port->direction, port->port_id,
+						SPA_PARAM_EnumFormat, &index,
+						NULL, &param, &b)) != 1)
+			break;
+
+		len = SPA_ROUND_UP_N(SPA_POD_SIZE(param), 8);
+		if ((d = realloc(data, size + len)) == NULL) {
+			res = -errno;
+			break;
+		}
+		data = d;
+		memcpy(SPA_MEMBER(data, size, void), param, SPA_POD_SIZE(param));
+		size += len;
+		n_params++;
+	}
+	if (res < 0) {
+		free(data);
+		return res;
+	}
+
+	port->enum_format.serial = ++node->core->format_serial;
+	port->enum_format.n_params = n_params;
+	port->enum_format.size = size;
+	port->enum_format.data = data;
+	port->enum_format.configured = port->state > PW_PORT_STATE_CONFIGURE;
+
+	pw_log_debug(NAME" %p: cached %u formats, serial %"PRIu64, port,
+			n_params, port->enum_format.serial);
+	return 0;
+}
+
+SPA_EXPORT
+void pw_port_clear_enum_format(struct pw_port *port)
+{
+	free(port->enum_format.data);
+	spa_zero(port->enum_format);
+}
+
 SPA_EXPORT
 int pw_port_set_param(struct pw_port *port, uint32_t id, uint32_t flags,
 		      const struct spa_pod *param)
@@ -1177,6 +1277,10 @@ int pw_port_set_param(struct pw_port *port, uint32_t id, uint32_t flags,
 	if (id == SPA_PARAM_Format) {
 		pw_log_debug(NAME" %p: %d %p %d", port, port->state, param, res);
 
+		/* nodes can limit the EnumFormat params to the current format */
+		if (port->enum_format.configured)
+			pw_port_clear_enum_format(port);
+
 		/* setting the format always destroys the negotiated buffers */
 		pw_buffers_clear(&port->buffers);
 		pw_buffers_clear(&port->mix_buffers);
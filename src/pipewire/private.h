@@ -29,7 +29,11 @@
 extern "C" {
 #endif
 
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/types.h> /* for pthread_t */
 
 #include "pipewire/buffers.h"
@@ -55,8 +59,70 @@ extern "C" {
 #define MIN_QUANTUM		32u
 #define MAX_QUANTUM		8192u
 
+/** Configuration of the quantum adaptation of the drivers */
+struct pw_quantum_adapt {
+	float high_load;		/**< raise the quantum when the load is above */
+	float low_load;			/**< lower the quantum when the load stays below */
+	uint32_t hold;			/**< checks with low load before lowering */
+	uint32_t max_quantum;		/**< limit for drivers without node.max-quantum */
+	uint32_t interval;		/**< msec between checks, 0 when the checks
+					  *  are only done by pw_core_adapt_quantum() */
+};
+
+/** Adaptation state of a driver */
+struct pw_quantum_adapt_state {
+	uint32_t quantum;		/**< lower bound for the quantum, 0 when not adapted */
+	uint32_t low_count;		/**< consecutive checks with low load */
+	uint32_t xrun_count;		/**< xrun count at the previous check */
+};
+
+/** Check the load of a driver running with \a quantum and update the
+ * lower bound of its quantum. The quantum is doubled when the load or an
+ * xrun shows that the cycle got near the deadline and halved again after
+ * adapt->hold checks with low load.
+ * \return the new lower bound, 0 when the requested quantum is used */
+static inline uint32_t pw_quantum_adapt_update(const struct pw_quantum_adapt *adapt,
+		struct pw_quantum_adapt_state *state, uint32_t quantum, uint32_t max_quantum,
+		float load, uint32_t xrun_count)
+{
+	bool xrun = xrun_count != state->xrun_count;
+
+	state->xrun_count = xrun_count;
+
+	/* the nodes request a larger quantum by themselves */
+	if (state->quantum < quantum)
+		state->quantum = 0;
+
+	if (xrun || load > adapt->high_load) {
+		state->low_count = 0;
+		if (quantum < max_quantum)
+			state->quantum = SPA_MIN(quantum * 2, max_quantum);
+	} else if (state->quantum > 0 && load < adapt->low_load) {
+		if (++state->low_count >= adapt->hold) {
+			state->low_count = 0;
+			state->quantum /= 2;
+			if (state->quantum < MIN_QUANTUM)
+				state->quantum = 0;
+		}
+	} else {
+		state->low_count = 0;
+	}
+	return state->quantum;
+}
+
 #define MAX_PARAMS	32
 
+#define MAX_DATA_LOOPS	16
+
+#define MAX_FORMAT_MEMO	32
+
+/** The negotiated format of a pair of ports, see \ref pw_core_find_format */
+struct pw_format_memo {
+	uint64_t output_serial;		/**< serial of the EnumFormat cache of the output */
+	uint64_t input_serial;		/**< serial of the EnumFormat cache of the input */
+	struct spa_pod *format;		/**< the common format or NULL when there is none */
+};
+
 #define pw_protocol_emit_destroy(p) spa_hook_list_call(&p->listener_list, struct pw_protocol_events, destroy, 0)
 
 struct pw_protocol {
@@ -234,6 +300,21 @@ struct pw_core {
 	struct pw_loop *data_loop;	/**< data loop for data passing */
         struct pw_data_loop *data_loop_impl;
 	struct spa_system *data_system;	/**< data system for data passing */
+	struct pw_data_loop *data_loops[MAX_DATA_LOOPS];	/**< pool of data loops, the first
+								  *  one is data_loop_impl */
+	uint32_t n_data_loops;		/**< number of data loops in the pool */
+	struct pw_profiler *profiler;	/**< publisher of cycle timings or NULL */
+	struct pw_quantum_adapt quantum_adapt;	/**< quantum adaptation config */
+	struct spa_source *adapt_timer;	/**< checks the load of the drivers or NULL */
+	unsigned int quantum_adapt_enabled:1;	/**< core.quantum-adapt is set */
+	uint32_t power_save_quantum;	/**< quantum when only latency tolerant nodes
+					  *  are active or 0 */
+
+	uint64_t format_serial;		/**< last serial of the port EnumFormat caches */
+	struct pw_format_memo format_memo[MAX_FORMAT_MEMO];	/**< results of format negotiation */
+	uint32_t format_memo_next;	/**< next memo entry to replace */
+	uint32_t format_memo_hits;	/**< negotiations answered from the memo */
+	uint32_t format_memo_misses;	/**< negotiations that compared the formats */
 
 	struct spa_support support[16];	/**< support for spa plugins */
 	uint32_t n_support;		/**< number of support items */
@@ -257,6 +338,9 @@ struct pw_data_loop {
 	struct spa_source *event;
 
 	pthread_t thread;
+	char *affinity;			/**< cpus to pin the thread to or NULL */
+	struct pw_executor *executor;	/**< executor for parallel graph branches of
+					  *  the loop or NULL, owned by the core */
 	unsigned int running:1;
 };
 
@@ -389,6 +473,13 @@ struct pw_node_activation {
 	uint32_t command;				/* next command */
 	uint32_t reposition_owner;			/* owner id with new reposition info, last one
 							 * to update wins */
+
+#define PW_NODE_ACTIVATION_WAITER_NONE		0
+#define PW_NODE_ACTIVATION_WAITER_SPIN		1
+#define PW_NODE_ACTIVATION_WAITER_FUTEX		2
+	uint32_t waiter;				/* futex, set when the node thread waits in
+							 * the activation and the trigger does not need
+							 * to go through the eventfd */
 };
 
 #define ATOMIC_CAS(v,ov,nv)						\
@@ -410,6 +501,54 @@ struct pw_node_activation {
 #define SEQ_READ(s)			ATOMIC_LOAD(s)
 #define SEQ_READ_SUCCESS(s1,s2)		((s1) == (s2) && ((s2) & 1) == 0)
 
+/** Trigger a node waiting in its activation. Returns true when the node is not
+ * waiting and needs to be woken up with its eventfd */
+static inline bool pw_node_activation_wake(struct pw_node_activation *a)
+{
+	uint32_t waiter = ATOMIC_XCHG(a->waiter, PW_NODE_ACTIVATION_WAITER_NONE);
+	if (waiter == PW_NODE_ACTIVATION_WAITER_FUTEX)
+		syscall(SYS_futex, &a->waiter, FUTEX_WAKE, 1, NULL, NULL, 0);
+	return waiter == PW_NODE_ACTIVATION_WAITER_NONE;
+}
+
+/** Wait in the activation until the node is triggered, first by spinning for
+ * \a spin_nsec and then on the futex for \a futex_nsec. Returns false when
+ * nothing happened, the trigger then comes from the eventfd. */
+static inline bool pw_node_activation_wait(struct pw_node_activation *a,
+		uint64_t spin_nsec, uint64_t futex_nsec)
+{
+	struct timespec ts;
+	uint64_t now, end;
+
+	ATOMIC_STORE(a->waiter, PW_NODE_ACTIVATION_WAITER_SPIN);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = SPA_TIMESPEC_TO_NSEC(&ts);
+	end = now + spin_nsec;
+	while (now < end && ATOMIC_LOAD(a->waiter) == PW_NODE_ACTIVATION_WAITER_SPIN) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		now = SPA_TIMESPEC_TO_NSEC(&ts);
+	}
+	if (futex_nsec > 0 && ATOMIC_CAS(a->waiter,
+				PW_NODE_ACTIVATION_WAITER_SPIN,
+				PW_NODE_ACTIVATION_WAITER_FUTEX)) {
+		end = now + futex_nsec;
+		while (now < end) {
+			ts.tv_sec = (end - now) / SPA_NSEC_PER_SEC;
+			ts.tv_nsec = (end - now) % SPA_NSEC_PER_SEC;
+			syscall(SYS_futex, &a->waiter, FUTEX_WAIT,
+					PW_NODE_ACTIVATION_WAITER_FUTEX, &ts, NULL, 0);
+			if (ATOMIC_LOAD(a->waiter) != PW_NODE_ACTIVATION_WAITER_FUTEX)
+				break;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			now = SPA_TIMESPEC_TO_NSEC(&ts);
+		}
+	}
+	/* stop waiting, when the trigger came in the meantime it is ours */
+	return ATOMIC_XCHG(a->waiter, PW_NODE_ACTIVATION_WAITER_NONE) ==
+		PW_NODE_ACTIVATION_WAITER_NONE;
+}
+
 #define pw_node_emit(o,m,v,...) spa_hook_list_call(&o->listener_list, struct pw_node_events, m, v, ##__VA_ARGS__)
 #define pw_node_emit_destroy(n)			pw_node_emit(n, destroy, 0)
 #define pw_node_emit_free(n)			pw_node_emit(n, free, 0)
@@ -428,6 +567,7 @@ struct pw_node_activation {
 #define pw_node_emit_driver_changed(n,o,d)	pw_node_emit(n, driver_changed, 0, o, d)
 #define pw_node_emit_peer_added(n,p)		pw_node_emit(n, peer_added, 0, p)
 #define pw_node_emit_peer_removed(n,p)		pw_node_emit(n, peer_removed, 0, p)
+#define pw_node_emit_data_loop_changed(n,l)	pw_node_emit(n, data_loop_changed, 1, l)
 
 struct pw_node {
 	struct pw_core *core;		/**< core object */
@@ -455,9 +595,15 @@ struct pw_node {
 					  *  is selected to drive the graph */
 	unsigned int visited:1;		/**< for sorting */
 	unsigned int want_driver:1;	/**< this node wants to be assigned to a driver */
+	unsigned int stream:1;		/**< the node is a stream */
+	unsigned int latency_tolerant:1;	/**< the node can run at the power save quantum */
+	unsigned int mix_volume:1;	/**< the volume is applied by the mixers of the peers */
+	unsigned int mute:1;		/**< mute for the mixers of the peers */
 
 	uint32_t port_user_data_size;	/**< extra size for port user data */
 
+	float volume;			/**< volume for the mixers of the peers */
+
 	struct spa_list driver_link;
 	struct pw_node *driver_node;
 	struct spa_list slave_list;
@@ -484,9 +630,18 @@ struct pw_node {
 	struct spa_hook_list listener_list;
 
 	struct pw_loop *data_loop;		/**< the data loop for this node */
+	struct spa_system *data_system;		/**< system of the data loop */
+	struct pw_executor *executor;		/**< executor of the data loop or NULL */
 
 	uint32_t quantum_size;			/**< desired quantum */
 	uint32_t quantum_current;		/**< current quantum for driver */
+	uint32_t max_quantum;			/**< limit of the quantum adaptation or 0 */
+	struct pw_quantum_adapt_state adapt;	/**< quantum adaptation of the driver */
+#define PW_NODE_WAKEUP_EVENTFD	0
+#define PW_NODE_WAKEUP_SPIN	1
+#define PW_NODE_WAKEUP_FUTEX	2
+	uint32_t wakeup;			/**< how the data thread waits for the next
+						  *  trigger */
 	struct spa_source source;		/**< source to remotely trigger this node */
 	struct pw_memblock *activation;
 	struct {
@@ -518,6 +673,9 @@ struct pw_port_mix {
 	} port;
 	struct spa_io_buffers *io;
 	uint32_t id;
+	float volume;			/**< mixer gain when have_volume is set */
+	unsigned int mute:1;
+	unsigned int have_volume:1;
 	unsigned int have_buffers:1;
 };
 
@@ -579,6 +737,14 @@ struct pw_port {
 	struct pw_port_info info;
 	struct spa_param_info params[MAX_PARAMS];
 
+	struct {
+		uint64_t serial;	/**< unique serial of the cached params, 0 when invalid */
+		uint32_t n_params;	/**< number of cached params */
+		uint32_t size;		/**< used size of data */
+		void *data;		/**< the params, each padded to 8 bytes */
+		unsigned int configured:1;	/**< enumerated while the port had a format */
+	} enum_format;			/**< cache of the EnumFormat params */
+
 	struct pw_buffers buffers;	/**< buffers managed by this port, only on
 					  *  output ports, shared with all links */
 
@@ -659,6 +825,8 @@ struct pw_link {
 
 	void *user_data;
 
+	float volume;			/**< link.volume, applied by the input mixer */
+	unsigned int mute:1;		/**< link.mute */
 	unsigned int registered:1;
 	unsigned int feedback:1;
 };
@@ -887,6 +1055,29 @@ const struct pw_export_type *pw_core_find_export_type(struct pw_core *core, uint
 
 int pw_core_recalc_graph(struct pw_core *core);
 
+int pw_core_adapt_quantum(struct pw_core *core);
+
+/** Select the data loop for a node with the given properties */
+struct pw_data_loop *pw_core_select_data_loop(struct pw_core *core, const struct spa_dict *props);
+
+/** A set of tasks that one thread waits for */
+struct pw_executor_region {
+	int pending;		/**< tasks left, also the futex the owner waits on */
+};
+
+struct pw_executor *pw_executor_new(uint32_t n_workers);
+void pw_executor_destroy(struct pw_executor *executor);
+
+bool pw_executor_begin(struct pw_executor *executor, struct pw_executor_region *region);
+void pw_executor_push(struct pw_executor *executor, struct pw_node_target *target);
+void pw_executor_end(struct pw_executor *executor, struct pw_executor_region *region);
+
+struct pw_profiler *pw_profiler_new(const char *name);
+void pw_profiler_destroy(struct pw_profiler *profiler);
+
+/** Publish the timings of the last cycle of \a driver when a reader is attached */
+void pw_profiler_process(struct pw_profiler *profiler, struct pw_node *driver);
+
 /** Create a new port \memberof pw_port
  * \return a newly allocated port */
 struct pw_port *
@@ -911,6 +1102,10 @@ int pw_port_add(struct pw_port *port, struct pw_node *node);
 int pw_port_init_mix(struct pw_port *port, struct pw_port_mix *mix);
 int pw_port_release_mix(struct pw_port *port, struct pw_port_mix *mix);
 
+/** Set the volume that the mixer of the port applies to a mix port */
+int pw_port_set_mix_volume(struct pw_port *port, struct pw_port_mix *mix,
+		float volume, bool mute);
+
 void pw_port_update_state(struct pw_port *port, enum pw_port_state state, char *error);
 
 /** Unlink a port \memberof pw_port */
@@ -919,6 +1114,21 @@ void pw_port_unlink(struct pw_port *port);
 /** Destroy a port \memberof pw_port */
 void pw_port_destroy(struct pw_port *port);
 
+/** Enumerate the EnumFormat params of the port into its cache. The cache
+ * stays valid until the port reports a change of its EnumFormat param or,
+ * when it was enumerated while the port had a format, until the format
+ * changes.
+ * \return 0 on success or a negative errno */
+int pw_port_update_enum_format(struct pw_port *port);
+
+/** Drop the cached EnumFormat params of the port */
+void pw_port_clear_enum_format(struct pw_port *port);
+
+#define pw_port_enum_format_for_each(port,i,pod)				\
+	for ((i) = 0, (pod) = (struct spa_pod *)(port)->enum_format.data;	\
+	     (i) < (port)->enum_format.n_params;				\
+	     (i)++, (pod) = SPA_MEMBER((pod), SPA_ROUND_UP_N(SPA_POD_SIZE(pod), 8), struct spa_pod))
+
 /** Iterate the params of the given port. The callback should return
  * 1 to fetch the next item, 0 to stop iteration or <0 on error.
  * The function returns 0 on success or the error returned by the callback. */
@@ -971,6 +1181,10 @@ int pw_node_initialized(struct pw_node *node);
 
 int pw_node_set_driver(struct pw_node *node, struct pw_node *driver);
 
+/** Set the volume that the mixers of the peers apply to the output of a node
+ * with node.mix-volume */
+int pw_node_set_mix_volume(struct pw_node *node, float volume, bool mute);
+
 /** Prepare a link \memberof pw_link
   * Starts the negotiation of formats and buffers on \a link */
 int pw_link_prepare(struct pw_link *link);
@@ -980,6 +1194,9 @@ int pw_link_activate(struct pw_link *link);
 /** Deactivate a link \memberof pw_link */
 int pw_link_deactivate(struct pw_link *link);
 
+/** Apply the volume of the link and its output node on the input mixer */
+void pw_link_update_volume(struct pw_link *link);
+
 struct pw_control *
 pw_control_new(struct pw_core *core,
 	       struct pw_port *owner,		/**< can be NULL */
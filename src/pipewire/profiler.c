@@ -0,0 +1,183 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include "pipewire/log.h"
+#include "pipewire/profiler.h"
+#include "pipewire/private.h"
+
+#define NAME "profiler"
+
+#define N_RECORDS	16384u
+
+struct pw_profiler {
+	char path[PATH_MAX];
+	int fd;
+	size_t size;
+	struct pw_profiler_area *area;
+	uint64_t cycle;
+};
+
+struct pw_profiler *pw_profiler_new(const char *name)
+{
+	struct pw_profiler *this;
+	struct pw_profiler_area *area;
+	const char *runtime_dir;
+	int res;
+
+	if ((runtime_dir = getenv("XDG_RUNTIME_DIR")) == NULL) {
+		pw_log_error(NAME": XDG_RUNTIME_DIR not set in the environment");
+		errno = EIO;
+		return NULL;
+	}
+
+	this = calloc(1, sizeof(*this));
+	if (this == NULL)
+		return NULL;
+
+	if (snprintf(this->path, sizeof(this->path), "%s/%s.profiler",
+				runtime_dir, name) >= (int)sizeof(this->path)) {
+		res = -ENAMETOOLONG;
+		goto error_free;
+	}
+
+	/* the file of another daemon is only touched after we own the lock */
+	this->fd = open(this->path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (this->fd < 0) {
+		res = -errno;
+		pw_log_error(NAME" %p: can't open %s: %m", this, this->path);
+		goto error_free;
+	}
+	if (flock(this->fd, LOCK_EX | LOCK_NB) < 0) {
+		res = -errno;
+		pw_log_error(NAME" %p: can't lock %s: %m (maybe another daemon is running)",
+				this, this->path);
+		goto error_close;
+	}
+
+	this->size = sizeof(struct pw_profiler_area) +
+		N_RECORDS * sizeof(struct pw_profiler_record);
+
+	/* clear what a previous daemon left behind */
+	if (ftruncate(this->fd, 0) < 0 ||
+	    ftruncate(this->fd, this->size) < 0) {
+		res = -errno;
+		goto error_unlink;
+	}
+
+	area = mmap(NULL, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+	if (area == MAP_FAILED) {
+		res = -errno;
+		goto error_unlink;
+	}
+
+	area->version = PW_PROFILER_VERSION;
+	area->n_records = N_RECORDS;
+	area->record_size = sizeof(struct pw_profiler_record);
+	ATOMIC_STORE(area->magic, PW_PROFILER_MAGIC);
+	this->area = area;
+
+	pw_log_debug(NAME" %p: new %s", this, this->path);
+
+	return this;
+
+error_unlink:
+	unlink(this->path);
+error_close:
+	close(this->fd);
+error_free:
+	free(this);
+	errno = -res;
+	return NULL;
+}
+
+void pw_profiler_destroy(struct pw_profiler *profiler)
+{
+	pw_log_debug(NAME" %p: destroy", profiler);
+
+	munmap(profiler->area, profiler->size);
+	unlink(profiler->path);
+	close(profiler->fd);
+	free(profiler);
+}
+
+/* called from the data loop of the driver when it starts a new cycle, the
+ * activations of the targets still contain the timings of the previous one.
+ * Drivers on different data loops can publish at the same time so slots are
+ * taken with an atomic add. */
+void pw_profiler_process(struct pw_profiler *profiler, struct pw_node *driver)
+{
+	struct pw_profiler_area *area = profiler->area;
+	struct pw_node_activation *a = driver->rt.activation;
+	struct pw_node_target *t;
+	uint64_t cycle, period, reader_time;
+
+	/* only publish while a reader is alive */
+	reader_time = __atomic_load_n(&area->reader_time, __ATOMIC_RELAXED);
+	if (reader_time == 0 ||
+	    a->signal_time > reader_time + PW_PROFILER_READER_TIMEOUT)
+		return;
+
+	cycle = __atomic_add_fetch(&profiler->cycle, 1, __ATOMIC_RELAXED);
+	period = a->signal_time > a->prev_signal_time ?
+		a->signal_time - a->prev_signal_time : 0;
+
+	spa_list_for_each(t, &driver->rt.target_list, link) {
+		struct pw_node_activation *ta = t->activation;
+		struct pw_profiler_record *r;
+		uint64_t index;
+
+		if (t->node == NULL)
+			continue;
+
+		index = __atomic_fetch_add(&area->write_index, 1, __ATOMIC_RELAXED);
+		r = &area->records[index & (N_RECORDS - 1)];
+
+		__atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+
+		r->cycle = cycle;
+		r->driver_id = driver->info.id;
+		r->node_id = t->node->info.id;
+		r->quantum = a->position.clock.duration;
+		r->rate = a->position.clock.rate.denom;
+		r->period = period;
+		r->signal_time = ta->signal_time;
+		r->awake_time = ta->awake_time;
+		r->finish_time = ta->finish_time;
+		r->status = ta->status;
+		r->xrun_count = ta->xrun_count;
+
+		__atomic_store_n(&r->seq, index + 1, __ATOMIC_RELEASE);
+	}
+}
@@ -0,0 +1,112 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PIPEWIRE_PROFILER_H
+#define PIPEWIRE_PROFILER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** \page page_profiler Profiler
+ *
+ * A daemon core publishes the timings of every graph cycle in a ring of
+ * records in the shared file $XDG_RUNTIME_DIR/<core name>.profiler.
+ *
+ * The driver only writes records while a reader is attached. A reader
+ * maps the file read-write and stores the CLOCK_MONOTONIC time in
+ * reader_time at least every PW_PROFILER_READER_TIMEOUT. A reader that
+ * exits or crashes stops doing this and the driver stops writing records
+ * soon after. The reader follows write_index. Records that were
+ * overwritten before they could be read are detected with the seq field.
+ */
+
+#define PW_PROFILER_MAGIC	0x50575046	/**< "PWPF" */
+#define PW_PROFILER_VERSION	1
+
+/** time after which a reader that didn't update reader_time is gone */
+#define PW_PROFILER_READER_TIMEOUT	(1000 * 1000 * 1000ull)
+
+/** values of the status field, the activation states of the node */
+#define PW_PROFILER_STATUS_NOT_TRIGGERED	0
+#define PW_PROFILER_STATUS_TRIGGERED		1
+#define PW_PROFILER_STATUS_AWAKE		2
+#define PW_PROFILER_STATUS_FINISHED		3
+
+/** The timings of one node in one cycle of a driver */
+struct pw_profiler_record {
+	uint64_t seq;			/**< index + 1 of the record, 0 while writing */
+	uint64_t cycle;			/**< cycle counter of the profiler */
+	uint32_t driver_id;		/**< id of the driver of the cycle */
+	uint32_t node_id;		/**< id of the node */
+	uint32_t quantum;		/**< duration of the cycle in samples */
+	uint32_t rate;			/**< sample rate of the driver */
+	uint64_t period;		/**< time since the previous cycle in nsec */
+	uint64_t signal_time;		/**< time the node was triggered */
+	uint64_t awake_time;		/**< time the node started processing */
+	uint64_t finish_time;		/**< time the node finished processing */
+	uint32_t status;		/**< PW_PROFILER_STATUS_ at the end of the cycle */
+	uint32_t xrun_count;		/**< total number of xruns of the node */
+};
+
+/** The header of the shared area, followed by the records */
+struct pw_profiler_area {
+	uint32_t magic;			/**< PW_PROFILER_MAGIC */
+	uint32_t version;		/**< PW_PROFILER_VERSION */
+	uint32_t n_records;		/**< number of records, a power of 2 */
+	uint32_t record_size;		/**< size of a record */
+	uint32_t padding[4];
+	uint64_t write_index;		/**< index of the next record to write */
+	uint64_t reader_time;		/**< time a reader was last active or 0 */
+	struct pw_profiler_record records[0];
+};
+
+/** Mark a reader active at \a now, the CLOCK_MONOTONIC time in nsec */
+static inline void pw_profiler_area_keep_alive(struct pw_profiler_area *area, uint64_t now)
+{
+	__atomic_store_n(&area->reader_time, now, __ATOMIC_RELAXED);
+}
+
+/** Copy the record at \a index into \a rec.
+ * \return false when the record was overwritten or is still being written */
+static inline bool pw_profiler_area_read(struct pw_profiler_area *area,
+		uint64_t index, struct pw_profiler_record *rec)
+{
+	struct pw_profiler_record *r = &area->records[index & (area->n_records - 1)];
+
+	if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != index + 1)
+		return false;
+	*rec = *r;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&r->seq, __ATOMIC_RELAXED) == index + 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PIPEWIRE_PROFILER_H */
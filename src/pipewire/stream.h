@@ -133,6 +133,11 @@ extern "C" {
  *
  * Filled buffers should be queued with \ref pw_stream_queue_buffer().
  *
+ * A buffer with only silence can be marked by setting
+ * SPA_META_HEADER_FLAG_GAP in its struct spa_meta_header, audio buffers
+ * have one. The converters and mixers then skip the buffer. The flag
+ * must be cleared again when the buffer is refilled with sound.
+ *
  * The process event is emited when PipeWire has emptied a buffer that
  * can now be refilled.
  *
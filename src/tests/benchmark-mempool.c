@@ -0,0 +1,107 @@
+/* PipeWire
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <spa/buffer/buffer.h>
+
+#include <pipewire/mem.h>
+
+#define MAX_BLOCKS	4096
+#define N_LOOKUPS	(1 << 20)
+#define BLOCK_SIZE	4096
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void run_test(uint32_t n_blocks)
+{
+	static struct pw_memblock *blocks[MAX_BLOCKS];
+	struct pw_mempool *pool;
+	struct pw_memblock *b;
+	struct pw_memmap *mm;
+	uint64_t t1, t2, t3, t4;
+	uint32_t i, idx, tag[5] = { 0, };
+
+	pool = pw_mempool_new(NULL);
+	spa_assert(pool != NULL);
+
+	for (i = 0; i < n_blocks; i++) {
+		blocks[i] = pw_mempool_alloc(pool,
+				PW_MEMBLOCK_FLAG_READWRITE |
+				PW_MEMBLOCK_FLAG_MAP,
+				SPA_DATA_MemFd, BLOCK_SIZE);
+		spa_assert(blocks[i] != NULL);
+		/* like the io areas and buffers of client-node */
+		tag[0] = 1;
+		tag[1] = i;
+		spa_assert(pw_memblock_map(blocks[i], PW_MEMMAP_FLAG_READWRITE,
+				0, BLOCK_SIZE, tag) != NULL);
+	}
+
+	/* visit the blocks in a scattered order */
+	t1 = get_time();
+	for (i = 0, idx = 0; i < N_LOOKUPS; i++, idx = (idx + 7919) % n_blocks) {
+		b = pw_mempool_find_ptr(pool,
+				SPA_MEMBER(blocks[idx]->map->ptr, i % BLOCK_SIZE, void));
+		spa_assert(b == blocks[idx]);
+	}
+	t2 = get_time();
+	for (i = 0, idx = 0; i < N_LOOKUPS; i++, idx = (idx + 7919) % n_blocks) {
+		b = pw_mempool_find_fd(pool, blocks[idx]->fd);
+		spa_assert(b == blocks[idx]);
+	}
+	t3 = get_time();
+	for (i = 0, idx = 0; i < N_LOOKUPS; i++, idx = (idx + 7919) % n_blocks) {
+		tag[0] = 1;
+		tag[1] = idx;
+		mm = pw_mempool_find_tag(pool, tag, sizeof(tag));
+		spa_assert(mm != NULL && mm->block == blocks[idx]);
+	}
+	t4 = get_time();
+
+	printf("blocks %5u: find_ptr %6.1f ns, find_fd %6.1f ns, find_tag %6.1f ns\n",
+			n_blocks,
+			(double)(t2 - t1) / N_LOOKUPS,
+			(double)(t3 - t2) / N_LOOKUPS,
+			(double)(t4 - t3) / N_LOOKUPS);
+
+	pw_mempool_destroy(pool);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t n_blocks;
+
+	for (n_blocks = 16; n_blocks <= MAX_BLOCKS; n_blocks *= 4)
+		run_test(n_blocks);
+
+	return 0;
+}
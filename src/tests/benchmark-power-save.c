@@ -0,0 +1,279 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+#include "test-node.h"
+
+/* A driver with latency tolerant and interactive streams linked to it, run
+ * by a core in power save mode. For each mix of streams, checks the quantum
+ * the core selects and counts the wakeups of the data loop, the cycles of
+ * the driver and the CPU time of the data thread. */
+#define DURATION_SEC	2
+#define MAX_ITERATIONS	1000
+
+struct node {
+	struct spa_handle *handle;
+	struct spa_node *impl;
+	struct pw_node *node;
+	struct pw_link *link;
+};
+
+struct data {
+	struct pw_core *core;
+	struct pw_loop *loop;
+	struct pw_loop *data_loop;
+	struct spa_hook hook_listener;
+
+	struct node driver;
+
+	uint32_t wakeups;
+	uint32_t n_wakeups;
+	uint64_t cpu_time;
+};
+
+static void do_after(void *data)
+{
+	struct data *d = data;
+	d->wakeups++;
+}
+
+static const struct spa_loop_control_hooks hooks = {
+	SPA_VERSION_LOOP_CONTROL_HOOKS,
+	.after = do_after,
+};
+
+static int do_add_hook(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	pw_loop_add_hook(d->data_loop, &d->hook_listener, &hooks, d);
+	return 0;
+}
+
+static int do_remove_hook(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	spa_hook_remove(&d->hook_listener);
+	return 0;
+}
+
+static uint64_t get_time(clockid_t id)
+{
+	struct timespec ts;
+	clock_gettime(id, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+/* runs in the data thread, the counters are only touched there */
+static int do_start(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	d->wakeups = 0;
+	d->cpu_time = get_time(CLOCK_THREAD_CPUTIME_ID);
+	return 0;
+}
+
+static int do_stop(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	d->cpu_time = get_time(CLOCK_THREAD_CPUTIME_ID) - d->cpu_time;
+	d->n_wakeups = d->wakeups;
+	return 0;
+}
+
+static void node_init(struct node *n, struct pw_core *core, struct pw_properties *props)
+{
+	const struct spa_support *support;
+	uint32_t n_support;
+	void *iface;
+
+	support = pw_core_get_support(core, &n_support);
+
+	n->handle = calloc(1, spa_handle_factory_get_size(&test_node_factory, NULL));
+	spa_assert(n->handle != NULL);
+	spa_assert(spa_handle_factory_init(&test_node_factory, n->handle,
+			&props->dict, support, n_support) >= 0);
+	spa_assert(spa_handle_get_interface(n->handle,
+			SPA_TYPE_INTERFACE_Node, &iface) >= 0);
+	n->impl = iface;
+	n->link = NULL;
+
+	n->node = pw_node_new(core, props, 0);
+	spa_assert(n->node != NULL);
+	spa_assert(pw_node_set_implementation(n->node, n->impl) >= 0);
+	spa_assert(pw_node_register(n->node, NULL) >= 0);
+	spa_assert(pw_node_set_active(n->node, true) >= 0);
+}
+
+static void node_clear(struct node *n)
+{
+	if (n->link)
+		pw_link_destroy(n->link);
+	pw_node_destroy(n->node);
+	spa_handle_clear(n->handle);
+	free(n->handle);
+}
+
+/* a stream that takes the output of the driver */
+static void stream_init(struct data *d, struct node *n, const char *name,
+		const char *tolerant, const char *latency)
+{
+	struct pw_port *output, *input;
+	const struct test_node_stats *stats;
+	int i;
+
+	node_init(n, d->core, pw_properties_new(
+				PW_KEY_NODE_NAME, name,
+				PW_KEY_MEDIA_CLASS, "Stream/Input/Audio",
+				PW_KEY_NODE_LATENCY_TOLERANT, tolerant,
+				PW_KEY_NODE_LATENCY, latency,
+				"test.direction", "input",
+				NULL));
+
+	output = pw_node_find_port(d->driver.node, PW_DIRECTION_OUTPUT, 0);
+	input = pw_node_find_port(n->node, PW_DIRECTION_INPUT, 0);
+	spa_assert(output != NULL && input != NULL);
+
+	n->link = pw_link_new(d->core, output, input, NULL, NULL, 0);
+	spa_assert(n->link != NULL);
+	spa_assert(pw_link_register(n->link, NULL) >= 0);
+
+	stats = test_node_get_stats(n->impl);
+	for (i = 0; i < MAX_ITERATIONS &&
+	    (n->node->info.state != PW_NODE_STATE_RUNNING || stats->cycles < 2); i++)
+		pw_loop_iterate(d->loop, 10);
+	spa_assert(n->node->info.state == PW_NODE_STATE_RUNNING);
+}
+
+/* checks that the driver runs at the expected quantum and measures the
+ * wakeups, returns the wakeups per second */
+static double run_test(struct data *d, uint32_t quantum, const char *name)
+{
+	const struct test_node_stats *stats = test_node_get_stats(d->driver.impl);
+	struct pw_node *driver = d->driver.node;
+	uint64_t start, now;
+	uint32_t timeouts;
+	double wakeups, cycles;
+	int i;
+
+	spa_assert(driver->quantum_current == quantum);
+	spa_assert(driver->rt.position->clock.duration == quantum);
+
+	/* the timer of the old quantum may still be pending */
+	timeouts = stats->timeouts;
+	for (i = 0; i < MAX_ITERATIONS && stats->timeouts - timeouts < 2; i++)
+		pw_loop_iterate(d->loop, 10);
+	spa_assert(stats->timeouts - timeouts >= 2);
+
+	pw_loop_invoke(d->data_loop, do_start, 0, NULL, 0, true, d);
+	timeouts = stats->timeouts;
+
+	start = now = get_time(CLOCK_MONOTONIC);
+	while (now - start < DURATION_SEC * SPA_NSEC_PER_SEC) {
+		pw_loop_iterate(d->loop, 10);
+		now = get_time(CLOCK_MONOTONIC);
+	}
+	pw_loop_invoke(d->data_loop, do_stop, 0, NULL, 0, true, d);
+
+	/* the invoke of do_start woke up the loop as well */
+	wakeups = (double)(d->n_wakeups - 1) / DURATION_SEC;
+	cycles = (double)(stats->timeouts - timeouts) / DURATION_SEC;
+
+	fprintf(stderr, "%-12s quantum %5u: %6.1f wakeups/s %6.1f cycles/s cpu %6.1f usec/s\n",
+			name, quantum, wakeups, cycles,
+			(double)d->cpu_time / 1000.0 / DURATION_SEC);
+
+	return wakeups;
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_main_loop *loop;
+	struct data data = { 0, };
+	struct node player, interactive;
+	struct spa_dict_item items[1];
+	double power_save, interactive_wakeups, normal;
+
+	pw_init(&argc, &argv);
+
+	loop = pw_main_loop_new(NULL);
+	data.core = pw_core_new(pw_main_loop_get_loop(loop),
+			pw_properties_new(
+				PW_KEY_CORE_POWER_SAVE, "true",
+				NULL), 0);
+	spa_assert(data.core != NULL);
+	spa_assert(data.core->power_save_quantum == MAX_QUANTUM);
+	data.loop = pw_core_get_main_loop(data.core);
+	data.data_loop = pw_core_get_data_loop(data.core, 0);
+
+	pw_loop_invoke(data.data_loop, do_add_hook, 0, NULL, 0, true, &data);
+	pw_loop_enter(data.loop);
+
+	node_init(&data.driver, data.core, pw_properties_new(
+				PW_KEY_NODE_NAME, "driver",
+				PW_KEY_NODE_DRIVER, "true",
+				"test.direction", "output",
+				NULL));
+
+	/* only a latency tolerant stream, its node.latency is ignored */
+	stream_init(&data, &player, "player", "true", "1024/48000");
+	power_save = run_test(&data, MAX_QUANTUM, "power save");
+
+	/* an interactive stream joins and gets its latency */
+	stream_init(&data, &interactive, "interactive", "false", "256/48000");
+	interactive_wakeups = run_test(&data, 256, "interactive");
+
+	/* and leaves again */
+	node_clear(&interactive);
+	run_test(&data, MAX_QUANTUM, "power save");
+
+	/* the player is not latency tolerant anymore and gets its latency */
+	items[0] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_LATENCY_TOLERANT, "false");
+	pw_node_update_properties(player.node, &SPA_DICT_INIT_ARRAY(items));
+	normal = run_test(&data, DEFAULT_QUANTUM, "default");
+
+	/* a cycle at 8192 samples replaces 8 at 1024 and 32 at 256 */
+	spa_assert(power_save * 4 < normal);
+	spa_assert(normal * 2 < interactive_wakeups);
+
+	node_clear(&player);
+	node_clear(&data.driver);
+
+	pw_loop_leave(data.loop);
+	pw_loop_invoke(data.data_loop, do_remove_hook, 0, NULL, 0, true, &data);
+
+	pw_core_destroy(data.core);
+	pw_main_loop_destroy(loop);
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+#include "test-node.h"
+
+#define N_RELINKS	8
+#define MAX_ITERATIONS	1000
+
+struct node {
+	struct spa_handle *handle;
+	struct spa_node *impl;
+	struct pw_node *node;
+	struct pw_port *port;
+};
+
+static void node_init(struct node *n, struct pw_core *core,
+		const char *name, enum pw_direction direction)
+{
+	struct spa_dict_item items[1];
+	const struct spa_support *support;
+	uint32_t n_support;
+	void *iface;
+
+	items[0] = SPA_DICT_ITEM_INIT("test.direction",
+			direction == PW_DIRECTION_INPUT ? "input" : "output");
+	support = pw_core_get_support(core, &n_support);
+
+	n->handle = calloc(1, spa_handle_factory_get_size(&test_node_factory, NULL));
+	spa_assert(n->handle != NULL);
+	spa_assert(spa_handle_factory_init(&test_node_factory, n->handle,
+			&SPA_DICT_INIT_ARRAY(items), support, n_support) >= 0);
+	spa_assert(spa_handle_get_interface(n->handle,
+			SPA_TYPE_INTERFACE_Node, &iface) >= 0);
+	n->impl = iface;
+
+	n->node = pw_node_new(core, pw_properties_new(PW_KEY_NODE_NAME, name, NULL), 0);
+	spa_assert(n->node != NULL);
+	spa_assert(pw_node_set_implementation(n->node, n->impl) >= 0);
+	spa_assert(pw_node_register(n->node, NULL) >= 0);
+	spa_assert(pw_node_set_active(n->node, true) >= 0);
+
+	n->port = pw_node_find_port(n->node, direction, 0);
+	spa_assert(n->port != NULL);
+}
+
+static void node_clear(struct node *n)
+{
+	pw_node_destroy(n->node);
+	spa_handle_clear(n->handle);
+	free(n->handle);
+}
+
+static bool ports_in_state(struct node *out, struct node *in, enum pw_port_state state)
+{
+	if (state == PW_PORT_STATE_CONFIGURE)
+		return out->port->state == state && in->port->state == state;
+	return out->port->state >= state && in->port->state >= state;
+}
+
+static void wait_ports(struct pw_loop *loop, struct node *out, struct node *in,
+		enum pw_port_state state)
+{
+	int i;
+
+	for (i = 0; i < MAX_ITERATIONS && !ports_in_state(out, in, state); i++)
+		pw_loop_iterate(loop, 10);
+	spa_assert(ports_in_state(out, in, state));
+}
+
+static void wait_nodes(struct pw_loop *loop, struct node *out, struct node *in,
+		enum pw_node_state state)
+{
+	int i;
+
+	for (i = 0; i < MAX_ITERATIONS &&
+	    (out->node->info.state != state || in->node->info.state != state); i++)
+		pw_loop_iterate(loop, 10);
+	spa_assert(out->node->info.state == state && in->node->info.state == state);
+}
+
+/* link the ports until the nodes run, unlink and suspend the nodes
+ * so that the ports need a format again */
+static void relink(struct pw_core *core, struct node *out, struct node *in)
+{
+	struct pw_loop *loop = pw_core_get_main_loop(core);
+	struct pw_link *link;
+
+	link = pw_link_new(core, out->port, in->port, NULL, NULL, 0);
+	spa_assert(link != NULL);
+	spa_assert(pw_link_register(link, NULL) >= 0);
+
+	wait_ports(loop, out, in, PW_PORT_STATE_PAUSED);
+	wait_nodes(loop, out, in, PW_NODE_STATE_RUNNING);
+
+	pw_link_destroy(link);
+	pw_node_set_state(out->node, PW_NODE_STATE_SUSPENDED);
+	pw_node_set_state(in->node, PW_NODE_STATE_SUSPENDED);
+
+	wait_ports(loop, out, in, PW_PORT_STATE_CONFIGURE);
+}
+
+static void test_relink(struct pw_core *core)
+{
+	struct node out, in;
+	const struct test_node_stats *os, *is;
+	uint32_t hits, misses, i;
+
+	node_init(&out, core, "out", PW_DIRECTION_OUTPUT);
+	node_init(&in, core, "in", PW_DIRECTION_INPUT);
+	os = test_node_get_stats(out.impl);
+	is = test_node_get_stats(in.impl);
+
+	hits = core->format_memo_hits;
+	misses = core->format_memo_misses;
+
+	/* only the first negotiation compares the formats, the ports are
+	 * enumerated once */
+	for (i = 0; i < N_RELINKS; i++)
+		relink(core, &out, &in);
+
+	fprintf(stderr, "relinks:%u memo hits:%u misses:%u enum out:%u in:%u\n",
+			N_RELINKS, core->format_memo_hits - hits,
+			core->format_memo_misses - misses,
+			os->enum_format, is->enum_format);
+
+	spa_assert(core->format_memo_hits - hits == N_RELINKS - 1);
+	spa_assert(core->format_memo_misses - misses == 1);
+	spa_assert(os->enum_format == 1);
+	spa_assert(is->enum_format == 1);
+
+	/* a change of the EnumFormat params is seen by the next negotiation,
+	 * the ports are enumerated again and the result is remembered */
+	test_node_set_rate(out.impl, 44100);
+	test_node_set_rate(in.impl, 44100);
+
+	relink(core, &out, &in);
+	spa_assert(core->format_memo_hits - hits == N_RELINKS - 1);
+	spa_assert(core->format_memo_misses - misses == 2);
+	spa_assert(os->enum_format == 2);
+	spa_assert(is->enum_format == 2);
+
+	relink(core, &out, &in);
+	spa_assert(core->format_memo_hits - hits == N_RELINKS);
+	spa_assert(core->format_memo_misses - misses == 2);
+	spa_assert(os->enum_format == 2);
+	spa_assert(is->enum_format == 2);
+
+	node_clear(&out);
+	node_clear(&in);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_main_loop *loop;
+	struct pw_core *core;
+
+	pw_init(&argc, &argv);
+
+	loop = pw_main_loop_new(NULL);
+	core = pw_core_new(pw_main_loop_get_loop(loop), NULL, 0);
+	spa_assert(core != NULL);
+
+	pw_loop_enter(pw_core_get_main_loop(core));
+	test_relink(core);
+	pw_loop_leave(pw_core_get_main_loop(core));
+
+	pw_core_destroy(core);
+	pw_main_loop_destroy(loop);
+
+	return 0;
+}
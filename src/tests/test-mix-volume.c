@@ -0,0 +1,264 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+#include "test-node.h"
+
+#define MAX_ITERATIONS	1000
+
+struct node {
+	struct spa_handle *handle;
+	struct spa_node *impl;
+	struct pw_node *node;
+};
+
+/* a stream that drives the graph and a sink, linked with DSP ports so
+ * that the input port of the sink gets a mixer */
+struct graph {
+	struct pw_core *core;
+	struct pw_loop *loop;
+	struct node stream;
+	struct node sink;
+	struct pw_link *link;
+};
+
+static void node_init(struct node *n, struct pw_core *core, struct pw_properties *props)
+{
+	const struct spa_support *support;
+	uint32_t n_support;
+	void *iface;
+
+	support = pw_core_get_support(core, &n_support);
+
+	n->handle = calloc(1, spa_handle_factory_get_size(&test_node_factory, NULL));
+	spa_assert(n->handle != NULL);
+	spa_assert(spa_handle_factory_init(&test_node_factory, n->handle,
+			&props->dict, support, n_support) >= 0);
+	spa_assert(spa_handle_get_interface(n->handle,
+			SPA_TYPE_INTERFACE_Node, &iface) >= 0);
+	n->impl = iface;
+
+	n->node = pw_node_new(core, props, 0);
+	spa_assert(n->node != NULL);
+	spa_assert(pw_node_set_implementation(n->node, n->impl) >= 0);
+	spa_assert(pw_node_register(n->node, NULL) >= 0);
+	spa_assert(pw_node_set_active(n->node, true) >= 0);
+}
+
+static void node_clear(struct node *n)
+{
+	pw_node_destroy(n->node);
+	spa_handle_clear(n->handle);
+	free(n->handle);
+}
+
+static void graph_init(struct graph *g, struct pw_core *core)
+{
+	spa_zero(*g);
+	g->core = core;
+	g->loop = pw_core_get_main_loop(core);
+
+	node_init(&g->stream, core, pw_properties_new(
+				PW_KEY_NODE_NAME, "stream",
+				PW_KEY_NODE_DRIVER, "true",
+				PW_KEY_NODE_MIX_VOLUME, "true",
+				"test.direction", "output",
+				"test.dsp", "true",
+				NULL));
+	node_init(&g->sink, core, pw_properties_new(
+				PW_KEY_NODE_NAME, "sink",
+				"test.direction", "input",
+				"test.dsp", "true",
+				NULL));
+}
+
+static void graph_link(struct graph *g, struct pw_properties *props)
+{
+	struct pw_port *output, *input;
+
+	output = pw_node_find_port(g->stream.node, PW_DIRECTION_OUTPUT, 0);
+	input = pw_node_find_port(g->sink.node, PW_DIRECTION_INPUT, 0);
+	spa_assert(output != NULL && input != NULL);
+
+	g->link = pw_link_new(g->core, output, input, NULL, props, 0);
+	spa_assert(g->link != NULL);
+	spa_assert(pw_link_register(g->link, NULL) >= 0);
+}
+
+static void graph_clear(struct graph *g)
+{
+	pw_link_destroy(g->link);
+	node_clear(&g->sink);
+	node_clear(&g->stream);
+}
+
+/* let a few buffers reach the sink, a new volume ramps over one cycle */
+static float graph_sample(struct graph *g)
+{
+	const struct test_node_stats *stats = test_node_get_stats(g->sink.impl);
+	uint32_t n_data = stats->n_data;
+	int i;
+
+	for (i = 0; i < MAX_ITERATIONS && stats->n_data - n_data < 3; i++)
+		pw_loop_iterate(g->loop, 10);
+	spa_assert(stats->n_data - n_data >= 3);
+
+	return stats->sample;
+}
+
+static bool equal(float a, float b)
+{
+	return a - b < 1e-6f && b - a < 1e-6f;
+}
+
+/* wait until the sink gets a value, a new link takes a few cycles */
+static float graph_wait(struct graph *g, float value)
+{
+	const struct test_node_stats *stats = test_node_get_stats(g->sink.impl);
+	int i;
+
+	for (i = 0; i < MAX_ITERATIONS && !equal(stats->sample, value); i++)
+		pw_loop_iterate(g->loop, 10);
+
+	return graph_sample(g);
+}
+
+static void test_volume(struct pw_core *core)
+{
+	struct graph g;
+	const struct test_node_stats *stats;
+	struct spa_dict_item items[1];
+
+	graph_init(&g, core);
+	stats = test_node_get_stats(g.sink.impl);
+
+	/* the volume of the stream and of the link multiply, the first cycle
+	 * already has them and does not ramp from unity */
+	pw_node_set_mix_volume(g.stream.node, 0.8f, false);
+	graph_link(&g, pw_properties_new(
+				PW_KEY_LINK_VOLUME, "0.5",
+				NULL));
+	spa_assert(equal(graph_sample(&g), 0.5f * 0.8f));
+	spa_assert(equal(stats->first_sample, 0.5f * 0.8f));
+
+	/* the volume changes while running */
+	pw_node_set_mix_volume(g.stream.node, 0.25f, false);
+	spa_assert(equal(graph_sample(&g), 0.5f * 0.25f));
+
+	pw_node_set_mix_volume(g.stream.node, 0.25f, true);
+	spa_assert(equal(graph_sample(&g), 0.0f));
+
+	pw_node_set_mix_volume(g.stream.node, 2.0f, false);
+	spa_assert(equal(graph_sample(&g), 0.5f * 2.0f));
+
+	/* without node.mix-volume only the volume of the link is left */
+	items[0] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_MIX_VOLUME, "false");
+	pw_node_update_properties(g.stream.node, &SPA_DICT_INIT_ARRAY(items));
+	spa_assert(equal(graph_sample(&g), 0.5f));
+
+	graph_clear(&g);
+}
+
+static void test_gap(struct pw_core *core)
+{
+	struct graph g;
+	struct node other;
+	struct pw_port *output, *input;
+	struct pw_link *link;
+	const struct test_node_stats *stats;
+	uint32_t n_gap;
+
+	graph_init(&g, core);
+	stats = test_node_get_stats(g.sink.impl);
+	graph_link(&g, NULL);
+	spa_assert(equal(graph_sample(&g), 1.0f));
+	spa_assert(stats->n_gap == 0);
+
+	/* the samples of a silent input are not read, the mixer makes
+	 * silence and marks it */
+	test_node_set_gap(g.stream.impl, true);
+	n_gap = stats->n_gap;
+	spa_assert(equal(graph_sample(&g), 0.0f));
+	spa_assert(stats->n_gap - n_gap >= 2);
+
+	/* a second input that is not silent is all that is mixed */
+	node_init(&other, core, pw_properties_new(
+				PW_KEY_NODE_NAME, "other",
+				"test.direction", "output",
+				"test.dsp", "true",
+				NULL));
+	test_node_set_value(other.impl, 0.5f);
+
+	output = pw_node_find_port(other.node, PW_DIRECTION_OUTPUT, 0);
+	input = pw_node_find_port(g.sink.node, PW_DIRECTION_INPUT, 0);
+	link = pw_link_new(core, output, input, NULL, NULL, 0);
+	spa_assert(link != NULL);
+	spa_assert(pw_link_register(link, NULL) >= 0);
+
+	spa_assert(equal(graph_wait(&g, 0.5f), 0.5f));
+	n_gap = stats->n_gap;
+	spa_assert(equal(graph_sample(&g), 0.5f));
+	spa_assert(stats->n_gap == n_gap);
+
+	test_node_set_gap(g.stream.impl, false);
+	spa_assert(equal(graph_wait(&g, 1.5f), 1.5f));
+
+	/* all inputs silent */
+	test_node_set_gap(g.stream.impl, true);
+	test_node_set_gap(other.impl, true);
+	spa_assert(equal(graph_wait(&g, 0.0f), 0.0f));
+	n_gap = stats->n_gap;
+	spa_assert(equal(graph_sample(&g), 0.0f));
+	spa_assert(stats->n_gap - n_gap >= 3);
+
+	pw_link_destroy(link);
+	node_clear(&other);
+	graph_clear(&g);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_main_loop *loop;
+	struct pw_core *core;
+
+	pw_init(&argc, &argv);
+
+	loop = pw_main_loop_new(NULL);
+	core = pw_core_new(pw_main_loop_get_loop(loop), NULL, 0);
+	spa_assert(core != NULL);
+
+	pw_loop_enter(pw_core_get_main_loop(core));
+	test_volume(core);
+	test_gap(core);
+	pw_loop_leave(pw_core_get_main_loop(core));
+
+	pw_core_destroy(core);
+	pw_main_loop_destroy(loop);
+
+	return 0;
+}
@@ -0,0 +1,798 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/log.h>
+#include <spa/support/loop.h>
+#include <spa/support/system.h>
+#include <spa/utils/names.h>
+#include <spa/buffer/buffer.h>
+#include <spa/node/node.h>
+#include <spa/node/io.h>
+#include <spa/node/utils.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/param.h>
+#include <spa/pod/filter.h>
+
+#include "test-node.h"
+
+#define NAME "test-node"
+
+#define DEFAULT_QUANTUM	1024
+#define CHANNELS	2
+#define MAX_SAMPLES	8192
+#define MAX_BUFFERS	8
+
+struct port {
+	enum spa_direction direction;
+
+	uint64_t info_all;
+	struct spa_port_info info;
+	struct spa_param_info params[5];
+
+	struct spa_io_buffers *io;
+
+	unsigned int have_format:1;
+	struct spa_audio_info_raw format;
+
+	struct spa_buffer *buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+};
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct spa_log *log;
+	struct spa_loop *data_loop;
+	struct spa_system *data_system;
+
+	struct spa_hook_list hooks;
+	struct spa_callbacks callbacks;
+
+	uint64_t info_all;
+	struct spa_node_info info;
+
+	struct spa_io_position *position;
+
+	uint32_t rate;
+	uint64_t cost;
+	float value;
+	bool gap;
+	unsigned int driver:1;
+	unsigned int dsp:1;
+	unsigned int started:1;
+
+	struct spa_source timer_source;
+	uint64_t next_time;
+	bool xrun;
+
+	struct port port;
+
+	struct test_node_stats stats;
+};
+
+#define CHECK_PORT(this,d,id)	((d) == (this)->port.direction && (id) == 0)
+
+static void emit_port_info(struct impl *this, bool full)
+{
+	struct port *port = &this->port;
+
+	if (full)
+		port->info.change_mask = port->info_all;
+	if (port->info.change_mask) {
+		spa_node_emit_port_info(&this->hooks,
+				port->direction, 0, &port->info);
+		port->info.change_mask = 0;
+	}
+}
+
+static int impl_node_add_listener(void *object,
+		struct spa_hook *listener,
+		const struct spa_node_events *events,
+		void *data)
+{
+	struct impl *this = object;
+	struct spa_hook_list save;
+
+	spa_hook_list_isolate(&this->hooks, &save, listener, events, data);
+
+	this->info.change_mask = this->info_all;
+	spa_node_emit_info(&this->hooks, &this->info);
+	this->info.change_mask = 0;
+	emit_port_info(this, true);
+
+	spa_hook_list_join(&this->hooks, &save);
+
+	return 0;
+}
+
+static int impl_node_set_callbacks(void *object,
+		const struct spa_node_callbacks *callbacks,
+		void *data)
+{
+	struct impl *this = object;
+	this->callbacks = SPA_CALLBACKS_INIT(callbacks, data);
+	return 0;
+}
+
+static int impl_node_sync(void *object, int seq)
+{
+	struct impl *this = object;
+	spa_node_emit_result(&this->hooks, seq, 0, 0, NULL);
+	return 0;
+}
+
+static int impl_node_enum_params(void *object, int seq,
+		uint32_t id, uint32_t start, uint32_t num,
+		const struct spa_pod *filter)
+{
+	return 0;
+}
+
+static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
+		const struct spa_pod *param)
+{
+	return -ENOENT;
+}
+
+static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	struct impl *this = object;
+
+	switch (id) {
+	case SPA_IO_Position:
+		this->position = data;
+		break;
+	case SPA_IO_Clock:
+		break;
+	default:
+		return -ENOENT;
+	}
+	return 0;
+}
+
+static void dsp_fill(struct impl *this, struct spa_data *d)
+{
+	float *samples = d->data, value;
+	uint32_t i, n_samples = DEFAULT_QUANTUM;
+
+	if (samples == NULL)
+		return;
+
+	if (this->position && this->position->clock.duration > 0)
+		n_samples = this->position->clock.duration;
+	n_samples = SPA_MIN(n_samples, d->maxsize / (uint32_t)sizeof(float));
+
+	__atomic_load(&this->value, &value, __ATOMIC_RELAXED);
+	for (i = 0; i < n_samples; i++)
+		samples[i] = value;
+
+	d->chunk->offset = 0;
+	d->chunk->size = n_samples * sizeof(float);
+	d->chunk->stride = sizeof(float);
+}
+
+static void dsp_mark(struct impl *this, struct spa_buffer *buf)
+{
+	struct spa_meta_header *h;
+
+	if ((h = spa_buffer_find_meta_data(buf, SPA_META_Header, sizeof(*h))) == NULL)
+		return;
+
+	if (__atomic_load_n(&this->gap, __ATOMIC_RELAXED))
+		SPA_FLAG_SET(h->flags, SPA_META_HEADER_FLAG_GAP);
+	else
+		SPA_FLAG_CLEAR(h->flags, SPA_META_HEADER_FLAG_GAP);
+}
+
+/* the output always hands out the first buffer */
+static void produce(struct impl *this, struct spa_io_buffers *io)
+{
+	struct port *port = &this->port;
+
+	if (io->status != SPA_STATUS_HAVE_DATA && port->n_buffers > 0) {
+		if (this->dsp) {
+			dsp_fill(this, &port->buffers[0]->datas[0]);
+			dsp_mark(this, port->buffers[0]);
+		}
+		io->buffer_id = 0;
+		io->status = SPA_STATUS_HAVE_DATA;
+	}
+}
+
+static void set_timer(struct impl *this, bool enabled)
+{
+	struct itimerspec ts;
+
+	spa_zero(ts);
+	if (enabled) {
+		ts.it_value.tv_sec = this->next_time / SPA_NSEC_PER_SEC;
+		ts.it_value.tv_nsec = this->next_time % SPA_NSEC_PER_SEC;
+	}
+	spa_system_timerfd_settime(this->data_system,
+			this->timer_source.fd, SPA_FD_TIMER_ABSTIME, &ts, NULL);
+}
+
+/* the driver follows the quantum the core wrote in the position, like a
+ * device would */
+static void on_timeout(struct spa_source *source)
+{
+	struct impl *this = source->data;
+	uint64_t expirations, nsec, duration;
+
+	if (spa_system_timerfd_read(this->data_system,
+				this->timer_source.fd, &expirations) < 0)
+		return;
+
+	if (__atomic_exchange_n(&this->xrun, false, __ATOMIC_RELAXED))
+		spa_node_call_xrun(&this->callbacks, this->next_time, 0, NULL);
+
+	nsec = this->next_time;
+	duration = DEFAULT_QUANTUM;
+	if (this->position) {
+		struct spa_io_clock *c = &this->position->clock;
+
+		if (c->duration > 0)
+			duration = c->duration;
+		c->nsec = nsec;
+		c->position += duration;
+		c->rate = SPA_FRACTION(1, this->rate);
+		c->delay = 0;
+	}
+	this->next_time = nsec + duration * SPA_NSEC_PER_SEC / this->rate;
+	set_timer(this, true);
+
+	this->stats.timeouts++;
+
+	/* like a device, the data is there when the cycle starts */
+	if (this->port.direction == SPA_DIRECTION_OUTPUT && this->port.io)
+		produce(this, this->port.io);
+
+	spa_node_call_ready(&this->callbacks,
+			this->port.direction == SPA_DIRECTION_OUTPUT ?
+			SPA_STATUS_HAVE_DATA : SPA_STATUS_NEED_DATA);
+}
+
+static int impl_node_send_command(void *object, const struct spa_command *command)
+{
+	struct impl *this = object;
+	struct timespec now;
+
+	switch (SPA_NODE_COMMAND_ID(command)) {
+	case SPA_NODE_COMMAND_Start:
+		if (this->started)
+			return 0;
+		if (!this->port.have_format || this->port.n_buffers == 0)
+			return -EIO;
+		this->started = true;
+		if (this->driver) {
+			spa_system_clock_gettime(this->data_system, CLOCK_MONOTONIC, &now);
+			this->next_time = SPA_TIMESPEC_TO_NSEC(&now);
+			set_timer(this, true);
+		}
+		break;
+	case SPA_NODE_COMMAND_Pause:
+	case SPA_NODE_COMMAND_Suspend:
+		this->started = false;
+		if (this->driver)
+			set_timer(this, false);
+		break;
+	default:
+		return -ENOTSUP;
+	}
+	return 0;
+}
+
+static int impl_node_add_port(void *object, enum spa_direction direction,
+		uint32_t port_id, const struct spa_dict *props)
+{
+	return -ENOTSUP;
+}
+
+static int impl_node_remove_port(void *object, enum spa_direction direction,
+		uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int impl_node_port_enum_params(void *object, int seq,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t id, uint32_t start, uint32_t num,
+		const struct spa_pod *filter)
+{
+	struct impl *this = object;
+	struct port *port = &this->port;
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_result_node_params result;
+	uint32_t count = 0, stride;
+
+	spa_return_val_if_fail(num != 0, -EINVAL);
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	if (id == SPA_PARAM_EnumFormat && start == 0)
+		this->stats.enum_format++;
+
+	stride = this->dsp ? sizeof(float) : CHANNELS * sizeof(int16_t);
+
+	result.id = id;
+	result.next = start;
+      next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_EnumFormat:
+		if (result.index > 0)
+			return 0;
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_Format, id,
+			SPA_FORMAT_mediaType,      SPA_POD_Id(SPA_MEDIA_TYPE_audio),
+			SPA_FORMAT_mediaSubtype,   SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+			SPA_FORMAT_AUDIO_format,   SPA_POD_Id(this->dsp ?
+					SPA_AUDIO_FORMAT_F32P : SPA_AUDIO_FORMAT_S16),
+			SPA_FORMAT_AUDIO_rate,     SPA_POD_Int(this->rate),
+			SPA_FORMAT_AUDIO_channels, SPA_POD_Int(this->dsp ? 1 : CHANNELS));
+		break;
+	case SPA_PARAM_Format:
+		if (!port->have_format)
+			return -EIO;
+		if (result.index > 0)
+			return 0;
+		param = spa_format_audio_raw_build(&b, id, &port->format);
+		break;
+	case SPA_PARAM_Buffers:
+		if (!port->have_format)
+			return -EIO;
+		if (result.index > 0)
+			return 0;
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamBuffers, id,
+			SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(2, 1, MAX_BUFFERS),
+			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+			SPA_PARAM_BUFFERS_size,    SPA_POD_Int(MAX_SAMPLES * stride),
+			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(stride),
+			SPA_PARAM_BUFFERS_align,   SPA_POD_Int(16));
+		break;
+	case SPA_PARAM_IO:
+		if (result.index > 0)
+			return 0;
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamIO, id,
+			SPA_PARAM_IO_id,   SPA_POD_Id(SPA_IO_Buffers),
+			SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_buffers)));
+		break;
+	case SPA_PARAM_Meta:
+		if (!this->dsp || result.index > 0)
+			return 0;
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamMeta, id,
+			SPA_PARAM_META_type, SPA_POD_Id(SPA_META_Header),
+			SPA_PARAM_META_size, SPA_POD_Int(sizeof(struct spa_meta_header)));
+		break;
+	default:
+		return -ENOENT;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
+}
+
+static int port_set_format(struct impl *this, const struct spa_pod *format)
+{
+	struct port *port = &this->port;
+	struct spa_audio_info_raw info;
+	uint32_t media_type, media_subtype;
+	int res;
+
+	if (format == NULL) {
+		port->have_format = false;
+		port->n_buffers = 0;
+	} else {
+		if ((res = spa_format_parse(format, &media_type, &media_subtype)) < 0)
+			return res;
+		if (media_type != SPA_MEDIA_TYPE_audio ||
+		    media_subtype != SPA_MEDIA_SUBTYPE_raw)
+			return -EINVAL;
+
+		spa_zero(info);
+		if ((res = spa_format_audio_raw_parse(format, &info)) < 0)
+			return res;
+		if (info.format != (this->dsp ? SPA_AUDIO_FORMAT_F32P : SPA_AUDIO_FORMAT_S16) ||
+		    info.rate != this->rate ||
+		    info.channels != (this->dsp ? 1u : CHANNELS))
+			return -EINVAL;
+
+		port->format = info;
+		port->have_format = true;
+	}
+
+	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	if (port->have_format) {
+		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_READWRITE);
+		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
+	} else {
+		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	}
+	emit_port_info(this, false);
+
+	return 0;
+}
+
+static int impl_node_port_set_param(void *object,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t id, uint32_t flags,
+		const struct spa_pod *param)
+{
+	struct impl *this = object;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	switch (id) {
+	case SPA_PARAM_Format:
+		return port_set_format(this, param);
+	default:
+		return -ENOENT;
+	}
+}
+
+static int impl_node_port_use_buffers(void *object,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t flags,
+		struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	struct impl *this = object;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+	spa_return_val_if_fail(this->port.have_format, -EIO);
+	spa_return_val_if_fail(n_buffers <= MAX_BUFFERS, -EINVAL);
+
+	if (n_buffers > 0)
+		memcpy(this->port.buffers, buffers, n_buffers * sizeof(struct spa_buffer *));
+	this->port.n_buffers = n_buffers;
+	return 0;
+}
+
+static int impl_node_port_set_io(void *object,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t id, void *data, size_t size)
+{
+	struct impl *this = object;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	switch (id) {
+	case SPA_IO_Buffers:
+		this->port.io = data;
+		break;
+	default:
+		return -ENOENT;
+	}
+	return 0;
+}
+
+static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
+{
+	return 0;
+}
+
+static void spin(uint64_t usec)
+{
+	struct timespec ts;
+	uint64_t end;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	end = SPA_TIMESPEC_TO_NSEC(&ts) + usec * SPA_NSEC_PER_USEC;
+	do {
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	} while ((uint64_t)SPA_TIMESPEC_TO_NSEC(&ts) < end);
+}
+
+static void dsp_check(struct impl *this, struct spa_buffer *buf)
+{
+	struct spa_data *d = &buf->datas[0];
+	struct spa_meta_header *h;
+	const float *samples;
+	uint32_t n_samples;
+
+	if (d->data == NULL || d->chunk->size < sizeof(float))
+		return;
+
+	h = spa_buffer_find_meta_data(buf, SPA_META_Header, sizeof(*h));
+	if (h && SPA_FLAG_IS_SET(h->flags, SPA_META_HEADER_FLAG_GAP))
+		this->stats.n_gap++;
+
+	samples = SPA_MEMBER(d->data, d->chunk->offset, const float);
+	n_samples = d->chunk->size / sizeof(float);
+
+	if (this->stats.n_data++ == 0)
+		this->stats.first_sample = samples[0];
+	this->stats.sample = samples[n_samples - 1];
+}
+
+/* only dsp ports touch the contents of the buffers, the input gives them
+ * back right away */
+static int impl_node_process(void *object)
+{
+	struct impl *this = object;
+	struct port *port = &this->port;
+	struct spa_io_buffers *io = port->io;
+	uint64_t cost = __atomic_load_n(&this->cost, __ATOMIC_RELAXED);
+
+	this->stats.cycles++;
+	if (cost > 0)
+		spin(cost);
+
+	if (io == NULL)
+		return SPA_STATUS_OK;
+
+	if (port->direction == SPA_DIRECTION_OUTPUT) {
+		produce(this, io);
+		return SPA_STATUS_HAVE_DATA;
+	}
+	if (this->dsp && io->status == SPA_STATUS_HAVE_DATA &&
+	    io->buffer_id < port->n_buffers)
+		dsp_check(this, port->buffers[io->buffer_id]);
+
+	io->status = SPA_STATUS_NEED_DATA;
+	return SPA_STATUS_NEED_DATA;
+}
+
+static const struct spa_node_methods impl_node = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = impl_node_add_listener,
+	.set_callbacks = impl_node_set_callbacks,
+	.sync = impl_node_sync,
+	.enum_params = impl_node_enum_params,
+	.set_param = impl_node_set_param,
+	.set_io = impl_node_set_io,
+	.send_command = impl_node_send_command,
+	.add_port = impl_node_add_port,
+	.remove_port = impl_node_remove_port,
+	.port_enum_params = impl_node_port_enum_params,
+	.port_set_param = impl_node_port_set_param,
+	.port_use_buffers = impl_node_port_use_buffers,
+	.port_set_io = impl_node_port_set_io,
+	.port_reuse_buffer = impl_node_port_reuse_buffer,
+	.process = impl_node_process,
+};
+
+const struct test_node_stats *test_node_get_stats(struct spa_node *node)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	return &this->stats;
+}
+
+void test_node_set_rate(struct spa_node *node, uint32_t rate)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct port *port = &this->port;
+
+	this->rate = rate;
+	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	port->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+	emit_port_info(this, false);
+}
+
+void test_node_set_cost(struct spa_node *node, uint32_t usec)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	__atomic_store_n(&this->cost, usec, __ATOMIC_RELAXED);
+}
+
+void test_node_xrun(struct spa_node *node)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	__atomic_store_n(&this->xrun, true, __ATOMIC_RELAXED);
+}
+
+void test_node_set_value(struct spa_node *node, float value)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	__atomic_store(&this->value, &value, __ATOMIC_RELAXED);
+}
+
+void test_node_set_gap(struct spa_node *node, bool gap)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	__atomic_store_n(&this->gap, gap, __ATOMIC_RELAXED);
+}
+
+static int impl_get_interface(struct spa_handle *handle, uint32_t type, void **interface)
+{
+	struct impl *this = (struct impl *) handle;
+
+	switch (type) {
+	case SPA_TYPE_INTERFACE_Node:
+		*interface = &this->node;
+		break;
+	default:
+		return -ENOENT;
+	}
+	return 0;
+}
+
+static int do_remove_source(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct impl *this = user_data;
+	spa_loop_remove_source(this->data_loop, &this->timer_source);
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *this = (struct impl *) handle;
+
+	if (this->driver) {
+		spa_loop_invoke(this->data_loop, do_remove_source, 0, NULL, 0, true, this);
+		spa_system_close(this->data_system, this->timer_source.fd);
+	}
+	return 0;
+}
+
+static size_t impl_get_size(const struct spa_handle_factory *factory,
+		const struct spa_dict *params)
+{
+	return sizeof(struct impl);
+}
+
+static int impl_init(const struct spa_handle_factory *factory,
+		struct spa_handle *handle,
+		const struct spa_dict *info,
+		const struct spa_support *support,
+		uint32_t n_support)
+{
+	struct impl *this;
+	struct port *port;
+	const char *str;
+	uint32_t i;
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this = (struct impl *) handle;
+
+	for (i = 0; i < n_support; i++) {
+		switch (support[i].type) {
+		case SPA_TYPE_INTERFACE_Log:
+			this->log = support[i].data;
+			break;
+		case SPA_TYPE_INTERFACE_DataLoop:
+			this->data_loop = support[i].data;
+			break;
+		case SPA_TYPE_INTERFACE_DataSystem:
+			this->data_system = support[i].data;
+			break;
+		}
+	}
+
+	port = &this->port;
+	port->direction = SPA_DIRECTION_OUTPUT;
+	this->rate = TEST_NODE_RATE;
+	this->value = 1.0f;
+
+	if (info) {
+		if ((str = spa_dict_lookup(info, "test.direction")) != NULL &&
+		    strcmp(str, "input") == 0)
+			port->direction = SPA_DIRECTION_INPUT;
+		if ((str = spa_dict_lookup(info, "test.rate")) != NULL)
+			this->rate = atoi(str);
+		if ((str = spa_dict_lookup(info, "test.cost")) != NULL)
+			this->cost = atoi(str);
+		if ((str = spa_dict_lookup(info, "node.driver")) != NULL)
+			this->driver = strcmp(str, "true") == 0 || atoi(str) == 1;
+		if ((str = spa_dict_lookup(info, "test.dsp")) != NULL)
+			this->dsp = strcmp(str, "true") == 0 || atoi(str) == 1;
+	}
+
+	if (this->driver) {
+		if (this->data_loop == NULL || this->data_system == NULL) {
+			spa_log_error(this->log, NAME " %p: a driver needs a data loop", this);
+			return -EINVAL;
+		}
+		this->timer_source.func = on_timeout;
+		this->timer_source.data = this;
+		this->timer_source.fd = spa_system_timerfd_create(this->data_system,
+				CLOCK_MONOTONIC, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
+		this->timer_source.mask = SPA_IO_IN;
+		this->timer_source.rmask = 0;
+		spa_loop_add_source(this->data_loop, &this->timer_source);
+	}
+
+	spa_hook_list_init(&this->hooks);
+
+	this->node.iface = SPA_INTERFACE_INIT(
+			SPA_TYPE_INTERFACE_Node,
+			SPA_VERSION_NODE,
+			&impl_node, this);
+
+	this->info_all = SPA_NODE_CHANGE_MASK_FLAGS;
+	this->info = SPA_NODE_INFO_INIT();
+	if (port->direction == SPA_DIRECTION_OUTPUT)
+		this->info.max_output_ports = 1;
+	else
+		this->info.max_input_ports = 1;
+	this->info.flags = SPA_NODE_FLAG_RT;
+
+	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
+			SPA_PORT_CHANGE_MASK_PARAMS;
+	port->info = SPA_PORT_INFO_INIT();
+	port->info.flags = SPA_PORT_FLAG_NO_REF;
+	if (this->driver)
+		port->info.flags |= SPA_PORT_FLAG_LIVE;
+	port->params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	port->params[1] = SPA_PARAM_INFO(SPA_PARAM_Meta, SPA_PARAM_INFO_READ);
+	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
+	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->info.params = port->params;
+	port->info.n_params = 5;
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE_INTERFACE_Node,},
+};
+
+static int impl_enum_interface_info(const struct spa_handle_factory *factory,
+		const struct spa_interface_info **info,
+		uint32_t *index)
+{
+	switch (*index) {
+	case 0:
+		*info = &impl_interfaces[*index];
+		break;
+	default:
+		return 0;
+	}
+	(*index)++;
+	return 1;
+}
+
+const struct spa_handle_factory test_node_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	"test.node",
+	NULL,
+	impl_get_size,
+	impl_init,
+	impl_enum_interface_info,
+};
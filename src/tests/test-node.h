@@ -0,0 +1,85 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PIPEWIRE_TEST_NODE_H
+#define PIPEWIRE_TEST_NODE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/node/node.h>
+#include <spa/support/plugin.h>
+
+/* A node with one S16 stereo port for building graphs in the tests.
+ *
+ *  test.direction: "input" or "output" (default), the direction of the port
+ *  test.rate: the only rate of the EnumFormat param, 48000 by default
+ *  test.cost: busy time of each cycle in microseconds, 0 by default
+ *  node.driver: when true, a timer on the data loop starts a cycle every
+ *     quantum, the quantum is taken from the position of the driver
+ *  test.dsp: when true, the port has one channel of F32P samples like the
+ *     DSP ports of a device. An output fills its buffers with the value set
+ *     by test_node_set_value(), 1.0 by default, and an input keeps the
+ *     samples it gets in its stats. The buffers have a header with the
+ *     GAP flag.
+ */
+#define TEST_NODE_RATE	48000
+
+extern const struct spa_handle_factory test_node_factory;
+
+struct test_node_stats {
+	uint32_t enum_format;	/**< number of EnumFormat enumerations */
+	uint32_t timeouts;	/**< number of cycles started by the driver timer */
+	uint32_t cycles;	/**< number of process calls */
+	uint32_t n_data;	/**< number of buffers with data on a dsp input */
+	float first_sample;	/**< first sample of the first of them */
+	float sample;		/**< last sample of the last of them */
+	uint32_t n_gap;		/**< number of them with the GAP flag */
+};
+
+/** get the counters of a node made by test_node_factory */
+const struct test_node_stats *test_node_get_stats(struct spa_node *node);
+
+/** set the rate of the EnumFormat param and notify its change */
+void test_node_set_rate(struct spa_node *node, uint32_t rate);
+
+/** set the busy time of each cycle */
+void test_node_set_cost(struct spa_node *node, uint32_t usec);
+
+/** make a driver report an xrun in its next cycle */
+void test_node_xrun(struct spa_node *node);
+
+/** set the value of the samples of a dsp output */
+void test_node_set_value(struct spa_node *node, float value);
+
+/** mark the buffers of a dsp output as silence, the samples keep their
+ * value so that a consumer that reads them anyway is noticed */
+void test_node_set_gap(struct spa_node *node, bool gap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PIPEWIRE_TEST_NODE_H */
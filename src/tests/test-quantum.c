@@ -0,0 +1,256 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+#include "test-node.h"
+
+#define CYCLES_PER_CHECK	32
+#define HOLD			2
+#define MAX_ITERATIONS		1000
+
+struct node {
+	struct spa_handle *handle;
+	struct spa_node *impl;
+	struct pw_node *node;
+};
+
+/* a driver linked to a follower that asks for a quantum with node.latency
+ * and has a per-cycle cost to overload the graph. The core runs the graph
+ * on its data loop and the test runs the checks of the quantum adaptation
+ * after a number of cycles. */
+struct graph {
+	struct pw_core *core;
+	struct pw_loop *loop;
+	struct node driver;
+	struct node follower;
+	struct pw_link *link;
+};
+
+static void node_init(struct node *n, struct pw_core *core, struct pw_properties *props)
+{
+	const struct spa_support *support;
+	uint32_t n_support;
+	void *iface;
+
+	support = pw_core_get_support(core, &n_support);
+
+	n->handle = calloc(1, spa_handle_factory_get_size(&test_node_factory, NULL));
+	spa_assert(n->handle != NULL);
+	spa_assert(spa_handle_factory_init(&test_node_factory, n->handle,
+			&props->dict, support, n_support) >= 0);
+	spa_assert(spa_handle_get_interface(n->handle,
+			SPA_TYPE_INTERFACE_Node, &iface) >= 0);
+	n->impl = iface;
+
+	n->node = pw_node_new(core, props, 0);
+	spa_assert(n->node != NULL);
+	spa_assert(pw_node_set_implementation(n->node, n->impl) >= 0);
+	spa_assert(pw_node_register(n->node, NULL) >= 0);
+	spa_assert(pw_node_set_active(n->node, true) >= 0);
+}
+
+static void node_clear(struct node *n)
+{
+	pw_node_destroy(n->node);
+	spa_handle_clear(n->handle);
+	free(n->handle);
+}
+
+static void graph_init(struct graph *g, struct pw_core *core, const char *latency)
+{
+	struct pw_port *output, *input;
+	int i;
+
+	spa_zero(*g);
+	g->core = core;
+	g->loop = pw_core_get_main_loop(core);
+
+	node_init(&g->driver, core, pw_properties_new(
+				PW_KEY_NODE_NAME, "driver",
+				PW_KEY_NODE_DRIVER, "true",
+				"test.direction", "output",
+				NULL));
+	node_init(&g->follower, core, pw_properties_new(
+				PW_KEY_NODE_NAME, "follower",
+				PW_KEY_NODE_LATENCY, latency,
+				"test.direction", "input",
+				NULL));
+
+	output = pw_node_find_port(g->driver.node, PW_DIRECTION_OUTPUT, 0);
+	input = pw_node_find_port(g->follower.node, PW_DIRECTION_INPUT, 0);
+	spa_assert(output != NULL && input != NULL);
+
+	g->link = pw_link_new(core, output, input, NULL, NULL, 0);
+	spa_assert(g->link != NULL);
+	spa_assert(pw_link_register(g->link, NULL) >= 0);
+
+	for (i = 0; i < MAX_ITERATIONS &&
+	    test_node_get_stats(g->follower.impl)->cycles < CYCLES_PER_CHECK; i++)
+		pw_loop_iterate(g->loop, 10);
+	spa_assert(g->driver.node->info.state == PW_NODE_STATE_RUNNING);
+	spa_assert(g->follower.node->info.state == PW_NODE_STATE_RUNNING);
+}
+
+static void graph_clear(struct graph *g)
+{
+	pw_link_destroy(g->link);
+	node_clear(&g->follower);
+	node_clear(&g->driver);
+}
+
+/* let the driver run the cycles until the next check of the load and
+ * return the quantum the core selected after it */
+static uint32_t graph_check(struct graph *g)
+{
+	const struct test_node_stats *stats = test_node_get_stats(g->driver.impl);
+	struct pw_node *driver = g->driver.node;
+	uint32_t timeouts = stats->timeouts;
+	int i;
+
+	for (i = 0; i < MAX_ITERATIONS &&
+	    stats->timeouts - timeouts < CYCLES_PER_CHECK; i++)
+		pw_loop_iterate(g->loop, 10);
+	spa_assert(stats->timeouts - timeouts >= CYCLES_PER_CHECK);
+
+	pw_core_adapt_quantum(g->core);
+
+	/* the driver runs at the selected quantum from the next cycle */
+	spa_assert(driver->rt.position->clock.duration == driver->quantum_current);
+
+	return driver->quantum_current;
+}
+
+static void test_overload(struct pw_core *core)
+{
+	struct graph g;
+	struct pw_node *driver;
+	uint32_t i;
+
+	graph_init(&g, core, "256/48000");
+	driver = g.driver.node;
+
+	/* no load, nothing changes */
+	for (i = 0; i < 4; i++)
+		spa_assert(graph_check(&g) == 256);
+	spa_assert(driver->adapt.quantum == 0);
+
+	/* 4.5ms of work does not fit in 256 samples but does in 512 */
+	test_node_set_cost(g.follower.impl, 4500);
+	spa_assert(graph_check(&g) == 512);
+	for (i = 0; i < 4; i++)
+		spa_assert(graph_check(&g) == 512);
+
+	/* more work raises it again, but never above the limit */
+	test_node_set_cost(g.follower.impl, 9000);
+	spa_assert(graph_check(&g) == 1024);
+	test_node_set_cost(g.follower.impl, 18000);
+	for (i = 0; i < 4; i++)
+		spa_assert(graph_check(&g) == 1024);
+
+	/* the load is gone, step down after the hold time */
+	test_node_set_cost(g.follower.impl, 0);
+	for (i = 0; i < HOLD - 1; i++)
+		spa_assert(graph_check(&g) == 1024);
+	spa_assert(graph_check(&g) == 512);
+	for (i = 0; i < HOLD - 1; i++)
+		spa_assert(graph_check(&g) == 512);
+	spa_assert(graph_check(&g) == 256);
+	for (i = 0; i < HOLD * 2; i++)
+		spa_assert(graph_check(&g) == 256);
+	spa_assert(driver->adapt.quantum == 0);
+
+	/* an xrun of the driver raises the quantum even when the load looks
+	 * fine */
+	test_node_xrun(g.driver.impl);
+	spa_assert(graph_check(&g) == 512);
+
+	/* a load between the thresholds keeps the quantum */
+	test_node_set_cost(g.follower.impl, 4500);
+	for (i = 0; i < HOLD * 4; i++)
+		spa_assert(graph_check(&g) == 512);
+
+	graph_clear(&g);
+}
+
+static void test_request(struct pw_core *core)
+{
+	struct graph g;
+	struct pw_node *driver;
+	struct spa_dict_item items[1];
+
+	graph_init(&g, core, "128/48000");
+	driver = g.driver.node;
+
+	test_node_set_cost(g.follower.impl, 2500);
+	spa_assert(graph_check(&g) == 256);
+	spa_assert(driver->adapt.quantum == 256);
+
+	/* the follower now asks for more than the adaptation did */
+	items[0] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_LATENCY, "1024/48000");
+	pw_node_update_properties(g.follower.node, &SPA_DICT_INIT_ARRAY(items));
+	spa_assert(driver->quantum_current == 1024);
+
+	test_node_set_cost(g.follower.impl, 0);
+	spa_assert(graph_check(&g) == 1024);
+	spa_assert(driver->adapt.quantum == 0);
+
+	graph_clear(&g);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_main_loop *loop;
+	struct pw_core *core;
+
+	pw_init(&argc, &argv);
+
+	loop = pw_main_loop_new(NULL);
+	/* no timer, the test runs the checks */
+	core = pw_core_new(pw_main_loop_get_loop(loop),
+			pw_properties_new(
+				PW_KEY_CORE_QUANTUM_ADAPT, "true",
+				PW_KEY_CORE_QUANTUM_ADAPT ".high-load", "0.75",
+				PW_KEY_CORE_QUANTUM_ADAPT ".low-load", "0.3",
+				PW_KEY_CORE_QUANTUM_ADAPT ".hold", SPA_STRINGIFY(HOLD),
+				PW_KEY_CORE_QUANTUM_ADAPT ".max-quantum", "1024",
+				PW_KEY_CORE_QUANTUM_ADAPT ".interval", "0",
+				NULL), 0);
+	spa_assert(core != NULL);
+	spa_assert(core->adapt_timer == NULL);
+
+	pw_loop_enter(pw_core_get_main_loop(core));
+	test_overload(core);
+	test_request(core);
+	pw_loop_leave(pw_core_get_main_loop(core));
+
+	pw_core_destroy(core);
+	pw_main_loop_destroy(loop);
+
+	return 0;
+}
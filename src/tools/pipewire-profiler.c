@@ -0,0 +1,419 @@
+/* PipeWire
+ *
+ * Copyright © 2019 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/profiler.h>
+
+#define POLL_MSEC	100
+#define REPORT_POLLS	10
+
+struct stats {
+	uint32_t count;
+	uint32_t incomplete;
+	uint64_t wait_sum;
+	uint64_t wait_max;
+	uint64_t busy_sum;
+	uint64_t busy_max;
+	double load_sum;
+	double load_max;
+};
+
+struct node {
+	struct spa_list link;
+	uint32_t id;
+	char name[64];
+	uint32_t driver_id;
+	uint32_t quantum;
+	uint32_t rate;
+	uint32_t xrun_count;
+	uint32_t xrun_reported;
+	bool have_xrun;
+	struct stats stats;
+};
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_core *core;
+
+	struct pw_remote *remote;
+	struct spa_hook remote_listener;
+
+	struct pw_core_proxy *core_proxy;
+	struct pw_registry_proxy *registry_proxy;
+	struct spa_hook registry_listener;
+
+	struct pw_profiler_area *area;
+	size_t size;
+	uint64_t read_index;
+	uint64_t lost;
+
+	struct spa_source *timer;
+	uint32_t polls;
+
+	struct spa_list nodes;
+};
+
+static struct node *find_node(struct data *d, uint32_t id, bool create)
+{
+	struct node *n;
+
+	spa_list_for_each(n, &d->nodes, link)
+		if (n->id == id)
+			return n;
+
+	if (!create || (n = calloc(1, sizeof(*n))) == NULL)
+		return NULL;
+
+	n->id = id;
+	snprintf(n->name, sizeof(n->name), "%u", id);
+	spa_list_append(&d->nodes, &n->link);
+	return n;
+}
+
+static void add_record(struct data *d, const struct pw_profiler_record *r)
+{
+	struct node *n;
+	struct stats *s;
+	uint64_t wait, busy;
+	double load;
+
+	if ((n = find_node(d, r->node_id, true)) == NULL)
+		return;
+
+	n->driver_id = r->driver_id;
+	n->quantum = r->quantum;
+	n->rate = r->rate;
+	if (!n->have_xrun) {
+		n->xrun_reported = r->xrun_count;
+		n->have_xrun = true;
+	}
+	n->xrun_count = r->xrun_count;
+
+	s = &n->stats;
+	if (r->status != PW_PROFILER_STATUS_FINISHED) {
+		s->incomplete++;
+		return;
+	}
+	if (r->awake_time < r->signal_time || r->finish_time < r->awake_time)
+		return;
+
+	wait = r->awake_time - r->signal_time;
+	busy = r->finish_time - r->awake_time;
+	load = r->period ? (double)busy / (double)r->period : 0.0;
+
+	s->count++;
+	s->wait_sum += wait;
+	s->wait_max = SPA_MAX(s->wait_max, wait);
+	s->busy_sum += busy;
+	s->busy_max = SPA_MAX(s->busy_max, busy);
+	s->load_sum += load;
+	s->load_max = SPA_MAX(s->load_max, load);
+}
+
+static void read_records(struct data *d)
+{
+	struct pw_profiler_area *area = d->area;
+	struct pw_profiler_record r;
+	uint64_t write_index;
+
+	write_index = __atomic_load_n(&area->write_index, __ATOMIC_ACQUIRE);
+
+	if (write_index - d->read_index > area->n_records) {
+		d->lost += write_index - d->read_index - area->n_records;
+		d->read_index = write_index - area->n_records;
+	}
+	for (; d->read_index < write_index; d->read_index++) {
+		if (pw_profiler_area_read(area, d->read_index, &r))
+			add_record(d, &r);
+		else
+			d->lost++;
+	}
+}
+
+static void print_report(struct data *d)
+{
+	struct node *n;
+
+	printf("\n%5s %-24s %6s %6s %8s %8s %8s %8s %6s %6s %5s %5s\n",
+			"ID", "NAME", "QUANT", "RATE",
+			"WAIT", "MAX", "BUSY", "MAX",
+			"LOAD", "MAX", "XRUN", "ERR");
+
+	spa_list_for_each(n, &d->nodes, link) {
+		struct stats *s = &n->stats;
+
+		if (s->count == 0 && s->incomplete == 0)
+			continue;
+
+		printf("%c%4u %-24.24s %6u %6u %8.1f %8.1f %8.1f %8.1f %5.1f%% %5.1f%% %5u %5u\n",
+				n->id == n->driver_id ? '*' : ' ',
+				n->id, n->name, n->quantum, n->rate,
+				s->count ? s->wait_sum / 1000.0 / s->count : 0.0,
+				s->wait_max / 1000.0,
+				s->count ? s->busy_sum / 1000.0 / s->count : 0.0,
+				s->busy_max / 1000.0,
+				s->count ? s->load_sum * 100.0 / s->count : 0.0,
+				s->load_max * 100.0,
+				n->xrun_count - n->xrun_reported,
+				s->incomplete);
+
+		n->xrun_reported = n->xrun_count;
+		spa_zero(n->stats);
+	}
+	if (d->lost > 0) {
+		printf("lost %"PRIu64" records\n", d->lost);
+		d->lost = 0;
+	}
+	fflush(stdout);
+}
+
+static void keep_alive(struct data *d)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pw_profiler_area_keep_alive(d->area, SPA_TIMESPEC_TO_NSEC(&now));
+}
+
+static void on_timeout(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+
+	keep_alive(d);
+	read_records(d);
+
+	if (++d->polls == REPORT_POLLS) {
+		print_report(d);
+		d->polls = 0;
+	}
+}
+
+static void registry_event_global(void *data, uint32_t id,
+				  uint32_t permissions, uint32_t type, uint32_t version,
+				  const struct spa_dict *props)
+{
+	struct data *d = data;
+	struct node *n;
+	const char *str;
+
+	if (type != PW_TYPE_INTERFACE_Node)
+		return;
+
+	if ((n = find_node(d, id, true)) == NULL)
+		return;
+
+	if (props && (str = spa_dict_lookup(props, PW_KEY_NODE_NAME)))
+		snprintf(n->name, sizeof(n->name), "%s", str);
+}
+
+static void registry_event_global_remove(void *data, uint32_t id)
+{
+	struct data *d = data;
+	struct node *n;
+
+	if ((n = find_node(d, id, false)) == NULL)
+		return;
+
+	spa_list_remove(&n->link);
+	free(n);
+}
+
+static const struct pw_registry_proxy_events registry_events = {
+	PW_VERSION_REGISTRY_PROXY_EVENTS,
+	.global = registry_event_global,
+	.global_remove = registry_event_global_remove,
+};
+
+static void on_state_changed(void *_data, enum pw_remote_state old,
+			     enum pw_remote_state state, const char *error)
+{
+	struct data *data = _data;
+
+	switch (state) {
+	case PW_REMOTE_STATE_ERROR:
+		fprintf(stderr, "remote error: %s\n", error);
+		pw_main_loop_quit(data->loop);
+		break;
+
+	case PW_REMOTE_STATE_UNCONNECTED:
+		pw_main_loop_quit(data->loop);
+		break;
+
+	case PW_REMOTE_STATE_CONNECTED:
+		data->core_proxy = pw_remote_get_core_proxy(data->remote);
+		data->registry_proxy = pw_core_proxy_get_registry(data->core_proxy,
+								  PW_VERSION_REGISTRY_PROXY, 0);
+		pw_registry_proxy_add_listener(data->registry_proxy,
+					       &data->registry_listener,
+					       &registry_events, data);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const struct pw_remote_events remote_events = {
+	PW_VERSION_REMOTE_EVENTS,
+	.state_changed = on_state_changed,
+};
+
+static void do_quit(void *data, int signal_number)
+{
+	struct data *d = data;
+	pw_main_loop_quit(d->loop);
+}
+
+static int attach_area(struct data *d, const char *name)
+{
+	const char *runtime_dir;
+	char path[PATH_MAX];
+	struct stat st;
+	struct pw_profiler_area *area;
+	int fd, res = 0;
+
+	if ((runtime_dir = getenv("XDG_RUNTIME_DIR")) == NULL) {
+		fprintf(stderr, "XDG_RUNTIME_DIR not set in the environment\n");
+		return -EIO;
+	}
+	snprintf(path, sizeof(path), "%s/%s.profiler", runtime_dir, name);
+
+	if ((fd = open(path, O_RDWR | O_CLOEXEC)) < 0) {
+		res = -errno;
+		fprintf(stderr, "can't open %s: %m\n", path);
+		return res;
+	}
+	if (fstat(fd, &st) < 0 ||
+	    st.st_size < (off_t) sizeof(struct pw_profiler_area)) {
+		res = -EINVAL;
+		goto exit_close;
+	}
+
+	area = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (area == MAP_FAILED) {
+		res = -errno;
+		goto exit_close;
+	}
+	if (__atomic_load_n(&area->magic, __ATOMIC_ACQUIRE) != PW_PROFILER_MAGIC ||
+	    area->version != PW_PROFILER_VERSION ||
+	    area->record_size != sizeof(struct pw_profiler_record) ||
+	    area->n_records == 0 ||
+	    (area->n_records & (area->n_records - 1)) != 0 ||
+	    sizeof(struct pw_profiler_area) + (size_t)area->n_records *
+	    sizeof(struct pw_profiler_record) > (size_t)st.st_size) {
+		fprintf(stderr, "%s is not a compatible profiler file\n", path);
+		munmap(area, st.st_size);
+		res = -EINVAL;
+		goto exit_close;
+	}
+
+	d->area = area;
+	d->size = st.st_size;
+	d->read_index = __atomic_load_n(&area->write_index, __ATOMIC_ACQUIRE);
+	keep_alive(d);
+
+exit_close:
+	close(fd);
+	return res;
+}
+
+static void detach_area(struct data *d)
+{
+	munmap(d->area, d->size);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	struct pw_loop *l;
+	struct pw_properties *props = NULL;
+	struct node *n;
+	struct timespec value, interval;
+	const char *name;
+
+	pw_init(&argc, &argv);
+
+	spa_list_init(&data.nodes);
+
+	if (argc > 1)
+		name = argv[1];
+	else if ((name = getenv("PIPEWIRE_REMOTE")) == NULL)
+		name = "pipewire-0";
+
+	if (attach_area(&data, name) < 0)
+		return -1;
+
+	data.loop = pw_main_loop_new(NULL);
+	if (data.loop == NULL)
+		return -1;
+
+	l = pw_main_loop_get_loop(data.loop);
+	pw_loop_add_signal(l, SIGINT, do_quit, &data);
+	pw_loop_add_signal(l, SIGTERM, do_quit, &data);
+
+	data.core = pw_core_new(l, NULL, 0);
+	if (data.core == NULL)
+		return -1;
+
+	props = pw_properties_new(PW_KEY_REMOTE_NAME, name, NULL);
+
+	data.remote = pw_remote_new(data.core, props, 0);
+	if (data.remote == NULL)
+		return -1;
+
+	pw_remote_add_listener(data.remote, &data.remote_listener, &remote_events, &data);
+	if (pw_remote_connect(data.remote) < 0)
+		return -1;
+
+	data.timer = pw_loop_add_timer(l, on_timeout, &data);
+	value.tv_sec = interval.tv_sec = 0;
+	value.tv_nsec = interval.tv_nsec = POLL_MSEC * SPA_NSEC_PER_MSEC;
+	pw_loop_update_timer(l, data.timer, &value, &interval, false);
+
+	pw_main_loop_run(data.loop);
+
+	detach_area(&data);
+
+	spa_list_consume(n, &data.nodes, link) {
+		spa_list_remove(&n->link);
+		free(n);
+	}
+
+	pw_remote_destroy(data.remote);
+	pw_core_destroy(data.core);
+	pw_main_loop_destroy(data.loop);
+
+	return 0;
+}